@@ -0,0 +1,157 @@
+#ifndef OPENMM_CROSSINGLOGAGGREGATOR_H_
+#define OPENMM_CROSSINGLOGAGGREGATOR_H_
+
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "MmvtAnchorStatistics.h"
+#include "internal/windowsExportSeekr2.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace Seekr2Plugin {
+
+/**
+ * The statistics extracted from one crossing log.
+ */
+
+struct CrossingLogSummary {
+    CrossingLogSummary() : numRows(0), numInvalidRows(0) {
+    }
+    /**
+     * The file the log was read from.
+     */
+    std::string fileName;
+    /**
+     * The transition statistics of the anchor, with the milestone groups
+     * that appear in the log in ascending order. N_alpha_beta counts the
+     * valid rows for each group, a transition is counted whenever a valid
+     * row names a different group than the one before it, Ri_alpha is the
+     * time between consecutive transitions, and T_alpha is the time between
+     * the first and last valid rows. For an MMVT log these are the same
+     * quantities the integrator accumulates itself.
+     */
+    MmvtAnchorStatistics statistics;
+    /**
+     * The number of data rows in the log, including invalid ones.
+     */
+    long long numRows;
+    /**
+     * The number of rows flagged with an asterisk, which Elber integrators
+     * write when the source milestone was never crossed. These rows are
+     * excluded from the statistics.
+     */
+    long long numInvalidRows;
+};
+
+/**
+ * This class reads the crossing logs written to the outputFileName of MMVT
+ * and Elber integrators (lines of the form "group,counter,time") for any
+ * number of anchors. Each file is memory mapped and parsed directly, and the
+ * files are spread over a pool of threads.
+ *
+ * The results may be saved as a single binary table with writeTable(), which
+ * is much faster to load than the logs themselves. The table is written in
+ * native byte order, and consists of the magic string "SEEKR2XT", a 32 bit
+ * format version and number of files, followed for each file by its name
+ * (a 32 bit length and the characters), the number of milestone groups G,
+ * the G groups, N_alpha_beta (G 64 bit integers), Nij_alpha (G*G 64 bit
+ * integers in row major order), Ri_alpha (G doubles), T_alpha, and the
+ * numbers of rows and invalid rows (64 bit integers).
+ */
+
+class OPENMM_EXPORT_SEEKR2 CrossingLogAggregator {
+public:
+    CrossingLogAggregator();
+    /**
+     * Add a crossing log to read.
+     *
+     * @param fileName   the crossing log
+     * @return the index of the file, which is also the index of its summary
+     */
+    int addFile(const std::string& fileName);
+    /**
+     * Get the number of files that have been added.
+     */
+    int getNumFiles() const {
+        return fileNames.size();
+    }
+    /**
+     * Get the number of threads used for parsing. If this is 0 (the default),
+     * one thread is used for each hardware thread.
+     */
+    int getNumThreads() const {
+        return numThreads;
+    }
+    /**
+     * Set the number of threads used for parsing, or 0 to use one for each
+     * hardware thread.
+     */
+    void setNumThreads(int threads);
+    /**
+     * Read all the files that have been added.
+     */
+    void run();
+    /**
+     * Get the summary of one file. This may only be called after run().
+     *
+     * @param index   the index of the file
+     */
+    const CrossingLogSummary& getSummary(int index) const;
+    /**
+     * Write the summaries of all files to a binary table. This may only be
+     * called after run().
+     */
+    void writeTable(const std::string& fileName) const;
+    /**
+     * Read the summaries from a binary table written by writeTable().
+     */
+    static std::vector<CrossingLogSummary> readTable(const std::string& fileName);
+    /**
+     * Parse the contents of a crossing log held in memory.
+     *
+     * @param data   the contents of the log, which need not be null terminated
+     * @param size   the number of bytes in the log
+     */
+    static CrossingLogSummary parse(const char* data, size_t size);
+private:
+    std::vector<std::string> fileNames;
+    std::vector<CrossingLogSummary> summaries;
+    int numThreads;
+};
+
+} // namespace Seekr2Plugin
+
+#endif /*OPENMM_CROSSINGLOGAGGREGATOR_H_*/
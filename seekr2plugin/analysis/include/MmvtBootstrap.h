@@ -0,0 +1,194 @@
+#ifndef OPENMM_MMVTBOOTSTRAP_H_
+#define OPENMM_MMVTBOOTSTRAP_H_
+
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "MmvtKineticsEstimator.h"
+#include "internal/windowsExportSeekr2.h"
+#include <string>
+#include <vector>
+
+namespace Seekr2Plugin {
+
+/**
+ * The outcome of a bootstrap error analysis. All times are in ps and all
+ * rates in 1/ps.
+ */
+
+struct MmvtBootstrapResult {
+    MmvtBootstrapResult() : numResamples(0), numFailed(0), mfpt(0), mfptMean(0), mfptStdDev(0), 
+            mfptLower(0), mfptUpper(0), rate(0), rateLower(0), rateUpper(0) {
+    }
+    /**
+     * The number of resamples that were requested.
+     */
+    int numResamples;
+    /**
+     * The number of resamples whose kinetics could not be computed (for
+     * example because an anchor was left without any transitions), and which
+     * are excluded from the statistics below.
+     */
+    int numFailed;
+    /**
+     * The MFPT computed from the original statistics.
+     */
+    double mfpt;
+    /**
+     * The mean and standard deviation of the MFPT over the resamples.
+     */
+    double mfptMean, mfptStdDev;
+    /**
+     * The percentile confidence interval of the MFPT.
+     */
+    double mfptLower, mfptUpper;
+    /**
+     * The rate constant (the inverse of the MFPT) computed from the original
+     * statistics, and its percentile confidence interval.
+     */
+    double rate, rateLower, rateUpper;
+    /**
+     * The MFPT of every successful resample, in the order of the resamples.
+     */
+    std::vector<double> mfptSamples;
+};
+
+/**
+ * This class estimates the uncertainty of MMVT kinetics by resampling the
+ * statistics of every anchor and recomputing the MFPT for each resample. The
+ * resamples are spread over a pool of threads.
+ *
+ * For anchors whose crossing log (the file written to the integrator's
+ * outputFileName) has been supplied, the log is split into incubation
+ * segments, each running from the first bounce against one boundary to the
+ * first bounce against a different one, and the segments are resampled with
+ * replacement (a nonparametric bootstrap). For the other anchors, every
+ * count in N_alpha_beta and Nij_alpha is redrawn from a Poisson distribution
+ * with the observed count as its mean, keeping Ri_alpha and T_alpha fixed.
+ *
+ * Every resample draws its random numbers from its own generator, seeded from
+ * the random number seed and the index of the resample, so the results do
+ * not depend on the number of threads.
+ */
+
+class OPENMM_EXPORT_SEEKR2 MmvtBootstrap {
+public:
+    /**
+     * Create an MmvtBootstrap.
+     *
+     * @param estimator    the model to resample. Its anchors, boundaries and
+     *                     statistics are copied, so later changes to it have no effect.
+     */
+    explicit MmvtBootstrap(const MmvtKineticsEstimator& estimator);
+    /**
+     * Supply the crossing log of an anchor, so that its incubation segments
+     * are resampled. If the estimator has no statistics for the anchor, they
+     * are computed from the log.
+     *
+     * @param anchor      the index of the anchor
+     * @param fileName    the crossing log written by the anchor's integrator
+     */
+    void readAnchorCrossingLog(int anchor, const std::string& fileName);
+    /**
+     * Get the number of incubation segments read from an anchor's crossing log.
+     */
+    int getNumAnchorSegments(int anchor) const;
+    /**
+     * Get the number of threads used for resampling. If this is 0 (the
+     * default), one thread is used for each hardware thread.
+     */
+    int getNumThreads() const {
+        return numThreads;
+    }
+    /**
+     * Set the number of threads used for resampling, or 0 to use one for
+     * each hardware thread.
+     */
+    void setNumThreads(int threads);
+    /**
+     * Get the random number seed.
+     */
+    int getRandomNumberSeed() const {
+        return randomNumberSeed;
+    }
+    /**
+     * Set the random number seed. Runs with the same seed produce the same
+     * resamples.
+     */
+    void setRandomNumberSeed(int seed) {
+        randomNumberSeed = seed;
+    }
+    /**
+     * Resample the statistics and compute confidence intervals for the MFPT
+     * from one milestone to a set of sink milestones.
+     *
+     * @param numResamples     the number of resamples
+     * @param sourceMilestone  the milestone at which the passage starts
+     * @param sinkMilestones   the milestones at which the passage ends
+     * @param confidence       the confidence level of the intervals, such as 0.95
+     */
+    MmvtBootstrapResult run(int numResamples, int sourceMilestone, const std::vector<int>& sinkMilestones, double confidence=0.95) const;
+private:
+    /**
+     * The bounces against one boundary, up to and including the first bounce
+     * against a different boundary.
+     */
+    struct Segment {
+        int from, to, bounces;
+        double duration;
+    };
+    /**
+     * The segments of an anchor's crossing log, with indices into its
+     * milestone groups. The bounces after the last transition form a trailing
+     * segment that counts toward N_alpha_beta and T_alpha but not toward any
+     * transition, and is kept in every resample.
+     */
+    struct AnchorSegments {
+        AnchorSegments() : trailingFrom(-1), trailingBounces(0), trailingDuration(0) {
+        }
+        std::vector<Segment> segments;
+        int trailingFrom, trailingBounces;
+        double trailingDuration;
+    };
+    static MmvtAnchorStatistics buildStatistics(const std::vector<int>& milestoneGroups, const AnchorSegments& segments,
+            const std::vector<int>& segmentCounts);
+    MmvtAnchorStatistics resampleAnchor(int anchor, unsigned long long seed, int resample) const;
+    MmvtKineticsEstimator estimator;
+    std::vector<AnchorSegments> anchorSegments;
+    int numThreads, randomNumberSeed;
+};
+
+} // namespace Seekr2Plugin
+
+#endif /*OPENMM_MMVTBOOTSTRAP_H_*/
@@ -0,0 +1,164 @@
+#ifndef OPENMM_MMVTCONVERGENCEMONITOR_H_
+#define OPENMM_MMVTCONVERGENCEMONITOR_H_
+
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "MmvtAnchorStatistics.h"
+#include "internal/windowsExportSeekr2.h"
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace Seekr2Plugin {
+
+/**
+ * This class tracks the convergence of the statistics of one MMVT anchor
+ * while it is running. The cumulative statistics are sampled at the end of
+ * every block of steps, and the increments over each block are used as
+ * batch means for two kinds of rates:
+ *
+ * - the bounce rates N_alpha_beta/T_alpha against each boundary, and
+ * - the transition rates Nij_alpha/Ri_alpha between each pair of boundaries.
+ *
+ * Each rate is a ratio of two block sums, so its standard error is estimated
+ * with the usual ratio estimator from running (Welford) means, variances and
+ * covariances of the block increments, which remains well defined even when
+ * some blocks contain no events. Only rates whose numerator has been
+ * nonzero in at least one block are tracked, since a rate that has never
+ * been observed has no meaningful relative error.
+ */
+
+class OPENMM_EXPORT_SEEKR2 MmvtConvergenceMonitor {
+public:
+    MmvtConvergenceMonitor();
+    /**
+     * Forget all blocks added so far.
+     */
+    void reset();
+    /**
+     * Forget all blocks added so far, and take the increments of the next
+     * block relative to the given statistics instead of to zero. This is
+     * used when a run is continued from a checkpoint.
+     *
+     * @param statistics   the cumulative statistics of the anchor at the start of the next block
+     */
+    void reset(const MmvtAnchorStatistics& statistics);
+    /**
+     * Get the minimum number of blocks before the statistics may be
+     * considered converged.
+     */
+    int getMinBlocks() const {
+        return minBlocks;
+    }
+    /**
+     * Set the minimum number of blocks before the statistics may be
+     * considered converged. The default is 10.
+     */
+    void setMinBlocks(int blocks);
+    /**
+     * Add a block, given the cumulative statistics at the end of it. The
+     * increments are taken relative to the statistics passed to the previous
+     * call (or to zero, or the statistics passed to reset(), for the first
+     * block).
+     *
+     * @param statistics   the cumulative statistics of the anchor
+     */
+    void addBlock(const MmvtAnchorStatistics& statistics);
+    /**
+     * Get the number of blocks added so far.
+     */
+    int getNumBlocks() const {
+        return numBlocks;
+    }
+    /**
+     * Get the number of rates currently being tracked.
+     */
+    int getNumTrackedRates() const {
+        int tracked = 0;
+        for (auto& rate : rates)
+            if (rate.second.nonzero)
+                tracked++;
+        return tracked;
+    }
+    /**
+     * Get the relative standard error of the bounce rate against a boundary,
+     * or infinity if it is not yet being tracked.
+     *
+     * @param index    the index of the boundary in the anchor's milestone groups
+     */
+    double getBounceRateRelativeError(int index) const;
+    /**
+     * Get the relative standard error of the transition rate from one
+     * boundary to another, or infinity if it is not yet being tracked.
+     *
+     * @param from    the index of the boundary the transition starts from
+     * @param to      the index of the boundary the transition ends at
+     */
+    double getTransitionRateRelativeError(int from, int to) const;
+    /**
+     * Get the largest relative standard error of all the tracked rates. This is
+     * infinite if fewer than the minimum number of blocks have been added, or if
+     * no rates are being tracked.
+     */
+    double getMaxRelativeError() const;
+    /**
+     * Get whether every tracked rate has a relative standard error no larger
+     * than a tolerance.
+     *
+     * @param tolerance   the largest acceptable relative error
+     */
+    bool isConverged(double tolerance) const;
+private:
+    /**
+     * Running block statistics for a ratio of two block sums x/y.
+     */
+    struct RatioAccumulator {
+        RatioAccumulator() : count(0), meanX(0), meanY(0), m2X(0), m2Y(0), cXY(0), nonzero(false) {
+        }
+        void addBlock(double x, double y);
+        double getRelativeError() const;
+        int count;
+        double meanX, meanY, m2X, m2Y, cXY;
+        bool nonzero;
+    };
+    double getRelativeError(int from, int to) const;
+    int minBlocks, numBlocks;
+    MmvtAnchorStatistics previous;
+    std::map<std::pair<int, int>, RatioAccumulator> rates;
+};
+
+} // namespace Seekr2Plugin
+
+#endif /*OPENMM_MMVTCONVERGENCEMONITOR_H_*/
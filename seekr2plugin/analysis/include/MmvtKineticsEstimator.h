@@ -0,0 +1,239 @@
+#ifndef OPENMM_MMVTKINETICSESTIMATOR_H_
+#define OPENMM_MMVTKINETICSESTIMATOR_H_
+
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "MmvtAnchorStatistics.h"
+#include "internal/windowsExportSeekr2.h"
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Seekr2Plugin {
+
+/**
+ * This class estimates the kinetics of an MMVT model from the transition
+ * statistics of its anchors. Statistics may be supplied while the anchors are
+ * still running, either directly from MmvtLangevinMiddleIntegrator::getStatistics()
+ * or from the statistics files written by the integrator, and the kinetics
+ * recomputed at any time.
+ *
+ * Each anchor is described by its boundaries. A boundary is identified within
+ * its anchor by the milestone group (force group) that the integrator
+ * monitors, and is mapped to a global milestone index and to the anchor on
+ * the other side of the milestone.
+ *
+ * computeKinetics() first finds the stationary probability pi_alpha of each
+ * anchor from the rates k_alpha_beta = N_alpha_beta/T_alpha of bouncing
+ * into neighboring anchors, then assembles the global milestone transition
+ * counts N_ij = sum_alpha pi_alpha N_ij_alpha/T_alpha and residence times
+ * R_i = sum_alpha pi_alpha R_i_alpha/T_alpha, and from them the milestoning
+ * rate matrix Q_ij = N_ij/R_i. Mean first passage times are found by solving
+ * the sparse linear system Q T = -1 over the milestones that are not sinks.
+ */
+
+class OPENMM_EXPORT_SEEKR2 MmvtKineticsEstimator {
+public:
+    MmvtKineticsEstimator();
+    /**
+     * Add an anchor to the model.
+     *
+     * @return the index of the anchor that was added
+     */
+    int addAnchor();
+    /**
+     * Get the number of anchors in the model.
+     */
+    int getNumAnchors() const {
+        return anchors.size();
+    }
+    /**
+     * Get the number of milestones in the model. This is one more than the
+     * largest milestone index passed to addAnchorBoundary().
+     */
+    int getNumMilestones() const {
+        return numMilestones;
+    }
+    /**
+     * Add a boundary to an anchor.
+     *
+     * @param anchor          the index of the anchor
+     * @param milestoneGroup  the force group the anchor's integrator monitors for this boundary
+     * @param milestone       the global index of the milestone the boundary lies on
+     * @param neighborAnchor  the index of the anchor on the other side of the boundary, or -1
+     *                        if there is none
+     */
+    void addAnchorBoundary(int anchor, int milestoneGroup, int milestone, int neighborAnchor);
+    /**
+     * Get the milestone groups of an anchor's boundaries, in the order they
+     * were added.
+     *
+     * @param anchor          the index of the anchor
+     */
+    std::vector<int> getAnchorMilestoneGroups(int anchor) const;
+    /**
+     * Set the statistics of an anchor, replacing any that were set before.
+     *
+     * @param anchor      the index of the anchor
+     * @param statistics  the statistics accumulated by the anchor's integrator
+     */
+    void setAnchorStatistics(int anchor, const MmvtAnchorStatistics& statistics);
+    /**
+     * Set the statistics of an anchor from a file written by an
+     * MmvtLangevinMiddleIntegrator, replacing any that were set before.
+     *
+     * @param anchor      the index of the anchor
+     * @param fileName    the statistics file to read
+     */
+    void readAnchorStatisticsFile(int anchor, const std::string& fileName);
+    /**
+     * Get whether statistics have been set for an anchor.
+     *
+     * @param anchor      the index of the anchor
+     */
+    bool hasAnchorStatistics(int anchor) const;
+    /**
+     * Get the statistics of an anchor.
+     *
+     * @param anchor      the index of the anchor
+     */
+    const MmvtAnchorStatistics& getAnchorStatistics(int anchor) const;
+    /**
+     * Read a statistics file written by an MmvtLangevinMiddleIntegrator.
+     *
+     * @param fileName    the statistics file to read
+     */
+    static MmvtAnchorStatistics readStatisticsFile(const std::string& fileName);
+    /**
+     * Read statistics in the format of the statistics file written by an
+     * MmvtLangevinMiddleIntegrator.
+     *
+     * @param input       the stream to read from
+     */
+    static MmvtAnchorStatistics readStatistics(std::istream& input);
+    /**
+     * Write statistics in the format of the statistics file written by an
+     * MmvtLangevinMiddleIntegrator, so that they may be read back with
+     * readStatistics() or readStatisticsFile().
+     *
+     * @param statistics  the statistics to write
+     * @param output      the stream to write to
+     */
+    static void writeStatistics(const MmvtAnchorStatistics& statistics, std::ostream& output);
+    /**
+     * Compute the stationary anchor probabilities and the milestoning rate
+     * matrix from the current statistics. Every anchor must have statistics
+     * with a nonzero total time.
+     */
+    void computeKinetics();
+    /**
+     * Get the stationary probability of each anchor, as found by the last
+     * call to computeKinetics().
+     */
+    std::vector<double> getAnchorProbabilities() const;
+    /**
+     * Get the global transition count N_ij between two milestones (per unit
+     * time), as found by the last call to computeKinetics().
+     */
+    double getTransitionCount(int fromMilestone, int toMilestone) const;
+    /**
+     * Get the global residence time R_i of a milestone (per unit time), as
+     * found by the last call to computeKinetics().
+     */
+    double getResidenceTime(int milestone) const;
+    /**
+     * Get an element Q_ij of the milestoning rate matrix (in 1/ps), as found
+     * by the last call to computeKinetics(). The diagonal elements are the
+     * negative sums of the rest of each row.
+     */
+    double getRate(int fromMilestone, int toMilestone) const;
+    /**
+     * Compute the mean first passage time (in ps) from every milestone to
+     * any of a set of sink milestones, using the rate matrix found by the last
+     * call to computeKinetics(). The time is zero for the sinks themselves,
+     * and NaN for milestones that have never been visited.
+     *
+     * @param sinkMilestones   the milestones at which the passage ends
+     */
+    std::vector<double> computeMFPTs(const std::vector<int>& sinkMilestones) const;
+    /**
+     * Compute the mean first passage time (in ps) from one milestone to any
+     * of a set of sink milestones. The rate constant for the process (for
+     * example k_off, when the source is the bound state milestone and the sink
+     * is the outermost milestone) is the inverse of this time.
+     *
+     * @param sourceMilestone  the milestone at which the passage starts
+     * @param sinkMilestones   the milestones at which the passage ends
+     */
+    double computeMFPT(int sourceMilestone, const std::vector<int>& sinkMilestones) const;
+private:
+    struct Boundary {
+        int milestoneGroup, milestone, neighborAnchor;
+    };
+    /**
+     * The statistics of one anchor, divided by T_alpha and mapped to global
+     * milestone indices. These are rebuilt only when the anchor's statistics
+     * change.
+     */
+    struct AnchorContribution {
+        std::vector<std::pair<int, double> > exitRates;
+        std::map<std::pair<int, int>, double> transitions;
+        std::map<int, double> residenceTimes;
+    };
+    struct Anchor {
+        Anchor() : hasStatistics(false), modified(false) {
+        }
+        std::vector<Boundary> boundaries;
+        MmvtAnchorStatistics statistics;
+        bool hasStatistics, modified;
+        AnchorContribution contribution;
+    };
+    void updateContribution(int anchorIndex);
+    void checkAnchorIndex(int anchor) const;
+    void checkMilestoneIndex(int milestone) const;
+    std::vector<Anchor> anchors;
+    int numMilestones;
+    bool kineticsComputed;
+    std::vector<double> anchorProbabilities;
+    std::vector<std::map<int, double> > transitionCounts;
+    std::vector<double> residenceTimes;
+    std::vector<std::map<int, double> > rates;
+};
+
+} // namespace Seekr2Plugin
+
+#endif /*OPENMM_MMVTKINETICSESTIMATOR_H_*/
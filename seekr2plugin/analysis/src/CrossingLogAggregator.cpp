@@ -0,0 +1,371 @@
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "CrossingLogAggregator.h"
+#include "openmm/OpenMMException.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#ifdef _WIN32
+    #include <iterator>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+using namespace Seekr2Plugin;
+using namespace OpenMM;
+using namespace std;
+
+static const char MAGIC[] = {'S', 'E', 'E', 'K', 'R', '2', 'X', 'T'};
+static const int MAGIC_LENGTH = sizeof(MAGIC);
+static const int FORMAT_VERSION = 1;
+
+namespace {
+
+/**
+ * A read-only view of the contents of a file. On POSIX systems the file is
+ * memory mapped; elsewhere it is read into memory.
+ */
+class MappedFile {
+public:
+    MappedFile(const string& fileName) : data(NULL), size(0) {
+#ifdef _WIN32
+        ifstream file(fileName.c_str(), ios::binary);
+        if (!file)
+            throw OpenMMException("CrossingLogAggregator: could not open crossing log "+fileName);
+        contents.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+        data = contents.data();
+        size = contents.size();
+#else
+        int fd = open(fileName.c_str(), O_RDONLY);
+        if (fd == -1)
+            throw OpenMMException("CrossingLogAggregator: could not open crossing log "+fileName);
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            close(fd);
+            throw OpenMMException("CrossingLogAggregator: could not read crossing log "+fileName);
+        }
+        size = info.st_size;
+        if (size > 0) {
+            void* mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                close(fd);
+                throw OpenMMException("CrossingLogAggregator: could not map crossing log "+fileName);
+            }
+            madvise(mapped, size, MADV_SEQUENTIAL);
+            data = (const char*) mapped;
+        }
+        close(fd);
+#endif
+    }
+    ~MappedFile() {
+#ifndef _WIN32
+        if (data != NULL)
+            munmap((void*) data, size);
+#endif
+    }
+    const char* data;
+    size_t size;
+private:
+#ifdef _WIN32
+    string contents;
+#endif
+};
+
+/**
+ * Accumulates statistics while the rows of a log are parsed, with the groups
+ * kept in the order in which they are first seen.
+ */
+struct LogAccumulator {
+    LogAccumulator() : current(-1), firstTime(0), lastTime(0), startTime(0) {
+    }
+    int findGroup(int group) {
+        for (int i = 0; i < groups.size(); i++)
+            if (groups[i] == group)
+                return i;
+        groups.push_back(group);
+        counts.push_back(0);
+        residence.push_back(0.0);
+        for (auto& row : transitions)
+            row.push_back(0);
+        transitions.push_back(vector<long long>(groups.size(), 0));
+        return groups.size()-1;
+    }
+    void addRow(int group, double time) {
+        int index = findGroup(group);
+        if (current == -1) {
+            firstTime = time;
+            startTime = time;
+        }
+        else if (index != current) {
+            transitions[current][index]++;
+            residence[current] += time-startTime;
+            startTime = time;
+        }
+        current = index;
+        counts[index]++;
+        lastTime = time;
+    }
+    vector<int> groups;
+    vector<long long> counts;
+    vector<vector<long long> > transitions;
+    vector<double> residence;
+    int current;
+    double firstTime, lastTime, startTime;
+};
+
+}
+
+CrossingLogAggregator::CrossingLogAggregator() : numThreads(0) {
+}
+
+int CrossingLogAggregator::addFile(const string& fileName) {
+    fileNames.push_back(fileName);
+    summaries.clear();
+    return fileNames.size()-1;
+}
+
+void CrossingLogAggregator::setNumThreads(int threads) {
+    if (threads < 0)
+        throw OpenMMException("CrossingLogAggregator: the number of threads cannot be negative");
+    numThreads = threads;
+}
+
+CrossingLogSummary CrossingLogAggregator::parse(const char* data, size_t size) {
+    CrossingLogSummary summary;
+    LogAccumulator accumulator;
+    const char* end = data+size;
+    const char* line = data;
+    while (line < end) {
+        const char* lineEnd = (const char*) memchr(line, '\n', end-line);
+        if (lineEnd == NULL)
+            lineEnd = end;
+        const char* next = lineEnd+1;
+        if (lineEnd > line && lineEnd[-1] == '\r')
+            lineEnd--;
+        if (lineEnd == line || line[0] == '#') {
+            line = next;
+            continue;
+        }
+        summary.numRows++;
+        if (memchr(line, '*', lineEnd-line) != NULL) {
+            summary.numInvalidRows++;
+            line = next;
+            continue;
+        }
+        
+        // The first field is the group and the last is the time.
+        
+        const char* p = line;
+        bool negative = (*p == '-');
+        if (negative)
+            p++;
+        int group = 0;
+        const char* digits = p;
+        while (p < lineEnd && *p >= '0' && *p <= '9')
+            group = 10*group + (*p++ - '0');
+        const char* lastComma = lineEnd;
+        while (lastComma > p && lastComma[-1] != ',')
+            lastComma--;
+        if (p == digits || p == lineEnd || *p != ',' || lastComma == p+1)
+            throw OpenMMException("CrossingLogAggregator: malformed line in crossing log: "+string(line, lineEnd));
+        char buffer[64];
+        size_t length = min((size_t) (lineEnd-lastComma), sizeof(buffer)-1);
+        memcpy(buffer, lastComma, length);
+        buffer[length] = 0;
+        char* parsedEnd;
+        double time = strtod(buffer, &parsedEnd);
+        if (parsedEnd == buffer)
+            throw OpenMMException("CrossingLogAggregator: malformed line in crossing log: "+string(line, lineEnd));
+        accumulator.addRow(negative ? -group : group, time);
+        line = next;
+    }
+    
+    // Store the statistics with the groups in ascending order.
+    
+    int numGroups = accumulator.groups.size();
+    vector<int> order(numGroups);
+    for (int i = 0; i < numGroups; i++)
+        order[i] = i;
+    sort(order.begin(), order.end(), [&](int a, int b) { return accumulator.groups[a] < accumulator.groups[b]; });
+    MmvtAnchorStatistics& statistics = summary.statistics;
+    statistics.milestoneGroups.resize(numGroups);
+    statistics.N_alpha_beta.resize(numGroups);
+    statistics.Nij_alpha.resize(numGroups, vector<int>(numGroups));
+    statistics.Ri_alpha.resize(numGroups);
+    for (int i = 0; i < numGroups; i++) {
+        statistics.milestoneGroups[i] = accumulator.groups[order[i]];
+        statistics.N_alpha_beta[i] = accumulator.counts[order[i]];
+        statistics.Ri_alpha[i] = accumulator.residence[order[i]];
+        for (int j = 0; j < numGroups; j++)
+            statistics.Nij_alpha[i][j] = accumulator.transitions[order[i]][order[j]];
+    }
+    statistics.T_alpha = accumulator.lastTime-accumulator.firstTime;
+    return summary;
+}
+
+void CrossingLogAggregator::run() {
+    int numFiles = fileNames.size();
+    vector<CrossingLogSummary> results(numFiles);
+    vector<string> errors(numFiles);
+    int threads = numThreads;
+    if (threads == 0)
+        threads = max(1, (int) thread::hardware_concurrency());
+    threads = max(1, min(threads, numFiles));
+    atomic<int> nextFile(0);
+    auto worker = [&]() {
+        while (true) {
+            int index = nextFile++;
+            if (index >= numFiles)
+                break;
+            try {
+                MappedFile file(fileNames[index]);
+                results[index] = parse(file.data, file.size);
+                results[index].fileName = fileNames[index];
+            }
+            catch (exception& ex) {
+                errors[index] = ex.what();
+            }
+        }
+    };
+    vector<thread> pool;
+    for (int i = 1; i < threads; i++)
+        pool.push_back(thread(worker));
+    worker();
+    for (auto& t : pool)
+        t.join();
+    for (int i = 0; i < numFiles; i++)
+        if (!errors[i].empty())
+            throw OpenMMException(errors[i]);
+    summaries.swap(results);
+}
+
+const CrossingLogSummary& CrossingLogAggregator::getSummary(int index) const {
+    if (summaries.size() != fileNames.size())
+        throw OpenMMException("CrossingLogAggregator: run() must be called before getting the results");
+    if (index < 0 || index >= summaries.size())
+        throw OpenMMException("CrossingLogAggregator: illegal file index");
+    return summaries[index];
+}
+
+template <class T>
+static void writeValue(ostream& out, T value) {
+    out.write((const char*) &value, sizeof(T));
+}
+
+template <class T>
+static T readValue(istream& in) {
+    T value;
+    in.read((char*) &value, sizeof(T));
+    if (!in)
+        throw OpenMMException("CrossingLogAggregator: unexpected end of table");
+    return value;
+}
+
+void CrossingLogAggregator::writeTable(const string& fileName) const {
+    if (summaries.size() != fileNames.size())
+        throw OpenMMException("CrossingLogAggregator: run() must be called before writing a table");
+    ofstream out(fileName.c_str(), ios::binary);
+    if (!out)
+        throw OpenMMException("CrossingLogAggregator: could not open table "+fileName);
+    out.write(MAGIC, MAGIC_LENGTH);
+    writeValue<int32_t>(out, FORMAT_VERSION);
+    writeValue<int32_t>(out, summaries.size());
+    for (const CrossingLogSummary& summary : summaries) {
+        const MmvtAnchorStatistics& statistics = summary.statistics;
+        int numGroups = statistics.milestoneGroups.size();
+        writeValue<int32_t>(out, summary.fileName.size());
+        out.write(summary.fileName.data(), summary.fileName.size());
+        writeValue<int32_t>(out, numGroups);
+        for (int i = 0; i < numGroups; i++)
+            writeValue<int32_t>(out, statistics.milestoneGroups[i]);
+        for (int i = 0; i < numGroups; i++)
+            writeValue<int64_t>(out, statistics.N_alpha_beta[i]);
+        for (int i = 0; i < numGroups; i++)
+            for (int j = 0; j < numGroups; j++)
+                writeValue<int64_t>(out, statistics.Nij_alpha[i][j]);
+        for (int i = 0; i < numGroups; i++)
+            writeValue<double>(out, statistics.Ri_alpha[i]);
+        writeValue<double>(out, statistics.T_alpha);
+        writeValue<int64_t>(out, summary.numRows);
+        writeValue<int64_t>(out, summary.numInvalidRows);
+    }
+    if (!out)
+        throw OpenMMException("CrossingLogAggregator: error writing table "+fileName);
+}
+
+vector<CrossingLogSummary> CrossingLogAggregator::readTable(const string& fileName) {
+    ifstream in(fileName.c_str(), ios::binary);
+    if (!in)
+        throw OpenMMException("CrossingLogAggregator: could not open table "+fileName);
+    char magic[MAGIC_LENGTH];
+    in.read(magic, MAGIC_LENGTH);
+    if (!in || memcmp(magic, MAGIC, MAGIC_LENGTH) != 0)
+        throw OpenMMException("CrossingLogAggregator: "+fileName+" is not a crossing log table");
+    if (readValue<int32_t>(in) != FORMAT_VERSION)
+        throw OpenMMException("CrossingLogAggregator: unsupported table version in "+fileName);
+    int numFiles = readValue<int32_t>(in);
+    vector<CrossingLogSummary> summaries(numFiles);
+    for (CrossingLogSummary& summary : summaries) {
+        MmvtAnchorStatistics& statistics = summary.statistics;
+        int nameLength = readValue<int32_t>(in);
+        summary.fileName.resize(nameLength);
+        in.read(&summary.fileName[0], nameLength);
+        int numGroups = readValue<int32_t>(in);
+        statistics.milestoneGroups.resize(numGroups);
+        statistics.N_alpha_beta.resize(numGroups);
+        statistics.Nij_alpha.resize(numGroups, vector<int>(numGroups));
+        statistics.Ri_alpha.resize(numGroups);
+        for (int i = 0; i < numGroups; i++)
+            statistics.milestoneGroups[i] = readValue<int32_t>(in);
+        for (int i = 0; i < numGroups; i++)
+            statistics.N_alpha_beta[i] = readValue<int64_t>(in);
+        for (int i = 0; i < numGroups; i++)
+            for (int j = 0; j < numGroups; j++)
+                statistics.Nij_alpha[i][j] = readValue<int64_t>(in);
+        for (int i = 0; i < numGroups; i++)
+            statistics.Ri_alpha[i] = readValue<double>(in);
+        statistics.T_alpha = readValue<double>(in);
+        summary.numRows = readValue<int64_t>(in);
+        summary.numInvalidRows = readValue<int64_t>(in);
+    }
+    return summaries;
+}
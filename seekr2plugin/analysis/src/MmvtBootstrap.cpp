@@ -0,0 +1,257 @@
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "MmvtBootstrap.h"
+#include "openmm/OpenMMException.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+using namespace Seekr2Plugin;
+using namespace OpenMM;
+using namespace std;
+
+MmvtBootstrap::MmvtBootstrap(const MmvtKineticsEstimator& estimator) : estimator(estimator), 
+        anchorSegments(estimator.getNumAnchors()), numThreads(0), randomNumberSeed(0) {
+}
+
+void MmvtBootstrap::setNumThreads(int threads) {
+    if (threads < 0)
+        throw OpenMMException("MmvtBootstrap: the number of threads cannot be negative");
+    numThreads = threads;
+}
+
+void MmvtBootstrap::readAnchorCrossingLog(int anchor, const string& fileName) {
+    if (anchor < 0 || anchor >= anchorSegments.size())
+        throw OpenMMException("MmvtBootstrap: illegal anchor index");
+    vector<int> groups = estimator.getAnchorMilestoneGroups(anchor);
+    ifstream file(fileName.c_str());
+    if (!file)
+        throw OpenMMException("MmvtBootstrap: could not open crossing log "+fileName);
+    
+    // Each line is "group,bounce index,time". Rows marked with an asterisk
+    // are not valid MMVT bounces, and are skipped.
+    
+    AnchorSegments result;
+    int current = -1, bounces = 0;
+    double startTime = 0.0, lastTime = 0.0;
+    string line;
+    while (getline(file, line)) {
+        if (line.empty() || line[0] == '#' || line.find('*') != string::npos)
+            continue;
+        size_t firstComma = line.find(',');
+        size_t lastComma = line.rfind(',');
+        if (firstComma == string::npos || firstComma == lastComma)
+            throw OpenMMException("MmvtBootstrap: malformed line in crossing log: "+line);
+        int group = atoi(line.substr(0, firstComma).c_str());
+        double time = atof(line.substr(lastComma+1).c_str());
+        int index = find(groups.begin(), groups.end(), group)-groups.begin();
+        if (index == groups.size())
+            throw OpenMMException("MmvtBootstrap: crossing log contains a milestone group that is not a boundary of the anchor: "+line);
+        if (current == -1) {
+            current = index;
+            startTime = time;
+        }
+        else if (index != current) {
+            Segment segment;
+            segment.from = current;
+            segment.to = index;
+            segment.bounces = bounces;
+            segment.duration = time-startTime;
+            result.segments.push_back(segment);
+            current = index;
+            startTime = time;
+            bounces = 0;
+        }
+        bounces++;
+        lastTime = time;
+    }
+    if (current != -1) {
+        result.trailingFrom = current;
+        result.trailingBounces = bounces;
+        result.trailingDuration = lastTime-startTime;
+    }
+    anchorSegments[anchor] = result;
+    if (!estimator.hasAnchorStatistics(anchor))
+        estimator.setAnchorStatistics(anchor, buildStatistics(groups, result, vector<int>(result.segments.size(), 1)));
+}
+
+int MmvtBootstrap::getNumAnchorSegments(int anchor) const {
+    if (anchor < 0 || anchor >= anchorSegments.size())
+        throw OpenMMException("MmvtBootstrap: illegal anchor index");
+    return anchorSegments[anchor].segments.size();
+}
+
+MmvtAnchorStatistics MmvtBootstrap::buildStatistics(const vector<int>& milestoneGroups, const AnchorSegments& segments,
+        const vector<int>& segmentCounts) {
+    int numGroups = milestoneGroups.size();
+    MmvtAnchorStatistics statistics;
+    statistics.milestoneGroups = milestoneGroups;
+    statistics.N_alpha_beta.assign(numGroups, 0);
+    statistics.Nij_alpha.assign(numGroups, vector<int>(numGroups, 0));
+    statistics.Ri_alpha.assign(numGroups, 0.0);
+    statistics.T_alpha = 0.0;
+    for (int i = 0; i < segments.segments.size(); i++) {
+        int count = segmentCounts[i];
+        if (count == 0)
+            continue;
+        const Segment& segment = segments.segments[i];
+        statistics.N_alpha_beta[segment.from] += count*segment.bounces;
+        statistics.Nij_alpha[segment.from][segment.to] += count;
+        statistics.Ri_alpha[segment.from] += count*segment.duration;
+        statistics.T_alpha += count*segment.duration;
+    }
+    if (segments.trailingFrom != -1) {
+        statistics.N_alpha_beta[segments.trailingFrom] += segments.trailingBounces;
+        statistics.T_alpha += segments.trailingDuration;
+    }
+    return statistics;
+}
+
+MmvtAnchorStatistics MmvtBootstrap::resampleAnchor(int anchor, unsigned long long seed, int resample) const {
+    seed_seq sequence = {(unsigned int) (seed & 0xFFFFFFFF), (unsigned int) (seed >> 32), (unsigned int) resample, (unsigned int) anchor};
+    mt19937_64 random(sequence);
+    const AnchorSegments& segments = anchorSegments[anchor];
+    if (!segments.segments.empty()) {
+        int numSegments = segments.segments.size();
+        vector<int> counts(numSegments, 0);
+        uniform_int_distribution<int> pick(0, numSegments-1);
+        for (int i = 0; i < numSegments; i++)
+            counts[pick(random)]++;
+        return buildStatistics(estimator.getAnchorMilestoneGroups(anchor), segments, counts);
+    }
+    MmvtAnchorStatistics statistics = estimator.getAnchorStatistics(anchor);
+    int numGroups = statistics.milestoneGroups.size();
+    for (int i = 0; i < numGroups; i++) {
+        if (statistics.N_alpha_beta[i] > 0)
+            statistics.N_alpha_beta[i] = poisson_distribution<int>(statistics.N_alpha_beta[i])(random);
+        for (int j = 0; j < numGroups; j++)
+            if (statistics.Nij_alpha[i][j] > 0)
+                statistics.Nij_alpha[i][j] = poisson_distribution<int>(statistics.Nij_alpha[i][j])(random);
+    }
+    return statistics;
+}
+
+/**
+ * Find a percentile of sorted values by linear interpolation.
+ */
+static double percentile(const vector<double>& sorted, double fraction) {
+    double position = fraction*(sorted.size()-1);
+    int lower = (int) floor(position);
+    int upper = min(lower+1, (int) sorted.size()-1);
+    double weight = position-lower;
+    return (1-weight)*sorted[lower] + weight*sorted[upper];
+}
+
+MmvtBootstrapResult MmvtBootstrap::run(int numResamples, int sourceMilestone, const vector<int>& sinkMilestones, double confidence) const {
+    if (numResamples < 1)
+        throw OpenMMException("MmvtBootstrap: at least one resample is required");
+    if (confidence <= 0.0 || confidence >= 1.0)
+        throw OpenMMException("MmvtBootstrap: the confidence level must be between 0 and 1");
+    MmvtBootstrapResult result;
+    result.numResamples = numResamples;
+    MmvtKineticsEstimator original(estimator);
+    original.computeKinetics();
+    result.mfpt = original.computeMFPT(sourceMilestone, sinkMilestones);
+    result.rate = 1.0/result.mfpt;
+    
+    // Every thread takes the next resample to do until none are left.
+    
+    int threads = numThreads;
+    if (threads == 0)
+        threads = max(1, (int) thread::hardware_concurrency());
+    threads = min(threads, numResamples);
+    int numAnchors = estimator.getNumAnchors();
+    unsigned long long seed = (unsigned int) randomNumberSeed;
+    vector<double> samples(numResamples);
+    vector<char> succeeded(numResamples, 0);
+    atomic<int> nextResample(0);
+    auto worker = [&]() {
+        MmvtKineticsEstimator resampled(estimator);
+        while (true) {
+            int resample = nextResample++;
+            if (resample >= numResamples)
+                break;
+            try {
+                for (int anchor = 0; anchor < numAnchors; anchor++)
+                    resampled.setAnchorStatistics(anchor, resampleAnchor(anchor, seed, resample));
+                resampled.computeKinetics();
+                double mfpt = resampled.computeMFPT(sourceMilestone, sinkMilestones);
+                if (std::isfinite(mfpt) && mfpt > 0.0) {
+                    samples[resample] = mfpt;
+                    succeeded[resample] = 1;
+                }
+            }
+            catch (OpenMMException& ex) {
+                // A resample without enough transitions to define the kinetics.
+            }
+        }
+    };
+    vector<thread> pool;
+    for (int i = 1; i < threads; i++)
+        pool.push_back(thread(worker));
+    worker();
+    for (auto& t : pool)
+        t.join();
+    
+    // Collect the statistics.
+    
+    for (int i = 0; i < numResamples; i++)
+        if (succeeded[i])
+            result.mfptSamples.push_back(samples[i]);
+    result.numFailed = numResamples-result.mfptSamples.size();
+    if (result.mfptSamples.empty())
+        throw OpenMMException("MmvtBootstrap: the kinetics could not be computed for any resample");
+    int count = result.mfptSamples.size();
+    double sum = 0.0, sumSquares = 0.0;
+    for (double mfpt : result.mfptSamples) {
+        sum += mfpt;
+        sumSquares += mfpt*mfpt;
+    }
+    result.mfptMean = sum/count;
+    result.mfptStdDev = (count > 1 ? sqrt(max(0.0, (sumSquares-count*result.mfptMean*result.mfptMean)/(count-1))) : 0.0);
+    vector<double> sorted = result.mfptSamples;
+    sort(sorted.begin(), sorted.end());
+    double tail = 0.5*(1.0-confidence);
+    result.mfptLower = percentile(sorted, tail);
+    result.mfptUpper = percentile(sorted, 1.0-tail);
+    result.rateLower = 1.0/result.mfptUpper;
+    result.rateUpper = 1.0/result.mfptLower;
+    return result;
+}
@@ -0,0 +1,143 @@
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "MmvtConvergenceMonitor.h"
+#include "openmm/OpenMMException.h"
+#include <cmath>
+#include <limits>
+
+using namespace Seekr2Plugin;
+using namespace OpenMM;
+using namespace std;
+
+void MmvtConvergenceMonitor::RatioAccumulator::addBlock(double x, double y) {
+    count++;
+    double dx = x-meanX;
+    double dy = y-meanY;
+    meanX += dx/count;
+    meanY += dy/count;
+    m2X += dx*(x-meanX);
+    m2Y += dy*(y-meanY);
+    cXY += dx*(y-meanY);
+    if (x != 0.0)
+        nonzero = true;
+}
+
+double MmvtConvergenceMonitor::RatioAccumulator::getRelativeError() const {
+    if (!nonzero || count < 2 || meanY <= 0.0)
+        return numeric_limits<double>::infinity();
+    
+    // The standard error of r = mean(x)/mean(y) from the variance of the
+    // residuals x-r*y over the blocks.
+    
+    double ratio = meanX/meanY;
+    double variance = (m2X + ratio*ratio*m2Y - 2*ratio*cXY)/(count-1);
+    double error = sqrt(max(variance, 0.0)/count)/meanY;
+    return error/fabs(ratio);
+}
+
+MmvtConvergenceMonitor::MmvtConvergenceMonitor() : minBlocks(10), numBlocks(0) {
+}
+
+void MmvtConvergenceMonitor::reset() {
+    numBlocks = 0;
+    previous = MmvtAnchorStatistics();
+    rates.clear();
+}
+
+void MmvtConvergenceMonitor::reset(const MmvtAnchorStatistics& statistics) {
+    numBlocks = 0;
+    previous = statistics;
+    rates.clear();
+}
+
+void MmvtConvergenceMonitor::setMinBlocks(int blocks) {
+    if (blocks < 2)
+        throw OpenMMException("MmvtConvergenceMonitor: at least two blocks are needed to estimate errors");
+    minBlocks = blocks;
+}
+
+void MmvtConvergenceMonitor::addBlock(const MmvtAnchorStatistics& statistics) {
+    int numGroups = statistics.milestoneGroups.size();
+    if (!previous.milestoneGroups.empty() && previous.milestoneGroups != statistics.milestoneGroups)
+        throw OpenMMException("MmvtConvergenceMonitor: the milestone groups changed between blocks");
+    if (previous.milestoneGroups.empty()) {
+        previous.milestoneGroups = statistics.milestoneGroups;
+        previous.N_alpha_beta.assign(numGroups, 0);
+        previous.Nij_alpha.assign(numGroups, vector<int>(numGroups, 0));
+        previous.Ri_alpha.assign(numGroups, 0.0);
+        previous.T_alpha = 0.0;
+    }
+    double deltaT = statistics.T_alpha-previous.T_alpha;
+    for (int i = 0; i < numGroups; i++) {
+        rates[make_pair(i, -1)].addBlock(statistics.N_alpha_beta[i]-previous.N_alpha_beta[i], deltaT);
+        double deltaR = statistics.Ri_alpha[i]-previous.Ri_alpha[i];
+        for (int j = 0; j < numGroups; j++)
+            if (j != i)
+                rates[make_pair(i, j)].addBlock(statistics.Nij_alpha[i][j]-previous.Nij_alpha[i][j], deltaR);
+    }
+    previous = statistics;
+    numBlocks++;
+}
+
+double MmvtConvergenceMonitor::getRelativeError(int from, int to) const {
+    auto rate = rates.find(make_pair(from, to));
+    if (rate == rates.end())
+        return numeric_limits<double>::infinity();
+    return rate->second.getRelativeError();
+}
+
+double MmvtConvergenceMonitor::getBounceRateRelativeError(int index) const {
+    return getRelativeError(index, -1);
+}
+
+double MmvtConvergenceMonitor::getTransitionRateRelativeError(int from, int to) const {
+    return getRelativeError(from, to);
+}
+
+double MmvtConvergenceMonitor::getMaxRelativeError() const {
+    if (numBlocks < minBlocks)
+        return numeric_limits<double>::infinity();
+    double maxError = -1.0;
+    for (auto& rate : rates)
+        if (rate.second.nonzero)
+            maxError = max(maxError, rate.second.getRelativeError());
+    if (maxError < 0.0)
+        return numeric_limits<double>::infinity();
+    return maxError;
+}
+
+bool MmvtConvergenceMonitor::isConverged(double tolerance) const {
+    return (getMaxRelativeError() <= tolerance);
+}
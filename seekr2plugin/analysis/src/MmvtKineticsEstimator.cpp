@@ -0,0 +1,419 @@
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "MmvtKineticsEstimator.h"
+#include "SparseLinearSolver.h"
+#include "openmm/OpenMMException.h"
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+using namespace Seekr2Plugin;
+using namespace OpenMM;
+using namespace std;
+
+MmvtKineticsEstimator::MmvtKineticsEstimator() : numMilestones(0), kineticsComputed(false) {
+}
+
+int MmvtKineticsEstimator::addAnchor() {
+    anchors.push_back(Anchor());
+    kineticsComputed = false;
+    return anchors.size()-1;
+}
+
+void MmvtKineticsEstimator::checkAnchorIndex(int anchor) const {
+    if (anchor < 0 || anchor >= anchors.size()) {
+        stringstream message;
+        message << "MmvtKineticsEstimator: illegal anchor index " << anchor;
+        throw OpenMMException(message.str());
+    }
+}
+
+void MmvtKineticsEstimator::checkMilestoneIndex(int milestone) const {
+    if (milestone < 0 || milestone >= numMilestones) {
+        stringstream message;
+        message << "MmvtKineticsEstimator: illegal milestone index " << milestone;
+        throw OpenMMException(message.str());
+    }
+}
+
+void MmvtKineticsEstimator::addAnchorBoundary(int anchor, int milestoneGroup, int milestone, int neighborAnchor) {
+    checkAnchorIndex(anchor);
+    if (neighborAnchor != -1)
+        checkAnchorIndex(neighborAnchor);
+    if (milestone < 0)
+        throw OpenMMException("MmvtKineticsEstimator: milestone indices must not be negative");
+    for (auto& boundary : anchors[anchor].boundaries)
+        if (boundary.milestoneGroup == milestoneGroup)
+            throw OpenMMException("MmvtKineticsEstimator: the anchor already has a boundary with this milestone group");
+    Boundary boundary;
+    boundary.milestoneGroup = milestoneGroup;
+    boundary.milestone = milestone;
+    boundary.neighborAnchor = neighborAnchor;
+    anchors[anchor].boundaries.push_back(boundary);
+    anchors[anchor].modified = true;
+    numMilestones = max(numMilestones, milestone+1);
+    kineticsComputed = false;
+}
+
+vector<int> MmvtKineticsEstimator::getAnchorMilestoneGroups(int anchor) const {
+    checkAnchorIndex(anchor);
+    vector<int> groups;
+    for (auto& boundary : anchors[anchor].boundaries)
+        groups.push_back(boundary.milestoneGroup);
+    return groups;
+}
+
+void MmvtKineticsEstimator::setAnchorStatistics(int anchor, const MmvtAnchorStatistics& statistics) {
+    checkAnchorIndex(anchor);
+    int numGroups = statistics.milestoneGroups.size();
+    if (statistics.N_alpha_beta.size() != numGroups || statistics.Nij_alpha.size() != numGroups || statistics.Ri_alpha.size() != numGroups)
+        throw OpenMMException("MmvtKineticsEstimator: the statistics arrays do not match the number of milestone groups");
+    for (auto& row : statistics.Nij_alpha)
+        if (row.size() != numGroups)
+            throw OpenMMException("MmvtKineticsEstimator: the statistics arrays do not match the number of milestone groups");
+    anchors[anchor].statistics = statistics;
+    anchors[anchor].hasStatistics = true;
+    anchors[anchor].modified = true;
+    kineticsComputed = false;
+}
+
+void MmvtKineticsEstimator::readAnchorStatisticsFile(int anchor, const string& fileName) {
+    setAnchorStatistics(anchor, readStatisticsFile(fileName));
+}
+
+bool MmvtKineticsEstimator::hasAnchorStatistics(int anchor) const {
+    checkAnchorIndex(anchor);
+    return anchors[anchor].hasStatistics;
+}
+
+const MmvtAnchorStatistics& MmvtKineticsEstimator::getAnchorStatistics(int anchor) const {
+    checkAnchorIndex(anchor);
+    if (!anchors[anchor].hasStatistics) {
+        stringstream message;
+        message << "MmvtKineticsEstimator: anchor " << anchor << " has no statistics";
+        throw OpenMMException(message.str());
+    }
+    return anchors[anchor].statistics;
+}
+
+static int parseGroup(const string& text, const string& line) {
+    char* end;
+    long group = strtol(text.c_str(), &end, 10);
+    if (text.empty() || *end != '\0')
+        throw OpenMMException("MmvtKineticsEstimator: malformed line in statistics file: "+line);
+    return (int) group;
+}
+
+static int findGroupIndex(MmvtAnchorStatistics& statistics, int group) {
+    for (int i = 0; i < statistics.milestoneGroups.size(); i++)
+        if (statistics.milestoneGroups[i] == group)
+            return i;
+    statistics.milestoneGroups.push_back(group);
+    statistics.N_alpha_beta.push_back(0);
+    statistics.Ri_alpha.push_back(0.0);
+    for (auto& row : statistics.Nij_alpha)
+        row.push_back(0);
+    statistics.Nij_alpha.push_back(vector<int>(statistics.milestoneGroups.size(), 0));
+    if (!statistics.incubationTimeHistograms.empty()) {
+        for (auto& row : statistics.incubationTimeHistograms)
+            row.push_back(LogBinnedHistogram());
+        statistics.incubationTimeHistograms.push_back(vector<LogBinnedHistogram>(statistics.milestoneGroups.size()));
+    }
+    return statistics.milestoneGroups.size()-1;
+}
+
+MmvtAnchorStatistics MmvtKineticsEstimator::readStatisticsFile(const string& fileName) {
+    ifstream file(fileName.c_str());
+    if (!file)
+        throw OpenMMException("MmvtKineticsEstimator: could not open statistics file "+fileName);
+    return readStatistics(file);
+}
+
+MmvtAnchorStatistics MmvtKineticsEstimator::readStatistics(istream& input) {
+    MmvtAnchorStatistics statistics;
+    const string alphaSuffix = "_alpha";
+    string line;
+    while (getline(input, line)) {
+        if (line.empty())
+            continue;
+        size_t colon = line.find(':');
+        if (colon == string::npos)
+            throw OpenMMException("MmvtKineticsEstimator: malformed line in statistics file: "+line);
+        string key = line.substr(0, colon);
+        string value = line.substr(colon+1);
+        if (key == "T_alpha")
+            statistics.T_alpha = atof(value.c_str());
+        else if (key.compare(0, 8, "N_alpha_") == 0) {
+            int i = findGroupIndex(statistics, parseGroup(key.substr(8), line));
+            statistics.N_alpha_beta[i] = atoi(value.c_str());
+        }
+        else if (key.size() > alphaSuffix.size() && key.compare(key.size()-alphaSuffix.size(), alphaSuffix.size(), alphaSuffix) == 0) {
+            string groups = key.substr(2, key.size()-2-alphaSuffix.size());
+            if (key.compare(0, 2, "R_") == 0) {
+                int i = findGroupIndex(statistics, parseGroup(groups, line));
+                statistics.Ri_alpha[i] = atof(value.c_str());
+            }
+            else if (key.compare(0, 2, "N_") == 0 || key.compare(0, 2, "H_") == 0) {
+                size_t split = groups.find('_');
+                if (split == string::npos)
+                    throw OpenMMException("MmvtKineticsEstimator: malformed line in statistics file: "+line);
+                int i = findGroupIndex(statistics, parseGroup(groups.substr(0, split), line));
+                int j = findGroupIndex(statistics, parseGroup(groups.substr(split+1), line));
+                if (key[0] == 'N')
+                    statistics.Nij_alpha[i][j] = atoi(value.c_str());
+                else {
+                    int numGroups = statistics.milestoneGroups.size();
+                    if (statistics.incubationTimeHistograms.empty())
+                        statistics.incubationTimeHistograms.assign(numGroups, vector<LogBinnedHistogram>(numGroups));
+                    statistics.incubationTimeHistograms[i][j] = LogBinnedHistogram::fromString(value);
+                }
+            }
+            else
+                throw OpenMMException("MmvtKineticsEstimator: malformed line in statistics file: "+line);
+        }
+        else
+            throw OpenMMException("MmvtKineticsEstimator: malformed line in statistics file: "+line);
+    }
+    return statistics;
+}
+
+void MmvtKineticsEstimator::writeStatistics(const MmvtAnchorStatistics& statistics, ostream& output) {
+    const vector<int>& groups = statistics.milestoneGroups;
+    int numGroups = groups.size();
+    stringstream stats;
+    stats.setf(ios::fixed, ios::floatfield);
+    stats.precision(6);
+    for (int i = 0; i < numGroups; i++)
+        stats << "N_alpha_" << groups[i] << ": " << statistics.N_alpha_beta[i] << "\n";
+    for (int i = 0; i < numGroups; i++)
+        for (int j = 0; j < numGroups; j++)
+            stats << "N_" << groups[i] << "_" << groups[j] << "_alpha: " << statistics.Nij_alpha[i][j] << "\n";
+    for (int i = 0; i < numGroups; i++)
+        stats << "R_" << groups[i] << "_alpha: " << statistics.Ri_alpha[i] << "\n";
+    if (statistics.incubationTimeHistograms.size() == numGroups)
+        for (int i = 0; i < numGroups; i++)
+            for (int j = 0; j < numGroups; j++)
+                if (statistics.incubationTimeHistograms[i][j].getTotalCount() > 0)
+                    stats << "H_" << groups[i] << "_" << groups[j] << "_alpha: " << statistics.incubationTimeHistograms[i][j].toString() << "\n";
+    stats << "T_alpha: " << statistics.T_alpha << "\n";
+    output << stats.str();
+}
+
+void MmvtKineticsEstimator::updateContribution(int anchorIndex) {
+    Anchor& anchor = anchors[anchorIndex];
+    const MmvtAnchorStatistics& statistics = anchor.statistics;
+    if (!anchor.hasStatistics || statistics.T_alpha <= 0.0) {
+        stringstream message;
+        message << "MmvtKineticsEstimator: anchor " << anchorIndex << " has no statistics";
+        throw OpenMMException(message.str());
+    }
+    
+    // Map the anchor's milestone groups onto its boundaries.
+    
+    int numGroups = statistics.milestoneGroups.size();
+    vector<const Boundary*> groupBoundaries(numGroups, NULL);
+    for (int i = 0; i < numGroups; i++) {
+        for (auto& boundary : anchor.boundaries)
+            if (boundary.milestoneGroup == statistics.milestoneGroups[i])
+                groupBoundaries[i] = &boundary;
+        if (groupBoundaries[i] == NULL) {
+            stringstream message;
+            message << "MmvtKineticsEstimator: anchor " << anchorIndex << " has statistics for milestone group " 
+                    << statistics.milestoneGroups[i] << ", which is not one of its boundaries";
+            throw OpenMMException(message.str());
+        }
+    }
+    
+    // Divide everything by the total time and record it by global milestone.
+    
+    AnchorContribution& contribution = anchor.contribution;
+    contribution.exitRates.clear();
+    contribution.transitions.clear();
+    contribution.residenceTimes.clear();
+    double invTime = 1.0/statistics.T_alpha;
+    for (int i = 0; i < numGroups; i++) {
+        const Boundary& boundary = *groupBoundaries[i];
+        if (boundary.neighborAnchor != -1 && statistics.N_alpha_beta[i] > 0)
+            contribution.exitRates.push_back(make_pair(boundary.neighborAnchor, statistics.N_alpha_beta[i]*invTime));
+        if (statistics.Ri_alpha[i] > 0.0)
+            contribution.residenceTimes[boundary.milestone] += statistics.Ri_alpha[i]*invTime;
+        for (int j = 0; j < numGroups; j++) {
+            int count = statistics.Nij_alpha[i][j];
+            int toMilestone = groupBoundaries[j]->milestone;
+            if (count > 0 && toMilestone != boundary.milestone)
+                contribution.transitions[make_pair(boundary.milestone, toMilestone)] += count*invTime;
+        }
+    }
+    anchor.modified = false;
+}
+
+void MmvtKineticsEstimator::computeKinetics() {
+    int numAnchors = anchors.size();
+    if (numAnchors == 0)
+        throw OpenMMException("MmvtKineticsEstimator: no anchors have been added");
+    for (int i = 0; i < numAnchors; i++)
+        if (anchors[i].modified)
+            updateContribution(i);
+    
+    // Find the stationary distribution of the anchors: pi^T K = 0, where
+    // K is the matrix of rates between anchors, with sum(pi) = 1 replacing
+    // the last equation.
+    
+    SparseLinearSolver anchorSolver(numAnchors);
+    for (int alpha = 0; alpha < numAnchors; alpha++) {
+        for (auto& exit : anchors[alpha].contribution.exitRates) {
+            anchorSolver.addToMatrix(exit.first, alpha, exit.second);
+            anchorSolver.addToMatrix(alpha, alpha, -exit.second);
+        }
+    }
+    anchorSolver.clearRow(numAnchors-1);
+    for (int alpha = 0; alpha < numAnchors; alpha++)
+        anchorSolver.addToMatrix(numAnchors-1, alpha, 1.0);
+    anchorSolver.addToRightHandSide(numAnchors-1, 1.0);
+    anchorSolver.solve(anchorProbabilities);
+    
+    // Assemble the global milestone statistics and the rate matrix.
+    
+    transitionCounts.assign(numMilestones, map<int, double>());
+    residenceTimes.assign(numMilestones, 0.0);
+    rates.assign(numMilestones, map<int, double>());
+    for (int alpha = 0; alpha < numAnchors; alpha++) {
+        const AnchorContribution& contribution = anchors[alpha].contribution;
+        double pi = anchorProbabilities[alpha];
+        for (auto& transition : contribution.transitions)
+            transitionCounts[transition.first.first][transition.first.second] += pi*transition.second;
+        for (auto& residence : contribution.residenceTimes)
+            residenceTimes[residence.first] += pi*residence.second;
+    }
+    for (int i = 0; i < numMilestones; i++) {
+        if (residenceTimes[i] <= 0.0)
+            continue;
+        double total = 0.0;
+        for (auto& count : transitionCounts[i]) {
+            double rate = count.second/residenceTimes[i];
+            rates[i][count.first] = rate;
+            total += rate;
+        }
+        rates[i][i] = -total;
+    }
+    kineticsComputed = true;
+}
+
+vector<double> MmvtKineticsEstimator::getAnchorProbabilities() const {
+    if (!kineticsComputed)
+        throw OpenMMException("MmvtKineticsEstimator: computeKinetics() has not been called");
+    return anchorProbabilities;
+}
+
+double MmvtKineticsEstimator::getTransitionCount(int fromMilestone, int toMilestone) const {
+    if (!kineticsComputed)
+        throw OpenMMException("MmvtKineticsEstimator: computeKinetics() has not been called");
+    checkMilestoneIndex(fromMilestone);
+    checkMilestoneIndex(toMilestone);
+    auto count = transitionCounts[fromMilestone].find(toMilestone);
+    return (count == transitionCounts[fromMilestone].end() ? 0.0 : count->second);
+}
+
+double MmvtKineticsEstimator::getResidenceTime(int milestone) const {
+    if (!kineticsComputed)
+        throw OpenMMException("MmvtKineticsEstimator: computeKinetics() has not been called");
+    checkMilestoneIndex(milestone);
+    return residenceTimes[milestone];
+}
+
+double MmvtKineticsEstimator::getRate(int fromMilestone, int toMilestone) const {
+    if (!kineticsComputed)
+        throw OpenMMException("MmvtKineticsEstimator: computeKinetics() has not been called");
+    checkMilestoneIndex(fromMilestone);
+    checkMilestoneIndex(toMilestone);
+    auto rate = rates[fromMilestone].find(toMilestone);
+    return (rate == rates[fromMilestone].end() ? 0.0 : rate->second);
+}
+
+vector<double> MmvtKineticsEstimator::computeMFPTs(const vector<int>& sinkMilestones) const {
+    if (!kineticsComputed)
+        throw OpenMMException("MmvtKineticsEstimator: computeKinetics() has not been called");
+    if (sinkMilestones.empty())
+        throw OpenMMException("MmvtKineticsEstimator: at least one sink milestone is required");
+    vector<bool> isSink(numMilestones, false);
+    for (int sink : sinkMilestones) {
+        checkMilestoneIndex(sink);
+        isSink[sink] = true;
+    }
+    
+    // The unknowns are the passage times from every visited milestone that
+    // is not a sink. Transitions into milestones that have never been
+    // visited are ignored.
+    
+    vector<int> unknownIndex(numMilestones, -1);
+    int numUnknowns = 0;
+    for (int i = 0; i < numMilestones; i++)
+        if (!isSink[i] && residenceTimes[i] > 0.0)
+            unknownIndex[i] = numUnknowns++;
+    vector<double> mfpts(numMilestones, numeric_limits<double>::quiet_NaN());
+    for (int i = 0; i < numMilestones; i++)
+        if (isSink[i])
+            mfpts[i] = 0.0;
+    if (numUnknowns == 0)
+        return mfpts;
+    SparseLinearSolver solver(numUnknowns);
+    for (int i = 0; i < numMilestones; i++) {
+        int row = unknownIndex[i];
+        if (row == -1)
+            continue;
+        for (auto& rate : rates[i]) {
+            int j = rate.first;
+            if (j == i || (!isSink[j] && unknownIndex[j] == -1))
+                continue;
+            solver.addToMatrix(row, row, -rate.second);
+            if (!isSink[j])
+                solver.addToMatrix(row, unknownIndex[j], rate.second);
+        }
+        solver.addToRightHandSide(row, -1.0);
+    }
+    vector<double> solution;
+    solver.solve(solution);
+    for (int i = 0; i < numMilestones; i++)
+        if (unknownIndex[i] != -1)
+            mfpts[i] = solution[unknownIndex[i]];
+    return mfpts;
+}
+
+double MmvtKineticsEstimator::computeMFPT(int sourceMilestone, const vector<int>& sinkMilestones) const {
+    checkMilestoneIndex(sourceMilestone);
+    return computeMFPTs(sinkMilestones)[sourceMilestone];
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "SparseLinearSolver.h"
+#include "openmm/OpenMMException.h"
+#include <cmath>
+
+using namespace Seekr2Plugin;
+using namespace OpenMM;
+using namespace std;
+
+SparseLinearSolver::SparseLinearSolver(int size) : rows(size), rhs(size, 0.0) {
+}
+
+void SparseLinearSolver::addToMatrix(int row, int column, double value) {
+    rows[row][column] += value;
+}
+
+void SparseLinearSolver::addToRightHandSide(int row, double value) {
+    rhs[row] += value;
+}
+
+void SparseLinearSolver::clearRow(int row) {
+    rows[row].clear();
+    rhs[row] = 0.0;
+}
+
+void SparseLinearSolver::solve(vector<double>& solution) {
+    int size = rows.size();
+    
+    // Scale tolerance for detecting singular matrices by the largest element.
+    
+    double maxElement = 0.0;
+    for (auto& row : rows)
+        for (auto& element : row)
+            maxElement = max(maxElement, fabs(element.second));
+    double tolerance = 1e-14*maxElement;
+    
+    // Forward elimination.
+    
+    for (int k = 0; k < size; k++) {
+        int pivot = -1;
+        double pivotValue = 0.0;
+        for (int i = k; i < size; i++) {
+            auto element = rows[i].find(k);
+            if (element != rows[i].end() && fabs(element->second) > pivotValue) {
+                pivot = i;
+                pivotValue = fabs(element->second);
+            }
+        }
+        if (pivot == -1 || pivotValue <= tolerance)
+            throw OpenMMException("SparseLinearSolver: the matrix is singular");
+        if (pivot != k) {
+            swap(rows[pivot], rows[k]);
+            swap(rhs[pivot], rhs[k]);
+        }
+        double diagonal = rows[k][k];
+        for (int i = k+1; i < size; i++) {
+            auto element = rows[i].find(k);
+            if (element == rows[i].end())
+                continue;
+            double factor = element->second/diagonal;
+            rows[i].erase(element);
+            for (auto& pivotElement : rows[k])
+                if (pivotElement.first > k)
+                    rows[i][pivotElement.first] -= factor*pivotElement.second;
+            rhs[i] -= factor*rhs[k];
+        }
+    }
+    
+    // Back substitution.
+    
+    solution.resize(size);
+    for (int k = size-1; k >= 0; k--) {
+        double sum = rhs[k];
+        for (auto& element : rows[k])
+            if (element.first > k)
+                sum -= element.second*solution[element.first];
+        solution[k] = sum/rows[k][k];
+    }
+}
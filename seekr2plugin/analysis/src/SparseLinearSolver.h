@@ -0,0 +1,84 @@
+#ifndef OPENMM_SEEKR2_SPARSELINEARSOLVER_H_
+#define OPENMM_SEEKR2_SPARSELINEARSOLVER_H_
+
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include <map>
+#include <vector>
+
+namespace Seekr2Plugin {
+
+/**
+ * This class solves a sparse linear system A x = b by Gaussian elimination
+ * with partial pivoting. The rows are stored as maps from column index to
+ * value, so that only nonzero elements and the fill-in created during the
+ * elimination take up memory. The rate matrices of milestoning models are
+ * nearly banded, so the fill-in stays small.
+ */
+
+class SparseLinearSolver {
+public:
+    /**
+     * Create a solver for a system of the given size. All elements of A and b
+     * start out as zero.
+     */
+    explicit SparseLinearSolver(int size);
+    /**
+     * Add a value to an element of the matrix.
+     */
+    void addToMatrix(int row, int column, double value);
+    /**
+     * Add a value to an element of the right hand side.
+     */
+    void addToRightHandSide(int row, double value);
+    /**
+     * Replace a row of the system with a new, empty one.
+     */
+    void clearRow(int row);
+    /**
+     * Solve the system. An OpenMMException is thrown if the matrix is singular.
+     * The matrix is destroyed in the process.
+     *
+     * @param solution    on exit, the solution x
+     */
+    void solve(std::vector<double>& solution);
+private:
+    std::vector<std::map<int, double> > rows;
+    std::vector<double> rhs;
+};
+
+} // namespace Seekr2Plugin
+
+#endif /*OPENMM_SEEKR2_SPARSELINEARSOLVER_H_*/
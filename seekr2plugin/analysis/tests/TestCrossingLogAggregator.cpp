@@ -0,0 +1,186 @@
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * This tests the MMVT kinetics estimator.
+ */
+
+#include "CrossingLogAggregator.h"
+#include "openmm/OpenMMException.h"
+#include "openmm/internal/AssertionUtilities.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+using namespace Seekr2Plugin;
+using namespace OpenMM;
+using namespace std;
+
+const double TOL = 1e-10;
+
+void testParse() {
+    // Transitions 2->1 after 2 ps and 1->2 after 3 ps, followed by a bounce
+    // that is not part of any transition. The last line has no newline.
+    
+    const char* log = "#\"Bounced boundary ID\",\"bounce index\",\"total time (ps)\"\n"
+                      "2,1,0.0\n2,2,1.0\n1,3,2.0\r\n\n1,4,3.0\n2,5,5.0\n2,6,6.5";
+    CrossingLogSummary summary = CrossingLogAggregator::parse(log, strlen(log));
+    const MmvtAnchorStatistics& statistics = summary.statistics;
+    ASSERT_EQUAL(6, summary.numRows);
+    ASSERT_EQUAL(0, summary.numInvalidRows);
+    ASSERT_EQUAL(2, (int) statistics.milestoneGroups.size());
+    ASSERT_EQUAL(1, statistics.milestoneGroups[0]);
+    ASSERT_EQUAL(2, statistics.milestoneGroups[1]);
+    ASSERT_EQUAL(2, statistics.N_alpha_beta[0]);
+    ASSERT_EQUAL(4, statistics.N_alpha_beta[1]);
+    ASSERT_EQUAL(0, statistics.Nij_alpha[0][0]);
+    ASSERT_EQUAL(1, statistics.Nij_alpha[0][1]);
+    ASSERT_EQUAL(1, statistics.Nij_alpha[1][0]);
+    ASSERT_EQUAL(0, statistics.Nij_alpha[1][1]);
+    ASSERT_EQUAL_TOL(3.0, statistics.Ri_alpha[0], TOL);
+    ASSERT_EQUAL_TOL(2.0, statistics.Ri_alpha[1], TOL);
+    ASSERT_EQUAL_TOL(6.5, statistics.T_alpha, TOL);
+    
+    // Malformed lines are reported.
+    
+    const char* bad = "1,2,3.0\nx,3,4.0\n";
+    bool failed = false;
+    try {
+        CrossingLogAggregator::parse(bad, strlen(bad));
+    }
+    catch (OpenMMException& ex) {
+        failed = true;
+    }
+    ASSERT(failed);
+}
+
+void testElberLog() {
+    // Rows flagged with an asterisk are counted but otherwise ignored.
+    
+    const char* log = "#\"Crossed boundary ID\",\"crossing counter\",\"total time (ps)\"\n"
+                      "# An asterisk(*) indicates that source milestone was never crossed - asterisked statistics are invalid and should be excluded.\n"
+                      "3*,1,0.5\n3,2,1.5\n1,3,2.0\n3*,4,4.0\n3,5,5.0\n";
+    CrossingLogSummary summary = CrossingLogAggregator::parse(log, strlen(log));
+    const MmvtAnchorStatistics& statistics = summary.statistics;
+    ASSERT_EQUAL(5, summary.numRows);
+    ASSERT_EQUAL(2, summary.numInvalidRows);
+    ASSERT_EQUAL(1, statistics.N_alpha_beta[0]);
+    ASSERT_EQUAL(2, statistics.N_alpha_beta[1]);
+    ASSERT_EQUAL(1, statistics.Nij_alpha[0][1]);
+    ASSERT_EQUAL(1, statistics.Nij_alpha[1][0]);
+    ASSERT_EQUAL_TOL(3.5, statistics.T_alpha, TOL);
+}
+
+void testFilesAndTable() {
+    // Write a set of logs, read them with several threads, and check that the
+    // binary table reproduces the summaries.
+    
+    const int numFiles = 7;
+    vector<string> fileNames;
+    CrossingLogAggregator aggregator;
+    aggregator.setNumThreads(3);
+    for (int i = 0; i < numFiles; i++) {
+        stringstream name;
+        name << "/tmp/seekr2_test_aggregator_" << i << ".txt";
+        fileNames.push_back(name.str());
+        ofstream file(name.str().c_str());
+        file << "#\"Bounced boundary ID\",\"bounce index\",\"total time (ps)\"\n";
+        for (int j = 0; j < 1000*(i+1); j++)
+            file << (j%(i+2) == 0 ? i+2 : i+1) << "," << j+1 << "," << 0.002*j << "\n";
+        file.close();
+        ASSERT_EQUAL(i, aggregator.addFile(name.str()));
+    }
+    aggregator.run();
+    for (int i = 0; i < numFiles; i++) {
+        const CrossingLogSummary& summary = aggregator.getSummary(i);
+        ASSERT_EQUAL(fileNames[i], summary.fileName);
+        ASSERT_EQUAL(1000*(i+1), summary.numRows);
+        ASSERT_EQUAL(i+1, summary.statistics.milestoneGroups[0]);
+        ASSERT_EQUAL(i+2, summary.statistics.milestoneGroups[1]);
+        ASSERT(abs(summary.statistics.Nij_alpha[1][0]-summary.statistics.Nij_alpha[0][1]) <= 1);
+        ASSERT(summary.statistics.Nij_alpha[1][0] > 0);
+        ASSERT_EQUAL_TOL(0.002*(1000*(i+1)-1), summary.statistics.T_alpha, 1e-8);
+    }
+    const char* tableName = "/tmp/seekr2_test_aggregator.bin";
+    aggregator.writeTable(tableName);
+    vector<CrossingLogSummary> table = CrossingLogAggregator::readTable(tableName);
+    remove(tableName);
+    ASSERT_EQUAL(numFiles, (int) table.size());
+    for (int i = 0; i < numFiles; i++) {
+        const CrossingLogSummary& expected = aggregator.getSummary(i);
+        ASSERT_EQUAL(expected.fileName, table[i].fileName);
+        ASSERT_EQUAL(expected.numRows, table[i].numRows);
+        ASSERT_EQUAL(expected.numInvalidRows, table[i].numInvalidRows);
+        ASSERT_EQUAL(expected.statistics.T_alpha, table[i].statistics.T_alpha);
+        for (int j = 0; j < 2; j++) {
+            ASSERT_EQUAL(expected.statistics.milestoneGroups[j], table[i].statistics.milestoneGroups[j]);
+            ASSERT_EQUAL(expected.statistics.N_alpha_beta[j], table[i].statistics.N_alpha_beta[j]);
+            ASSERT_EQUAL(expected.statistics.Ri_alpha[j], table[i].statistics.Ri_alpha[j]);
+            for (int k = 0; k < 2; k++)
+                ASSERT_EQUAL(expected.statistics.Nij_alpha[j][k], table[i].statistics.Nij_alpha[j][k]);
+        }
+    }
+    
+    // A missing file is reported.
+    
+    remove(fileNames[0].c_str());
+    bool failed = false;
+    try {
+        aggregator.run();
+    }
+    catch (OpenMMException& ex) {
+        failed = true;
+    }
+    ASSERT(failed);
+    for (int i = 1; i < numFiles; i++)
+        remove(fileNames[i].c_str());
+}
+
+int main() {
+    try {
+        testParse();
+        testElberLog();
+        testFilesAndTable();
+    }
+    catch(const exception& e) {
+        cout << "exception: " << e.what() << endl;
+        return 1;
+    }
+    cout << "Done" << endl;
+    return 0;
+}
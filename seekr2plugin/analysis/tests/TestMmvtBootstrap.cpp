@@ -0,0 +1,203 @@
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * This tests the MMVT kinetics estimator.
+ */
+
+#include "MmvtBootstrap.h"
+#include "openmm/OpenMMException.h"
+#include "openmm/internal/AssertionUtilities.h"
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+using namespace Seekr2Plugin;
+using namespace OpenMM;
+using namespace std;
+
+const double TOL = 1e-10;
+
+MmvtAnchorStatistics createStatistics(const vector<int>& groups, int bounces, double time) {
+    MmvtAnchorStatistics statistics;
+    int numGroups = groups.size();
+    statistics.milestoneGroups = groups;
+    statistics.N_alpha_beta.resize(numGroups, bounces);
+    statistics.Nij_alpha.resize(numGroups, vector<int>(numGroups, 0));
+    statistics.Ri_alpha.resize(numGroups, time);
+    statistics.T_alpha = time;
+    return statistics;
+}
+
+/**
+ * Build a three anchor, two milestone model where the statistics of the
+ * outer anchors are given directly, and those of the middle anchor are left
+ * to be read from a crossing log.
+ */
+void buildModel(MmvtKineticsEstimator& estimator) {
+    for (int i = 0; i < 3; i++)
+        estimator.addAnchor();
+    estimator.addAnchorBoundary(0, 1, 0, 1);
+    estimator.addAnchorBoundary(1, 1, 0, 0);
+    estimator.addAnchorBoundary(1, 2, 1, 2);
+    estimator.addAnchorBoundary(2, 1, 1, 1);
+    vector<int> oneGroup(1, 1);
+    estimator.setAnchorStatistics(0, createStatistics(oneGroup, 100, 100.0));
+    estimator.setAnchorStatistics(2, createStatistics(oneGroup, 100, 100.0));
+}
+
+/**
+ * Write a crossing log for the middle anchor that alternates between its
+ * two boundaries, with a varying number of bounces and dwell time on each.
+ */
+void writeCrossingLog(const char* fileName, int numSegments) {
+    ofstream file(fileName);
+    file << "#\"Bounced boundary ID\",\"bounce index\",\"total time (ps)\"\n";
+    double time = 0.0;
+    int bounce = 1;
+    for (int i = 0; i < numSegments; i++) {
+        int group = (i%2 == 0 ? 1 : 2);
+        int bounces = 1+(i*7)%5;
+        for (int j = 0; j < bounces; j++) {
+            file << group << "," << bounce++ << "," << time << "\n";
+            time += 0.1*(1+(i*3+j)%4);
+        }
+    }
+    file << "1," << bounce << "," << time << "\n";
+    file.close();
+}
+
+void testCrossingLog() {
+    // Segments are 1->2 (2 bounces, 2 ps) and 2->1 (2 bounces, 3 ps), with
+    // an invalid row that must be skipped and two trailing bounces.
+    
+    const char* fileName = "/tmp/seekr2_test_bootstrap_log.txt";
+    ofstream file(fileName);
+    file << "#\"Bounced boundary ID\",\"bounce index\",\"total time (ps)\"\n";
+    file << "1,1,0.0\n1,2,1.0\n2,3,2.0\n2,4,3.0\n1,5,5.0\n2*,6,5.5\n1,6,6.0\n";
+    file.close();
+    MmvtKineticsEstimator estimator;
+    buildModel(estimator);
+    MmvtBootstrap bootstrap(estimator);
+    bootstrap.readAnchorCrossingLog(1, fileName);
+    remove(fileName);
+    ASSERT_EQUAL(2, bootstrap.getNumAnchorSegments(1));
+    ASSERT_EQUAL(0, bootstrap.getNumAnchorSegments(0));
+    
+    // The point estimate should match statistics built by hand.
+    
+    vector<int> twoGroups;
+    twoGroups.push_back(1);
+    twoGroups.push_back(2);
+    MmvtAnchorStatistics expected = createStatistics(twoGroups, 0, 6.0);
+    expected.N_alpha_beta[0] = 4;
+    expected.N_alpha_beta[1] = 2;
+    expected.Nij_alpha[0][1] = 1;
+    expected.Nij_alpha[1][0] = 1;
+    expected.Ri_alpha[0] = 2.0;
+    expected.Ri_alpha[1] = 3.0;
+    estimator.setAnchorStatistics(1, expected);
+    estimator.computeKinetics();
+    vector<int> sinks(1, 1);
+    MmvtBootstrapResult result = bootstrap.run(20, 0, sinks);
+    ASSERT_EQUAL_TOL(estimator.computeMFPT(0, sinks), result.mfpt, TOL);
+    ASSERT_EQUAL(20, result.numResamples);
+}
+
+void testConfidenceInterval() {
+    const char* fileName = "/tmp/seekr2_test_bootstrap_log.txt";
+    writeCrossingLog(fileName, 200);
+    MmvtKineticsEstimator estimator;
+    buildModel(estimator);
+    MmvtBootstrap bootstrap(estimator);
+    bootstrap.readAnchorCrossingLog(1, fileName);
+    remove(fileName);
+    bootstrap.setRandomNumberSeed(5);
+    vector<int> sinks(1, 1);
+    MmvtBootstrapResult result = bootstrap.run(200, 0, sinks, 0.9);
+    ASSERT_EQUAL(0, result.numFailed);
+    ASSERT_EQUAL(200, (int) result.mfptSamples.size());
+    ASSERT(result.mfptLower < result.mfpt);
+    ASSERT(result.mfptUpper > result.mfpt);
+    ASSERT(result.mfptLower <= result.mfptMean && result.mfptMean <= result.mfptUpper);
+    ASSERT(result.mfptStdDev > 0.0);
+    ASSERT(result.mfptStdDev < 0.5*result.mfpt);
+    ASSERT_EQUAL_TOL(1.0/result.mfpt, result.rate, TOL);
+    ASSERT_EQUAL_TOL(1.0/result.mfptUpper, result.rateLower, TOL);
+    ASSERT_EQUAL_TOL(1.0/result.mfptLower, result.rateUpper, TOL);
+}
+
+void testDeterminism() {
+    // The resamples depend only on the seed, not on how many threads
+    // generate them.
+    
+    const char* fileName = "/tmp/seekr2_test_bootstrap_log.txt";
+    writeCrossingLog(fileName, 50);
+    MmvtKineticsEstimator estimator;
+    buildModel(estimator);
+    MmvtBootstrap bootstrap(estimator);
+    bootstrap.readAnchorCrossingLog(1, fileName);
+    remove(fileName);
+    bootstrap.setRandomNumberSeed(11);
+    vector<int> sinks(1, 1);
+    bootstrap.setNumThreads(1);
+    MmvtBootstrapResult serial = bootstrap.run(50, 0, sinks);
+    bootstrap.setNumThreads(4);
+    MmvtBootstrapResult parallel = bootstrap.run(50, 0, sinks);
+    ASSERT_EQUAL(serial.mfptSamples.size(), parallel.mfptSamples.size());
+    for (int i = 0; i < serial.mfptSamples.size(); i++)
+        ASSERT_EQUAL(serial.mfptSamples[i], parallel.mfptSamples[i]);
+    bootstrap.setRandomNumberSeed(12);
+    MmvtBootstrapResult other = bootstrap.run(50, 0, sinks);
+    bool different = false;
+    for (int i = 0; i < serial.mfptSamples.size(); i++)
+        different |= (serial.mfptSamples[i] != other.mfptSamples[i]);
+    ASSERT(different);
+}
+
+int main() {
+    try {
+        testCrossingLog();
+        testConfidenceInterval();
+        testDeterminism();
+    }
+    catch(const exception& e) {
+        cout << "exception: " << e.what() << endl;
+        return 1;
+    }
+    cout << "Done" << endl;
+    return 0;
+}
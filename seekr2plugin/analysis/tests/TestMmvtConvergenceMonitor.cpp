@@ -0,0 +1,142 @@
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * This tests the MMVT convergence monitor.
+ */
+
+#include "MmvtConvergenceMonitor.h"
+#include "openmm/OpenMMException.h"
+#include "openmm/internal/AssertionUtilities.h"
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+using namespace Seekr2Plugin;
+using namespace OpenMM;
+using namespace std;
+
+const double TOL = 1e-10;
+
+/**
+ * Advance cumulative two-boundary statistics by one block.
+ */
+void addIncrement(MmvtAnchorStatistics& statistics, int bounces0, int bounces1, int transitions, double residence, double time) {
+    if (statistics.milestoneGroups.empty()) {
+        statistics.milestoneGroups.push_back(1);
+        statistics.milestoneGroups.push_back(2);
+        statistics.N_alpha_beta.assign(2, 0);
+        statistics.Nij_alpha.assign(2, vector<int>(2, 0));
+        statistics.Ri_alpha.assign(2, 0.0);
+    }
+    statistics.N_alpha_beta[0] += bounces0;
+    statistics.N_alpha_beta[1] += bounces1;
+    statistics.Nij_alpha[0][1] += transitions;
+    statistics.Nij_alpha[1][0] += transitions;
+    statistics.Ri_alpha[0] += residence;
+    statistics.Ri_alpha[1] += residence;
+    statistics.T_alpha += time;
+}
+
+void testSteadyRates() {
+    // Identical blocks have no variance, but the monitor must still wait for
+    // the minimum number of blocks.
+    
+    MmvtConvergenceMonitor monitor;
+    monitor.setMinBlocks(5);
+    MmvtAnchorStatistics statistics;
+    for (int i = 0; i < 4; i++) {
+        addIncrement(statistics, 10, 10, 2, 5.0, 10.0);
+        monitor.addBlock(statistics);
+        ASSERT(!monitor.isConverged(0.01));
+    }
+    addIncrement(statistics, 10, 10, 2, 5.0, 10.0);
+    monitor.addBlock(statistics);
+    ASSERT_EQUAL(5, monitor.getNumBlocks());
+    ASSERT_EQUAL(4, monitor.getNumTrackedRates());
+    ASSERT_EQUAL_TOL(0.0, monitor.getMaxRelativeError(), TOL);
+    ASSERT(monitor.isConverged(0.01));
+    monitor.reset();
+    ASSERT_EQUAL(0, monitor.getNumBlocks());
+    ASSERT(!monitor.isConverged(0.01));
+}
+
+void testRatioError() {
+    // Blocks of equal length with bounce counts alternating between 8 and 12
+    // give a rate of 1 with a standard error of sqrt(var/n)/10.
+    
+    MmvtConvergenceMonitor monitor;
+    MmvtAnchorStatistics statistics;
+    int numBlocks = 20;
+    for (int i = 0; i < numBlocks; i++) {
+        addIncrement(statistics, (i%2 == 0 ? 8 : 12), 10, 1, 5.0, 10.0);
+        monitor.addBlock(statistics);
+    }
+    double variance = 4.0*numBlocks/(numBlocks-1);
+    double expected = sqrt(variance/numBlocks)/10.0;
+    ASSERT_EQUAL_TOL(expected, monitor.getBounceRateRelativeError(0), TOL);
+    ASSERT_EQUAL_TOL(0.0, monitor.getBounceRateRelativeError(1), TOL);
+    ASSERT_EQUAL_TOL(expected, monitor.getMaxRelativeError(), TOL);
+    ASSERT(monitor.isConverged(0.1));
+    ASSERT(!monitor.isConverged(0.01));
+}
+
+void testUnobservedRates() {
+    // Transitions that never happen are not tracked, and with no events at
+    // all the statistics are never converged.
+    
+    MmvtConvergenceMonitor monitor;
+    MmvtAnchorStatistics statistics;
+    for (int i = 0; i < 20; i++) {
+        addIncrement(statistics, 0, 0, 0, 0.0, 10.0);
+        monitor.addBlock(statistics);
+    }
+    ASSERT_EQUAL(0, monitor.getNumTrackedRates());
+    ASSERT(!monitor.isConverged(1.0));
+    ASSERT(std::isinf(monitor.getTransitionRateRelativeError(0, 1)));
+}
+
+int main() {
+    try {
+        testSteadyRates();
+        testRatioError();
+        testUnobservedRates();
+    }
+    catch(const exception& e) {
+        cout << "exception: " << e.what() << endl;
+        return 1;
+    }
+    cout << "Done" << endl;
+    return 0;
+}
@@ -0,0 +1,343 @@
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * This tests the MMVT kinetics estimator.
+ */
+
+#include "MmvtKineticsEstimator.h"
+#include "openmm/OpenMMException.h"
+#include "openmm/internal/AssertionUtilities.h"
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+using namespace Seekr2Plugin;
+using namespace OpenMM;
+using namespace std;
+
+const double TOL = 1e-10;
+
+MmvtAnchorStatistics createStatistics(const vector<int>& groups, double time) {
+    MmvtAnchorStatistics statistics;
+    int numGroups = groups.size();
+    statistics.milestoneGroups = groups;
+    statistics.N_alpha_beta.resize(numGroups, 0);
+    statistics.Nij_alpha.resize(numGroups, vector<int>(numGroups, 0));
+    statistics.Ri_alpha.resize(numGroups, 0.0);
+    statistics.T_alpha = time;
+    return statistics;
+}
+
+/**
+ * Build a three anchor, two milestone model whose kinetics can be worked out
+ * by hand: every anchor has the same stationary probability, and the time to
+ * go from milestone 0 to milestone 1 is 6 ps.
+ */
+void buildSymmetricModel(MmvtKineticsEstimator& estimator) {
+    for (int i = 0; i < 3; i++)
+        estimator.addAnchor();
+    estimator.addAnchorBoundary(0, 1, 0, 1);
+    estimator.addAnchorBoundary(1, 1, 0, 0);
+    estimator.addAnchorBoundary(1, 2, 1, 2);
+    estimator.addAnchorBoundary(2, 1, 1, 1);
+    
+    vector<int> oneGroup(1, 1);
+    vector<int> twoGroups;
+    twoGroups.push_back(1);
+    twoGroups.push_back(2);
+    MmvtAnchorStatistics anchor0 = createStatistics(oneGroup, 10.0);
+    anchor0.N_alpha_beta[0] = 10;
+    anchor0.Ri_alpha[0] = 10.0;
+    MmvtAnchorStatistics anchor1 = createStatistics(twoGroups, 20.0);
+    anchor1.N_alpha_beta[0] = 20;
+    anchor1.N_alpha_beta[1] = 20;
+    anchor1.Nij_alpha[0][1] = 5;
+    anchor1.Nij_alpha[1][0] = 5;
+    anchor1.Ri_alpha[0] = 10.0;
+    anchor1.Ri_alpha[1] = 10.0;
+    MmvtAnchorStatistics anchor2 = createStatistics(oneGroup, 10.0);
+    anchor2.N_alpha_beta[0] = 10;
+    anchor2.Ri_alpha[0] = 10.0;
+    estimator.setAnchorStatistics(0, anchor0);
+    estimator.setAnchorStatistics(1, anchor1);
+    estimator.setAnchorStatistics(2, anchor2);
+}
+
+void testSymmetricModel() {
+    MmvtKineticsEstimator estimator;
+    buildSymmetricModel(estimator);
+    estimator.computeKinetics();
+    vector<double> pi = estimator.getAnchorProbabilities();
+    for (int i = 0; i < 3; i++)
+        ASSERT_EQUAL_TOL(1.0/3.0, pi[i], TOL);
+    ASSERT_EQUAL_TOL(1.0/12.0, estimator.getTransitionCount(0, 1), TOL);
+    ASSERT_EQUAL_TOL(0.5, estimator.getResidenceTime(0), TOL);
+    ASSERT_EQUAL_TOL(1.0/6.0, estimator.getRate(0, 1), TOL);
+    ASSERT_EQUAL_TOL(-1.0/6.0, estimator.getRate(0, 0), TOL);
+    vector<int> sinks(1, 1);
+    ASSERT_EQUAL_TOL(6.0, estimator.computeMFPT(0, sinks), TOL);
+    vector<double> mfpts = estimator.computeMFPTs(sinks);
+    ASSERT_EQUAL_TOL(0.0, mfpts[1], TOL);
+}
+
+void testIncrementalUpdate() {
+    // Doubling the rate of leaving anchor 2 halves its probability, and
+    // updating one anchor's statistics should be reflected by the next
+    // call to computeKinetics().
+    
+    MmvtKineticsEstimator estimator;
+    buildSymmetricModel(estimator);
+    estimator.computeKinetics();
+    vector<int> oneGroup(1, 1);
+    MmvtAnchorStatistics anchor2 = createStatistics(oneGroup, 10.0);
+    anchor2.N_alpha_beta[0] = 20;
+    anchor2.Ri_alpha[0] = 10.0;
+    estimator.setAnchorStatistics(2, anchor2);
+    estimator.computeKinetics();
+    vector<double> pi = estimator.getAnchorProbabilities();
+    ASSERT_EQUAL_TOL(0.4, pi[0], TOL);
+    ASSERT_EQUAL_TOL(0.4, pi[1], TOL);
+    ASSERT_EQUAL_TOL(0.2, pi[2], TOL);
+}
+
+void testChain() {
+    // A chain of milestones 0-1-2, each pair bracketing one anchor, with a
+    // reflecting anchor below milestone 0 and a sink at milestone 2. The MFPT
+    // from milestone 0 must match the solution of the 2x2 system written out
+    // by hand.
+    
+    MmvtKineticsEstimator estimator;
+    for (int i = 0; i < 4; i++)
+        estimator.addAnchor();
+    estimator.addAnchorBoundary(0, 1, 0, 1);
+    estimator.addAnchorBoundary(1, 1, 0, 0);
+    estimator.addAnchorBoundary(1, 2, 1, 2);
+    estimator.addAnchorBoundary(2, 1, 1, 1);
+    estimator.addAnchorBoundary(2, 2, 2, 3);
+    estimator.addAnchorBoundary(3, 1, 2, 2);
+    vector<int> oneGroup(1, 1);
+    vector<int> twoGroups;
+    twoGroups.push_back(1);
+    twoGroups.push_back(2);
+    MmvtAnchorStatistics stats0 = createStatistics(oneGroup, 50.0);
+    stats0.N_alpha_beta[0] = 40;
+    stats0.Ri_alpha[0] = 50.0;
+    MmvtAnchorStatistics stats1 = createStatistics(twoGroups, 100.0);
+    stats1.N_alpha_beta[0] = 30;
+    stats1.N_alpha_beta[1] = 20;
+    stats1.Nij_alpha[0][1] = 8;
+    stats1.Nij_alpha[1][0] = 7;
+    stats1.Ri_alpha[0] = 60.0;
+    stats1.Ri_alpha[1] = 40.0;
+    MmvtAnchorStatistics stats2 = createStatistics(twoGroups, 80.0);
+    stats2.N_alpha_beta[0] = 25;
+    stats2.N_alpha_beta[1] = 15;
+    stats2.Nij_alpha[0][1] = 4;
+    stats2.Nij_alpha[1][0] = 5;
+    stats2.Ri_alpha[0] = 50.0;
+    stats2.Ri_alpha[1] = 30.0;
+    MmvtAnchorStatistics stats3 = createStatistics(oneGroup, 30.0);
+    stats3.N_alpha_beta[0] = 45;
+    stats3.Ri_alpha[0] = 30.0;
+    estimator.setAnchorStatistics(0, stats0);
+    estimator.setAnchorStatistics(1, stats1);
+    estimator.setAnchorStatistics(2, stats2);
+    estimator.setAnchorStatistics(3, stats3);
+    estimator.computeKinetics();
+    
+    // Check the anchor probabilities against detailed balance.
+    
+    vector<double> pi = estimator.getAnchorProbabilities();
+    ASSERT_EQUAL_TOL(pi[0]*40.0/50.0, pi[1]*30.0/100.0, TOL);
+    ASSERT_EQUAL_TOL(pi[1]*20.0/100.0, pi[2]*25.0/80.0, TOL);
+    ASSERT_EQUAL_TOL(pi[2]*15.0/80.0, pi[3]*45.0/30.0, TOL);
+    ASSERT_EQUAL_TOL(1.0, pi[0]+pi[1]+pi[2]+pi[3], TOL);
+    
+    double q01 = estimator.getRate(0, 1);
+    double q10 = estimator.getRate(1, 0);
+    double q12 = estimator.getRate(1, 2);
+    ASSERT_EQUAL_TOL(pi[1]*8.0/100.0/(pi[0]*50.0/50.0+pi[1]*60.0/100.0), q01, TOL);
+    double t1 = (1.0+q10/q01)/q12;
+    double t0 = 1.0/q01+t1;
+    vector<int> sinks(1, 2);
+    vector<double> mfpts = estimator.computeMFPTs(sinks);
+    ASSERT_EQUAL_TOL(t0, mfpts[0], 1e-8);
+    ASSERT_EQUAL_TOL(t1, mfpts[1], 1e-8);
+    ASSERT_EQUAL_TOL(0.0, mfpts[2], TOL);
+}
+
+void testStatisticsFile() {
+    const char* fileName = "/tmp/seekr2_test_statistics.txt";
+    ofstream file(fileName);
+    file << "N_alpha_1: 20\nN_alpha_2: 20\n";
+    file << "N_1_1_alpha: 0\nN_1_2_alpha: 5\nN_2_1_alpha: 5\nN_2_2_alpha: 0\n";
+    file << "R_1_alpha: 10.000\nR_2_alpha: 10.000\nT_alpha: 20.000\n";
+    file.close();
+    MmvtAnchorStatistics statistics = MmvtKineticsEstimator::readStatisticsFile(fileName);
+    ASSERT_EQUAL(2, (int) statistics.milestoneGroups.size());
+    ASSERT_EQUAL(1, statistics.milestoneGroups[0]);
+    ASSERT_EQUAL(2, statistics.milestoneGroups[1]);
+    ASSERT_EQUAL(20, statistics.N_alpha_beta[1]);
+    ASSERT_EQUAL(5, statistics.Nij_alpha[0][1]);
+    ASSERT_EQUAL(5, statistics.Nij_alpha[1][0]);
+    ASSERT_EQUAL(0, statistics.Nij_alpha[1][1]);
+    ASSERT_EQUAL_TOL(10.0, statistics.Ri_alpha[1], TOL);
+    ASSERT_EQUAL_TOL(20.0, statistics.T_alpha, TOL);
+    
+    // Reading the middle anchor from the file gives the same kinetics.
+    
+    MmvtKineticsEstimator estimator;
+    buildSymmetricModel(estimator);
+    estimator.readAnchorStatisticsFile(1, fileName);
+    estimator.computeKinetics();
+    vector<int> sinks(1, 1);
+    ASSERT_EQUAL_TOL(6.0, estimator.computeMFPT(0, sinks), TOL);
+    remove(fileName);
+}
+
+void testIncubationTimeHistograms() {
+    // Each decade is split into the same number of bins, and values outside
+    // the range are counted separately.
+    
+    LogBinnedHistogram histogram(0.01, 3, 2);
+    ASSERT_EQUAL(6, histogram.getNumBins());
+    ASSERT_EQUAL_TOL(10.0, histogram.getMaxValue(), TOL);
+    ASSERT_EQUAL_TOL(sqrt(10.0)*0.1, histogram.getBinLowerEdge(3), TOL);
+    histogram.addValue(0.005);
+    histogram.addValue(0.02);
+    histogram.addValue(0.05);
+    histogram.addValue(0.2);
+    histogram.addValue(20.0);
+    ASSERT_EQUAL(1, (int) histogram.getUnderflowCount());
+    ASSERT_EQUAL(1, (int) histogram.getBinCount(0));
+    ASSERT_EQUAL(1, (int) histogram.getBinCount(1));
+    ASSERT_EQUAL(1, (int) histogram.getBinCount(2));
+    ASSERT_EQUAL(1, (int) histogram.getOverflowCount());
+    ASSERT_EQUAL(5, (int) histogram.getTotalCount());
+    ASSERT_EQUAL_TOL(20.275, histogram.getSum(), TOL);
+    
+    // Histograms are read back from the statistics file.
+    
+    const char* fileName = "/tmp/seekr2_test_histograms.txt";
+    ofstream file(fileName);
+    file << "N_alpha_1: 2\nN_alpha_2: 2\n";
+    file << "N_1_1_alpha: 0\nN_1_2_alpha: 2\nN_2_1_alpha: 1\nN_2_2_alpha: 0\n";
+    file << "R_1_alpha: 4.000\nR_2_alpha: 2.000\n";
+    file << "H_1_2_alpha: " << histogram.toString() << "\n";
+    file << "T_alpha: 6.000\n";
+    file.close();
+    MmvtAnchorStatistics statistics = MmvtKineticsEstimator::readStatisticsFile(fileName);
+    ASSERT_EQUAL(2, (int) statistics.incubationTimeHistograms.size());
+    const LogBinnedHistogram& read = statistics.incubationTimeHistograms[0][1];
+    ASSERT_EQUAL(6, read.getNumBins());
+    ASSERT_EQUAL(5, (int) read.getTotalCount());
+    ASSERT_EQUAL(1, (int) read.getBinCount(2));
+    ASSERT_EQUAL(1, (int) read.getOverflowCount());
+    ASSERT_EQUAL_TOL(20.275, read.getSum(), TOL);
+    ASSERT_EQUAL(0, (int) statistics.incubationTimeHistograms[1][0].getTotalCount());
+    remove(fileName);
+}
+
+void testWriteStatistics() {
+    // Statistics written out are read back unchanged.
+    
+    vector<int> groups;
+    groups.push_back(3);
+    groups.push_back(7);
+    MmvtAnchorStatistics statistics = createStatistics(groups, 12.5);
+    statistics.N_alpha_beta[0] = 4;
+    statistics.N_alpha_beta[1] = 6;
+    statistics.Nij_alpha[0][1] = 3;
+    statistics.Nij_alpha[1][0] = 2;
+    statistics.Ri_alpha[0] = 7.25;
+    statistics.Ri_alpha[1] = 5.25;
+    statistics.incubationTimeHistograms.resize(2, vector<LogBinnedHistogram>(2));
+    statistics.incubationTimeHistograms[0][1].addValue(0.5);
+    statistics.incubationTimeHistograms[0][1].addValue(2.5);
+    stringstream stream;
+    MmvtKineticsEstimator::writeStatistics(statistics, stream);
+    MmvtAnchorStatistics read = MmvtKineticsEstimator::readStatistics(stream);
+    ASSERT_EQUAL(2, (int) read.milestoneGroups.size());
+    ASSERT_EQUAL(3, read.milestoneGroups[0]);
+    ASSERT_EQUAL(7, read.milestoneGroups[1]);
+    ASSERT_EQUAL(4, read.N_alpha_beta[0]);
+    ASSERT_EQUAL(6, read.N_alpha_beta[1]);
+    ASSERT_EQUAL(3, read.Nij_alpha[0][1]);
+    ASSERT_EQUAL(2, read.Nij_alpha[1][0]);
+    ASSERT_EQUAL(0, read.Nij_alpha[0][0]);
+    ASSERT_EQUAL_TOL(7.25, read.Ri_alpha[0], TOL);
+    ASSERT_EQUAL_TOL(5.25, read.Ri_alpha[1], TOL);
+    ASSERT_EQUAL_TOL(12.5, read.T_alpha, TOL);
+    ASSERT_EQUAL(2, (int) read.incubationTimeHistograms[0][1].getTotalCount());
+    ASSERT_EQUAL_TOL(3.0, read.incubationTimeHistograms[0][1].getSum(), 1e-5);
+    ASSERT_EQUAL(0, (int) read.incubationTimeHistograms[1][0].getTotalCount());
+}
+
+void testMissingStatistics() {
+    MmvtKineticsEstimator estimator;
+    estimator.addAnchor();
+    estimator.addAnchor();
+    estimator.addAnchorBoundary(0, 1, 0, 1);
+    estimator.addAnchorBoundary(1, 1, 0, 0);
+    bool failed = false;
+    try {
+        estimator.computeKinetics();
+    }
+    catch (OpenMMException& ex) {
+        failed = true;
+    }
+    ASSERT(failed);
+}
+
+int main() {
+    try {
+        testSymmetricModel();
+        testIncrementalUpdate();
+        testChain();
+        testStatisticsFile();
+        testIncubationTimeHistograms();
+        testWriteStatistics();
+        testMissingStatistics();
+    }
+    catch(const exception& e) {
+        cout << "exception: " << e.what() << endl;
+        return 1;
+    }
+    cout << "Done" << endl;
+    return 0;
+}
@@ -0,0 +1,171 @@
+#ifndef OPENMM_CROSSINGSNAPSHOTQUEUE_H_
+#define OPENMM_CROSSINGSNAPSHOTQUEUE_H_
+
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "openmm/Vec3.h"
+#include "internal/windowsExportSeekr2.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <vector>
+
+namespace Seekr2Plugin {
+
+/**
+ * The positions and velocities of the system at the moment an MMVT boundary
+ * was bounced upon, along with the information needed to identify the event.
+ */
+
+struct CrossingSnapshot {
+    CrossingSnapshot() : milestoneGroup(-1), bounceIndex(-1), time(0.0) {
+    }
+    int milestoneGroup;
+    int bounceIndex;
+    double time;
+    OpenMM::Vec3 periodicBoxVectors[3];
+    std::vector<OpenMM::Vec3> positions;
+    std::vector<OpenMM::Vec3> velocities;
+};
+
+/**
+ * A bounded, thread-safe queue of crossing snapshots. An
+ * MmvtLangevinMiddleIntegrator publishes a snapshot into the queue whenever
+ * it bounces against a single boundary whose milestone group is accepted by
+ * the queue, and an Elber runner may pop the snapshots in another thread and
+ * load them directly into its own Context, without any XML files being
+ * written to or read from the disk.
+ *
+ * The queue does not take ownership of anything, and must outlive every
+ * Context whose integrator publishes to it.
+ */
+
+class OPENMM_EXPORT_SEEKR2 CrossingSnapshotQueue {
+public:
+    /**
+     * Create a CrossingSnapshotQueue.
+     *
+     * @param capacity    the maximum number of snapshots held by the queue at once
+     */
+    explicit CrossingSnapshotQueue(int capacity);
+    /**
+     * Get the maximum number of snapshots held by the queue at once.
+     */
+    int getCapacity() const {
+        return capacity;
+    }
+    /**
+     * Get whether publish() waits for room in the queue when it is full.
+     */
+    bool getBlockWhenFull() const;
+    /**
+     * Set whether publish() waits for room in the queue when it is full. If
+     * false (the default), snapshots published into a full queue are
+     * discarded, so that a slow consumer never stalls the MMVT simulation.
+     *
+     * @param block    whether to block the publisher
+     */
+    void setBlockWhenFull(bool block);
+    /**
+     * Only accept snapshots from the given milestone group. If this is never
+     * called, snapshots from every milestone group are accepted.
+     *
+     * @param milestoneGroup    the milestone group to accept
+     */
+    void addMilestoneGroup(int milestoneGroup);
+    /**
+     * Get whether snapshots from a milestone group are accepted by the queue.
+     *
+     * @param milestoneGroup    the milestone group to test
+     */
+    bool acceptsMilestoneGroup(int milestoneGroup) const;
+    /**
+     * Add a snapshot to the back of the queue.
+     *
+     * @param snapshot    the snapshot to add
+     * @return true if the snapshot was queued, false if it was discarded
+     * because its milestone group is not accepted, or because the queue
+     * was full or closed
+     */
+    bool publish(const CrossingSnapshot& snapshot);
+    /**
+     * Remove the snapshot at the front of the queue, waiting for one to be
+     * published if the queue is empty.
+     *
+     * @param snapshot    on exit, the removed snapshot
+     * @return false if the queue was closed and no snapshots remain
+     */
+    bool pop(CrossingSnapshot& snapshot);
+    /**
+     * Remove the snapshot at the front of the queue if there is one.
+     *
+     * @param snapshot    on exit, the removed snapshot
+     * @return false if the queue was empty
+     */
+    bool tryPop(CrossingSnapshot& snapshot);
+    /**
+     * Close the queue. Further snapshots are discarded, and pop() returns
+     * false once the remaining snapshots have been consumed.
+     */
+    void close();
+    /**
+     * Get whether the queue has been closed.
+     */
+    bool isClosed() const;
+    /**
+     * Get the number of snapshots currently in the queue.
+     */
+    int getSize() const;
+    /**
+     * Get the number of snapshots that were discarded because the queue was
+     * full or closed.
+     */
+    long long getNumDropped() const;
+private:
+    int capacity;
+    bool blockWhenFull;
+    bool closed;
+    long long numDropped;
+    std::set<int> milestoneGroups;
+    std::deque<CrossingSnapshot> snapshots;
+    mutable std::mutex lock;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+};
+
+} // namespace Seekr2Plugin
+
+#endif /*OPENMM_CROSSINGSNAPSHOTQUEUE_H_*/
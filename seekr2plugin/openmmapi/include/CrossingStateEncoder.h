@@ -0,0 +1,198 @@
+#ifndef OPENMM_CROSSINGSTATEENCODER_H_
+#define OPENMM_CROSSINGSTATEENCODER_H_
+
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "CrossingSnapshotQueue.h"
+#include "internal/windowsExportSeekr2.h"
+#include "openmm/State.h"
+#include "openmm/Vec3.h"
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace Seekr2Plugin {
+
+/**
+ * This class describes how the states saved upon milestone crossings are
+ * encoded, and reads them back.
+ *
+ * By default, a state is written as XML, in the same format as a serialized
+ * State. A compact binary format may be chosen instead, in which the
+ * positions and velocities are stored as doubles, as floats, or as 32 bit
+ * integers in units of a fixed resolution. The positions may also be stored
+ * as their differences from a reference structure, such as the starting
+ * structure of the anchor, which are small and so quantize and compress
+ * well. Finally, the binary data may be compressed with zlib, after the
+ * bytes of the values have been shuffled so that the i'th bytes of all
+ * values are stored together.
+ *
+ * A binary file starts with the magic string "SKR2STAT", followed by a
+ * header of the format, flags, number of atoms, time, step count, box
+ * vectors, and resolution, and then the (possibly compressed) payload of
+ * atom indices, positions, and velocities, all in the byte order of the
+ * machine that wrote it. Files written with a reference structure can only
+ * be decoded by an encoder that holds the same reference structure.
+ */
+
+class OPENMM_EXPORT_SEEKR2 CrossingStateEncoder {
+public:
+    /**
+     * This is an enumeration of the formats a state may be written in.
+     */
+    enum Format {
+        /**
+         * XML, in the same format as a serialized State.
+         */
+        Xml = 0,
+        /**
+         * Binary, with every value stored as a double.
+         */
+        Double = 1,
+        /**
+         * Binary, with every value stored as a float.
+         */
+        Float = 2,
+        /**
+         * Binary, with every value rounded to a multiple of the resolution,
+         * and stored as a 32 bit zigzag encoded integer.
+         */
+        FixedPoint = 3
+    };
+    CrossingStateEncoder();
+    /**
+     * Get the format states are written in.
+     */
+    Format getFormat() const {
+        return format;
+    }
+    /**
+     * Set the format states are written in.
+     *
+     * @param format    the format to write states in
+     */
+    void setFormat(Format format);
+    /**
+     * Get the resolution of the FixedPoint format, in nm for positions and
+     * nm/ps for velocities.
+     */
+    double getResolution() const {
+        return resolution;
+    }
+    /**
+     * Set the resolution of the FixedPoint format, in nm for positions and
+     * nm/ps for velocities. The default is 1e-4.
+     *
+     * @param resolution    the resolution
+     */
+    void setResolution(double resolution);
+    /**
+     * Get the reference structure the positions are stored relative to. If
+     * this is empty, the positions themselves are stored.
+     */
+    const std::vector<OpenMM::Vec3>& getReferencePositions() const {
+        return referencePositions;
+    }
+    /**
+     * Set a reference structure, with one position per particle in the
+     * System, that the positions written in a binary format are stored
+     * relative to. It is ignored by the Xml format.
+     *
+     * @param positions    the reference positions, or an empty vector to store the positions themselves
+     */
+    void setReferencePositions(const std::vector<OpenMM::Vec3>& positions);
+    /**
+     * Get whether states written in a binary format are compressed with zlib.
+     */
+    bool getCompression() const {
+        return compression;
+    }
+    /**
+     * Set whether states written in a binary format are compressed with
+     * zlib. This is ignored by the Xml format, and may only be enabled if the
+     * plugin was built with zlib; see isCompressionAvailable().
+     *
+     * @param compress    whether to compress the states
+     */
+    void setCompression(bool compress);
+    /**
+     * Get whether the plugin was built with zlib, so that states may be
+     * compressed.
+     */
+    static bool isCompressionAvailable();
+    /**
+     * Write a state to a stream.
+     *
+     * @param time                 the simulation time of the state
+     * @param stepCount            the step count of the state
+     * @param periodicBoxVectors   the three periodic box vectors
+     * @param atoms                the atoms the positions and velocities belong to, or an empty
+     *                             vector if there is one position and velocity for every particle
+     * @param positions            the positions
+     * @param velocities           the velocities
+     * @param stream               the stream to write to
+     */
+    void encode(double time, long long stepCount, const OpenMM::Vec3* periodicBoxVectors, const std::vector<int>& atoms,
+                const std::vector<OpenMM::Vec3>& positions, const std::vector<OpenMM::Vec3>& velocities, std::ostream& stream);
+    /**
+     * Read a state from a stream. Both the Xml and the binary formats may be
+     * read, whatever the format of this encoder is.
+     *
+     * @param stream     the stream to read from
+     * @param snapshot   on exit, holds the time, box vectors, positions, and velocities that were read
+     * @param atoms      on exit, holds the atoms the positions and velocities belong to, or is
+     *                   empty if there is one position and velocity for every particle
+     */
+    void decode(std::istream& stream, CrossingSnapshot& snapshot, std::vector<int>& atoms) const;
+    /**
+     * Read a state from a file, in either the Xml or a binary format.
+     *
+     * @param fileName   the name of the file to read
+     * @return a State holding the time, step count, box vectors, positions, and velocities
+     *         that were read, for the selected atoms only if the file holds a subset of them
+     */
+    OpenMM::State readState(const std::string& fileName) const;
+private:
+    void decode(std::istream& stream, CrossingSnapshot& snapshot, std::vector<int>& atoms, long long& stepCount) const;
+    Format format;
+    double resolution;
+    std::vector<OpenMM::Vec3> referencePositions;
+    bool compression;
+    std::vector<char> payload, packed;
+};
+
+} // namespace Seekr2Plugin
+
+#endif /*OPENMM_CROSSINGSTATEENCODER_H_*/
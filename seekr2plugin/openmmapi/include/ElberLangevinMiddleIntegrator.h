@@ -40,6 +40,8 @@
 #include "openmm/TabulatedFunction.h"
 #include "openmm/Force.h"
 #include "openmm/System.h"
+#include "CrossingSnapshotQueue.h"
+#include "LogBinnedHistogram.h"
 #include "internal/windowsExportSeekr2.h"
 #include "lepton/Operation.h"
 #include "lepton/Parser.h"
@@ -154,6 +156,108 @@ public:
      */
     void setSaveStateFileName(const std::string& fileName);
     
+    /**
+     * Get the base name of the trajectory files written around milestone
+     * crossings. If this is empty, no trajectories are written.
+     */
+    const std::string& getTrajectoryFileName() const {
+        return trajectoryFileName;
+    }
+    
+    /**
+     * Set the base name of the trajectory files written around milestone
+     * crossings. A frame is recorded every getTrajectoryInterval() steps,
+     * and the last getTrajectoryFramesBeforeCrossing() frames are kept in
+     * memory. When a crossing occurs, they are written to a new DCD file,
+     * followed by the next getTrajectoryFramesAfterCrossing() frames.
+     * The file is named with the crossing counter and the
+     * force group of the milestone crossed, for instance "traj_0_2.dcd".
+     * This must be called before the integrator is bound to a Context.
+     *
+     * @param fileName    the base name of the trajectory files, or an empty string to write none
+     */
+    void setTrajectoryFileName(const std::string& fileName);
+    
+    /**
+     * Get the number of steps between the frames of the trajectories written
+     * around milestone crossings.
+     */
+    int getTrajectoryInterval() const {
+        return trajectoryInterval;
+    }
+    
+    /**
+     * Set the number of steps between the frames of the trajectories written
+     * around milestone crossings. The default is 10.
+     * This must be called before the integrator is bound to a Context.
+     *
+     * @param steps    the number of steps between frames
+     */
+    void setTrajectoryInterval(int steps);
+    
+    /**
+     * Get the number of frames from before a milestone crossing that are
+     * written to its trajectory.
+     */
+    int getTrajectoryFramesBeforeCrossing() const {
+        return trajectoryFramesBefore;
+    }
+    
+    /**
+     * Set the number of frames from before a milestone crossing that are
+     * written to its trajectory. The default is 100.
+     * This must be called before the integrator is bound to a Context.
+     *
+     * @param frames    the number of frames to keep in memory
+     */
+    void setTrajectoryFramesBeforeCrossing(int frames);
+    
+    /**
+     * Get the number of frames from after a milestone crossing that are
+     * written to its trajectory.
+     */
+    int getTrajectoryFramesAfterCrossing() const {
+        return trajectoryFramesAfter;
+    }
+    
+    /**
+     * Set the number of frames from after a milestone crossing that are
+     * written to its trajectory. The default is 100.
+     * This must be called before the integrator is bound to a Context.
+     *
+     * @param frames    the number of frames to write after a crossing
+     */
+    void setTrajectoryFramesAfterCrossing(int frames);
+    
+    /**
+     * Get the name of the file a timeline of the integrator's work is written
+     * to. If this is empty, no timeline is written.
+     */
+    const std::string& getTraceFileName() const {
+        return traceFileName;
+    }
+    
+    /**
+     * Set the name of a file to write a timeline of the integrator's work to,
+     * in the Chrome trace-event JSON format, which can be viewed with
+     * Perfetto (https://ui.perfetto.dev) or chrome://tracing. Every step
+     * records how long the dynamics, the boundary evaluations, the
+     * writes of the output file, and the serialization of saved states took. The events are buffered in
+     * memory, and are written when flushTrace() is called, when the buffer
+     * is half full, and when the Context is destroyed. Integrators given the
+     * same file name in one process write to the same timeline.
+     * This must be called before the integrator is bound to a Context.
+     *
+     * @param fileName    the name of the trace file, or an empty string to write none
+     */
+    void setTraceFileName(const std::string& fileName);
+    
+    /**
+     * Write the timeline events recorded so far to the trace file. The
+     * integrator must be bound to a Context.
+     */
+    void flushTrace();
+    
      /**
      * Get the force group that describes a particular milestone
      * 
@@ -199,6 +303,32 @@ public:
     
     void setEndOnSrcMilestone(bool endOnSrc);
     
+    /**
+     * Start a new Elber trajectory from a snapshot published by an
+     * MmvtLangevinMiddleIntegrator. The positions, velocities and periodic
+     * box vectors of the Context are set from the snapshot, the time is reset
+     * to zero, and the crossing monitor is rearmed so that the next crossing
+     * of a source or destination milestone is logged again. The integrator
+     * must already be bound to a Context.
+     *
+     * @param snapshot    the snapshot to start from
+     */
+    void loadCrossingSnapshot(const CrossingSnapshot& snapshot);
+    
+    /**
+     * Get the distribution of the first passage times of the trajectories
+     * that have ended on a milestone since the integrator was bound to its
+     * Context. The first passage time of a trajectory is the time at which it
+     * crossed the milestone, measured from the start of the trajectory, or
+     * from its source milestone crossing if getEndOnSrcMilestone() is false.
+     * Trajectories that never crossed their source milestone are left out,
+     * just as they are marked invalid in the output file. The integrator must
+     * be bound to a Context.
+     *
+     * @param milestoneGroup    the milestone group the trajectories ended on
+     */
+    LogBinnedHistogram getFirstPassageTimeHistogram(int milestoneGroup);
+    
 protected:
     /**
      * This will be called by the Context when it is created.  It informs the Integrator
@@ -225,6 +355,9 @@ private:
     OpenMM::Kernel kernel;
     std::string outputFileName;
     std::string saveStateFileName;
+    std::string trajectoryFileName;
+    int trajectoryInterval, trajectoryFramesBefore, trajectoryFramesAfter;
+    std::string traceFileName;
     std::vector<int> srcMilestoneGroups;
     std::vector<int> destMilestoneGroups;
     int crossingCounter;
@@ -0,0 +1,180 @@
+#ifndef OPENMM_LOGBINNEDHISTOGRAM_H_
+#define OPENMM_LOGBINNEDHISTOGRAM_H_
+
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "internal/windowsExportSeekr2.h"
+#include <string>
+#include <vector>
+
+namespace Seekr2Plugin {
+
+/**
+ * A histogram of positive values, such as incubation times or first passage
+ * times, with bins of equal width in log10 of the value. The range of the
+ * histogram is fixed when it is created, so it uses a fixed amount of memory
+ * however many values are added to it, and adding a value takes constant
+ * time. Values below the range are counted as underflow and values above it
+ * as overflow, and the sum of every value added is kept so that the mean is
+ * exact.
+ */
+
+class OPENMM_EXPORT_SEEKR2 LogBinnedHistogram {
+public:
+    /**
+     * Create a LogBinnedHistogram. The default range, 0.001 ps to 10 us with
+     * ten bins per decade, covers everything from a fraction of a time step
+     * to the longest incubation times seen in practice.
+     *
+     * @param minValue         the lower edge of the first bin
+     * @param numDecades       the number of decades spanned by the bins
+     * @param binsPerDecade    the number of bins in each decade
+     */
+    explicit LogBinnedHistogram(double minValue=0.001, int numDecades=10, int binsPerDecade=10);
+    /**
+     * Get the lower edge of the first bin.
+     */
+    double getMinValue() const {
+        return minValue;
+    }
+    /**
+     * Get the upper edge of the last bin.
+     */
+    double getMaxValue() const;
+    /**
+     * Get the number of decades spanned by the bins.
+     */
+    int getNumDecades() const {
+        return numDecades;
+    }
+    /**
+     * Get the number of bins in each decade.
+     */
+    int getBinsPerDecade() const {
+        return binsPerDecade;
+    }
+    /**
+     * Get the number of bins, not counting underflow and overflow.
+     */
+    int getNumBins() const {
+        return counts.size();
+    }
+    /**
+     * Get the lower edge of a bin.
+     *
+     * @param bin    the index of the bin
+     */
+    double getBinLowerEdge(int bin) const;
+    /**
+     * Get the upper edge of a bin.
+     *
+     * @param bin    the index of the bin
+     */
+    double getBinUpperEdge(int bin) const;
+    /**
+     * Get the number of values that fell into a bin.
+     *
+     * @param bin    the index of the bin
+     */
+    long long getBinCount(int bin) const;
+    /**
+     * Get the number of values below the lower edge of the first bin.
+     */
+    long long getUnderflowCount() const {
+        return underflow;
+    }
+    /**
+     * Get the number of values at or above the upper edge of the last bin.
+     */
+    long long getOverflowCount() const {
+        return overflow;
+    }
+    /**
+     * Get the total number of values added, including underflow and overflow.
+     */
+    long long getTotalCount() const {
+        return totalCount;
+    }
+    /**
+     * Get the sum of every value added.
+     */
+    double getSum() const {
+        return sum;
+    }
+    /**
+     * Get the mean of every value added, or 0 if there are none.
+     */
+    double getMean() const {
+        return (totalCount == 0 ? 0.0 : sum/totalCount);
+    }
+    /**
+     * Add a value to the histogram.
+     *
+     * @param value    the value to add
+     */
+    void addValue(double value);
+    /**
+     * Add every value counted by another histogram to this one. Both must
+     * have the same bins.
+     *
+     * @param other    the histogram to add
+     */
+    void addHistogram(const LogBinnedHistogram& other);
+    /**
+     * Remove every value from the histogram, keeping its bins.
+     */
+    void clear();
+    /**
+     * Format the histogram as a single line of text, listing its bins,
+     * its sum, and the count of every bin that is not empty.
+     */
+    std::string toString() const;
+    /**
+     * Create a histogram from text produced by toString().
+     *
+     * @param text    the text to parse
+     */
+    static LogBinnedHistogram fromString(const std::string& text);
+private:
+    double minValue, logMinValue;
+    int numDecades, binsPerDecade;
+    std::vector<long long> counts;
+    long long underflow, overflow, totalCount;
+    double sum;
+};
+
+} // namespace Seekr2Plugin
+
+#endif /*OPENMM_LOGBINNEDHISTOGRAM_H_*/
@@ -0,0 +1,86 @@
+#ifndef OPENMM_MMVTANCHORSTATISTICS_H_
+#define OPENMM_MMVTANCHORSTATISTICS_H_
+
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "LogBinnedHistogram.h"
+#include <vector>
+
+namespace Seekr2Plugin {
+
+/**
+ * The transition statistics accumulated by an MMVT simulation within one
+ * anchor. These are the same quantities that MmvtLangevinMiddleIntegrator
+ * writes to its statistics file, and every vector is indexed in the same
+ * order as the integrator's milestone groups.
+ */
+
+struct MmvtAnchorStatistics {
+    MmvtAnchorStatistics() : T_alpha(0.0) {
+    }
+    /**
+     * The force group of each milestone boundary of the anchor.
+     */
+    std::vector<int> milestoneGroups;
+    /**
+     * The number of bounces against each boundary.
+     */
+    std::vector<int> N_alpha_beta;
+    /**
+     * Nij_alpha[i][j] is the number of transitions from boundary i to
+     * boundary j.
+     */
+    std::vector<std::vector<int> > Nij_alpha;
+    /**
+     * The total incubation time (in ps) for which boundary i was the last
+     * one touched.
+     */
+    std::vector<double> Ri_alpha;
+    /**
+     * incubationTimeHistograms[i][j] is the distribution of the incubation
+     * times (in ps) of the transitions from boundary i to boundary j, whose
+     * sum over j is Ri_alpha[i]. This is empty if the distributions were not
+     * recorded, as when the statistics are read from an older file.
+     */
+    std::vector<std::vector<LogBinnedHistogram> > incubationTimeHistograms;
+    /**
+     * The total simulation time (in ps) since the first bounce.
+     */
+    double T_alpha;
+};
+
+} // namespace Seekr2Plugin
+
+#endif /*OPENMM_MMVTANCHORSTATISTICS_H_*/
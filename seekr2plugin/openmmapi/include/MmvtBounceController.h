@@ -0,0 +1,164 @@
+#ifndef OPENMM_MMVTBOUNCECONTROLLER_H_
+#define OPENMM_MMVTBOUNCECONTROLLER_H_
+
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "MmvtAnchorStatistics.h"
+#include "openmm/Context.h"
+#include "openmm/Vec3.h"
+#include "internal/windowsExportSeekr2.h"
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace Seekr2Plugin {
+
+/**
+ * This class runs an MMVT simulation with any OpenMM Integrator, such as a
+ * LangevinMiddleIntegrator or a CustomIntegrator implementing another
+ * thermostat. It takes the steps by calling the integrator of a Context, and
+ * after each step evaluates force group 1, whose energy is a bitcode of the
+ * milestone boundaries that are crossed, just as MmvtLangevinMiddleIntegrator
+ * does. When a boundary has been crossed, the positions are restored to
+ * those at the start of the step and the velocities are reversed, and the
+ * bounce is written to the crossing log and added to the statistics.
+ *
+ * Everything is done through the public Context API, so it works on every
+ * platform and with every integrator, but it transfers the state of the
+ * system from the platform at every step. MmvtLangevinMiddleIntegrator,
+ * which does the same work inside its kernels, is normally much faster when
+ * Langevin dynamics is wanted.
+ *
+ * The controller does not take ownership of the Context, which must outlive
+ * it. Only the controller's step() method should be used to advance the
+ * simulation.
+ */
+
+class OPENMM_EXPORT_SEEKR2 MmvtBounceController {
+public:
+    /**
+     * Create a MmvtBounceController.
+     *
+     * @param context     the Context whose integrator will take the steps
+     * @param fileName    the name of the file to write milestone transitions to
+     */
+    MmvtBounceController(OpenMM::Context& context, std::string fileName);
+    /**
+     * Get the name of the file that milestone transitions are written to.
+     */
+    const std::string& getOutputFileName() const {
+        return outputFileName;
+    }
+    /**
+     * Get the name of the file that the state is saved to upon each bounce
+     * against a single boundary. If empty, no states are saved.
+     */
+    const std::string& getSaveStateFileName() const {
+        return saveStateFileName;
+    }
+    /**
+     * Set the name of the file that the state is saved to upon each bounce
+     * against a single boundary. The bounce index and milestone group are
+     * appended to the name.
+     *
+     * @param fileName    the file name, or an empty string to save no states
+     */
+    void setSaveStateFileName(std::string fileName) {
+        saveStateFileName = fileName;
+    }
+    /**
+     * Get the number of milestone groups.
+     */
+    int getNumMilestoneGroups() const {
+        return milestoneGroups.size();
+    }
+    /**
+     * Get the milestone group at an index. Bit i of the boundary bitcode
+     * corresponds to milestone group i.
+     *
+     * @param index    the index of the milestone group
+     */
+    int getMilestoneGroup(int index) const;
+    /**
+     * Add a milestone group. This must be called before the first step.
+     *
+     * @param milestoneGroup    the milestone group to add
+     * @return the index of the milestone group that was added
+     */
+    int addMilestoneGroup(int milestoneGroup);
+    /**
+     * Get the number of bounces so far.
+     */
+    int getBounceCounter() const {
+        return bounceCounter;
+    }
+    /**
+     * Set the number of bounces so far, which is used to number the bounces
+     * in the crossing log.
+     *
+     * @param counter    the number of bounces
+     */
+    void setBounceCounter(int counter) {
+        bounceCounter = counter;
+    }
+    /**
+     * Get the transition statistics accumulated since the controller was
+     * created.
+     */
+    MmvtAnchorStatistics getStatistics() const;
+    /**
+     * Advance the simulation by taking a series of steps with the Context's
+     * integrator, bouncing whenever a step crosses a boundary.
+     *
+     * @param steps    the number of steps to take
+     */
+    void step(int steps);
+private:
+    void initialize();
+    void recordBounce(int bitcode, double time);
+    OpenMM::Context& context;
+    std::string outputFileName, saveStateFileName;
+    std::ofstream crossingLog;
+    std::vector<int> milestoneGroups;
+    std::vector<OpenMM::Vec3> reversedVelocities;
+    MmvtAnchorStatistics statistics;
+    bool initialized;
+    int bounceCounter, previousMilestoneCrossed;
+    double firstCrossingTime, incubationTime;
+};
+
+} // namespace Seekr2Plugin
+
+#endif /*OPENMM_MMVTBOUNCECONTROLLER_H_*/
@@ -40,6 +40,11 @@
 #include "openmm/TabulatedFunction.h"
 #include "openmm/Force.h"
 #include "openmm/System.h"
+#include "CrossingSnapshotQueue.h"
+#include "CrossingStateEncoder.h"
+#include "MmvtAnchorStatistics.h"
+#include "MmvtConvergenceMonitor.h"
+#include "MmvtPerformanceCounters.h"
 #include "internal/windowsExportSeekr2.h"
 #include "lepton/Operation.h"
 #include "lepton/Parser.h"
@@ -154,6 +159,314 @@ public:
      */
     void setSaveStateFileName(const std::string& fileName);
     
+    /**
+     * Get whether saved crossing states hold the configuration before the
+     * crossing. See setSaveStateBeforeCrossing() for details.
+     */
+    bool getSaveStateBeforeCrossing() const {
+        return saveStateBeforeCrossing;
+    }
+    
+    /**
+     * Set which configuration is written to the state files and published to
+     * the crossing snapshot queue upon a bounce. By default (false) it is the
+     * configuration at the end of the step that crossed the boundary, just
+     * outside the anchor. If this is true, it is instead the in-bounds
+     * configuration at the start of that step, which the simulation is
+     * rolled back to, with the velocities as they were before being reversed.
+     * This must be called before the integrator is bound to a Context.
+     *
+     * @param before    whether to save the configuration before the crossing
+     */
+    void setSaveStateBeforeCrossing(bool before);
+    
+    /**
+     * Get whether states are only saved upon first hits. See
+     * setSaveFirstHitsOnly() for details.
+     */
+    bool getSaveFirstHitsOnly() const {
+        return saveFirstHitsOnly;
+    }
+    
+    /**
+     * Set whether states are only saved upon first hits. A first hit is a
+     * bounce against a boundary when the previous bounce was against a
+     * different one, so the states saved are samples of the first hitting
+     * point distribution on each milestone that Elber trajectories are
+     * started from. If this is true, the other bounces, including the very
+     * first one of the simulation, are neither written to state files nor
+     * published to the crossing snapshot queue, and only first hits are
+     * candidates for the state reservoir, which then holds a bounded pool of
+     * first hitting points for each milestone. The default is false, which
+     * saves a state upon every bounce.
+     * This must be called before the integrator is bound to a Context.
+     *
+     * @param firstHitsOnly    whether to only save states upon first hits
+     */
+    void setSaveFirstHitsOnly(bool firstHitsOnly);
+    
+    /**
+     * Get the atoms whose positions and velocities are written to the state
+     * files. If this is empty, every atom is written.
+     */
+    const std::vector<int>& getSaveStateAtomSelection() const {
+        return saveStateAtoms;
+    }
+    
+    /**
+     * Set the atoms whose positions and velocities are written to the state
+     * files, such as those of the receptor and ligand in an explicit solvent
+     * system. The state files then hold one position and velocity for each
+     * selected atom, in the order given here, so the i'th position belongs to
+     * atoms[i]. Every state file is still complete if the selection is empty,
+     * which is the default; see setFullSaveStateInterval() to write a
+     * complete state file every so often. The snapshots published to the
+     * crossing snapshot queue always hold every atom.
+     * This must be called before the integrator is bound to a Context.
+     *
+     * @param atoms    the indices of the atoms to write, or an empty vector to write every atom
+     */
+    void setSaveStateAtomSelection(const std::vector<int>& atoms);
+    
+    /**
+     * Get how often a state file holds every atom when an atom selection is
+     * set. See setFullSaveStateInterval() for details.
+     */
+    int getFullSaveStateInterval() const {
+        return fullSaveStateInterval;
+    }
+    
+    /**
+     * Set how often a state file holds every atom when an atom selection is
+     * set with setSaveStateAtomSelection(). If this is N, the first state
+     * saved, and every Nth one after it, holds every atom, so that it may be
+     * used to restart a simulation, while the others hold only the selected
+     * atoms. The default is 0, which writes only the selected atoms.
+     * This must be called before the integrator is bound to a Context.
+     *
+     * @param interval    the number of states saved per complete state, or 0 to never save a complete state
+     */
+    void setFullSaveStateInterval(int interval);
+    
+    /**
+     * Get the largest number of states saved for each boundary, or 0 if a
+     * state is saved upon every bounce. See setSaveStateReservoirSize() for
+     * details.
+     */
+    int getSaveStateReservoirSize() const {
+        return saveStateReservoirSize;
+    }
+    
+    /**
+     * Set the largest number of states saved for each boundary. By default
+     * (0), a state file is written upon every bounce against a single
+     * boundary. Otherwise, the states are sampled so that each boundary has
+     * at most this many state files, named after the save state file name,
+     * the milestone group, and a slot number from 0 to size-1, such as
+     * "state_reservoir_1_0". Every bounce that counts as a candidate (see
+     * setSaveStateReservoirSpacing()) is equally likely to be held in one of
+     * the slots, however long the simulation is run, so the disk space and
+     * write bandwidth used stay bounded. The slots are chosen with a random
+     * number generator seeded with the integrator's random number seed.
+     * This must be called before the integrator is bound to a Context.
+     *
+     * @param size    the number of states to keep per boundary, or 0 to save every state
+     */
+    void setSaveStateReservoirSize(int size);
+    
+    /**
+     * Get the minimum number of steps between bounces against the same
+     * boundary for both to be candidates for the state reservoir.
+     */
+    int getSaveStateReservoirSpacing() const {
+        return saveStateReservoirSpacing;
+    }
+    
+    /**
+     * Set the minimum number of steps between bounces against the same
+     * boundary for both to be candidates for the state reservoir. A bounce
+     * that follows the last candidate at its boundary more closely than this
+     * is not saved, so that the states kept are decorrelated. The default
+     * is 0, which makes every bounce a candidate.
+     * This must be called before the integrator is bound to a Context.
+     *
+     * @param steps    the minimum number of steps between candidates
+     */
+    void setSaveStateReservoirSpacing(int steps);
+    
+    /**
+     * Get the encoder that describes the format the saved states are written in.
+     */
+    const CrossingStateEncoder& getSaveStateEncoder() const {
+        return saveStateEncoder;
+    }
+    
+    /**
+     * Set the encoder that describes the format the saved states are written
+     * in. By default they are written as XML, but a compact binary format
+     * may be chosen instead, with the positions stored relative to the
+     * starting structure of the anchor and optionally compressed. If the
+     * encoder has a reference structure, it must have one position for every
+     * particle in the System. Files written this way may be read back with
+     * CrossingStateEncoder::readState().
+     * This must be called before the integrator is bound to a Context.
+     *
+     * @param encoder    the encoder to write the saved states with
+     */
+    void setSaveStateEncoder(const CrossingStateEncoder& encoder);
+    
+    /**
+     * Get the base name of the trajectory files written around milestone
+     * crossings. If this is empty, no trajectories are written.
+     */
+    const std::string& getTrajectoryFileName() const {
+        return trajectoryFileName;
+    }
+    
+    /**
+     * Set the base name of the trajectory files written around milestone
+     * crossings. A frame is recorded every getTrajectoryInterval() steps,
+     * and the last getTrajectoryFramesBeforeCrossing() frames are kept in
+     * memory. When a crossing occurs, they are written to a new DCD file,
+     * followed by the next getTrajectoryFramesAfterCrossing() frames.
+     * The file is named like the saved states, with ".dcd"
+     * appended, for instance "traj_12_1.dcd" for the twelfth bounce against
+     * force group 1. A bounce that occurs while the frames after an earlier
+     * one are being written extends the earlier file.
+     * This must be called before the integrator is bound to a Context.
+     *
+     * @param fileName    the base name of the trajectory files, or an empty string to write none
+     */
+    void setTrajectoryFileName(const std::string& fileName);
+    
+    /**
+     * Get the number of steps between the frames of the trajectories written
+     * around milestone crossings.
+     */
+    int getTrajectoryInterval() const {
+        return trajectoryInterval;
+    }
+    
+    /**
+     * Set the number of steps between the frames of the trajectories written
+     * around milestone crossings. The default is 10.
+     * This must be called before the integrator is bound to a Context.
+     *
+     * @param steps    the number of steps between frames
+     */
+    void setTrajectoryInterval(int steps);
+    
+    /**
+     * Get the number of frames from before a milestone crossing that are
+     * written to its trajectory.
+     */
+    int getTrajectoryFramesBeforeCrossing() const {
+        return trajectoryFramesBefore;
+    }
+    
+    /**
+     * Set the number of frames from before a milestone crossing that are
+     * written to its trajectory. The default is 100.
+     * This must be called before the integrator is bound to a Context.
+     *
+     * @param frames    the number of frames to keep in memory
+     */
+    void setTrajectoryFramesBeforeCrossing(int frames);
+    
+    /**
+     * Get the number of frames from after a milestone crossing that are
+     * written to its trajectory.
+     */
+    int getTrajectoryFramesAfterCrossing() const {
+        return trajectoryFramesAfter;
+    }
+    
+    /**
+     * Set the number of frames from after a milestone crossing that are
+     * written to its trajectory. The default is 100.
+     * This must be called before the integrator is bound to a Context.
+     *
+     * @param frames    the number of frames to write after a crossing
+     */
+    void setTrajectoryFramesAfterCrossing(int frames);
+    
+    /**
+     * Get the name of the shared memory segment the status of the simulation
+     * is published to. If this is empty, no status is published.
+     */
+    const std::string& getStatusSegmentName() const {
+        return statusSegmentName;
+    }
+    
+    /**
+     * Set the name of a POSIX shared memory segment to publish the status of
+     * the simulation to. The segment is created when the integrator is bound
+     * to a Context, is updated after every step with the step count, time,
+     * transition statistics and performance counters, and is removed when
+     * the Context is destroyed. Other processes may read it with
+     * MmvtStatusSegment or the seekr2_status program while the simulation
+     * runs. Every running Context must use a different name.
+     * This must be called before the integrator is bound to a Context.
+     *
+     * @param name    the name of the segment, or an empty string to publish no status
+     */
+    void setStatusSegmentName(const std::string& name);
+    
+    /**
+     * Get the name of the file a timeline of the integrator's work is written
+     * to. If this is empty, no timeline is written.
+     */
+    const std::string& getTraceFileName() const {
+        return traceFileName;
+    }
+    
+    /**
+     * Set the name of a file to write a timeline of the integrator's work to,
+     * in the Chrome trace-event JSON format, which can be viewed with
+     * Perfetto (https://ui.perfetto.dev) or chrome://tracing. Every step
+     * records how long the dynamics, the boundary evaluations, the
+     * restores of the state at bounces, the writes of the crossing log and
+     * statistics file, and the serialization of saved states took. The events are buffered in
+     * memory, and are written when flushTrace() is called, when the buffer
+     * is half full, and when the Context is destroyed. Integrators given the
+     * same file name in one process write to the same timeline.
+     * This must be called before the integrator is bound to a Context.
+     *
+     * @param fileName    the name of the trace file, or an empty string to write none
+     */
+    void setTraceFileName(const std::string& fileName);
+    
+    /**
+     * Write the timeline events recorded so far to the trace file. The
+     * integrator must be bound to a Context.
+     */
+    void flushTrace();
+    
+    /**
+     * Write the bounce counter, the transition statistics, the incubation
+     * under way and the state of the saved state reservoirs to a checkpoint.
+     * Together with a State saved at the same time, this allows an
+     * interrupted run to be continued in a new Context with loadCheckpoint(),
+     * so that the statistics do not start again from zero and bounce indices
+     * are not reused. The same data is included in checkpoints created with
+     * Context::createCheckpoint(). The integrator must be bound to a Context.
+     *
+     * @param stream    the stream to write the checkpoint to
+     */
+    void createCheckpoint(std::ostream& stream) const;
+    
+    /**
+     * Load a checkpoint written by createCheckpoint(), after the State saved
+     * with it has been set on the Context. The crossing log is cut back to
+     * its length when the checkpoint was created, since the steps that
+     * followed will be simulated again, and convergence monitoring starts
+     * again from the restored statistics. The integrator must be bound to a
+     * Context.
+     *
+     * @param stream    the stream to read the checkpoint from
+     */
+    void loadCheckpoint(std::istream& stream);
+    
      /**
      * Get the base name of the file that the simulation state is being 
      * written to upon a bounce/crossing event
@@ -193,6 +506,208 @@ public:
     
     void setBounceCounter(int counter);
     
+    /**
+     * Get the queue that crossing snapshots are published to, or NULL if
+     * snapshots are not being published.
+     */
+    CrossingSnapshotQueue* getCrossingSnapshotQueue() const;
+    
+    /**
+     * Set a queue to publish a snapshot to upon each bounce against a single
+     * boundary whose milestone group the queue accepts. This allows an Elber
+     * simulation to consume the crossing states directly, in the same process,
+     * instead of reading the files written with setSaveStateFileName(). The
+     * queue is not owned by the integrator, and must outlive the Context.
+     * This must be called before the integrator is bound to a Context.
+     *
+     * @param queue    the queue to publish to, or NULL to stop publishing
+     */
+    void setCrossingSnapshotQueue(CrossingSnapshotQueue* queue);
+    
+    /**
+     * Get the transition statistics accumulated so far by this integrator.
+     * These are the same values written to the statistics file, but are
+     * available whether or not setSaveStatisticsFileName() was called. The
+     * integrator must be bound to a Context.
+     */
+    MmvtAnchorStatistics getStatistics();
+    
+    /**
+     * Get the number of steps in each block used to monitor the convergence of
+     * the statistics. If this is 0 (the default), convergence is not monitored.
+     */
+    int getConvergenceBlockSteps() const {
+        return convergenceBlockSteps;
+    }
+    
+    /**
+     * Set the number of steps in each block used to monitor the convergence of
+     * the statistics. At the end of every block, the statistics are passed to
+     * the integrator's MmvtConvergenceMonitor.
+     *
+     * @param steps    the number of steps per block, or 0 to disable monitoring
+     */
+    void setConvergenceBlockSteps(int steps);
+    
+    /**
+     * Get the relative error below which the statistics are considered
+     * converged. If this is 0 (the default), step() never stops early.
+     */
+    double getConvergenceTolerance() const {
+        return convergenceTolerance;
+    }
+    
+    /**
+     * Set the relative error below which the statistics are considered
+     * converged. When convergence is being monitored and every tracked rate
+     * has a relative standard error no larger than this, step() returns
+     * without taking the rest of the requested steps, and further calls to
+     * step() return immediately.
+     *
+     * @param tolerance    the largest acceptable relative error, or 0 to never stop early
+     */
+    void setConvergenceTolerance(double tolerance);
+    
+    /**
+     * Get the monitor tracking the convergence of the statistics.
+     */
+    const MmvtConvergenceMonitor& getConvergenceMonitor() const {
+        return convergenceMonitor;
+    }
+    
+    /**
+     * Get whether the statistics have converged to within the convergence
+     * tolerance, so that step() will no longer advance the simulation.
+     */
+    bool isConverged() const;
+    
+    /**
+     * Get the number of steps between evaluations of the milestone
+     * boundaries. See setBoundaryCheckInterval() for details.
+     */
+    int getBoundaryCheckInterval() const {
+        return boundaryCheckInterval;
+    }
+    
+    /**
+     * Set the number of steps between evaluations of the milestone
+     * boundaries. The default is 1, which checks for a crossing after every
+     * step. With a larger interval, the state at the start of each step is
+     * kept in a ring buffer, and when a check finds that a boundary has been
+     * crossed, the stored states are examined to find the first step that
+     * crossed it. The simulation is then rolled back to the start of that
+     * step and bounced exactly as if every step had been checked, and the
+     * steps after it are discarded. The random number stream is not rewound,
+     * so the trajectory after a bounce is statistically equivalent to, but not
+     * identical to, the one obtained with an interval of 1. An excursion that
+     * crosses a boundary and returns within a single interval is not seen, so
+     * the interval should be short compared to the time the system takes to
+     * cross a boundary and come back; see setSafeStepDistanceGroup() for a
+     * check that is skipped only when no crossing is possible. The boundaries
+     * are always checked at the end of each call to step().
+     * This must be called before the integrator is bound to a Context.
+     *
+     * @param interval    the number of steps between boundary checks
+     */
+    void setBoundaryCheckInterval(int interval);
+    
+    /**
+     * Get the force group whose energy is the safe step distance, or -1 if
+     * boundaries are evaluated regardless of distance. See
+     * setSafeStepDistanceGroup() for details.
+     */
+    int getSafeStepDistanceGroup() const {
+        return safeStepDistanceGroup;
+    }
+    
+    /**
+     * Set a force group whose energy is a lower bound, in nm, on how far some
+     * atom must move before any milestone boundary can be crossed, and which
+     * is zero or negative once a boundary has been crossed. For example, for
+     * a boundary on the distance between the centroids of two groups of
+     * atoms, half the difference between the boundary radius and the current
+     * centroid distance may be used: no centroid moves farther than its most
+     * displaced atom, so the distance between two centroids changes by at
+     * most twice that. The force group is left out of the forces used to
+     * integrate the system.
+     *
+     * When this is set, the kernel adds up the largest displacement of any
+     * atom over each step, and skips evaluating the boundaries for as long as
+     * the total stays below the distance last evaluated. When a check is due,
+     * the safe distance is evaluated again, and the boundaries are skipped
+     * only if every step since the last check ended closer to the current
+     * positions than that distance. Otherwise the boundaries are evaluated
+     * at the end of every one of those steps, so that an excursion across a
+     * boundary and back within the interval is still bounced. Since no
+     * crossing is possible during the skipped steps, the bounces are
+     * identical to those obtained by checking every step.
+     * This must be called before the integrator is bound to a Context.
+     *
+     * @param group    the force group giving the safe distance, or -1 to disable the prescreen
+     */
+    void setSafeStepDistanceGroup(int group);
+    
+    /**
+     * Get whether the number of steps between boundary evaluations adapts to
+     * the observed bounces. See setAdaptiveBoundaryChecks() for details.
+     */
+    bool getAdaptiveBoundaryChecks() const {
+        return adaptiveBoundaryChecks;
+    }
+    
+    /**
+     * Set whether the number of steps between boundary evaluations adapts to
+     * the observed bounces. When this is enabled, the boundary check interval
+     * becomes an upper limit. Checks start every step, and the interval
+     * doubles each time a check finds no crossing and returns to 1 after every
+     * bounce, so steps close to a bounce are checked often and long
+     * excursions into the interior of the anchor are checked rarely. The
+     * interval is also kept below a quarter of the recent average number of
+     * steps between bounces and, when a safe step distance group is set,
+     * below the number of steps needed to cover the last evaluated safe
+     * distance at the recent average displacement per step. Every crossing
+     * that is seen is still bounced at the exact step it happened, as
+     * described in setBoundaryCheckInterval(). The default is false.
+     * This must be called before the integrator is bound to a Context.
+     *
+     * @param adaptive    whether the boundary check interval should adapt
+     */
+    void setAdaptiveBoundaryChecks(bool adaptive);
+    
+    /**
+     * Get counters describing the work spent monitoring the boundaries since
+     * the integrator was bound to its Context, such as the number of
+     * boundary evaluations per step. The integrator must be bound to a
+     * Context.
+     */
+    MmvtPerformanceCounters getPerformanceCounters();
+    
+    /**
+     * Get the number of inner steps taken with the fast forces during each
+     * step. This is always 1 for this class; see MmvtMTSLangevinIntegrator.
+     */
+    virtual int getNumInnerSteps() const {
+        return 1;
+    }
+    
+    /**
+     * Get the force groups, as a bitmask, that are evaluated only once per
+     * step rather than on every inner step. This is always 0 for this class;
+     * see MmvtMTSLangevinIntegrator.
+     */
+    virtual int getSlowForceGroups() const {
+        return 0;
+    }
+    
+    /**
+     * Get the size of the inner steps with which the dynamics are integrated
+     * and the boundaries are checked (in picoseconds). This is the step size
+     * divided by the number of inner steps.
+     */
+    double getInnerStepSize() const {
+        return getStepSize()/getNumInnerSteps();
+    }
+    
 protected:
     /**
      * This will be called by the Context when it is created.  It informs the Integrator
@@ -214,6 +729,7 @@ protected:
      */
     double computeKineticEnergy();
 private:
+    void takeMultipleTimeStep(int forceGroups);
     double temperature, friction;
     int randomNumberSeed;
     OpenMM::Kernel kernel;
@@ -222,7 +738,20 @@ private:
     std::string saveStatisticsFileName;
     std::vector<int> milestoneGroups;
     int bounceCounter;
-    
+    bool saveStateBeforeCrossing, saveFirstHitsOnly;
+    std::vector<int> saveStateAtoms;
+    int fullSaveStateInterval;
+    int saveStateReservoirSize, saveStateReservoirSpacing;
+    CrossingStateEncoder saveStateEncoder;
+    std::string trajectoryFileName;
+    int trajectoryInterval, trajectoryFramesBefore, trajectoryFramesAfter;
+    std::string statusSegmentName, traceFileName;
+    CrossingSnapshotQueue* crossingSnapshotQueue;
+    int convergenceBlockSteps, stepsInBlock;
+    int boundaryCheckInterval, safeStepDistanceGroup;
+    bool adaptiveBoundaryChecks;
+    double convergenceTolerance;
+    MmvtConvergenceMonitor convergenceMonitor;
 };
 
 } // namespace Seekr2Plugin
@@ -0,0 +1,133 @@
+#ifndef OPENMM_MMVTMTSLANGEVININTEGRATOR_H_
+#define OPENMM_MMVTMTSLANGEVININTEGRATOR_H_
+
+/*
+   Copyright 2019 by Lane Votapka
+   All rights reserved
+   
+   -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2014 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "MmvtLangevinMiddleIntegrator.h"
+#include "internal/windowsExportSeekr2.h"
+#include <string>
+
+namespace Seekr2Plugin {
+
+/**
+ * This is an MmvtLangevinMiddleIntegrator that uses multiple time steps.
+ * The forces are divided into fast and slow groups. Each step begins by
+ * kicking the velocities with the slow forces for half a step, then takes a
+ * number of LangevinMiddle inner steps with the fast forces only, and ends by
+ * kicking the velocities with the slow forces, evaluated at the new
+ * positions, for another half step. Since the slow forces at the start of a
+ * step are normally those computed at the end of the previous one, the slow
+ * forces are evaluated once per step.
+ *
+ * The milestone boundaries are checked, and crossings bounced and rolled
+ * back, on the inner steps, exactly as MmvtLangevinMiddleIntegrator does on
+ * its steps, so expensive forces such as the reciprocal space part of PME
+ * can be made slow without coarsening the resolution of the boundaries. All
+ * pending boundary checks are resolved before the closing slow kick. The
+ * time and step count of the Context advance with every inner step.
+ *
+ * The kinetic energy is computed from the velocities at the end of the step,
+ * without a time shift.
+ */
+
+class OPENMM_EXPORT_SEEKR2 MmvtMTSLangevinIntegrator : public MmvtLangevinMiddleIntegrator {
+public:
+    /**
+     * Create a MmvtMTSLangevinIntegrator.
+     * 
+     * @param temperature    the temperature of the heat bath (in Kelvin)
+     * @param frictionCoeff  the friction coefficient which couples the system to the heat bath (in inverse picoseconds)
+     * @param stepSize       the outer step size, over which the slow forces act (in picoseconds)
+     * @param fileName       the name of the file to write milestone transitions to
+     * @param numInnerSteps  the number of inner steps, with the fast forces, per outer step
+     */
+    MmvtMTSLangevinIntegrator(double temperature, double frictionCoeff, double stepSize, std::string fileName, int numInnerSteps);
+    /**
+     * Get the number of inner steps taken with the fast forces during each
+     * step.
+     */
+    int getNumInnerSteps() const {
+        return numInnerSteps;
+    }
+    /**
+     * Set the number of inner steps taken with the fast forces during each
+     * step.
+     *
+     * @param steps    the number of inner steps per step
+     */
+    void setNumInnerSteps(int steps);
+    /**
+     * Get the force groups, as a bitmask, that are evaluated only once per
+     * step.
+     */
+    int getSlowForceGroups() const {
+        return slowForceGroups;
+    }
+    /**
+     * Add a force group to the slow forces, which are evaluated only once per
+     * step. Force group 1, which holds the boundaries, and the safe step
+     * distance group cannot be slow. This must be called before the
+     * integrator is bound to a Context.
+     *
+     * @param group    the force group to add
+     */
+    void addSlowForceGroup(int group);
+    /**
+     * Get whether a force group is one of the slow forces.
+     *
+     * @param group    the force group to check
+     */
+    bool isSlowForceGroup(int group) const;
+protected:
+    /**
+     * This will be called by the Context when it is created. It checks that
+     * no boundary force group is slow, then initializes the integrator.
+     */
+    void initialize(OpenMM::ContextImpl& context);
+    /**
+     * The kinetic energy is computed without a time shift, so it does not
+     * need the forces.
+     */
+    bool kineticEnergyRequiresForce() const {
+        return false;
+    }
+private:
+    int numInnerSteps, slowForceGroups;
+};
+
+} // namespace Seekr2Plugin
+
+#endif /*OPENMM_MMVTMTSLANGEVININTEGRATOR_H_*/
@@ -0,0 +1,91 @@
+#ifndef OPENMM_MMVTPERFORMANCECOUNTERS_H_
+#define OPENMM_MMVTPERFORMANCECOUNTERS_H_
+
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+namespace Seekr2Plugin {
+
+/**
+ * Counters describing how much work an MmvtLangevinMiddleIntegrator has spent
+ * monitoring the milestone boundaries since it was bound to its Context.
+ */
+
+struct MmvtPerformanceCounters {
+    MmvtPerformanceCounters() : numSteps(0), numBoundaryEvaluations(0), numSafeDistanceEvaluations(0), 
+            numSafeSteps(0), numRollbacks(0), numDiscardedSteps(0), boundaryCheckInterval(1) {
+    }
+    /**
+     * The number of steps taken, including those later discarded by a rollback.
+     */
+    long long numSteps;
+    /**
+     * The number of times the boundary force group was evaluated, including
+     * the evaluations needed to find the step that crossed a boundary.
+     */
+    long long numBoundaryEvaluations;
+    /**
+     * The number of times the safe step distance force group was evaluated.
+     */
+    long long numSafeDistanceEvaluations;
+    /**
+     * The number of steps the safe step prescreen showed could not have
+     * crossed a boundary.
+     */
+    long long numSafeSteps;
+    /**
+     * The number of times the simulation was rolled back to bounce at an
+     * earlier step.
+     */
+    long long numRollbacks;
+    /**
+     * The number of steps discarded by rollbacks.
+     */
+    long long numDiscardedSteps;
+    /**
+     * The number of steps currently taken between boundary checks.
+     */
+    int boundaryCheckInterval;
+    /**
+     * Get the number of force group evaluations spent monitoring the
+     * boundaries per step taken.
+     */
+    double getChecksPerStep() const {
+        return (numSteps == 0 ? 0.0 : (numBoundaryEvaluations+numSafeDistanceEvaluations)/(double) numSteps);
+    }
+};
+
+} // namespace Seekr2Plugin
+
+#endif /*OPENMM_MMVTPERFORMANCECOUNTERS_H_*/
@@ -0,0 +1,171 @@
+#ifndef OPENMM_MMVTSTATUSSEGMENT_H_
+#define OPENMM_MMVTSTATUSSEGMENT_H_
+
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "MmvtAnchorStatistics.h"
+#include "MmvtPerformanceCounters.h"
+#include "internal/windowsExportSeekr2.h"
+#include <string>
+#include <vector>
+
+namespace Seekr2Plugin {
+
+/**
+ * The status of a running MMVT anchor, as read from its status segment.
+ */
+
+struct MmvtStatus {
+    MmvtStatus() : processId(0), numUpdates(0), stepCount(0), time(0.0), bounceCounter(0) {
+    }
+    /**
+     * The ID of the process running the anchor.
+     */
+    int processId;
+    /**
+     * The number of times the status has been updated.
+     */
+    long long numUpdates;
+    /**
+     * The step count of the Context.
+     */
+    long long stepCount;
+    /**
+     * The simulated time of the Context, in ps.
+     */
+    double time;
+    /**
+     * The index of the next bounce.
+     */
+    int bounceCounter;
+    /**
+     * The transition statistics accumulated so far. The incubation time
+     * histograms are not included.
+     */
+    MmvtAnchorStatistics statistics;
+    /**
+     * The work spent monitoring the boundaries so far.
+     */
+    MmvtPerformanceCounters counters;
+};
+
+/**
+ * This class is a block of POSIX shared memory holding the live status of an
+ * MMVT simulation, so that other processes can monitor a running anchor
+ * without reading its output files. The kernels create the segment when the
+ * integrator is given a name for it, update it after every step, and remove
+ * it when the Context is destroyed.
+ *
+ * Updates are made under a sequence lock: the writer never waits, and a
+ * reader copies the whole block and tries again if an update happened while
+ * it was copying. A reader maps the segment read only, and so cannot disturb
+ * the simulation. Shared memory status segments are not available on
+ * Windows.
+ */
+
+class OPENMM_EXPORT_SEEKR2 MmvtStatusSegment {
+public:
+    /**
+     * The largest number of milestone groups a segment can hold. This is the
+     * number of force groups a System can have.
+     */
+    static const int MAX_MILESTONE_GROUPS = 32;
+    MmvtStatusSegment();
+    ~MmvtStatusSegment();
+    /**
+     * Create a segment and map it for writing. A segment left with the same
+     * name by a process that is no longer running is replaced. If the process
+     * that created it is still running, or it is not a status segment, an
+     * exception is thrown. The segment is removed when this object is closed
+     * or destroyed.
+     *
+     * @param name             the name of the segment. A leading "/" is added if it is missing.
+     * @param milestoneGroups  the force group of each milestone boundary
+     */
+    void create(const std::string& name, const std::vector<int>& milestoneGroups);
+    /**
+     * Map an existing segment for reading.
+     *
+     * @param name    the name the segment was created with
+     */
+    void attach(const std::string& name);
+    /**
+     * Unmap the segment, and remove it if it was created by this object.
+     */
+    void close();
+    /**
+     * Get whether a segment is mapped.
+     */
+    bool isOpen() const {
+        return block != NULL;
+    }
+    /**
+     * Get the name of the mapped segment, including the leading "/".
+     */
+    const std::string& getName() const {
+        return name;
+    }
+    /**
+     * Update the status held by a segment this object created.
+     *
+     * @param stepCount      the step count of the Context
+     * @param time           the simulated time of the Context, in ps
+     * @param bounceCounter  the index of the next bounce
+     * @param N_alpha_beta   the number of bounces against each boundary
+     * @param Nij_alpha      the number of transitions between each pair of boundaries
+     * @param Ri_alpha       the incubation time spent after touching each boundary
+     * @param T_alpha        the simulation time since the first bounce
+     * @param counters       the work spent monitoring the boundaries
+     */
+    void publish(long long stepCount, double time, int bounceCounter, const std::vector<int>& N_alpha_beta,
+                 const std::vector<std::vector<int> >& Nij_alpha, const std::vector<double>& Ri_alpha, double T_alpha,
+                 const MmvtPerformanceCounters& counters);
+    /**
+     * Read a consistent copy of the status held by the segment.
+     *
+     * @param status    on exit, the status of the simulation
+     */
+    void read(MmvtStatus& status) const;
+private:
+    MmvtStatusSegment(const MmvtStatusSegment&);
+    MmvtStatusSegment& operator=(const MmvtStatusSegment&);
+    void* block;
+    std::string name;
+    bool owner;
+};
+
+} // namespace Seekr2Plugin
+
+#endif /*OPENMM_MMVTSTATUSSEGMENT_H_*/
@@ -41,6 +41,7 @@
 #include "openmm/KernelImpl.h"
 #include "openmm/Platform.h"
 #include "openmm/System.h"
+#include <iosfwd>
 #include <string>
 
 namespace Seekr2Plugin {
@@ -74,6 +75,60 @@ public:
      * Compute the kinetic energy.
      */
     virtual double computeKineticEnergy(OpenMM::ContextImpl& context, const MmvtLangevinMiddleIntegrator& integrator) = 0;
+    /**
+     * Get the transition statistics accumulated so far.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param statistics     on exit, the accumulated statistics
+     */
+    virtual void getStatistics(OpenMM::ContextImpl& context, MmvtAnchorStatistics& statistics) = 0;
+    /**
+     * Check the boundaries for any steps taken since they were last checked,
+     * and bounce if one was crossed.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param integrator     the MmvtLangevinMiddleIntegrator this kernel is being used for
+     */
+    virtual void checkPendingBoundaries(OpenMM::ContextImpl& context, const MmvtLangevinMiddleIntegrator& integrator) = 0;
+    /**
+     * Get the counters describing the work spent monitoring the boundaries.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param counters       on exit, the performance counters
+     */
+    virtual void getPerformanceCounters(OpenMM::ContextImpl& context, MmvtPerformanceCounters& counters) = 0;
+    /**
+     * Add the current forces, multiplied by a time step and divided by the
+     * particle masses, to the velocities. This is used to apply the slow
+     * forces of a multiple time step integrator.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param integrator     the MmvtLangevinMiddleIntegrator this kernel is being used for
+     * @param dt             the time step over which the forces act
+     */
+    virtual void kickVelocities(OpenMM::ContextImpl& context, const MmvtLangevinMiddleIntegrator& integrator, double dt) = 0;
+    /**
+     * Write the trace events recorded so far to the trace file.
+     *
+     * @param context        the context in which to execute this kernel
+     */
+    virtual void flushTrace(OpenMM::ContextImpl& context) = 0;
+    /**
+     * Write the bounce counter, the transition statistics and the incubation
+     * under way to a checkpoint.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param stream         the stream to write the checkpoint to
+     */
+    virtual void createCheckpoint(OpenMM::ContextImpl& context, std::ostream& stream) const = 0;
+    /**
+     * Load a checkpoint written by createCheckpoint(), so that bounces are
+     * counted as if the run had not been interrupted.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param stream         the stream to read the checkpoint from
+     */
+    virtual void loadCheckpoint(OpenMM::ContextImpl& context, std::istream& stream) = 0;
 };
 
 /**
@@ -105,6 +160,29 @@ public:
      * Compute the kinetic energy.
      */
     virtual double computeKineticEnergy(OpenMM::ContextImpl& context, const ElberLangevinMiddleIntegrator& integrator) = 0;
+    /**
+     * Forget any milestone crossings seen so far, so that a new trajectory
+     * may be started in the same context.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param integrator     the ElberLangevinMiddleIntegrator this kernel is being used for
+     */
+    virtual void resetCrossingState(OpenMM::ContextImpl& context, const ElberLangevinMiddleIntegrator& integrator) = 0;
+    /**
+     * Get the distribution of the first passage times of the trajectories
+     * that ended on a milestone.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param milestoneGroup the milestone group the trajectories ended on
+     * @param histogram      on exit, the distribution of first passage times
+     */
+    virtual void getFirstPassageTimeHistogram(OpenMM::ContextImpl& context, int milestoneGroup, LogBinnedHistogram& histogram) = 0;
+    /**
+     * Write the trace events recorded so far to the trace file.
+     *
+     * @param context        the context in which to execute this kernel
+     */
+    virtual void flushTrace(OpenMM::ContextImpl& context) = 0;
 };
 
 } // namespace Seekr2Plugin
@@ -0,0 +1,114 @@
+#ifndef OPENMM_CROSSINGSTATERESERVOIR_H_
+#define OPENMM_CROSSINGSTATERESERVOIR_H_
+
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "internal/windowsExportSeekr2.h"
+#include <iosfwd>
+#include <random>
+#include <vector>
+
+namespace Seekr2Plugin {
+
+/**
+ * This class is used by the MMVT kernels to decide which crossing states to
+ * keep when at most a fixed number may be saved for each boundary.
+ *
+ * A bounce is a candidate for being saved if at least a minimum number of
+ * steps have passed since the previous candidate at the same boundary, so
+ * that the states kept are decorrelated. Each boundary then keeps a
+ * reservoir of slots: the first candidates fill the slots in order, and
+ * after that the n'th candidate replaces a slot chosen at random with
+ * probability size/n. At any time, every candidate seen so far is equally
+ * likely to be held by one of the slots, however long the run has been.
+ */
+
+class OPENMM_EXPORT_SEEKR2 CrossingStateReservoir {
+public:
+    CrossingStateReservoir();
+    /**
+     * Empty every reservoir.
+     *
+     * @param numBoundaries   the number of boundaries to keep states for
+     * @param size            the number of states kept per boundary, or 0 to keep every state
+     * @param spacing         the minimum number of steps between candidates at the same boundary
+     * @param seed            the seed for choosing the slots to replace, or 0 to choose a unique one
+     */
+    void initialize(int numBoundaries, int size, int spacing, int seed);
+    /**
+     * Get whether states are being sampled, rather than all kept.
+     */
+    bool isEnabled() const {
+        return size > 0;
+    }
+    /**
+     * Offer the state of a bounce against a boundary.
+     *
+     * @param boundary    the index of the boundary that was bounced against
+     * @param stepCount   the step count at the bounce
+     * @return the slot the state should be saved in, or -1 if it should not be saved
+     */
+    int offer(int boundary, long long stepCount);
+    /**
+     * Get the number of candidates seen so far at a boundary.
+     *
+     * @param boundary    the index of the boundary
+     */
+    long long getNumCandidates(int boundary) const {
+        return numCandidates[boundary];
+    }
+    /**
+     * Write the candidates seen so far and the state of the random number
+     * generator to a checkpoint.
+     *
+     * @param stream    the stream to write to
+     */
+    void createCheckpoint(std::ostream& stream) const;
+    /**
+     * Load a checkpoint written by createCheckpoint(), so that sampling
+     * continues as if the run had not been interrupted.
+     *
+     * @param stream    the stream to read from
+     */
+    void loadCheckpoint(std::istream& stream);
+private:
+    int size, spacing;
+    std::vector<long long> numCandidates, lastCandidateStep;
+    std::mt19937_64 random;
+};
+
+} // namespace Seekr2Plugin
+
+#endif /*OPENMM_CROSSINGSTATERESERVOIR_H_*/
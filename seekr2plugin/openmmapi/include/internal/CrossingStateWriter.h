@@ -0,0 +1,122 @@
+#ifndef OPENMM_CROSSINGSTATEWRITER_H_
+#define OPENMM_CROSSINGSTATEWRITER_H_
+
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "CrossingSnapshotQueue.h"
+#include "CrossingStateEncoder.h"
+#include "internal/windowsExportSeekr2.h"
+#include "openmm/Vec3.h"
+#include "openmm/internal/ContextImpl.h"
+#include <string>
+#include <vector>
+
+namespace Seekr2Plugin {
+
+/**
+ * This class is used by the kernels to save the state of the system when a
+ * milestone is crossed. The positions and velocities are copied straight
+ * from the platform's own buffers into vectors that are allocated once, when
+ * the kernel is initialized, rather than being requested from the Context
+ * as a new State. They may then be written to a state file, or copied into
+ * a CrossingSnapshot.
+ */
+
+class OPENMM_EXPORT_SEEKR2 CrossingStateWriter {
+public:
+    CrossingStateWriter();
+    /**
+     * Allocate the buffers the state is captured into, and set which atoms
+     * are written to the state files.
+     *
+     * @param numParticles        the number of particles in the System
+     * @param atoms               the atoms to write to the state files, or an empty vector to write every atom
+     * @param fullStateInterval   when atoms are selected, write every atom to the first state file and
+     *                            every fullStateInterval'th one after it, or never if this is 0
+     * @param encoder             the encoder that describes the format of the state files
+     */
+    void initialize(int numParticles, const std::vector<int>& atoms=std::vector<int>(), int fullStateInterval=0,
+                    const CrossingStateEncoder& encoder=CrossingStateEncoder());
+    /**
+     * Capture the current positions, velocities, periodic box vectors, time,
+     * and step count of a Context. The positions and velocities are
+     * retrieved from the platform through the ContextImpl.
+     *
+     * @param context    the context to capture the state of
+     */
+    void capture(OpenMM::ContextImpl& context);
+    /**
+     * Capture the given positions and velocities, together with the current
+     * periodic box vectors, time, and step count of a Context. This is used
+     * by kernels that keep the positions and velocities in host memory, and
+     * by those that save a configuration other than the current one.
+     *
+     * @param context      the context to capture the box vectors, time, and step count of
+     * @param positions    the positions to capture
+     * @param velocities   the velocities to capture
+     */
+    void capture(OpenMM::ContextImpl& context, const std::vector<OpenMM::Vec3>& positions, const std::vector<OpenMM::Vec3>& velocities);
+    /**
+     * Multiply the captured velocities by -1.
+     */
+    void reverseVelocities();
+    /**
+     * Write the captured state to a file, in the format described by the
+     * encoder. Depending on the atom selection, it holds either every atom,
+     * or only the selected atoms in the order they were given.
+     *
+     * @param fileName   the name of the file to write
+     */
+    void write(const std::string& fileName);
+    /**
+     * Copy the captured state into a snapshot.
+     *
+     * @param snapshot   on exit, holds the captured time, box vectors, positions, and velocities
+     */
+    void copyTo(CrossingSnapshot& snapshot) const;
+private:
+    double time;
+    long long stepCount;
+    OpenMM::Vec3 periodicBoxVectors[3];
+    std::vector<OpenMM::Vec3> positions, velocities;
+    std::vector<int> atoms;
+    std::vector<OpenMM::Vec3> selectedPositions, selectedVelocities;
+    int fullStateInterval, numWritten;
+    CrossingStateEncoder encoder;
+};
+
+} // namespace Seekr2Plugin
+
+#endif /*OPENMM_CROSSINGSTATEWRITER_H_*/
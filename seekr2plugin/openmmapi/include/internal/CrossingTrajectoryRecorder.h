@@ -0,0 +1,147 @@
+#ifndef OPENMM_CROSSINGTRAJECTORYRECORDER_H_
+#define OPENMM_CROSSINGTRAJECTORYRECORDER_H_
+
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "internal/windowsExportSeekr2.h"
+#include "openmm/Vec3.h"
+#include "openmm/internal/ContextImpl.h"
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace Seekr2Plugin {
+
+/**
+ * This class is used by the kernels to write trajectories of the steps
+ * around milestone crossings, rather than of the whole simulation.
+ *
+ * A frame is recorded every few steps into a ring buffer that holds the
+ * last few frames. When a crossing occurs, a new DCD file is opened, the
+ * frames in the ring buffer are written to it, and so are the next few
+ * frames after the crossing. A crossing that occurs while the frames after
+ * an earlier one are still being written extends the same file instead of
+ * opening a new one.
+ *
+ * The simulation may be rolled back to an earlier step when a crossing is
+ * detected. Any buffered frames from after the step a crossing is recorded
+ * at, or from after the step a new frame is recorded at, are discarded. If
+ * it may be rolled back, the frames after a crossing are only written once
+ * stepsChecked() reports that the boundaries have been checked up to them,
+ * so that no frame of a discarded step is ever written.
+ */
+
+class OPENMM_EXPORT_SEEKR2 CrossingTrajectoryRecorder {
+public:
+    CrossingTrajectoryRecorder();
+    ~CrossingTrajectoryRecorder();
+    /**
+     * Set up the recorder. If the file name is empty, no trajectories are
+     * written.
+     *
+     * @param fileName        the base name of the trajectory files
+     * @param numParticles    the number of particles in the System
+     * @param periodic        whether the System uses periodic boundary conditions
+     * @param stepSize        the step size of the integrator, in ps
+     * @param interval        the number of steps between frames
+     * @param framesBefore    the number of frames to keep from before a crossing
+     * @param framesAfter     the number of frames to write after a crossing
+     * @param maxRollback     the largest number of steps the simulation may be rolled back by
+     *                        when a crossing is detected
+     */
+    void initialize(const std::string& fileName, int numParticles, bool periodic, double stepSize, int interval, int framesBefore,
+                    int framesAfter, int maxRollback=0);
+    /**
+     * Get whether trajectories are being written.
+     */
+    bool isEnabled() const {
+        return enabled;
+    }
+    /**
+     * Get whether a frame should be recorded at a step.
+     *
+     * @param stepCount   the step count of the Context
+     */
+    bool isFrameStep(long long stepCount) const {
+        return enabled && stepCount%interval == 0;
+    }
+    /**
+     * Record the current positions and periodic box vectors of a Context as
+     * a frame. It is buffered, and written if a crossing occurred recently
+     * enough, once its step can no longer be rolled back.
+     *
+     * @param context    the context to record a frame of
+     */
+    void recordFrame(OpenMM::ContextImpl& context);
+    /**
+     * Record that the boundaries have been checked up to a step, so that the
+     * simulation will not be rolled back to before it. Buffered frames up to
+     * that step that follow a crossing closely enough are written.
+     *
+     * @param stepCount   the step count of the Context
+     */
+    void stepsChecked(long long stepCount);
+    /**
+     * Record that a crossing occurred at the current step of a Context. If no
+     * file is open, one is opened, named fileName+eventName+".dcd", and the
+     * buffered frames are written to it.
+     *
+     * @param context     the context the crossing occurred in
+     * @param eventName   the suffix of the name of the file to open
+     */
+    void trigger(OpenMM::ContextImpl& context, const std::string& eventName);
+private:
+    struct Frame {
+        std::vector<OpenMM::Vec3> positions;
+        OpenMM::Vec3 periodicBoxVectors[3];
+        long long stepCount;
+    };
+    void writeFrame(const Frame& frame);
+    void closeFile();
+    bool enabled, periodic;
+    std::string fileName;
+    double stepSize;
+    int interval, framesBefore, framesAfter, maxRollback;
+    std::vector<Frame> ring;
+    int firstFrame, numBuffered;
+    std::ofstream file;
+    int numWritten, framesRemaining;
+    long long lastWrittenStep;
+    std::vector<float> coordinates;
+};
+
+} // namespace Seekr2Plugin
+
+#endif /*OPENMM_CROSSINGTRAJECTORYRECORDER_H_*/
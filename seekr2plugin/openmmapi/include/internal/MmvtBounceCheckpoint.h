@@ -0,0 +1,101 @@
+#ifndef OPENMM_MMVTBOUNCECHECKPOINT_H_
+#define OPENMM_MMVTBOUNCECHECKPOINT_H_
+
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "MmvtAnchorStatistics.h"
+#include "internal/windowsExportSeekr2.h"
+#include <iosfwd>
+#include <string>
+
+namespace Seekr2Plugin {
+
+/**
+ * This struct holds everything the MMVT kernels need to continue counting
+ * bounces in a new Context, after the positions, velocities and time have
+ * been restored from a saved State: the transition statistics, the bounce
+ * counter, the incubation under way, and the length of the crossing log.
+ *
+ * When a checkpoint is loaded, the crossing log is cut back to the length
+ * it had when the checkpoint was created, since the steps that followed will
+ * be simulated again.
+ */
+
+struct OPENMM_EXPORT_SEEKR2 MmvtBounceCheckpoint {
+    MmvtBounceCheckpoint() : bounceCounter(0), previousMilestoneCrossed(-1), incubationTime(0.0),
+            firstCrossingTime(0.0), crossingLogSize(0) {
+    }
+    /**
+     * Write the checkpoint to a stream.
+     *
+     * @param stream    the stream to write to
+     */
+    void write(std::ostream& stream) const;
+    /**
+     * Read a checkpoint written by write().
+     *
+     * @param stream    the stream to read from
+     */
+    void read(std::istream& stream);
+    /**
+     * Throw an exception if the checkpoint was created for a different set
+     * of milestone groups.
+     *
+     * @param milestoneGroups    the milestone groups of the kernel loading the checkpoint
+     */
+    void checkMilestoneGroups(const std::vector<int>& milestoneGroups) const;
+    /**
+     * Get the current length in bytes of a crossing log, or 0 if it does not
+     * exist.
+     *
+     * @param fileName    the name of the crossing log
+     */
+    static long long getCrossingLogSize(const std::string& fileName);
+    /**
+     * Cut a crossing log back to the length recorded in the checkpoint,
+     * removing the crossings logged after it was created.
+     *
+     * @param fileName    the name of the crossing log
+     */
+    void restoreCrossingLog(const std::string& fileName) const;
+    MmvtAnchorStatistics statistics;
+    int bounceCounter, previousMilestoneCrossed;
+    double incubationTime, firstCrossingTime;
+    long long crossingLogSize;
+};
+
+} // namespace Seekr2Plugin
+
+#endif /*OPENMM_MMVTBOUNCECHECKPOINT_H_*/
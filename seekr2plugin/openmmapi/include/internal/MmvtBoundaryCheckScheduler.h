@@ -0,0 +1,127 @@
+#ifndef OPENMM_MMVTBOUNDARYCHECKSCHEDULER_H_
+#define OPENMM_MMVTBOUNDARYCHECKSCHEDULER_H_
+
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "MmvtPerformanceCounters.h"
+#include "internal/windowsExportSeekr2.h"
+
+namespace Seekr2Plugin {
+
+/**
+ * This class is used by the MMVT kernels to decide how many steps to take
+ * between boundary checks, and to keep their performance counters.
+ *
+ * With a fixed schedule, the interval is always the integrator's boundary
+ * check interval. With an adaptive schedule, that interval is only an upper
+ * limit. The interval starts at 1, doubles after every check that finds no
+ * crossing, and drops back to 1 after every rollback, since a system that has
+ * just bounced is still next to the boundary. It is further limited to a
+ * quarter of the recent average number of steps between bounces, so narrow
+ * anchors that bounce every few steps are checked nearly every step, and,
+ * when a safe step distance is available, to the number of steps it would
+ * take to cover that distance at the recent average displacement per step.
+ */
+
+class OPENMM_EXPORT_SEEKR2 MmvtBoundaryCheckScheduler {
+public:
+    MmvtBoundaryCheckScheduler();
+    /**
+     * Reset the schedule and the counters.
+     *
+     * @param maxInterval   the integrator's boundary check interval
+     * @param adaptive      whether the interval should adapt, or always equal maxInterval
+     */
+    void initialize(int maxInterval, bool adaptive);
+    /**
+     * Get the number of steps to take before the next boundary check.
+     */
+    int getInterval() const {
+        return interval;
+    }
+    /**
+     * Record that a step was taken.
+     *
+     * @param displacement   the largest displacement of any atom over the step,
+     *                       or a negative value if it was not computed
+     */
+    void stepTaken(double displacement);
+    /**
+     * Record that the safe step prescreen showed the last step could not
+     * have crossed a boundary.
+     */
+    void stepSafe() {
+        counters.numSafeSteps++;
+    }
+    /**
+     * Record an evaluation of the boundary force group.
+     */
+    void boundariesEvaluated() {
+        counters.numBoundaryEvaluations++;
+    }
+    /**
+     * Record an evaluation of the safe step distance force group.
+     */
+    void safeDistanceEvaluated(double distance);
+    /**
+     * Record that a boundary check found no crossing.
+     */
+    void checkPassed();
+    /**
+     * Record that a boundary check found a crossing, and the simulation was
+     * rolled back to bounce.
+     *
+     * @param discardedSteps   the number of steps taken after the crossing step, which were discarded
+     * @param stepCount        the step count at which the bounce happened
+     */
+    void rolledBack(int discardedSteps, long long stepCount);
+    /**
+     * Get the performance counters.
+     */
+    const MmvtPerformanceCounters& getCounters() const {
+        return counters;
+    }
+private:
+    int limitInterval(int proposed) const;
+    MmvtPerformanceCounters counters;
+    int interval, maxInterval;
+    bool adaptive;
+    long long lastBounceStep;
+    double averageBounceSteps, averageDisplacement, safeDistance;
+};
+
+} // namespace Seekr2Plugin
+
+#endif /*OPENMM_MMVTBOUNDARYCHECKSCHEDULER_H_*/
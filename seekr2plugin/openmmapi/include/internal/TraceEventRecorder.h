@@ -0,0 +1,136 @@
+#ifndef OPENMM_TRACEEVENTRECORDER_H_
+#define OPENMM_TRACEEVENTRECORDER_H_
+
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "internal/windowsExportSeekr2.h"
+#include <chrono>
+#include <memory>
+#include <string>
+
+namespace Seekr2Plugin {
+
+class TraceSession;
+
+/**
+ * This class is used by the kernels to write a timeline of where the time of
+ * each step goes, as a Chrome trace-event JSON file that can be viewed with
+ * Perfetto or chrome://tracing.
+ *
+ * All recorders given the same file name share one trace session, so the
+ * MMVT and Elber integrators of a process may be traced to one timeline.
+ * Each thread records its events into its own ring buffer, without locking.
+ * The buffers are drained to the file when flush() is called, when the
+ * buffer of the recording thread is half full, and when the last recorder
+ * of a session is destroyed. If a buffer fills up before it is drained, new
+ * events are dropped and counted.
+ */
+
+class OPENMM_EXPORT_SEEKR2 TraceEventRecorder {
+public:
+    /**
+     * This class records the time from its creation to its destruction as
+     * one event. It does nothing if the recorder is not enabled.
+     */
+    class Scope {
+    public:
+        /**
+         * @param recorder   the recorder to record the event with
+         * @param name       the name of the event. This must be a string literal.
+         */
+        Scope(TraceEventRecorder& recorder, const char* name) : recorder(recorder.isEnabled() ? &recorder : NULL), name(name) {
+            if (this->recorder != NULL)
+                start = getTime();
+        }
+        ~Scope() {
+            if (recorder != NULL)
+                recorder->record(name, start, getTime());
+        }
+    private:
+        TraceEventRecorder* recorder;
+        const char* name;
+        long long start;
+    };
+    TraceEventRecorder();
+    ~TraceEventRecorder();
+    /**
+     * Set up the recorder. If the file name is empty, no events are recorded.
+     *
+     * @param fileName    the name of the trace file
+     * @param category    the category of the events, such as the name of the
+     *                    integrator. This must be a string literal.
+     */
+    void initialize(const std::string& fileName, const char* category);
+    /**
+     * Get whether events are being recorded.
+     */
+    bool isEnabled() const {
+        return session != NULL;
+    }
+    /**
+     * Get the current time, in ns, on the clock used to time the events.
+     */
+    static long long getTime() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    /**
+     * Record an event on the calling thread.
+     *
+     * @param name    the name of the event. This must be a string literal.
+     * @param start   the time the event started, as returned by getTime()
+     * @param end     the time the event ended, as returned by getTime()
+     */
+    void record(const char* name, long long start, long long end);
+    /**
+     * Write the events recorded so far by every thread of the session to the
+     * trace file.
+     */
+    void flush();
+    /**
+     * Get the number of events dropped so far by the session because a
+     * buffer was full.
+     */
+    long long getNumDroppedEvents() const;
+private:
+    TraceEventRecorder(const TraceEventRecorder&);
+    TraceEventRecorder& operator=(const TraceEventRecorder&);
+    std::shared_ptr<TraceSession> sessionHandle;
+    TraceSession* session;
+    const char* category;
+};
+
+} // namespace Seekr2Plugin
+
+#endif /*OPENMM_TRACEEVENTRECORDER_H_*/
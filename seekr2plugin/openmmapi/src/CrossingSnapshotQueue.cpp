@@ -0,0 +1,127 @@
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "CrossingSnapshotQueue.h"
+#include "openmm/OpenMMException.h"
+
+using namespace Seekr2Plugin;
+using namespace OpenMM;
+using std::mutex;
+using std::unique_lock;
+
+CrossingSnapshotQueue::CrossingSnapshotQueue(int capacity) : capacity(capacity), 
+                          blockWhenFull(false), closed(false), numDropped(0) {
+    if (capacity < 1)
+        throw OpenMMException("CrossingSnapshotQueue: the capacity must be at least 1");
+}
+
+bool CrossingSnapshotQueue::getBlockWhenFull() const {
+    unique_lock<mutex> guard(lock);
+    return blockWhenFull;
+}
+
+void CrossingSnapshotQueue::setBlockWhenFull(bool block) {
+    unique_lock<mutex> guard(lock);
+    blockWhenFull = block;
+    notFull.notify_all();
+}
+
+void CrossingSnapshotQueue::addMilestoneGroup(int milestoneGroup) {
+    unique_lock<mutex> guard(lock);
+    milestoneGroups.insert(milestoneGroup);
+}
+
+bool CrossingSnapshotQueue::acceptsMilestoneGroup(int milestoneGroup) const {
+    unique_lock<mutex> guard(lock);
+    return (milestoneGroups.empty() || milestoneGroups.count(milestoneGroup) > 0);
+}
+
+bool CrossingSnapshotQueue::publish(const CrossingSnapshot& snapshot) {
+    unique_lock<mutex> guard(lock);
+    if (!milestoneGroups.empty() && milestoneGroups.count(snapshot.milestoneGroup) == 0)
+        return false;
+    while (blockWhenFull && !closed && snapshots.size() >= capacity)
+        notFull.wait(guard);
+    if (closed || snapshots.size() >= capacity) {
+        numDropped++;
+        return false;
+    }
+    snapshots.push_back(snapshot);
+    notEmpty.notify_one();
+    return true;
+}
+
+bool CrossingSnapshotQueue::pop(CrossingSnapshot& snapshot) {
+    unique_lock<mutex> guard(lock);
+    while (snapshots.empty() && !closed)
+        notEmpty.wait(guard);
+    if (snapshots.empty())
+        return false;
+    snapshot = snapshots.front();
+    snapshots.pop_front();
+    notFull.notify_one();
+    return true;
+}
+
+bool CrossingSnapshotQueue::tryPop(CrossingSnapshot& snapshot) {
+    unique_lock<mutex> guard(lock);
+    if (snapshots.empty())
+        return false;
+    snapshot = snapshots.front();
+    snapshots.pop_front();
+    notFull.notify_one();
+    return true;
+}
+
+void CrossingSnapshotQueue::close() {
+    unique_lock<mutex> guard(lock);
+    closed = true;
+    notEmpty.notify_all();
+    notFull.notify_all();
+}
+
+bool CrossingSnapshotQueue::isClosed() const {
+    unique_lock<mutex> guard(lock);
+    return closed;
+}
+
+int CrossingSnapshotQueue::getSize() const {
+    unique_lock<mutex> guard(lock);
+    return snapshots.size();
+}
+
+long long CrossingSnapshotQueue::getNumDropped() const {
+    unique_lock<mutex> guard(lock);
+    return numDropped;
+}
@@ -0,0 +1,340 @@
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "CrossingStateEncoder.h"
+#include "openmm/OpenMMException.h"
+#include "openmm/serialization/XmlSerializer.h"
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#ifdef SEEKR2_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace Seekr2Plugin;
+using namespace OpenMM;
+using namespace std;
+
+static const char MAGIC[] = "SKR2STAT";
+static const int MAGIC_SIZE = 8;
+static const int32_t VERSION = 1;
+static const int32_t FLAG_DELTA = 1;
+static const int32_t FLAG_COMPRESSED = 2;
+static const int32_t FLAG_ATOMS = 4;
+
+/**
+ * The fixed size header that follows the magic string of a binary file.
+ */
+struct BinaryHeader {
+    int32_t version, format, flags, numAtoms;
+    double time;
+    int64_t stepCount;
+    double periodicBoxVectors[9];
+    double resolution;
+    int64_t payloadSize, storedSize;
+};
+
+static int getValueSize(int format) {
+    return (format == CrossingStateEncoder::Double ? 8 : 4);
+}
+
+template <class T>
+static void appendValue(vector<char>& buffer, T value) {
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    buffer.insert(buffer.end(), bytes, bytes+sizeof(T));
+}
+
+static void appendVector(vector<char>& buffer, const Vec3& v, int format, double resolution) {
+    for (int i = 0; i < 3; i++) {
+        if (format == CrossingStateEncoder::Double)
+            appendValue<double>(buffer, v[i]);
+        else if (format == CrossingStateEncoder::Float)
+            appendValue<float>(buffer, (float) v[i]);
+        else {
+            double scaled = round(v[i]/resolution);
+            if (!(fabs(scaled) <= INT32_MAX))
+                throw OpenMMException("CrossingStateEncoder: value out of range for the fixed point resolution");
+            int32_t value = (int32_t) scaled;
+            appendValue<uint32_t>(buffer, ((uint32_t) value << 1) ^ (uint32_t) (value >> 31));
+        }
+    }
+}
+
+/**
+ * Fixed point values are stored with zigzag encoding, which maps 0, -1, 1,
+ * -2, 2, ... to 0, 1, 2, 3, 4, ... so that small values of either sign have
+ * zeros in their high order bytes.
+ */
+static Vec3 readVector(const char* data, int format, double resolution) {
+    Vec3 v;
+    for (int i = 0; i < 3; i++) {
+        if (format == CrossingStateEncoder::Double) {
+            double value;
+            memcpy(&value, data+8*i, 8);
+            v[i] = value;
+        }
+        else if (format == CrossingStateEncoder::Float) {
+            float value;
+            memcpy(&value, data+4*i, 4);
+            v[i] = value;
+        }
+        else {
+            uint32_t value;
+            memcpy(&value, data+4*i, 4);
+            v[i] = ((int32_t) (value >> 1) ^ -(int32_t) (value & 1))*resolution;
+        }
+    }
+    return v;
+}
+
+#ifdef SEEKR2_HAVE_ZLIB
+/**
+ * Reorder the bytes of a section of values, so that the first bytes of every
+ * value come first, then the second bytes, and so on. Neighboring values
+ * mostly differ in their low order bytes, so this leaves long runs of
+ * similar bytes for zlib to compress.
+ */
+static void shuffle(const char* in, char* out, size_t numValues, int valueSize) {
+    for (size_t i = 0; i < numValues; i++)
+        for (int j = 0; j < valueSize; j++)
+            out[j*numValues+i] = in[i*valueSize+j];
+}
+
+static void unshuffle(const char* in, char* out, size_t numValues, int valueSize) {
+    for (size_t i = 0; i < numValues; i++)
+        for (int j = 0; j < valueSize; j++)
+            out[i*valueSize+j] = in[j*numValues+i];
+}
+#endif
+
+CrossingStateEncoder::CrossingStateEncoder() : format(Xml), resolution(1e-4), compression(false) {
+}
+
+void CrossingStateEncoder::setFormat(Format format) {
+    if (format < Xml || format > FixedPoint)
+        throw OpenMMException("CrossingStateEncoder: illegal format");
+    this->format = format;
+}
+
+void CrossingStateEncoder::setResolution(double resolution) {
+    if (resolution <= 0.0)
+        throw OpenMMException("CrossingStateEncoder: the resolution must be positive");
+    this->resolution = resolution;
+}
+
+void CrossingStateEncoder::setReferencePositions(const vector<Vec3>& positions) {
+    referencePositions = positions;
+}
+
+void CrossingStateEncoder::setCompression(bool compress) {
+    if (compress && !isCompressionAvailable())
+        throw OpenMMException("CrossingStateEncoder: compression requires the plugin to be built with zlib");
+    compression = compress;
+}
+
+bool CrossingStateEncoder::isCompressionAvailable() {
+#ifdef SEEKR2_HAVE_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+void CrossingStateEncoder::encode(double time, long long stepCount, const Vec3* periodicBoxVectors, const vector<int>& atoms,
+            const vector<Vec3>& positions, const vector<Vec3>& velocities, ostream& stream) {
+    if (format == Xml) {
+        State::StateBuilder builder(time, stepCount);
+        builder.setPositions(positions);
+        builder.setVelocities(velocities);
+        builder.setPeriodicBoxVectors(periodicBoxVectors[0], periodicBoxVectors[1], periodicBoxVectors[2]);
+        State state = builder.getState();
+        XmlSerializer::serialize<State>(&state, "State", stream);
+        return;
+    }
+    int numAtoms = positions.size();
+    bool delta = (referencePositions.size() > 0);
+    if (atoms.size() > 0 && atoms.size() != numAtoms)
+        throw OpenMMException("CrossingStateEncoder: the number of atoms does not match the number of positions");
+    BinaryHeader header;
+    header.version = VERSION;
+    header.format = format;
+    header.flags = (delta ? FLAG_DELTA : 0) | (compression ? FLAG_COMPRESSED : 0) | (atoms.size() > 0 ? FLAG_ATOMS : 0);
+    header.numAtoms = numAtoms;
+    header.time = time;
+    header.stepCount = stepCount;
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            header.periodicBoxVectors[3*i+j] = periodicBoxVectors[i][j];
+    header.resolution = resolution;
+
+    // Build the payload: the atom indices, then the positions, then the velocities.
+
+    payload.clear();
+    for (int atom : atoms)
+        appendValue<int32_t>(payload, atom);
+    for (int i = 0; i < numAtoms; i++) {
+        Vec3 pos = positions[i];
+        if (delta) {
+            int atom = (atoms.size() > 0 ? atoms[i] : i);
+            if (atom >= referencePositions.size())
+                throw OpenMMException("CrossingStateEncoder: the reference structure has too few positions");
+            pos -= referencePositions[atom];
+        }
+        appendVector(payload, pos, format, resolution);
+    }
+    for (int i = 0; i < numAtoms; i++)
+        appendVector(payload, velocities[i], format, resolution);
+    header.payloadSize = payload.size();
+    header.storedSize = payload.size();
+    const char* stored = payload.data();
+#ifdef SEEKR2_HAVE_ZLIB
+    if (compression) {
+        vector<char> shuffled(payload.size());
+        int valueSize = getValueSize(format);
+        size_t indexBytes = 4*atoms.size();
+        shuffle(&payload[0], &shuffled[0], atoms.size(), 4);
+        shuffle(&payload[indexBytes], &shuffled[indexBytes], 6*numAtoms, valueSize);
+        uLongf packedSize = compressBound(payload.size());
+        packed.resize(packedSize);
+        if (compress2((Bytef*) packed.data(), &packedSize, (const Bytef*) shuffled.data(), shuffled.size(), Z_BEST_SPEED) != Z_OK)
+            throw OpenMMException("CrossingStateEncoder: failed to compress a state");
+        header.storedSize = packedSize;
+        stored = packed.data();
+    }
+#endif
+    stream.write(MAGIC, MAGIC_SIZE);
+    stream.write((const char*) &header, sizeof(header));
+    stream.write(stored, header.storedSize);
+}
+
+void CrossingStateEncoder::decode(istream& stream, CrossingSnapshot& snapshot, vector<int>& atoms) const {
+    long long stepCount;
+    decode(stream, snapshot, atoms, stepCount);
+}
+
+void CrossingStateEncoder::decode(istream& stream, CrossingSnapshot& snapshot, vector<int>& atoms, long long& stepCount) const {
+    string data((istreambuf_iterator<char>(stream)), istreambuf_iterator<char>());
+    atoms.clear();
+    if (data.size() < MAGIC_SIZE || data.compare(0, MAGIC_SIZE, MAGIC) != 0) {
+        // This is not a binary file, so it should be a serialized State.
+
+        istringstream xml(data);
+        State* state = XmlSerializer::deserialize<State>(xml);
+        snapshot.time = state->getTime();
+        stepCount = state->getStepCount();
+        state->getPeriodicBoxVectors(snapshot.periodicBoxVectors[0], snapshot.periodicBoxVectors[1], snapshot.periodicBoxVectors[2]);
+        snapshot.positions = state->getPositions();
+        snapshot.velocities = state->getVelocities();
+        delete state;
+        return;
+    }
+    BinaryHeader header;
+    if (data.size() < MAGIC_SIZE+sizeof(header))
+        throw OpenMMException("CrossingStateEncoder: truncated state file");
+    memcpy(&header, &data[MAGIC_SIZE], sizeof(header));
+    if (header.version != VERSION)
+        throw OpenMMException("CrossingStateEncoder: unsupported state file version");
+    if (header.format < Double || header.format > FixedPoint || header.numAtoms < 0)
+        throw OpenMMException("CrossingStateEncoder: corrupt state file header");
+    if (data.size() < MAGIC_SIZE+sizeof(header)+header.storedSize)
+        throw OpenMMException("CrossingStateEncoder: truncated state file");
+    bool delta = (header.flags & FLAG_DELTA) != 0;
+    if (delta && referencePositions.size() == 0)
+        throw OpenMMException("CrossingStateEncoder: the state file was written relative to a reference structure, but none has been set");
+    int numAtoms = header.numAtoms;
+    int numIndices = ((header.flags & FLAG_ATOMS) != 0 ? numAtoms : 0);
+    int valueSize = getValueSize(header.format);
+    size_t indexBytes = 4*(size_t) numIndices;
+    if (header.payloadSize != indexBytes+6*(size_t) numAtoms*valueSize)
+        throw OpenMMException("CrossingStateEncoder: corrupt state file header");
+    const char* stored = &data[MAGIC_SIZE+sizeof(header)];
+    vector<char> unpacked;
+    if ((header.flags & FLAG_COMPRESSED) != 0) {
+#ifdef SEEKR2_HAVE_ZLIB
+        vector<char> shuffled(header.payloadSize);
+        uLongf size = header.payloadSize;
+        if (uncompress((Bytef*) shuffled.data(), &size, (const Bytef*) stored, header.storedSize) != Z_OK || size != header.payloadSize)
+            throw OpenMMException("CrossingStateEncoder: failed to decompress a state");
+        unpacked.resize(header.payloadSize);
+        unshuffle(&shuffled[0], &unpacked[0], numIndices, 4);
+        unshuffle(&shuffled[indexBytes], &unpacked[indexBytes], 6*numAtoms, valueSize);
+        stored = unpacked.data();
+#else
+        throw OpenMMException("CrossingStateEncoder: reading a compressed state requires the plugin to be built with zlib");
+#endif
+    }
+    snapshot.time = header.time;
+    stepCount = header.stepCount;
+    for (int i = 0; i < 3; i++)
+        snapshot.periodicBoxVectors[i] = Vec3(header.periodicBoxVectors[3*i], header.periodicBoxVectors[3*i+1], header.periodicBoxVectors[3*i+2]);
+    atoms.resize(numIndices);
+    for (int i = 0; i < numIndices; i++) {
+        int32_t atom;
+        memcpy(&atom, stored+4*i, 4);
+        atoms[i] = atom;
+    }
+    const char* positionData = stored+indexBytes;
+    const char* velocityData = positionData+3*(size_t) numAtoms*valueSize;
+    snapshot.positions.resize(numAtoms);
+    snapshot.velocities.resize(numAtoms);
+    for (int i = 0; i < numAtoms; i++) {
+        snapshot.positions[i] = readVector(positionData+3*(size_t) i*valueSize, header.format, header.resolution);
+        snapshot.velocities[i] = readVector(velocityData+3*(size_t) i*valueSize, header.format, header.resolution);
+        if (delta) {
+            int atom = (numIndices > 0 ? atoms[i] : i);
+            if (atom < 0 || atom >= referencePositions.size())
+                throw OpenMMException("CrossingStateEncoder: the reference structure has too few positions");
+            snapshot.positions[i] += referencePositions[atom];
+        }
+    }
+}
+
+State CrossingStateEncoder::readState(const string& fileName) const {
+    ifstream file(fileName, ios_base::binary);
+    if (!file.is_open())
+        throw OpenMMException("CrossingStateEncoder: failed to open "+fileName);
+    CrossingSnapshot snapshot;
+    vector<int> atoms;
+    long long stepCount;
+    decode(file, snapshot, atoms, stepCount);
+    State::StateBuilder builder(snapshot.time, stepCount);
+    builder.setPositions(snapshot.positions);
+    builder.setVelocities(snapshot.velocities);
+    builder.setPeriodicBoxVectors(snapshot.periodicBoxVectors[0], snapshot.periodicBoxVectors[1], snapshot.periodicBoxVectors[2]);
+    return builder.getState();
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "internal/CrossingStateReservoir.h"
+#include "openmm/OpenMMException.h"
+#include <iostream>
+#include <sstream>
+
+using namespace Seekr2Plugin;
+using namespace OpenMM;
+using namespace std;
+
+CrossingStateReservoir::CrossingStateReservoir() {
+    initialize(0, 0, 0, 1);
+}
+
+void CrossingStateReservoir::initialize(int numBoundaries, int size, int spacing, int seed) {
+    this->size = size;
+    this->spacing = spacing;
+    numCandidates.assign(numBoundaries, 0);
+    lastCandidateStep.assign(numBoundaries, 0);
+    if (seed == 0)
+        random.seed(random_device()());
+    else
+        random.seed(seed);
+}
+
+int CrossingStateReservoir::offer(int boundary, long long stepCount) {
+    if (size == 0)
+        return -1;
+    if (numCandidates[boundary] > 0 && stepCount-lastCandidateStep[boundary] < spacing)
+        return -1;
+    lastCandidateStep[boundary] = stepCount;
+    long long n = numCandidates[boundary]++;
+    if (n < size)
+        return n;
+    long long slot = uniform_int_distribution<long long>(0, n)(random);
+    return (slot < size ? slot : -1);
+}
+
+void CrossingStateReservoir::createCheckpoint(ostream& stream) const {
+    int numBoundaries = numCandidates.size();
+    stream.write((char*) &numBoundaries, sizeof(int));
+    stream.write((char*) numCandidates.data(), numBoundaries*sizeof(long long));
+    stream.write((char*) lastCandidateStep.data(), numBoundaries*sizeof(long long));
+    stringstream randomState;
+    randomState << random;
+    string text = randomState.str();
+    int length = text.size();
+    stream.write((char*) &length, sizeof(int));
+    stream.write(text.c_str(), length);
+}
+
+void CrossingStateReservoir::loadCheckpoint(istream& stream) {
+    int numBoundaries, length;
+    stream.read((char*) &numBoundaries, sizeof(int));
+    if (!stream || numBoundaries != numCandidates.size())
+        throw OpenMMException("CrossingStateReservoir: the checkpoint was created for a different number of boundaries");
+    stream.read((char*) numCandidates.data(), numBoundaries*sizeof(long long));
+    stream.read((char*) lastCandidateStep.data(), numBoundaries*sizeof(long long));
+    stream.read((char*) &length, sizeof(int));
+    if (!stream || length < 0)
+        throw OpenMMException("CrossingStateReservoir: the checkpoint is malformed");
+    string text(length, ' ');
+    stream.read(&text[0], length);
+    stringstream randomState(text);
+    randomState >> random;
+    if (!stream || !randomState)
+        throw OpenMMException("CrossingStateReservoir: the checkpoint is malformed");
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "internal/CrossingStateWriter.h"
+#include "openmm/OpenMMException.h"
+#include <algorithm>
+#include <fstream>
+
+using namespace Seekr2Plugin;
+using namespace OpenMM;
+using namespace std;
+
+CrossingStateWriter::CrossingStateWriter() : time(0.0), stepCount(0), fullStateInterval(0), numWritten(0) {
+}
+
+void CrossingStateWriter::initialize(int numParticles, const vector<int>& atoms, int fullStateInterval, const CrossingStateEncoder& encoder) {
+    for (int atom : atoms)
+        if (atom < 0 || atom >= numParticles)
+            throw OpenMMException("Illegal atom index in the atoms selected for saved states");
+    if (encoder.getReferencePositions().size() > 0 && encoder.getReferencePositions().size() != numParticles)
+        throw OpenMMException("The reference structure for saved states must have one position for every particle");
+    positions.resize(numParticles);
+    velocities.resize(numParticles);
+    this->atoms = atoms;
+    selectedPositions.resize(atoms.size());
+    selectedVelocities.resize(atoms.size());
+    this->fullStateInterval = fullStateInterval;
+    numWritten = 0;
+    this->encoder = encoder;
+}
+
+void CrossingStateWriter::capture(ContextImpl& context) {
+    time = context.getTime();
+    stepCount = context.getStepCount();
+    context.getPeriodicBoxVectors(periodicBoxVectors[0], periodicBoxVectors[1], periodicBoxVectors[2]);
+    context.getPositions(positions);
+    context.getVelocities(velocities);
+}
+
+void CrossingStateWriter::capture(ContextImpl& context, const vector<Vec3>& positions, const vector<Vec3>& velocities) {
+    time = context.getTime();
+    stepCount = context.getStepCount();
+    context.getPeriodicBoxVectors(periodicBoxVectors[0], periodicBoxVectors[1], periodicBoxVectors[2]);
+    copy(positions.begin(), positions.end(), this->positions.begin());
+    copy(velocities.begin(), velocities.end(), this->velocities.begin());
+}
+
+void CrossingStateWriter::reverseVelocities() {
+    for (int i = 0; i < velocities.size(); i++)
+        velocities[i] *= -1.0;
+}
+
+void CrossingStateWriter::write(const string& fileName) {
+    bool full = (atoms.size() == 0 || (fullStateInterval > 0 && numWritten%fullStateInterval == 0));
+    numWritten++;
+    ofstream stateFile(fileName, ios_base::trunc | ios_base::binary);
+    if (full)
+        encoder.encode(time, stepCount, periodicBoxVectors, vector<int>(), positions, velocities, stateFile);
+    else {
+        for (int i = 0; i < atoms.size(); i++) {
+            selectedPositions[i] = positions[atoms[i]];
+            selectedVelocities[i] = velocities[atoms[i]];
+        }
+        encoder.encode(time, stepCount, periodicBoxVectors, atoms, selectedPositions, selectedVelocities, stateFile);
+    }
+}
+
+void CrossingStateWriter::copyTo(CrossingSnapshot& snapshot) const {
+    snapshot.time = time;
+    for (int i = 0; i < 3; i++)
+        snapshot.periodicBoxVectors[i] = periodicBoxVectors[i];
+    snapshot.positions = positions;
+    snapshot.velocities = velocities;
+}
@@ -0,0 +1,203 @@
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "internal/CrossingTrajectoryRecorder.h"
+#include "openmm/OpenMMException.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+using namespace Seekr2Plugin;
+using namespace OpenMM;
+using namespace std;
+
+template <class T>
+static void writeValue(ostream& stream, T value) {
+    stream.write((const char*) &value, sizeof(T));
+}
+
+CrossingTrajectoryRecorder::CrossingTrajectoryRecorder() : enabled(false), periodic(false), stepSize(0.0), interval(1), framesBefore(0), framesAfter(0),
+        maxRollback(0), firstFrame(0), numBuffered(0), numWritten(0), framesRemaining(0), lastWrittenStep(0) {
+}
+
+CrossingTrajectoryRecorder::~CrossingTrajectoryRecorder() {
+    closeFile();
+}
+
+void CrossingTrajectoryRecorder::initialize(const string& fileName, int numParticles, bool periodic, double stepSize, int interval, int framesBefore,
+            int framesAfter, int maxRollback) {
+    closeFile();
+    this->fileName = fileName;
+    this->periodic = periodic;
+    this->stepSize = stepSize;
+    this->interval = interval;
+    this->framesBefore = framesBefore;
+    this->framesAfter = framesAfter;
+    this->maxRollback = maxRollback;
+    enabled = !fileName.empty();
+    ring.clear();
+    if (enabled) {
+        // Frames recorded after a crossing may be discarded when the
+        // simulation is rolled back to it, and are held until their steps
+        // have been checked, so extra ones are kept.
+        
+        ring.resize(framesBefore+maxRollback/interval+1);
+        for (Frame& frame : ring)
+            frame.positions.resize(numParticles);
+        coordinates.resize(numParticles);
+    }
+    firstFrame = 0;
+    numBuffered = 0;
+}
+
+void CrossingTrajectoryRecorder::recordFrame(ContextImpl& context) {
+    long long stepCount = context.getStepCount();
+    while (numBuffered > 0 && ring[(firstFrame+numBuffered-1)%ring.size()].stepCount >= stepCount)
+        numBuffered--;
+    if (numBuffered == ring.size()) {
+        firstFrame = (firstFrame+1)%ring.size();
+        numBuffered--;
+    }
+    Frame& frame = ring[(firstFrame+numBuffered)%ring.size()];
+    numBuffered++;
+    frame.stepCount = stepCount;
+    context.getPositions(frame.positions);
+    context.getPeriodicBoxVectors(frame.periodicBoxVectors[0], frame.periodicBoxVectors[1], frame.periodicBoxVectors[2]);
+    if (maxRollback == 0)
+        stepsChecked(stepCount);
+}
+
+void CrossingTrajectoryRecorder::stepsChecked(long long stepCount) {
+    for (int i = 0; i < numBuffered && file.is_open(); i++) {
+        const Frame& frame = ring[(firstFrame+i)%ring.size()];
+        if (frame.stepCount > stepCount)
+            break;
+        if (frame.stepCount > lastWrittenStep) {
+            writeFrame(frame);
+            if (--framesRemaining <= 0)
+                closeFile();
+        }
+    }
+}
+
+void CrossingTrajectoryRecorder::trigger(ContextImpl& context, const string& eventName) {
+    long long stepCount = context.getStepCount();
+    while (numBuffered > 0 && ring[(firstFrame+numBuffered-1)%ring.size()].stepCount > stepCount)
+        numBuffered--;
+    if (!file.is_open()) {
+        string name = fileName+eventName+".dcd";
+        file.open(name, ios_base::out | ios_base::trunc | ios_base::binary);
+        if (!file.is_open())
+            throw OpenMMException("Failed to open the trajectory file "+name);
+        numWritten = 0;
+        int first = max(0, numBuffered-framesBefore);
+        lastWrittenStep = (numBuffered > 0 ? ring[(firstFrame+first)%ring.size()].stepCount : stepCount)-1;
+        
+        // Write the header, in the same layout as OpenMM's DCDFile. The
+        // number of frames and the last step are updated as frames are
+        // written.
+        
+        writeValue<int32_t>(file, 84);
+        file.write("CORD", 4);
+        writeValue<int32_t>(file, 0);
+        writeValue<int32_t>(file, lastWrittenStep+1);
+        writeValue<int32_t>(file, interval);
+        for (int i = 0; i < 6; i++)
+            writeValue<int32_t>(file, 0);
+        writeValue<float>(file, stepSize/0.04888821);
+        writeValue<int32_t>(file, periodic ? 1 : 0);
+        for (int i = 0; i < 8; i++)
+            writeValue<int32_t>(file, 0);
+        writeValue<int32_t>(file, 24);
+        writeValue<int32_t>(file, 84);
+        writeValue<int32_t>(file, 164);
+        writeValue<int32_t>(file, 2);
+        char title[160];
+        memset(title, ' ', sizeof(title));
+        const char* line1 = "Created by the SEEKR2 plugin";
+        const char* line2 = "Frames around milestone crossings";
+        memcpy(title, line1, strlen(line1));
+        memcpy(title+80, line2, strlen(line2));
+        file.write(title, sizeof(title));
+        writeValue<int32_t>(file, 164);
+        writeValue<int32_t>(file, 4);
+        writeValue<int32_t>(file, coordinates.size());
+        writeValue<int32_t>(file, 4);
+        for (int i = first; i < numBuffered; i++)
+            writeFrame(ring[(firstFrame+i)%ring.size()]);
+    }
+    framesRemaining = framesAfter;
+    if (framesRemaining == 0)
+        closeFile();
+}
+
+void CrossingTrajectoryRecorder::writeFrame(const Frame& frame) {
+    if (periodic) {
+        const Vec3* box = frame.periodicBoxVectors;
+        double a = sqrt(box[0].dot(box[0]));
+        double b = sqrt(box[1].dot(box[1]));
+        double c = sqrt(box[2].dot(box[2]));
+        writeValue<int32_t>(file, 48);
+        writeValue<double>(file, 10*a);
+        writeValue<double>(file, box[0].dot(box[1])/(a*b));
+        writeValue<double>(file, 10*b);
+        writeValue<double>(file, box[0].dot(box[2])/(a*c));
+        writeValue<double>(file, box[1].dot(box[2])/(b*c));
+        writeValue<double>(file, 10*c);
+        writeValue<int32_t>(file, 48);
+    }
+    int32_t length = 4*coordinates.size();
+    for (int axis = 0; axis < 3; axis++) {
+        for (int i = 0; i < coordinates.size(); i++)
+            coordinates[i] = (float) (10*frame.positions[i][axis]);
+        writeValue<int32_t>(file, length);
+        file.write((const char*) coordinates.data(), length);
+        writeValue<int32_t>(file, length);
+    }
+    numWritten++;
+    lastWrittenStep = frame.stepCount;
+    streampos end = file.tellp();
+    file.seekp(8);
+    writeValue<int32_t>(file, numWritten);
+    file.seekp(20);
+    writeValue<int32_t>(file, lastWrittenStep);
+    file.seekp(end);
+}
+
+void CrossingTrajectoryRecorder::closeFile() {
+    if (file.is_open())
+        file.close();
+    framesRemaining = 0;
+}
@@ -65,6 +65,11 @@ ElberLangevinMiddleIntegrator::ElberLangevinMiddleIntegrator(double temperature,
     setRandomNumberSeed(0);
     setOutputFileName(fileName);
     setSaveStateFileName("");
+    setTrajectoryFileName("");
+    setTrajectoryInterval(10);
+    setTrajectoryFramesBeforeCrossing(100);
+    setTrajectoryFramesAfterCrossing(100);
+    setTraceFileName("");
     setConstraintTolerance(1e-5);
     setCrossingCounter(0);
 }
@@ -116,6 +121,28 @@ void ElberLangevinMiddleIntegrator::setSaveStateFileName(const string& fileName)
     saveStateFileName = fileName;
 }
 
+void ElberLangevinMiddleIntegrator::setTrajectoryFileName(const string& fileName) {
+    trajectoryFileName = fileName;
+}
+
+void ElberLangevinMiddleIntegrator::setTrajectoryInterval(int steps) {
+    if (steps < 1)
+        throw OpenMMException("The trajectory interval must be at least 1");
+    trajectoryInterval = steps;
+}
+
+void ElberLangevinMiddleIntegrator::setTrajectoryFramesBeforeCrossing(int frames) {
+    if (frames < 0)
+        throw OpenMMException("The number of trajectory frames before a crossing cannot be negative");
+    trajectoryFramesBefore = frames;
+}
+
+void ElberLangevinMiddleIntegrator::setTrajectoryFramesAfterCrossing(int frames) {
+    if (frames < 0)
+        throw OpenMMException("The number of trajectory frames after a crossing cannot be negative");
+    trajectoryFramesAfter = frames;
+}
+
 const int ElberLangevinMiddleIntegrator::getSrcMilestoneGroup(int index) const {
     ASSERT_VALID_INDEX(index, srcMilestoneGroups)
     return srcMilestoneGroups[index];
@@ -151,3 +178,32 @@ const bool ElberLangevinMiddleIntegrator::getEndOnSrcMilestone() const {
 void ElberLangevinMiddleIntegrator::setEndOnSrcMilestone(bool endOnSrc) {
     endOnSrcMilestone = endOnSrc;
 }
+
+void ElberLangevinMiddleIntegrator::loadCrossingSnapshot(const CrossingSnapshot& snapshot) {
+    if (context == NULL)
+        throw OpenMMException("This Integrator is not bound to a context!");
+    Context& owner = context->getOwner();
+    owner.setPeriodicBoxVectors(snapshot.periodicBoxVectors[0], snapshot.periodicBoxVectors[1], snapshot.periodicBoxVectors[2]);
+    owner.setPositions(snapshot.positions);
+    owner.setVelocities(snapshot.velocities);
+    owner.setTime(0.0);
+    kernel.getAs<IntegrateElberLangevinMiddleStepKernel>().resetCrossingState(*context, *this);
+}
+
+void ElberLangevinMiddleIntegrator::setTraceFileName(const string& fileName) {
+    traceFileName = fileName;
+}
+
+void ElberLangevinMiddleIntegrator::flushTrace() {
+    if (context == NULL)
+        throw OpenMMException("This Integrator is not bound to a context!");
+    kernel.getAs<IntegrateElberLangevinMiddleStepKernel>().flushTrace(*context);
+}
+
+LogBinnedHistogram ElberLangevinMiddleIntegrator::getFirstPassageTimeHistogram(int milestoneGroup) {
+    if (context == NULL)
+        throw OpenMMException("This Integrator is not bound to a context!");
+    LogBinnedHistogram histogram;
+    kernel.getAs<IntegrateElberLangevinMiddleStepKernel>().getFirstPassageTimeHistogram(*context, milestoneGroup, histogram);
+    return histogram;
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "LogBinnedHistogram.h"
+#include "openmm/OpenMMException.h"
+#include <cmath>
+#include <sstream>
+
+using namespace Seekr2Plugin;
+using namespace OpenMM;
+using namespace std;
+
+LogBinnedHistogram::LogBinnedHistogram(double minValue, int numDecades, int binsPerDecade) : minValue(minValue),
+        numDecades(numDecades), binsPerDecade(binsPerDecade) {
+    if (!(minValue > 0.0))
+        throw OpenMMException("LogBinnedHistogram: the minimum value must be positive");
+    if (numDecades < 1 || binsPerDecade < 1)
+        throw OpenMMException("LogBinnedHistogram: the number of decades and bins per decade must be positive");
+    logMinValue = log10(minValue);
+    counts.resize(numDecades*binsPerDecade);
+    clear();
+}
+
+double LogBinnedHistogram::getMaxValue() const {
+    return getBinLowerEdge(counts.size());
+}
+
+double LogBinnedHistogram::getBinLowerEdge(int bin) const {
+    return minValue*pow(10.0, bin/(double) binsPerDecade);
+}
+
+double LogBinnedHistogram::getBinUpperEdge(int bin) const {
+    return getBinLowerEdge(bin+1);
+}
+
+long long LogBinnedHistogram::getBinCount(int bin) const {
+    if (bin < 0 || bin >= counts.size())
+        throw OpenMMException("LogBinnedHistogram: bin index out of range");
+    return counts[bin];
+}
+
+void LogBinnedHistogram::addValue(double value) {
+    totalCount++;
+    sum += value;
+    if (!(value >= minValue)) {
+        underflow++;
+        return;
+    }
+    double bin = (log10(value)-logMinValue)*binsPerDecade;
+    if (bin >= counts.size())
+        overflow++;
+    else
+        counts[(int) bin]++;
+}
+
+void LogBinnedHistogram::addHistogram(const LogBinnedHistogram& other) {
+    if (other.minValue != minValue || other.numDecades != numDecades || other.binsPerDecade != binsPerDecade)
+        throw OpenMMException("LogBinnedHistogram: cannot add histograms with different bins");
+    for (int i = 0; i < counts.size(); i++)
+        counts[i] += other.counts[i];
+    underflow += other.underflow;
+    overflow += other.overflow;
+    totalCount += other.totalCount;
+    sum += other.sum;
+}
+
+void LogBinnedHistogram::clear() {
+    counts.assign(counts.size(), 0);
+    underflow = 0;
+    overflow = 0;
+    totalCount = 0;
+    sum = 0.0;
+}
+
+string LogBinnedHistogram::toString() const {
+    stringstream text;
+    text.precision(12);
+    text << minValue << " " << numDecades << " " << binsPerDecade << " " << sum << " " << underflow << " " << overflow;
+    for (int i = 0; i < counts.size(); i++)
+        if (counts[i] != 0)
+            text << " " << i << ":" << counts[i];
+    return text.str();
+}
+
+LogBinnedHistogram LogBinnedHistogram::fromString(const string& text) {
+    stringstream input(text);
+    double minValue, sum;
+    int numDecades, binsPerDecade;
+    long long underflow, overflow;
+    if (!(input >> minValue >> numDecades >> binsPerDecade >> sum >> underflow >> overflow))
+        throw OpenMMException("LogBinnedHistogram: malformed histogram: "+text);
+    LogBinnedHistogram histogram(minValue, numDecades, binsPerDecade);
+    histogram.sum = sum;
+    histogram.underflow = underflow;
+    histogram.overflow = overflow;
+    histogram.totalCount = underflow+overflow;
+    string entry;
+    while (input >> entry) {
+        int bin;
+        long long count;
+        char separator;
+        stringstream binText(entry);
+        if (!(binText >> bin >> separator >> count) || separator != ':' || bin < 0 || bin >= histogram.counts.size())
+            throw OpenMMException("LogBinnedHistogram: malformed histogram: "+text);
+        histogram.counts[bin] += count;
+        histogram.totalCount += count;
+    }
+    return histogram;
+}
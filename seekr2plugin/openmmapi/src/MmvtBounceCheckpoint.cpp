@@ -0,0 +1,153 @@
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "internal/MmvtBounceCheckpoint.h"
+#include "openmm/OpenMMException.h"
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+using namespace Seekr2Plugin;
+using namespace OpenMM;
+using namespace std;
+
+template <class T>
+static void writeValue(ostream& stream, const T& value) {
+    stream.write((char*) &value, sizeof(T));
+}
+
+template <class T>
+static void readValue(istream& stream, T& value) {
+    stream.read((char*) &value, sizeof(T));
+}
+
+void MmvtBounceCheckpoint::write(ostream& stream) const {
+    int numGroups = statistics.milestoneGroups.size();
+    bool hasHistograms = !statistics.incubationTimeHistograms.empty();
+    writeValue(stream, numGroups);
+    for (int i = 0; i < numGroups; i++) {
+        writeValue(stream, statistics.milestoneGroups[i]);
+        writeValue(stream, statistics.N_alpha_beta[i]);
+        writeValue(stream, statistics.Ri_alpha[i]);
+        for (int j = 0; j < numGroups; j++)
+            writeValue(stream, statistics.Nij_alpha[i][j]);
+    }
+    writeValue(stream, statistics.T_alpha);
+    writeValue(stream, hasHistograms);
+    if (hasHistograms) {
+        for (int i = 0; i < numGroups; i++)
+            for (int j = 0; j < numGroups; j++) {
+                string text = statistics.incubationTimeHistograms[i][j].toString();
+                int length = text.size();
+                writeValue(stream, length);
+                stream.write(text.c_str(), length);
+            }
+    }
+    writeValue(stream, bounceCounter);
+    writeValue(stream, previousMilestoneCrossed);
+    writeValue(stream, incubationTime);
+    writeValue(stream, firstCrossingTime);
+    writeValue(stream, crossingLogSize);
+}
+
+void MmvtBounceCheckpoint::read(istream& stream) {
+    int numGroups;
+    bool hasHistograms;
+    readValue(stream, numGroups);
+    if (!stream || numGroups < 0)
+        throw OpenMMException("MmvtBounceCheckpoint: the checkpoint is malformed");
+    statistics = MmvtAnchorStatistics();
+    statistics.milestoneGroups.resize(numGroups);
+    statistics.N_alpha_beta.resize(numGroups);
+    statistics.Ri_alpha.resize(numGroups);
+    statistics.Nij_alpha.assign(numGroups, vector<int>(numGroups));
+    for (int i = 0; i < numGroups; i++) {
+        readValue(stream, statistics.milestoneGroups[i]);
+        readValue(stream, statistics.N_alpha_beta[i]);
+        readValue(stream, statistics.Ri_alpha[i]);
+        for (int j = 0; j < numGroups; j++)
+            readValue(stream, statistics.Nij_alpha[i][j]);
+    }
+    readValue(stream, statistics.T_alpha);
+    readValue(stream, hasHistograms);
+    if (hasHistograms) {
+        statistics.incubationTimeHistograms.assign(numGroups, vector<LogBinnedHistogram>(numGroups));
+        for (int i = 0; i < numGroups; i++)
+            for (int j = 0; j < numGroups; j++) {
+                int length = 0;
+                readValue(stream, length);
+                if (!stream || length < 0)
+                    throw OpenMMException("MmvtBounceCheckpoint: the checkpoint is malformed");
+                string text(length, ' ');
+                stream.read(&text[0], length);
+                statistics.incubationTimeHistograms[i][j] = LogBinnedHistogram::fromString(text);
+            }
+    }
+    readValue(stream, bounceCounter);
+    readValue(stream, previousMilestoneCrossed);
+    readValue(stream, incubationTime);
+    readValue(stream, firstCrossingTime);
+    readValue(stream, crossingLogSize);
+    if (!stream)
+        throw OpenMMException("MmvtBounceCheckpoint: the checkpoint is malformed");
+}
+
+void MmvtBounceCheckpoint::checkMilestoneGroups(const vector<int>& milestoneGroups) const {
+    if (statistics.milestoneGroups != milestoneGroups)
+        throw OpenMMException("MmvtBounceCheckpoint: the checkpoint was created for different milestone groups");
+}
+
+long long MmvtBounceCheckpoint::getCrossingLogSize(const string& fileName) {
+    ifstream file(fileName.c_str(), ios_base::in | ios_base::binary | ios_base::ate);
+    if (!file)
+        return 0;
+    return (long long) file.tellg();
+}
+
+void MmvtBounceCheckpoint::restoreCrossingLog(const string& fileName) const {
+    string contents;
+    {
+        ifstream file(fileName.c_str(), ios_base::in | ios_base::binary);
+        contents.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    }
+    if (contents.size() < crossingLogSize)
+        throw OpenMMException("MmvtBounceCheckpoint: the crossing log "+fileName+" is shorter than when the checkpoint was created");
+    if (contents.size() == crossingLogSize)
+        return;
+    ofstream file(fileName.c_str(), ios_base::out | ios_base::binary | ios_base::trunc);
+    file.write(contents.c_str(), crossingLogSize);
+    file.close();
+    if (!file)
+        throw OpenMMException("MmvtBounceCheckpoint: error writing the crossing log "+fileName);
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "MmvtBounceController.h"
+#include "openmm/Integrator.h"
+#include "openmm/OpenMMException.h"
+#include "openmm/internal/AssertionUtilities.h"
+#include "openmm/State.h"
+#include "openmm/serialization/XmlSerializer.h"
+#include <sstream>
+
+using namespace Seekr2Plugin;
+using namespace OpenMM;
+using namespace std;
+
+MmvtBounceController::MmvtBounceController(Context& context, string fileName) : context(context),
+        outputFileName(fileName), initialized(false), bounceCounter(0), previousMilestoneCrossed(-1),
+        firstCrossingTime(0.0), incubationTime(0.0) {
+}
+
+int MmvtBounceController::getMilestoneGroup(int index) const {
+    ASSERT_VALID_INDEX(index, milestoneGroups);
+    return milestoneGroups[index];
+}
+
+int MmvtBounceController::addMilestoneGroup(int milestoneGroup) {
+    if (initialized)
+        throw OpenMMException("MmvtBounceController: milestone groups cannot be added after the first step");
+    milestoneGroups.push_back(milestoneGroup);
+    return milestoneGroups.size()-1;
+}
+
+MmvtAnchorStatistics MmvtBounceController::getStatistics() const {
+    MmvtAnchorStatistics result = statistics;
+    result.milestoneGroups = milestoneGroups;
+    if (!initialized) {
+        int numGroups = milestoneGroups.size();
+        result.N_alpha_beta.assign(numGroups, 0);
+        result.Nij_alpha.assign(numGroups, vector<int>(numGroups, 0));
+        result.Ri_alpha.assign(numGroups, 0.0);
+        result.incubationTimeHistograms.assign(numGroups, vector<LogBinnedHistogram>(numGroups));
+    }
+    return result;
+}
+
+void MmvtBounceController::initialize() {
+    int numGroups = milestoneGroups.size();
+    statistics.N_alpha_beta.assign(numGroups, 0);
+    statistics.Nij_alpha.assign(numGroups, vector<int>(numGroups, 0));
+    statistics.Ri_alpha.assign(numGroups, 0.0);
+    statistics.incubationTimeHistograms.assign(numGroups, vector<LogBinnedHistogram>(numGroups));
+    statistics.T_alpha = 0.0;
+    
+    // Write the header only if the crossing log does not already exist.
+    
+    bool outputFileAlreadyExists = ifstream(outputFileName).good();
+    crossingLog.open(outputFileName, ios_base::app);
+    if (!crossingLog)
+        throw OpenMMException("MmvtBounceController: cannot open "+outputFileName);
+    if (!outputFileAlreadyExists)
+        crossingLog << "#\"Bounced boundary ID\",\"bounce index\",\"total time (ps)\"\n";
+    crossingLog.setf(ios::fixed, ios::floatfield);
+    crossingLog.precision(3);
+    double value = context.getState(State::Energy, false, 2).getPotentialEnergy();
+    if (value > 0.0)
+        throw OpenMMException("MMVT simulation bouncing on first step: the system is trapped behind a boundary. Check and revise MMVT boundary definitions and atomic positions.");
+    initialized = true;
+}
+
+void MmvtBounceController::step(int steps) {
+    if (!initialized)
+        initialize();
+    Integrator& integrator = context.getIntegrator();
+    for (int i = 0; i < steps; i++) {
+        // Save the state at the start of the step, so that the simulation can
+        // be rolled back to it if the step crosses a boundary.
+        
+        State start = context.getState(State::Positions | State::Velocities);
+        integrator.step(1);
+        State end = context.getState(State::Energy, false, 2);
+        double stepTime = end.getTime()-start.getTime();
+        double value = end.getPotentialEnergy();
+        if (value <= 0.0) {
+            incubationTime += stepTime;
+            continue;
+        }
+        
+        // Record the bounce as of the start of the step, then restore the
+        // positions and reverse the velocities of the particles. The time
+        // keeps advancing.
+        
+        recordBounce(static_cast<int>(value), start.getTime());
+        incubationTime += stepTime;
+        Vec3 a, b, c;
+        start.getPeriodicBoxVectors(a, b, c);
+        context.setPeriodicBoxVectors(a, b, c);
+        context.setPositions(start.getPositions());
+        const vector<Vec3>& velocities = start.getVelocities();
+        reversedVelocities.resize(velocities.size());
+        for (int j = 0; j < velocities.size(); j++)
+            reversedVelocities[j] = -velocities[j];
+        context.setVelocities(reversedVelocities);
+    }
+}
+
+void MmvtBounceController::recordBounce(int bitcode, double time) {
+    int numBouncedSurfaces = 0;
+    for (int i = 0; i < milestoneGroups.size(); i++)
+        if ((bitcode & (1<<i)) != 0)
+            numBouncedSurfaces++;
+    for (int i = 0; i < milestoneGroups.size(); i++) {
+        if ((bitcode & (1<<i)) == 0)
+            continue;
+        crossingLog << milestoneGroups[i] << "," << bounceCounter << "," << time << "\n";
+        if (!saveStateFileName.empty() && numBouncedSurfaces == 1) {
+            // Save the state that crossed the boundary, before it is rolled
+            // back.
+            
+            State crossed = context.getState(State::Positions | State::Velocities);
+            stringstream number;
+            number << "_" << bounceCounter << "_" << milestoneGroups[i];
+            ofstream stateFile(saveStateFileName+number.str());
+            XmlSerializer::serialize<State>(&crossed, "State", stateFile);
+        }
+        statistics.N_alpha_beta[i] += 1;
+        if (previousMilestoneCrossed != i) {
+            if (previousMilestoneCrossed != -1) {
+                statistics.Nij_alpha[previousMilestoneCrossed][i] += 1;
+                statistics.Ri_alpha[previousMilestoneCrossed] += incubationTime;
+                statistics.incubationTimeHistograms[previousMilestoneCrossed][i].addValue(incubationTime);
+            }
+            else
+                firstCrossingTime = time;
+            incubationTime = 0.0;
+        }
+        statistics.T_alpha = time-firstCrossingTime;
+        previousMilestoneCrossed = i;
+        bounceCounter++;
+    }
+    crossingLog.flush();
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "internal/MmvtBoundaryCheckScheduler.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace Seekr2Plugin;
+using namespace std;
+
+// The weight given to the newest value in the running averages.
+
+static const double AVERAGE_WEIGHT = 0.1;
+
+MmvtBoundaryCheckScheduler::MmvtBoundaryCheckScheduler() {
+    initialize(1, false);
+}
+
+void MmvtBoundaryCheckScheduler::initialize(int maxInterval, bool adaptive) {
+    this->maxInterval = maxInterval;
+    this->adaptive = adaptive;
+    interval = (adaptive ? 1 : maxInterval);
+    counters = MmvtPerformanceCounters();
+    counters.boundaryCheckInterval = interval;
+    lastBounceStep = -1;
+    averageBounceSteps = 0.0;
+    averageDisplacement = 0.0;
+    safeDistance = 0.0;
+}
+
+void MmvtBoundaryCheckScheduler::stepTaken(double displacement) {
+    counters.numSteps++;
+    if (displacement >= 0.0) {
+        if (averageDisplacement == 0.0)
+            averageDisplacement = displacement;
+        else
+            averageDisplacement += AVERAGE_WEIGHT*(displacement-averageDisplacement);
+    }
+}
+
+void MmvtBoundaryCheckScheduler::safeDistanceEvaluated(double distance) {
+    counters.numSafeDistanceEvaluations++;
+    safeDistance = distance;
+}
+
+int MmvtBoundaryCheckScheduler::limitInterval(int proposed) const {
+    double limit = maxInterval;
+    if (averageBounceSteps > 0.0)
+        limit = min(limit, 0.25*averageBounceSteps);
+    if (safeDistance > 0.0 && averageDisplacement > 0.0)
+        limit = min(limit, safeDistance/averageDisplacement);
+    return max(1, min(proposed, (int) limit));
+}
+
+void MmvtBoundaryCheckScheduler::checkPassed() {
+    if (adaptive) {
+        interval = limitInterval(2*interval);
+        counters.boundaryCheckInterval = interval;
+    }
+}
+
+void MmvtBoundaryCheckScheduler::rolledBack(int discardedSteps, long long stepCount) {
+    counters.numRollbacks++;
+    counters.numDiscardedSteps += discardedSteps;
+    if (lastBounceStep >= 0) {
+        double steps = (double) (stepCount-lastBounceStep);
+        if (averageBounceSteps == 0.0)
+            averageBounceSteps = steps;
+        else
+            averageBounceSteps += AVERAGE_WEIGHT*(steps-averageBounceSteps);
+    }
+    lastBounceStep = stepCount;
+    safeDistance = 0.0;
+    if (adaptive) {
+        interval = 1;
+        counters.boundaryCheckInterval = interval;
+    }
+}
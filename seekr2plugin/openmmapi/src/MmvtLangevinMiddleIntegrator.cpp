@@ -65,9 +65,27 @@ MmvtLangevinMiddleIntegrator::MmvtLangevinMiddleIntegrator(double temperature,
     setRandomNumberSeed(0);
     setOutputFileName(fileName);
     setSaveStateFileName("");
+    setSaveStateBeforeCrossing(false);
+    setSaveFirstHitsOnly(false);
+    setFullSaveStateInterval(0);
+    setSaveStateReservoirSize(0);
+    setSaveStateReservoirSpacing(0);
+    setTrajectoryFileName("");
+    setTrajectoryInterval(10);
+    setTrajectoryFramesBeforeCrossing(100);
+    setTrajectoryFramesAfterCrossing(100);
+    setStatusSegmentName("");
+    setTraceFileName("");
     setConstraintTolerance(1e-5);
     setSaveStatisticsFileName("");
     setBounceCounter(0);
+    setCrossingSnapshotQueue(NULL);
+    setConvergenceBlockSteps(0);
+    setConvergenceTolerance(0.0);
+    setBoundaryCheckInterval(1);
+    setSafeStepDistanceGroup(-1);
+    setAdaptiveBoundaryChecks(false);
+    stepsInBlock = 0;
 }
 
 void MmvtLangevinMiddleIntegrator::initialize(ContextImpl& contextRef) {
@@ -75,6 +93,8 @@ void MmvtLangevinMiddleIntegrator::initialize(ContextImpl& contextRef) {
     const System& system = contextRef.getSystem();
     kernel = context->getPlatform().createKernel(IntegrateMmvtLangevinMiddleStepKernel::Name(), contextRef);
     kernel.getAs<IntegrateMmvtLangevinMiddleStepKernel>().initialize(contextRef.getSystem(), *this);
+    convergenceMonitor.reset();
+    stepsInBlock = 0;
 }
 
 void MmvtLangevinMiddleIntegrator::cleanup() {
@@ -94,10 +114,55 @@ double MmvtLangevinMiddleIntegrator::computeKineticEnergy() {
 void MmvtLangevinMiddleIntegrator::step(int steps) {
     if (context == NULL)
         throw OpenMMException("This Integrator is not bound to a context!");  
+    if (isConverged())
+        return;
+    int forceGroups = (safeStepDistanceGroup >= 0 ? ~(1<<safeStepDistanceGroup) : 0xFFFFFFFF);
+    bool multipleTimeSteps = (getNumInnerSteps() > 1 || getSlowForceGroups() != 0);
     for (int i = 0; i < steps; ++i) {
         context->updateContextState();
-        context->calcForcesAndEnergy(true, false);
-        kernel.getAs<IntegrateMmvtLangevinMiddleStepKernel>().execute(*context, *this);
+        if (multipleTimeSteps)
+            takeMultipleTimeStep(forceGroups);
+        else {
+            context->calcForcesAndEnergy(true, false, forceGroups);
+            kernel.getAs<IntegrateMmvtLangevinMiddleStepKernel>().execute(*context, *this);
+        }
+        if (convergenceBlockSteps > 0 && ++stepsInBlock == convergenceBlockSteps) {
+            stepsInBlock = 0;
+            kernel.getAs<IntegrateMmvtLangevinMiddleStepKernel>().checkPendingBoundaries(*context, *this);
+            convergenceMonitor.addBlock(getStatistics());
+            if (isConverged())
+                break;
+        }
+    }
+    kernel.getAs<IntegrateMmvtLangevinMiddleStepKernel>().checkPendingBoundaries(*context, *this);
+}
+
+void MmvtLangevinMiddleIntegrator::takeMultipleTimeStep(int forceGroups) {
+    IntegrateMmvtLangevinMiddleStepKernel& stepKernel = kernel.getAs<IntegrateMmvtLangevinMiddleStepKernel>();
+    int slowGroups = forceGroups & getSlowForceGroups();
+    int fastGroups = forceGroups & ~getSlowForceGroups();
+    
+    // Kick the velocities with the slow forces for half a step. These are
+    // usually still the forces computed at the end of the previous step.
+    
+    if (slowGroups != 0) {
+        if (!context->getForcesValid() || context->getLastForceGroups() != slowGroups)
+            context->calcForcesAndEnergy(true, false, slowGroups);
+        stepKernel.kickVelocities(*context, *this, 0.5*getStepSize());
+    }
+    
+    // Take the inner steps with the fast forces. Crossings are detected, and
+    // rolled back, on the inner steps, and all of them must be resolved
+    // before the slow forces act on the new positions.
+    
+    for (int j = 0; j < getNumInnerSteps(); j++) {
+        context->calcForcesAndEnergy(true, false, fastGroups);
+        stepKernel.execute(*context, *this);
+    }
+    stepKernel.checkPendingBoundaries(*context, *this);
+    if (slowGroups != 0) {
+        context->calcForcesAndEnergy(true, false, slowGroups);
+        stepKernel.kickVelocities(*context, *this, 0.5*getStepSize());
     }
 }
 
@@ -142,3 +207,146 @@ const int MmvtLangevinMiddleIntegrator::getBounceCounter() const {
 void MmvtLangevinMiddleIntegrator::setBounceCounter(int counter) {
     bounceCounter = counter;
 }
+
+CrossingSnapshotQueue* MmvtLangevinMiddleIntegrator::getCrossingSnapshotQueue() const {
+    return crossingSnapshotQueue;
+}
+
+void MmvtLangevinMiddleIntegrator::setCrossingSnapshotQueue(CrossingSnapshotQueue* queue) {
+    crossingSnapshotQueue = queue;
+}
+
+MmvtAnchorStatistics MmvtLangevinMiddleIntegrator::getStatistics() {
+    if (context == NULL)
+        throw OpenMMException("This Integrator is not bound to a context!");
+    MmvtAnchorStatistics statistics;
+    kernel.getAs<IntegrateMmvtLangevinMiddleStepKernel>().getStatistics(*context, statistics);
+    return statistics;
+}
+
+void MmvtLangevinMiddleIntegrator::setConvergenceBlockSteps(int steps) {
+    if (steps < 0)
+        throw OpenMMException("The number of convergence block steps cannot be negative");
+    convergenceBlockSteps = steps;
+}
+
+void MmvtLangevinMiddleIntegrator::setConvergenceTolerance(double tolerance) {
+    if (tolerance < 0.0)
+        throw OpenMMException("The convergence tolerance cannot be negative");
+    convergenceTolerance = tolerance;
+}
+
+bool MmvtLangevinMiddleIntegrator::isConverged() const {
+    return (convergenceBlockSteps > 0 && convergenceTolerance > 0.0 && convergenceMonitor.isConverged(convergenceTolerance));
+}
+
+void MmvtLangevinMiddleIntegrator::setBoundaryCheckInterval(int interval) {
+    if (interval < 1)
+        throw OpenMMException("The boundary check interval must be at least 1");
+    boundaryCheckInterval = interval;
+}
+
+void MmvtLangevinMiddleIntegrator::setSafeStepDistanceGroup(int group) {
+    if (group < -1 || group > 31)
+        throw OpenMMException("The safe step distance group must be between 0 and 31, or -1 to disable it");
+    safeStepDistanceGroup = group;
+}
+
+void MmvtLangevinMiddleIntegrator::setAdaptiveBoundaryChecks(bool adaptive) {
+    adaptiveBoundaryChecks = adaptive;
+}
+
+void MmvtLangevinMiddleIntegrator::setSaveStateBeforeCrossing(bool before) {
+    saveStateBeforeCrossing = before;
+}
+
+void MmvtLangevinMiddleIntegrator::setSaveFirstHitsOnly(bool firstHitsOnly) {
+    saveFirstHitsOnly = firstHitsOnly;
+}
+
+void MmvtLangevinMiddleIntegrator::setSaveStateAtomSelection(const vector<int>& atoms) {
+    for (int atom : atoms)
+        if (atom < 0)
+            throw OpenMMException("The atoms selected for saved states cannot have negative indices");
+    saveStateAtoms = atoms;
+}
+
+void MmvtLangevinMiddleIntegrator::setFullSaveStateInterval(int interval) {
+    if (interval < 0)
+        throw OpenMMException("The full save state interval cannot be negative");
+    fullSaveStateInterval = interval;
+}
+
+void MmvtLangevinMiddleIntegrator::setSaveStateReservoirSize(int size) {
+    if (size < 0)
+        throw OpenMMException("The save state reservoir size cannot be negative");
+    saveStateReservoirSize = size;
+}
+
+void MmvtLangevinMiddleIntegrator::setSaveStateReservoirSpacing(int steps) {
+    if (steps < 0)
+        throw OpenMMException("The save state reservoir spacing cannot be negative");
+    saveStateReservoirSpacing = steps;
+}
+
+void MmvtLangevinMiddleIntegrator::setSaveStateEncoder(const CrossingStateEncoder& encoder) {
+    saveStateEncoder = encoder;
+}
+
+void MmvtLangevinMiddleIntegrator::setTrajectoryFileName(const string& fileName) {
+    trajectoryFileName = fileName;
+}
+
+void MmvtLangevinMiddleIntegrator::setStatusSegmentName(const string& name) {
+    statusSegmentName = name;
+}
+
+void MmvtLangevinMiddleIntegrator::setTrajectoryInterval(int steps) {
+    if (steps < 1)
+        throw OpenMMException("The trajectory interval must be at least 1");
+    trajectoryInterval = steps;
+}
+
+void MmvtLangevinMiddleIntegrator::setTrajectoryFramesBeforeCrossing(int frames) {
+    if (frames < 0)
+        throw OpenMMException("The number of trajectory frames before a crossing cannot be negative");
+    trajectoryFramesBefore = frames;
+}
+
+void MmvtLangevinMiddleIntegrator::setTrajectoryFramesAfterCrossing(int frames) {
+    if (frames < 0)
+        throw OpenMMException("The number of trajectory frames after a crossing cannot be negative");
+    trajectoryFramesAfter = frames;
+}
+
+void MmvtLangevinMiddleIntegrator::setTraceFileName(const string& fileName) {
+    traceFileName = fileName;
+}
+
+void MmvtLangevinMiddleIntegrator::flushTrace() {
+    if (context == NULL)
+        throw OpenMMException("This Integrator is not bound to a context!");
+    kernel.getAs<IntegrateMmvtLangevinMiddleStepKernel>().flushTrace(*context);
+}
+
+void MmvtLangevinMiddleIntegrator::createCheckpoint(std::ostream& stream) const {
+    if (context == NULL)
+        throw OpenMMException("This Integrator is not bound to a context!");
+    kernel.getAs<IntegrateMmvtLangevinMiddleStepKernel>().createCheckpoint(*context, stream);
+}
+
+void MmvtLangevinMiddleIntegrator::loadCheckpoint(std::istream& stream) {
+    if (context == NULL)
+        throw OpenMMException("This Integrator is not bound to a context!");
+    kernel.getAs<IntegrateMmvtLangevinMiddleStepKernel>().loadCheckpoint(*context, stream);
+    convergenceMonitor.reset(getStatistics());
+    stepsInBlock = 0;
+}
+
+MmvtPerformanceCounters MmvtLangevinMiddleIntegrator::getPerformanceCounters() {
+    if (context == NULL)
+        throw OpenMMException("This Integrator is not bound to a context!");
+    MmvtPerformanceCounters counters;
+    kernel.getAs<IntegrateMmvtLangevinMiddleStepKernel>().getPerformanceCounters(*context, counters);
+    return counters;
+}
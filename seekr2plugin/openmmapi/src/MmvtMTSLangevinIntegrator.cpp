@@ -0,0 +1,74 @@
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "MmvtMTSLangevinIntegrator.h"
+#include "openmm/OpenMMException.h"
+#include "openmm/internal/ContextImpl.h"
+
+using namespace Seekr2Plugin;
+using namespace OpenMM;
+using namespace std;
+
+MmvtMTSLangevinIntegrator::MmvtMTSLangevinIntegrator(double temperature, double frictionCoeff, double stepSize, 
+        string fileName, int numInnerSteps) : MmvtLangevinMiddleIntegrator(temperature, frictionCoeff, stepSize, fileName), 
+        slowForceGroups(0) {
+    setNumInnerSteps(numInnerSteps);
+}
+
+void MmvtMTSLangevinIntegrator::setNumInnerSteps(int steps) {
+    if (steps < 1)
+        throw OpenMMException("The number of inner steps must be at least 1");
+    numInnerSteps = steps;
+}
+
+void MmvtMTSLangevinIntegrator::addSlowForceGroup(int group) {
+    if (group < 0 || group > 31)
+        throw OpenMMException("Force group must be between 0 and 31");
+    slowForceGroups |= 1<<group;
+}
+
+bool MmvtMTSLangevinIntegrator::isSlowForceGroup(int group) const {
+    return (group >= 0 && group <= 31 && (slowForceGroups & (1<<group)) != 0);
+}
+
+void MmvtMTSLangevinIntegrator::initialize(ContextImpl& contextRef) {
+    // The boundaries are evaluated after every inner step, so the forces
+    // they depend on must not be slow.
+    
+    if (isSlowForceGroup(1))
+        throw OpenMMException("MmvtMTSLangevinIntegrator: force group 1 holds the MMVT boundaries and cannot be a slow force group");
+    if (isSlowForceGroup(getSafeStepDistanceGroup()))
+        throw OpenMMException("MmvtMTSLangevinIntegrator: the safe step distance group cannot be a slow force group");
+    MmvtLangevinMiddleIntegrator::initialize(contextRef);
+}
@@ -0,0 +1,279 @@
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "MmvtStatusSegment.h"
+#include "openmm/OpenMMException.h"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <sched.h>
+    #include <signal.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+using namespace Seekr2Plugin;
+using namespace OpenMM;
+using namespace std;
+
+static const char STATUS_MAGIC[8] = "SEEKR2S";
+static const int STATUS_VERSION = 1;
+
+/**
+ * The contents of a status segment, apart from the sequence number that
+ * guards them. This is copied as a whole by readers.
+ */
+struct StatusData {
+    char magic[8];
+    int version, numMilestoneGroups, processId, bounceCounter;
+    long long stepCount;
+    double time, T_alpha;
+    int milestoneGroups[MmvtStatusSegment::MAX_MILESTONE_GROUPS];
+    int N_alpha_beta[MmvtStatusSegment::MAX_MILESTONE_GROUPS];
+    int Nij_alpha[MmvtStatusSegment::MAX_MILESTONE_GROUPS][MmvtStatusSegment::MAX_MILESTONE_GROUPS];
+    double Ri_alpha[MmvtStatusSegment::MAX_MILESTONE_GROUPS];
+    long long numSteps, numBoundaryEvaluations, numSafeDistanceEvaluations, numSafeSteps, numRollbacks, numDiscardedSteps;
+    int boundaryCheckInterval;
+};
+
+/**
+ * The layout of a status segment. The sequence number is odd while an update
+ * is in progress, and is advanced by two by every update.
+ */
+struct StatusBlock {
+    atomic<unsigned long long> sequence;
+    StatusData data;
+};
+
+static string getFullName(const string& name) {
+    if (name.empty())
+        throw OpenMMException("MmvtStatusSegment: the name of the segment must not be empty");
+    return (name[0] == '/' ? name : "/"+name);
+}
+
+MmvtStatusSegment::MmvtStatusSegment() : block(NULL), owner(false) {
+}
+
+MmvtStatusSegment::~MmvtStatusSegment() {
+    close();
+}
+
+#ifdef _WIN32
+
+void MmvtStatusSegment::create(const string& name, const vector<int>& milestoneGroups) {
+    throw OpenMMException("MmvtStatusSegment: shared memory status segments are not supported on Windows");
+}
+
+void MmvtStatusSegment::attach(const string& name) {
+    throw OpenMMException("MmvtStatusSegment: shared memory status segments are not supported on Windows");
+}
+
+void MmvtStatusSegment::close() {
+}
+
+#else
+
+void MmvtStatusSegment::create(const string& name, const vector<int>& milestoneGroups) {
+    string fullName = getFullName(name);
+    if (milestoneGroups.size() > MAX_MILESTONE_GROUPS)
+        throw OpenMMException("MmvtStatusSegment: too many milestone groups");
+    close();
+    
+    // A segment left behind by a process that did not exit cleanly is
+    // replaced, rather than reused, so that readers still attached to it
+    // never see it change underneath them. A segment whose creator is still
+    // running belongs to another simulation, and is left alone.
+    
+    int fd = shm_open(fullName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0 && errno == EEXIST) {
+        MmvtStatusSegment existing;
+        existing.attach(fullName);
+        int processId = ((const StatusBlock*) existing.block)->data.processId;
+        existing.close();
+        if (processId <= 0 || kill(processId, 0) == 0 || errno != ESRCH)
+            throw OpenMMException("MmvtStatusSegment: "+fullName+" is in use by process "+to_string(processId));
+        shm_unlink(fullName.c_str());
+        fd = shm_open(fullName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    }
+    if (fd < 0)
+        throw OpenMMException("MmvtStatusSegment: could not create "+fullName+": "+strerror(errno));
+    if (ftruncate(fd, sizeof(StatusBlock)) != 0) {
+        string error = strerror(errno);
+        ::close(fd);
+        shm_unlink(fullName.c_str());
+        throw OpenMMException("MmvtStatusSegment: could not size "+fullName+": "+error);
+    }
+    void* memory = mmap(NULL, sizeof(StatusBlock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+        string error = strerror(errno);
+        shm_unlink(fullName.c_str());
+        throw OpenMMException("MmvtStatusSegment: could not map "+fullName+": "+error);
+    }
+    StatusBlock* status = new(memory) StatusBlock();
+    status->sequence.store(0);
+    memset(&status->data, 0, sizeof(StatusData));
+    memcpy(status->data.magic, STATUS_MAGIC, sizeof(STATUS_MAGIC));
+    status->data.version = STATUS_VERSION;
+    status->data.numMilestoneGroups = milestoneGroups.size();
+    status->data.processId = getpid();
+    for (int i = 0; i < milestoneGroups.size(); i++)
+        status->data.milestoneGroups[i] = milestoneGroups[i];
+    status->data.boundaryCheckInterval = 1;
+    atomic_thread_fence(memory_order_release);
+    block = memory;
+    this->name = fullName;
+    owner = true;
+}
+
+void MmvtStatusSegment::attach(const string& name) {
+    string fullName = getFullName(name);
+    close();
+    int fd = shm_open(fullName.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        throw OpenMMException("MmvtStatusSegment: could not open "+fullName+": "+strerror(errno));
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t) sizeof(StatusBlock)) {
+        ::close(fd);
+        throw OpenMMException("MmvtStatusSegment: "+fullName+" is not an MMVT status segment");
+    }
+    void* memory = mmap(NULL, sizeof(StatusBlock), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED)
+        throw OpenMMException("MmvtStatusSegment: could not map "+fullName+": "+strerror(errno));
+    const StatusData& data = ((const StatusBlock*) memory)->data;
+    if (memcmp(data.magic, STATUS_MAGIC, sizeof(STATUS_MAGIC)) != 0 || data.version != STATUS_VERSION) {
+        munmap(memory, sizeof(StatusBlock));
+        throw OpenMMException("MmvtStatusSegment: "+fullName+" is not an MMVT status segment");
+    }
+    block = memory;
+    this->name = fullName;
+    owner = false;
+}
+
+void MmvtStatusSegment::close() {
+    if (block == NULL)
+        return;
+    munmap(block, sizeof(StatusBlock));
+    if (owner)
+        shm_unlink(name.c_str());
+    block = NULL;
+    name.clear();
+    owner = false;
+}
+
+#endif
+
+void MmvtStatusSegment::publish(long long stepCount, double time, int bounceCounter, const vector<int>& N_alpha_beta,
+        const vector<vector<int> >& Nij_alpha, const vector<double>& Ri_alpha, double T_alpha, const MmvtPerformanceCounters& counters) {
+    if (!owner)
+        throw OpenMMException("MmvtStatusSegment: only the process that created a segment may update it");
+    StatusBlock* status = (StatusBlock*) block;
+    StatusData& data = status->data;
+    unsigned long long sequence = status->sequence.load(memory_order_relaxed);
+    status->sequence.store(sequence+1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    data.stepCount = stepCount;
+    data.time = time;
+    data.bounceCounter = bounceCounter;
+    data.T_alpha = T_alpha;
+    int numGroups = data.numMilestoneGroups;
+    for (int i = 0; i < numGroups; i++) {
+        data.N_alpha_beta[i] = N_alpha_beta[i];
+        data.Ri_alpha[i] = Ri_alpha[i];
+        for (int j = 0; j < numGroups; j++)
+            data.Nij_alpha[i][j] = Nij_alpha[i][j];
+    }
+    data.numSteps = counters.numSteps;
+    data.numBoundaryEvaluations = counters.numBoundaryEvaluations;
+    data.numSafeDistanceEvaluations = counters.numSafeDistanceEvaluations;
+    data.numSafeSteps = counters.numSafeSteps;
+    data.numRollbacks = counters.numRollbacks;
+    data.numDiscardedSteps = counters.numDiscardedSteps;
+    data.boundaryCheckInterval = counters.boundaryCheckInterval;
+    status->sequence.store(sequence+2, memory_order_release);
+}
+
+void MmvtStatusSegment::read(MmvtStatus& status) const {
+    if (block == NULL)
+        throw OpenMMException("MmvtStatusSegment: no segment is open");
+    const StatusBlock* source = (const StatusBlock*) block;
+    
+    // Copy the block until no update overlapped the copy. An update only
+    // takes a few microseconds, so a sequence that stays odd means the
+    // process died while updating it.
+    
+    StatusData data;
+    unsigned long long sequence;
+    for (int attempt = 0; ; attempt++) {
+        sequence = source->sequence.load(memory_order_acquire);
+        if (sequence%2 == 0) {
+            memcpy(&data, &source->data, sizeof(StatusData));
+            atomic_thread_fence(memory_order_acquire);
+            if (source->sequence.load(memory_order_relaxed) == sequence)
+                break;
+        }
+        if (attempt == 1000000)
+            throw OpenMMException("MmvtStatusSegment: "+name+" was left partly updated");
+#ifndef _WIN32
+        sched_yield();
+#endif
+    }
+    int numGroups = data.numMilestoneGroups;
+    status.processId = data.processId;
+    status.numUpdates = sequence/2;
+    status.stepCount = data.stepCount;
+    status.time = data.time;
+    status.bounceCounter = data.bounceCounter;
+    MmvtAnchorStatistics& statistics = status.statistics;
+    statistics.milestoneGroups.assign(data.milestoneGroups, data.milestoneGroups+numGroups);
+    statistics.N_alpha_beta.assign(data.N_alpha_beta, data.N_alpha_beta+numGroups);
+    statistics.Nij_alpha.resize(numGroups);
+    for (int i = 0; i < numGroups; i++)
+        statistics.Nij_alpha[i].assign(data.Nij_alpha[i], data.Nij_alpha[i]+numGroups);
+    statistics.Ri_alpha.assign(data.Ri_alpha, data.Ri_alpha+numGroups);
+    statistics.incubationTimeHistograms.clear();
+    statistics.T_alpha = data.T_alpha;
+    status.counters.numSteps = data.numSteps;
+    status.counters.numBoundaryEvaluations = data.numBoundaryEvaluations;
+    status.counters.numSafeDistanceEvaluations = data.numSafeDistanceEvaluations;
+    status.counters.numSafeSteps = data.numSafeSteps;
+    status.counters.numRollbacks = data.numRollbacks;
+    status.counters.numDiscardedSteps = data.numDiscardedSteps;
+    status.counters.boundaryCheckInterval = data.boundaryCheckInterval;
+}
@@ -0,0 +1,263 @@
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "internal/TraceEventRecorder.h"
+#include "openmm/OpenMMException.h"
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+    #include <process.h>
+#else
+    #include <unistd.h>
+#endif
+
+using namespace Seekr2Plugin;
+using namespace OpenMM;
+using namespace std;
+
+static int getProcessId() {
+#ifdef _WIN32
+    return _getpid();
+#else
+    return getpid();
+#endif
+}
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    const char* category;
+    long long start, end;
+};
+
+/**
+ * The events recorded by one thread. The thread is the only one to advance
+ * the head, and a flush, holding the lock of the session, is the only one to
+ * advance the tail.
+ */
+struct ThreadBuffer {
+    ThreadBuffer(int threadIndex, int capacity) : events(capacity), head(0), tail(0), threadIndex(threadIndex), named(false) {
+    }
+    vector<TraceEvent> events;
+    atomic<size_t> head, tail;
+    int threadIndex;
+    bool named;
+};
+
+/**
+ * The buffer the calling thread last recorded to, and the session it belongs
+ * to. Sessions are identified by number rather than address, since a new one
+ * may be allocated where an old one was.
+ */
+struct BufferCache {
+    unsigned long long sessionId;
+    ThreadBuffer* buffer;
+};
+
+thread_local BufferCache cache = {0, NULL};
+
+}
+
+namespace Seekr2Plugin {
+
+/**
+ * A trace file, and the buffers of the threads recording to it.
+ */
+class TraceSession {
+public:
+    static const size_t BUFFER_SIZE = 1<<16;
+    TraceSession(const string& fileName);
+    ~TraceSession();
+    ThreadBuffer& getBuffer();
+    void flush();
+    const unsigned long long id;
+    atomic<long long> droppedEvents;
+private:
+    void writeSeparator();
+    mutex lock;
+    ofstream file;
+    long long startTime;
+    int processId;
+    bool firstEvent;
+    long long reportedDrops;
+    vector<unique_ptr<ThreadBuffer> > buffers;
+    map<thread::id, ThreadBuffer*> threadBuffers;
+};
+
+}
+
+static atomic<unsigned long long> nextSessionId(1);
+
+TraceSession::TraceSession(const string& fileName) : id(nextSessionId++), droppedEvents(0), startTime(TraceEventRecorder::getTime()),
+        processId(getProcessId()), firstEvent(true), reportedDrops(0) {
+    file.open(fileName.c_str(), ios::out | ios::trunc);
+    if (!file)
+        throw OpenMMException("TraceEventRecorder: could not open "+fileName);
+    
+    // The closing bracket of the array is optional in the trace-event
+    // format, so the file can still be read if the process dies.
+    
+    file << "[\n";
+    writeSeparator();
+    file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << processId << ",\"tid\":0,\"args\":{\"name\":\"seekr2 " << processId << "\"}}";
+}
+
+TraceSession::~TraceSession() {
+    flush();
+    file << "\n]\n";
+    file.close();
+}
+
+void TraceSession::writeSeparator() {
+    if (!firstEvent)
+        file << ",\n";
+    firstEvent = false;
+}
+
+ThreadBuffer& TraceSession::getBuffer() {
+    lock_guard<mutex> guard(lock);
+    thread::id thread = this_thread::get_id();
+    map<thread::id, ThreadBuffer*>::iterator existing = threadBuffers.find(thread);
+    if (existing != threadBuffers.end())
+        return *existing->second;
+    buffers.push_back(unique_ptr<ThreadBuffer>(new ThreadBuffer(buffers.size()+1, BUFFER_SIZE)));
+    threadBuffers[thread] = buffers.back().get();
+    return *buffers.back();
+}
+
+void TraceSession::flush() {
+    lock_guard<mutex> guard(lock);
+    char line[256];
+    for (int i = 0; i < buffers.size(); i++) {
+        ThreadBuffer& buffer = *buffers[i];
+        size_t head = buffer.head.load(memory_order_acquire);
+        size_t tail = buffer.tail.load(memory_order_relaxed);
+        if (head == tail)
+            continue;
+        if (!buffer.named) {
+            writeSeparator();
+            file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << processId << ",\"tid\":" << buffer.threadIndex
+                 << ",\"args\":{\"name\":\"thread " << buffer.threadIndex << "\"}}";
+            buffer.named = true;
+        }
+        for (size_t j = tail; j != head; j++) {
+            const TraceEvent& event = buffer.events[j%BUFFER_SIZE];
+            snprintf(line, sizeof(line), "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}",
+                    event.name, event.category, 1e-3*(event.start-startTime), 1e-3*(event.end-event.start), processId, buffer.threadIndex);
+            writeSeparator();
+            file << line;
+        }
+        buffer.tail.store(head, memory_order_release);
+    }
+    
+    // Dropped events are shown as a counter track.
+    
+    long long dropped = droppedEvents.load();
+    if (dropped != reportedDrops) {
+        writeSeparator();
+        snprintf(line, sizeof(line), "{\"name\":\"dropped events\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":%d,\"tid\":0,\"args\":{\"count\":%lld}}",
+                1e-3*(TraceEventRecorder::getTime()-startTime), processId, dropped);
+        file << line;
+        reportedDrops = dropped;
+    }
+    file.flush();
+}
+
+TraceEventRecorder::TraceEventRecorder() : session(NULL), category("") {
+}
+
+TraceEventRecorder::~TraceEventRecorder() {
+    if (session != NULL)
+        flush();
+}
+
+void TraceEventRecorder::initialize(const string& fileName, const char* category) {
+    if (session != NULL)
+        flush();
+    sessionHandle.reset();
+    session = NULL;
+    this->category = category;
+    if (fileName.empty())
+        return;
+    
+    // Recorders given the same file name share a session, which is closed
+    // when the last of them is destroyed.
+    
+    static mutex registryLock;
+    static map<string, weak_ptr<TraceSession> > sessions;
+    lock_guard<mutex> guard(registryLock);
+    sessionHandle = sessions[fileName].lock();
+    if (!sessionHandle) {
+        sessionHandle = make_shared<TraceSession>(fileName);
+        sessions[fileName] = sessionHandle;
+    }
+    session = sessionHandle.get();
+}
+
+void TraceEventRecorder::record(const char* name, long long start, long long end) {
+    if (cache.sessionId != session->id) {
+        cache.buffer = &session->getBuffer();
+        cache.sessionId = session->id;
+    }
+    ThreadBuffer& buffer = *cache.buffer;
+    size_t head = buffer.head.load(memory_order_relaxed);
+    size_t tail = buffer.tail.load(memory_order_acquire);
+    if (head-tail >= TraceSession::BUFFER_SIZE) {
+        session->droppedEvents++;
+        return;
+    }
+    TraceEvent& event = buffer.events[head%TraceSession::BUFFER_SIZE];
+    event.name = name;
+    event.category = category;
+    event.start = start;
+    event.end = end;
+    buffer.head.store(head+1, memory_order_release);
+    if (head+1-tail >= TraceSession::BUFFER_SIZE/2)
+        session->flush();
+}
+
+void TraceEventRecorder::flush() {
+    if (session != NULL)
+        session->flush();
+}
+
+long long TraceEventRecorder::getNumDroppedEvents() const {
+    return (session == NULL ? 0 : session->droppedEvents.load());
+}
@@ -0,0 +1,1015 @@
+/*
+   Copyright 2019 by Lane Votapka
+   All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2014 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "CommonSeekr2Kernels.h"
+#include "CommonSeekr2KernelSources.h"
+#include "openmm/common/IntegrationUtilities.h"
+#include "openmm/internal/ContextImpl.h"
+#include "openmm/OpenMMException.h"
+#include "openmm/reference/SimTKOpenMMRealType.h"
+#include <cmath>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+using namespace Seekr2Plugin;
+using namespace OpenMM;
+using namespace std;
+
+CommonIntegrateMmvtLangevinMiddleStepKernel::CommonIntegrateMmvtLangevinMiddleStepKernel(
+                                    std::string name, 
+                                    const OpenMM::Platform& platform, 
+                                    OpenMM::ComputeContext& cc) : 
+                                    IntegrateMmvtLangevinMiddleStepKernel(name, 
+                                    platform), cc(cc) {
+    crossingSnapshotQueue = nullptr;
+}
+
+void CommonIntegrateMmvtLangevinMiddleStepKernel::allocateMemory(const MmvtLangevinMiddleIntegrator& integrator) {
+    int numAtoms = cc.getNumAtoms();
+    int paddedNumAtoms = cc.getPaddedNumAtoms();
+    
+    // The old positions and velocities hold one slot for the start of each
+    // step between boundary checks, plus one for the end of the last step.
+    
+    int numSlots = integrator.getBoundaryCheckInterval()+1;
+    int realSize = (cc.getUseDoublePrecision() ? sizeof(mm_double4) : sizeof(mm_float4));
+    int mixedSize = (cc.getUseDoublePrecision() || cc.getUseMixedPrecision() ? sizeof(mm_double4) : sizeof(mm_float4));
+    oldPosq.initialize(cc, numAtoms*numSlots, realSize, "oldPosq");
+    if (cc.getUseMixedPrecision())
+        oldPosqCorrection.initialize(cc, numAtoms*numSlots, realSize, "oldPosqCorrection");
+    oldVelm.initialize(cc, numAtoms*numSlots, mixedSize, "oldVelm");
+    oldDelta.initialize(cc, paddedNumAtoms, mixedSize, "oldDelta");
+}
+
+void CommonIntegrateMmvtLangevinMiddleStepKernel::initialize(const System& system, const MmvtLangevinMiddleIntegrator& integrator) {
+    bool output_file_already_exists;
+    cc.initializeContexts();
+    cc.setAsCurrent();
+    allocateMemory(integrator);
+    IntegrationUtilities& integration = cc.getIntegrationUtilities();
+    integration.initRandomNumberGenerator(integrator.getRandomNumberSeed());
+    if (cc.getUseDoublePrecision() || cc.getUseMixedPrecision())
+        params.initialize<double>(cc, 2, "mmvtLangevinMiddleParams");
+    else
+        params.initialize<float>(cc, 2, "mmvtLangevinMiddleParams");
+    safeStepDistanceGroup = integrator.getSafeStepDistanceGroup();
+    if (safeStepDistanceGroup >= 0)
+        maxDisplacement.initialize<float>(cc, 1, "maxDisplacement");
+    
+    // Create the kernels. The arguments that change from step to step, the
+    // ring buffer slots and the random number index, are set before each
+    // launch.
+    
+    int numAtoms = cc.getNumAtoms();
+    int paddedNumAtoms = cc.getPaddedNumAtoms();
+    map<string, string> defines;
+    ComputeProgram program = cc.compileProgram(CommonSeekr2KernelSources::langevinMiddle, defines);
+    kernel1 = program->createKernel("integrateMmvtLangevinMiddlePart1");
+    kernel1->addArg(numAtoms);
+    kernel1->addArg(paddedNumAtoms);
+    kernel1->addArg(cc.getVelm());
+    kernel1->addArg(cc.getLongForceBuffer());
+    kernel1->addArg(integration.getStepSize());
+    kernel2 = program->createKernel("integrateMmvtLangevinMiddlePart2");
+    kernel2->addArg(numAtoms);
+    kernel2->addArg(cc.getVelm());
+    kernel2->addArg(integration.getPosDelta());
+    kernel2->addArg(oldDelta);
+    kernel2->addArg(params);
+    kernel2->addArg(integration.getStepSize());
+    kernel2->addArg(oldVelm);
+    kernel2->addArg(); // slot
+    kernel2->addArg(integration.getRandom());
+    kernel2->addArg(); // random index
+    kernel3 = program->createKernel("integrateMmvtLangevinMiddlePart3");
+    kernel3->addArg(numAtoms);
+    kernel3->addArg(cc.getPosq());
+    kernel3->addArg(cc.getVelm());
+    kernel3->addArg(integration.getPosDelta());
+    kernel3->addArg(oldDelta);
+    kernel3->addArg(integration.getStepSize());
+    kernel3->addArg(oldPosq);
+    kernel3->addArg(); // slot
+    if (cc.getUseMixedPrecision())
+        kernel3->addArg(cc.getPosqCorrection());
+    kernelBounce = program->createKernel("mmvtBounce");
+    kernelBounce->addArg(numAtoms);
+    kernelBounce->addArg(paddedNumAtoms);
+    kernelBounce->addArg(cc.getPosq());
+    kernelBounce->addArg(cc.getVelm());
+    kernelBounce->addArg(oldPosq);
+    kernelBounce->addArg(oldVelm);
+    kernelBounce->addArg(); // slot
+    kernelKick = program->createKernel("mmvtKickVelocities");
+    kernelKick->addArg(numAtoms);
+    kernelKick->addArg(paddedNumAtoms);
+    kernelKick->addArg(cc.getVelm());
+    kernelKick->addArg(cc.getLongForceBuffer());
+    kernelKick->addArg(); // dt
+    kernelCopyPositions = program->createKernel("mmvtCopyPositions");
+    kernelCopyVelocities = program->createKernel("mmvtCopyVelocities");
+    for (int i = 0; i < 5; i++) {
+        kernelCopyPositions->addArg();
+        kernelCopyVelocities->addArg();
+    }
+    if (safeStepDistanceGroup >= 0) {
+        kernelMaxDisplacement = program->createKernel("mmvtMaxDisplacement");
+        kernelMaxDisplacement->addArg(numAtoms);
+        kernelMaxDisplacement->addArg(cc.getPosq());
+        kernelMaxDisplacement->addArg(oldPosq);
+        kernelMaxDisplacement->addArg(); // firstSlot
+        kernelMaxDisplacement->addArg(); // numSlots
+        kernelMaxDisplacement->addArg(maxDisplacement);
+    }
+    prevStepSize = -1.0;
+    
+    N_alpha_beta = vector<int> (integrator.getNumMilestoneGroups());
+    for (int i=0; i<integrator.getNumMilestoneGroups(); i++) {
+        N_alpha_beta[i] = 0;
+    }
+    Nij_alpha = vector<vector <int> > (integrator.getNumMilestoneGroups());
+    for (int i=0; i<integrator.getNumMilestoneGroups(); i++) {
+        Nij_alpha[i] = vector<int>(integrator.getNumMilestoneGroups());
+        for (int j=0; j<integrator.getNumMilestoneGroups(); j++) {
+            Nij_alpha[i][j] = 0;
+        }
+    }
+    Ri_alpha = vector<double> (integrator.getNumMilestoneGroups());
+    for (int i=0; i<integrator.getNumMilestoneGroups(); i++) {
+        Ri_alpha[i] = 0.0;
+    }
+    incubationTimeHistograms.assign(integrator.getNumMilestoneGroups(), vector<LogBinnedHistogram>(integrator.getNumMilestoneGroups()));
+    T_alpha = 0.0;
+    //New parameters for running integrator
+    outputFileName = integrator.getOutputFileName();
+    saveStateFileName = integrator.getSaveStateFileName();
+    if (saveStateFileName.empty()) {
+        saveStateBool = false;
+    } else {
+        saveStateBool = true;
+    }
+    saveStatisticsFileName = integrator.getSaveStatisticsFileName();
+    if (saveStatisticsFileName.empty()) {
+        saveStatisticsBool = false;
+    } else {
+        saveStatisticsBool = true;
+    }
+    for (int i=0; i<integrator.getNumMilestoneGroups(); i++) {
+        milestoneGroups.push_back(integrator.getMilestoneGroup(i));
+    }
+    saveStateBeforeCrossing = integrator.getSaveStateBeforeCrossing();
+    saveFirstHitsOnly = integrator.getSaveFirstHitsOnly();
+    crossingSnapshotQueue = integrator.getCrossingSnapshotQueue();
+    crossingState.initialize(system.getNumParticles(), integrator.getSaveStateAtomSelection(), integrator.getFullSaveStateInterval(),
+            integrator.getSaveStateEncoder());
+    reservoir.initialize(integrator.getNumMilestoneGroups(), integrator.getSaveStateReservoirSize(),
+            integrator.getSaveStateReservoirSpacing(), integrator.getRandomNumberSeed());
+    trajectory.initialize(integrator.getTrajectoryFileName(), system.getNumParticles(), system.usesPeriodicBoundaryConditions(),
+            integrator.getInnerStepSize(), integrator.getTrajectoryInterval(), integrator.getTrajectoryFramesBeforeCrossing(),
+            integrator.getTrajectoryFramesAfterCrossing(), integrator.getBoundaryCheckInterval());
+    boundaryCheckInterval = integrator.getBoundaryCheckInterval();
+    frameTimes.resize(boundaryCheckInterval);
+    frameIncubationTimes.resize(boundaryCheckInterval);
+    frameStepCounts.resize(boundaryCheckInterval);
+    numFrames = 0;
+    safeDistance = 0.0;
+    safeDisplacement = 0.0;
+    scheduler.initialize(boundaryCheckInterval, integrator.getAdaptiveBoundaryChecks());
+    if (!integrator.getStatusSegmentName().empty())
+        status.create(integrator.getStatusSegmentName(), milestoneGroups);
+    tracer.initialize(integrator.getTraceFileName(), "mmvt");
+    bounceCounter = integrator.getBounceCounter();
+    incubationTime = 0.0;
+    firstCrossingTime = 0.0;
+    previousMilestoneCrossed = -1;
+    assert(cc.getStepCount() == 0);
+    assert(cc.getTime() == 0.0);
+    // see whether the file already exists
+    ifstream datafile;
+    datafile.open(outputFileName);
+    if (datafile) {
+        output_file_already_exists = true;
+    } else {
+        output_file_already_exists = false;
+    }
+    datafile.close();
+    if (output_file_already_exists == false) {
+        ofstream datafile; // open datafile for writing
+        datafile.open(outputFileName, std::ios_base::app); // write new file
+        datafile << "#\"Bounced boundary ID\",\"bounce index\",\"total time (ps)\"\n";
+        datafile.close(); // close data file
+    }
+}
+
+void CommonIntegrateMmvtLangevinMiddleStepKernel::execute(ContextImpl& context, const MmvtLangevinMiddleIntegrator& integrator) {
+    cc.setAsCurrent();
+    IntegrationUtilities& integration = cc.getIntegrationUtilities();
+    int numAtoms = cc.getNumAtoms();
+    double temperature = integrator.getTemperature();
+    double friction = integrator.getFriction();
+    double stepSize = integrator.getInnerStepSize();
+    float value = 0.0;
+    bool includeForces = false;
+    bool includeEnergy = true;
+    
+    integration.setNextStepSize(stepSize);
+    if (temperature != prevTemp || friction != prevFriction || stepSize != prevStepSize) {
+        // Calculate the integration parameters.
+
+        double kT = BOLTZ*temperature;
+        double vscale = exp(-stepSize*friction);
+        double noisescale = sqrt(kT*(1-vscale*vscale));
+        vector<double> p(params.getSize());
+        p[0] = vscale;
+        p[1] = noisescale;
+        params.upload(p, true);
+        prevTemp = temperature;
+        prevFriction = friction;
+        prevStepSize = stepSize;
+    }
+    
+    if (cc.getStepCount() <= 0) {
+        value = context.calcForcesAndEnergy(includeForces, includeEnergy, 2);
+        if (value > 0.0) { // take a step back and reverse velocities
+            throw OpenMMException("MMVT simulation bouncing on first step: the system will be trapped behind a boundary. Check and revise MMVT boundary definitions and/or atomic positions.");
+        }
+    }
+    
+    // The start of this step is saved in the next slot of the old positions
+    // and velocities, so that the simulation can be rolled back to it if the
+    // step turns out to cross a boundary.
+    
+    int slot = numFrames;
+    frameTimes[numFrames] = cc.getTime();
+    frameStepCounts[numFrames] = cc.getStepCount();
+    frameIncubationTimes[numFrames] = incubationTime;
+    if (cc.getUseMixedPrecision())
+        copyPositions(cc.getPosqCorrection(), 0, oldPosqCorrection, numFrames);
+    numFrames++;
+    {
+        TraceEventRecorder::Scope scope(tracer, "dynamics");
+        
+        // Call the first integration kernel.
+        
+        kernel1->execute(numAtoms, 128);
+        
+        // Apply velocity constraints.
+
+        integration.applyVelocityConstraints(integrator.getConstraintTolerance());
+        
+        // Call the second integration kernel.
+
+        kernel2->setArg(7, slot);
+        kernel2->setArg(9, integration.prepareRandomNumbers(cc.getPaddedNumAtoms()));
+        kernel2->execute(numAtoms, 128);
+        
+        // Apply constraints.
+
+        integration.applyConstraints(integrator.getConstraintTolerance());
+
+        // Call the third integration kernel.
+
+        kernel3->setArg(7, slot);
+        kernel3->execute(numAtoms, 128);
+        integration.computeVirtualSites();
+    }
+    
+    // Update the time and step count, and monitor for one or more milestone
+    // crossings once enough steps have been taken.
+    
+    cc.setTime(cc.getTime()+stepSize);
+    cc.setStepCount(cc.getStepCount()+1);
+    incubationTime += stepSize;
+    if (trajectory.isFrameStep(cc.getStepCount()))
+        trajectory.recordFrame(context);
+    
+    // No boundary can have been crossed while the atoms have moved less than
+    // the safe distance since it was last evaluated. The displacement is
+    // padded to allow for the rounding of single precision positions.
+    
+    bool safe = false;
+    if (safeStepDistanceGroup >= 0) {
+        double displacement = findMaxDisplacement(slot, 1);
+        scheduler.stepTaken(displacement);
+        safeDisplacement += displacement;
+        if (safeDisplacement < safeDistance) {
+            scheduler.stepSafe();
+            numFrames = 0;
+            safe = true;
+        }
+    }
+    else
+        scheduler.stepTaken(-1.0);
+    if (!safe && numFrames >= scheduler.getInterval())
+        checkBoundaries(context, integrator);
+    
+    // Atoms may only be reordered, and frames written to the trajectory, once
+    // the saved steps have been checked.
+    
+    if (numFrames == 0) {
+        trajectory.stepsChecked(cc.getStepCount());
+        cc.reorderAtoms();
+    }
+    publishStatus();
+}
+
+double CommonIntegrateMmvtLangevinMiddleStepKernel::findMaxDisplacement(int firstSlot, int numSlots) {
+    kernelMaxDisplacement->setArg(3, firstSlot);
+    kernelMaxDisplacement->setArg(4, numSlots);
+    kernelMaxDisplacement->execute(128, 128);
+    float maxDisplacement2;
+    maxDisplacement.download(&maxDisplacement2, true);
+    return sqrt((double) maxDisplacement2)+1e-5;
+}
+
+void CommonIntegrateMmvtLangevinMiddleStepKernel::copyPositions(ArrayInterface& source, int sourceSlot, ArrayInterface& dest, int destSlot) {
+    kernelCopyPositions->setArg(0, cc.getNumAtoms());
+    kernelCopyPositions->setArg(1, source);
+    kernelCopyPositions->setArg(2, sourceSlot);
+    kernelCopyPositions->setArg(3, dest);
+    kernelCopyPositions->setArg(4, destSlot);
+    kernelCopyPositions->execute(cc.getNumAtoms(), 128);
+}
+
+void CommonIntegrateMmvtLangevinMiddleStepKernel::copyVelocities(ArrayInterface& source, int sourceSlot, ArrayInterface& dest, int destSlot) {
+    kernelCopyVelocities->setArg(0, cc.getNumAtoms());
+    kernelCopyVelocities->setArg(1, source);
+    kernelCopyVelocities->setArg(2, sourceSlot);
+    kernelCopyVelocities->setArg(3, dest);
+    kernelCopyVelocities->setArg(4, destSlot);
+    kernelCopyVelocities->execute(cc.getNumAtoms(), 128);
+}
+
+void CommonIntegrateMmvtLangevinMiddleStepKernel::checkPendingBoundaries(ContextImpl& context, const MmvtLangevinMiddleIntegrator& integrator) {
+    cc.setAsCurrent();
+    checkBoundaries(context, integrator);
+    trajectory.stepsChecked(cc.getStepCount());
+    
+    // The positions may be changed before the next step, so the safe
+    // distance must be evaluated again.
+    
+    safeDistance = 0.0;
+    publishStatus();
+}
+
+void CommonIntegrateMmvtLangevinMiddleStepKernel::checkBoundaries(ContextImpl& context, const MmvtLangevinMiddleIntegrator& integrator) {
+    if (numFrames == 0)
+        return;
+    int numAtoms = cc.getNumAtoms();
+    
+    // The safe distance only covers the current positions. The positions at
+    // the end of each earlier step in the interval are also in bounds if
+    // every atom is closer to them than the safe distance. Otherwise one of
+    // them may have crossed a boundary even though the current positions are
+    // back in bounds, so every saved step is checked.
+    
+    bool checkEveryStep = false;
+    if (safeStepDistanceGroup >= 0) {
+        {
+            TraceEventRecorder::Scope scope(tracer, "safe distance evaluation");
+            safeDistance = context.calcForcesAndEnergy(false, true, 1<<safeStepDistanceGroup);
+        }
+        safeDisplacement = 0.0;
+        scheduler.safeDistanceEvaluated(safeDistance);
+        if (safeDistance > 0.0 && (numFrames == 1 || findMaxDisplacement(1, numFrames-1) < safeDistance)) {
+            scheduler.checkPassed();
+            numFrames = 0;
+            return;
+        }
+        checkEveryStep = true;
+    }
+    float value = 0.0f;
+    int crossingStep = -1;
+    if (!checkEveryStep) {
+        {
+            TraceEventRecorder::Scope scope(tracer, "boundary evaluation");
+            value = context.calcForcesAndEnergy(false, true, 2);
+        }
+        scheduler.boundariesEvaluated();
+        if (value <= 0.0) {
+            scheduler.checkPassed();
+            numFrames = 0;
+            return;
+        }
+        crossingStep = numFrames-1;
+    }
+    
+    // Find the first step that crossed a boundary. The positions at the end
+    // of each step are the ones saved at the start of the next, so the saved
+    // positions are checked in order until one is out of bounds.
+    
+    bool mixed = cc.getUseMixedPrecision();
+    if (numFrames > 1) {
+        TraceEventRecorder::Scope scope(tracer, "boundary evaluation");
+        copyPositions(cc.getPosq(), 0, oldPosq, numFrames);
+        copyVelocities(cc.getVelm(), 0, oldVelm, numFrames);
+        if (mixed)
+            copyPositions(cc.getPosqCorrection(), 0, oldPosqCorrection, numFrames);
+        for (int i = 1; i < numFrames; i++) {
+            copyPositions(oldPosq, i, cc.getPosq(), 0);
+            if (mixed)
+                copyPositions(oldPosqCorrection, i, cc.getPosqCorrection(), 0);
+            float frameValue = context.calcForcesAndEnergy(false, true, 2);
+            scheduler.boundariesEvaluated();
+            if (frameValue > 0.0) {
+                crossingStep = i-1;
+                value = frameValue;
+                break;
+            }
+        }
+        if (crossingStep == -1 || crossingStep == numFrames-1) {
+            copyPositions(oldPosq, numFrames, cc.getPosq(), 0);
+            if (mixed)
+                copyPositions(oldPosqCorrection, numFrames, cc.getPosqCorrection(), 0);
+        }
+    }
+    if (crossingStep == -1) {
+        // No earlier step crossed a boundary, so only the last one can have.
+        
+        {
+            TraceEventRecorder::Scope scope(tracer, "boundary evaluation");
+            value = context.calcForcesAndEnergy(false, true, 2);
+        }
+        scheduler.boundariesEvaluated();
+        if (value <= 0.0) {
+            scheduler.checkPassed();
+            numFrames = 0;
+            return;
+        }
+        crossingStep = numFrames-1;
+    }
+    if (crossingStep < numFrames-1) {
+        // Only the velocities at the start of each step are saved, so these
+        // are the ones recorded with the crossing.
+        
+        copyVelocities(oldVelm, crossingStep+1, cc.getVelm(), 0);
+    }
+    
+    // Record the bounce as of the crossing step, then take a step back and
+    // reverse the velocities.
+    
+    cc.setTime(frameTimes[crossingStep]);
+    cc.setStepCount(frameStepCounts[crossingStep]);
+    incubationTime = frameIncubationTimes[crossingStep];
+    scheduler.rolledBack(numFrames-1-crossingStep, frameStepCounts[crossingStep]);
+    
+    // When the configuration before the crossing is saved, it is captured
+    // once the bounce has restored it.
+    
+    if (!saveStateBeforeCrossing)
+        recordBounce(context, integrator, value);
+    {
+        TraceEventRecorder::Scope scope(tracer, "bounce restore");
+        kernelBounce->setArg(6, crossingStep);
+        kernelBounce->execute(numAtoms, 128);
+        if (cc.getUseMixedPrecision())
+            copyPositions(oldPosqCorrection, crossingStep, cc.getPosqCorrection(), 0);
+    }
+    if (saveStateBeforeCrossing)
+        recordBounce(context, integrator, value);
+    cc.setTime(cc.getTime()+integrator.getInnerStepSize());
+    cc.setStepCount(cc.getStepCount()+1);
+    incubationTime += integrator.getInnerStepSize();
+    numFrames = 0;
+    safeDistance = 0.0;
+}
+
+void CommonIntegrateMmvtLangevinMiddleStepKernel::recordBounce(ContextImpl& context, const MmvtLangevinMiddleIntegrator& integrator, float value) {
+    int bitcode;
+    int num_bounced_surfaces = 0;
+    // Write to output file
+    ofstream datafile; // open datafile for writing
+    datafile.open(outputFileName, std::ios_base::app); // append to file
+    datafile.setf(std::ios::fixed,std::ios::floatfield);
+    datafile.precision(3);
+    bitcode = static_cast<int>(value);
+    // check for corner bounce so as not to save state
+    for (int i=0; i<milestoneGroups.size(); i++) {
+        if ((bitcode % 2) != 0) {
+            // count the number of bounced surfaces
+            num_bounced_surfaces++;
+        }
+        bitcode = bitcode >> 1;
+    }
+    bitcode = static_cast<int>(value);
+    for (int i=0; i<integrator.getNumMilestoneGroups(); i++) {
+        if ((bitcode % 2) == 0) {
+            // if value is not showing this as crossed, continue
+            bitcode = bitcode >> 1;
+            continue;
+        }
+        bitcode = bitcode >> 1;
+        
+        datafile << milestoneGroups[i] << "," << bounceCounter << "," << context.getTime() << "\n";
+        if (trajectory.isEnabled()) {
+            TraceEventRecorder::Scope scope(tracer, "trajectory write");
+            stringstream event_str;
+            event_str << "_" << bounceCounter << "_" << milestoneGroups[i];
+            trajectory.trigger(context, event_str.str());
+        }
+        // A bounce only samples the first hitting point distribution if the
+        // previous one was against a different boundary.
+        
+        bool firstHit = (previousMilestoneCrossed != -1 && previousMilestoneCrossed != i);
+        bool keepState = (num_bounced_surfaces == 1 && (firstHit || !saveFirstHitsOnly));
+        bool publishSnapshot = (crossingSnapshotQueue != NULL && keepState 
+                && crossingSnapshotQueue->acceptsMilestoneGroup(milestoneGroups[i]));
+        bool saveState = (saveStateBool == true && keepState);
+        int reservoirSlot = -1;
+        if (saveState && reservoir.isEnabled()) {
+            reservoirSlot = reservoir.offer(i, context.getStepCount());
+            saveState = (reservoirSlot >= 0);
+        }
+        if (saveState || publishSnapshot == true) {
+            TraceEventRecorder::Scope scope(tracer, "state serialization");
+            crossingState.capture(context);
+            if (saveStateBeforeCrossing)
+                crossingState.reverseVelocities();
+            if (publishSnapshot == true) {
+                CrossingSnapshot snapshot;
+                snapshot.milestoneGroup = milestoneGroups[i];
+                snapshot.bounceIndex = bounceCounter;
+                crossingState.copyTo(snapshot);
+                crossingSnapshotQueue->publish(snapshot);
+            }
+            if (saveState) {
+                stringstream number_str;
+                if (reservoirSlot >= 0)
+                    number_str << "_reservoir_" << milestoneGroups[i] << "_" << reservoirSlot;
+                else
+                    number_str << "_" << bounceCounter << "_" << milestoneGroups[i];
+                crossingState.write(saveStateFileName + number_str.str());
+            }
+        }
+        if (previousMilestoneCrossed != -1) {
+            N_alpha_beta[i] += 1;
+        }
+        if (previousMilestoneCrossed != i) {
+            if (previousMilestoneCrossed != -1) { // if this isn't the first time a bounce has occurred
+                Nij_alpha[previousMilestoneCrossed][i] += 1; 
+                Ri_alpha[previousMilestoneCrossed] += incubationTime;
+                incubationTimeHistograms[previousMilestoneCrossed][i].addValue(incubationTime);
+            } else {
+                firstCrossingTime = cc.getTime();
+            }
+            incubationTime = 0.0;
+        }
+        T_alpha = cc.getTime() - firstCrossingTime;
+        
+        previousMilestoneCrossed = i;
+        bounceCounter++;
+    }
+    TraceEventRecorder::Scope scope(tracer, "event write");
+    datafile.close(); // close data file
+    if (saveStatisticsBool == true) {
+        //throw OpenMMException("Statistics file feature not working: saveStatisticsBool must be set to 'false' at this time");
+        /* // TODO: remove
+        // This feature is temporarily disabled. With the improvement
+        // of moving all boundary definitions to a single force group,
+        // this feature is now broken. Since it is not actively used
+        // yet, we will postpone its functionality. To get this 
+        // working, this plugin would need to be provided with an
+        // array of milestone indices, similar to the function that
+        // milestoneGroups used to have (but now, milestoneGroups
+        // will merely be an array of size 1).
+        */
+        ofstream stats;
+        stats.open(saveStatisticsFileName, ios_base::trunc);
+        stats.setf(std::ios::fixed,std::ios::floatfield);
+        stats.precision(3);
+        for (int i = 0; i < N_alpha_beta.size(); i++) {
+            stats << "N_alpha_" << milestoneGroups[i] << ": " << N_alpha_beta[i] << "\n";
+        }
+        int nij_index = 0;
+        for (int i = 0; i < integrator.getNumMilestoneGroups(); i++) {
+            for (int j = 0; j < integrator.getNumMilestoneGroups(); j++) {
+                stats << "N_" << milestoneGroups[i] << "_" << milestoneGroups[j] << "_alpha: " << Nij_alpha[i][j] << "\n"; 
+                nij_index += 1;
+            }
+        }
+        for (int i = 0; i < integrator.getNumMilestoneGroups(); i++) {
+            stats << "R_" << milestoneGroups[i] << "_alpha: " << Ri_alpha[i] << "\n";       
+        }
+        for (int i = 0; i < integrator.getNumMilestoneGroups(); i++) {
+            for (int j = 0; j < integrator.getNumMilestoneGroups(); j++) {
+                if (Nij_alpha[i][j] > 0)
+                    stats << "H_" << milestoneGroups[i] << "_" << milestoneGroups[j] << "_alpha: " << incubationTimeHistograms[i][j].toString() << "\n";
+            }
+        }
+        stats << "T_alpha: " << T_alpha << "\n";  
+        stats.close();
+        
+    }
+}
+
+double CommonIntegrateMmvtLangevinMiddleStepKernel::computeKineticEnergy(ContextImpl& context, const MmvtLangevinMiddleIntegrator& integrator) {
+    // With multiple time steps, the velocities at the end of a step are not
+    // offset by half a step, so they are used as they are.
+    
+    bool multipleTimeSteps = (integrator.getNumInnerSteps() > 1 || integrator.getSlowForceGroups() != 0);
+    return cc.getIntegrationUtilities().computeKineticEnergy(multipleTimeSteps ? 0.0 : 0.5*integrator.getStepSize());
+}
+
+void CommonIntegrateMmvtLangevinMiddleStepKernel::kickVelocities(ContextImpl& context, const MmvtLangevinMiddleIntegrator& integrator, double dt) {
+    cc.setAsCurrent();
+    if (cc.getUseDoublePrecision() || cc.getUseMixedPrecision())
+        kernelKick->setArg(4, dt);
+    else
+        kernelKick->setArg(4, (float) dt);
+    kernelKick->execute(cc.getNumAtoms(), 128);
+    cc.getIntegrationUtilities().applyVelocityConstraints(integrator.getConstraintTolerance());
+}
+
+void CommonIntegrateMmvtLangevinMiddleStepKernel::publishStatus() {
+    if (status.isOpen())
+        status.publish(cc.getStepCount(), cc.getTime(), bounceCounter, N_alpha_beta, Nij_alpha, Ri_alpha, T_alpha, scheduler.getCounters());
+}
+
+void CommonIntegrateMmvtLangevinMiddleStepKernel::getStatistics(ContextImpl& context, MmvtAnchorStatistics& statistics) {
+    statistics.milestoneGroups = milestoneGroups;
+    statistics.N_alpha_beta = N_alpha_beta;
+    statistics.Nij_alpha = Nij_alpha;
+    statistics.Ri_alpha = Ri_alpha;
+    statistics.incubationTimeHistograms = incubationTimeHistograms;
+    statistics.T_alpha = T_alpha;
+}
+
+void CommonIntegrateMmvtLangevinMiddleStepKernel::getPerformanceCounters(ContextImpl& context, MmvtPerformanceCounters& counters) {
+    counters = scheduler.getCounters();
+}
+
+void CommonIntegrateMmvtLangevinMiddleStepKernel::flushTrace(ContextImpl& context) {
+    tracer.flush();
+}
+
+void CommonIntegrateMmvtLangevinMiddleStepKernel::createCheckpoint(ContextImpl& context, ostream& stream) const {
+    MmvtBounceCheckpoint checkpoint;
+    checkpoint.statistics.milestoneGroups = milestoneGroups;
+    checkpoint.statistics.N_alpha_beta = N_alpha_beta;
+    checkpoint.statistics.Nij_alpha = Nij_alpha;
+    checkpoint.statistics.Ri_alpha = Ri_alpha;
+    checkpoint.statistics.incubationTimeHistograms = incubationTimeHistograms;
+    checkpoint.statistics.T_alpha = T_alpha;
+    checkpoint.bounceCounter = bounceCounter;
+    checkpoint.previousMilestoneCrossed = previousMilestoneCrossed;
+    checkpoint.incubationTime = incubationTime;
+    checkpoint.firstCrossingTime = firstCrossingTime;
+    checkpoint.crossingLogSize = MmvtBounceCheckpoint::getCrossingLogSize(outputFileName);
+    checkpoint.write(stream);
+    reservoir.createCheckpoint(stream);
+}
+
+void CommonIntegrateMmvtLangevinMiddleStepKernel::loadCheckpoint(ContextImpl& context, istream& stream) {
+    MmvtBounceCheckpoint checkpoint;
+    checkpoint.read(stream);
+    checkpoint.checkMilestoneGroups(milestoneGroups);
+    reservoir.loadCheckpoint(stream);
+    checkpoint.restoreCrossingLog(outputFileName);
+    N_alpha_beta = checkpoint.statistics.N_alpha_beta;
+    Nij_alpha = checkpoint.statistics.Nij_alpha;
+    Ri_alpha = checkpoint.statistics.Ri_alpha;
+    if (!checkpoint.statistics.incubationTimeHistograms.empty())
+        incubationTimeHistograms = checkpoint.statistics.incubationTimeHistograms;
+    T_alpha = checkpoint.statistics.T_alpha;
+    bounceCounter = checkpoint.bounceCounter;
+    previousMilestoneCrossed = checkpoint.previousMilestoneCrossed;
+    incubationTime = checkpoint.incubationTime;
+    firstCrossingTime = checkpoint.firstCrossingTime;
+    
+    // The positions were replaced along with the State, so nothing is known
+    // about how far they are from the boundaries.
+    
+    numFrames = 0;
+    safeDistance = 0.0;
+    safeDisplacement = 0.0;
+    publishStatus();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+CommonIntegrateElberLangevinMiddleStepKernel::CommonIntegrateElberLangevinMiddleStepKernel(std::string name, 
+                                    const OpenMM::Platform& platform, 
+                                    OpenMM::ComputeContext& cc) : 
+                                    IntegrateElberLangevinMiddleStepKernel(name, 
+                                    platform), cc(cc) {
+    
+}
+
+void CommonIntegrateElberLangevinMiddleStepKernel::allocateMemory(const ElberLangevinMiddleIntegrator& integrator) {
+    int paddedNumAtoms = cc.getPaddedNumAtoms();
+    int mixedSize = (cc.getUseDoublePrecision() || cc.getUseMixedPrecision() ? sizeof(mm_double4) : sizeof(mm_float4));
+    oldDelta.initialize(cc, paddedNumAtoms, mixedSize, "oldDelta");
+}
+
+void CommonIntegrateElberLangevinMiddleStepKernel::initialize(const System& system, const ElberLangevinMiddleIntegrator& integrator) {
+    bool output_file_already_exists;
+    cc.initializeContexts();
+    cc.setAsCurrent();
+    allocateMemory(integrator);
+    IntegrationUtilities& integration = cc.getIntegrationUtilities();
+    integration.initRandomNumberGenerator(integrator.getRandomNumberSeed());
+    if (cc.getUseDoublePrecision() || cc.getUseMixedPrecision())
+        params.initialize<double>(cc, 2, "elberLangevinMiddleParams");
+    else
+        params.initialize<float>(cc, 2, "elberLangevinMiddleParams");
+    int numAtoms = cc.getNumAtoms();
+    int paddedNumAtoms = cc.getPaddedNumAtoms();
+    map<string, string> defines;
+    ComputeProgram program = cc.compileProgram(CommonSeekr2KernelSources::langevinMiddle, defines);
+    kernel1 = program->createKernel("integrateElberLangevinMiddlePart1");
+    kernel1->addArg(numAtoms);
+    kernel1->addArg(paddedNumAtoms);
+    kernel1->addArg(cc.getVelm());
+    kernel1->addArg(cc.getLongForceBuffer());
+    kernel1->addArg(integration.getStepSize());
+    kernel2 = program->createKernel("integrateElberLangevinMiddlePart2");
+    kernel2->addArg(numAtoms);
+    kernel2->addArg(cc.getVelm());
+    kernel2->addArg(integration.getPosDelta());
+    kernel2->addArg(oldDelta);
+    kernel2->addArg(params);
+    kernel2->addArg(integration.getStepSize());
+    kernel2->addArg(integration.getRandom());
+    kernel2->addArg(); // random index
+    kernel3 = program->createKernel("integrateElberLangevinMiddlePart3");
+    kernel3->addArg(numAtoms);
+    kernel3->addArg(cc.getPosq());
+    kernel3->addArg(cc.getVelm());
+    kernel3->addArg(integration.getPosDelta());
+    kernel3->addArg(oldDelta);
+    kernel3->addArg(integration.getStepSize());
+    if (cc.getUseMixedPrecision())
+        kernel3->addArg(cc.getPosqCorrection());
+    prevStepSize = -1.0;
+    crossingCounter = integrator.getCrossingCounter();
+    tracer.initialize(integrator.getTraceFileName(), "elber");
+    crossedSrcMilestone = false;
+    
+    //New parameters for running integrator
+    outputFileName = integrator.getOutputFileName();
+    saveStateFileName = integrator.getSaveStateFileName();
+    if (saveStateFileName.empty()) {
+        saveStateBool = false;
+    } else {
+        saveStateBool = true;
+    }
+    crossingState.initialize(system.getNumParticles());
+    trajectory.initialize(integrator.getTrajectoryFileName(), system.getNumParticles(), system.usesPeriodicBoundaryConditions(),
+            integrator.getStepSize(), integrator.getTrajectoryInterval(), integrator.getTrajectoryFramesBeforeCrossing(),
+            integrator.getTrajectoryFramesAfterCrossing());
+    endOnSrcMilestone = integrator.getEndOnSrcMilestone();
+    for (int i=0; i<integrator.getNumSrcMilestoneGroups(); i++) {
+        bool foundForceGroup=false;
+        for (int j=0; j<system.getNumForces(); j++) {
+            if (system.getForce(j).getForceGroup() == integrator.getSrcMilestoneGroup(i))
+                foundForceGroup=true;
+        }
+        if (foundForceGroup == false)
+            throw OpenMMException("System contains no force groups used to detect Elber boundary crossings. Check for mismatches between force group assignments and the groups added to the Elber integrator.");
+        srcMilestoneGroups.push_back(integrator.getSrcMilestoneGroup(i));
+        srcMilestoneValues.push_back(-INFINITY);
+    }
+    for (int i=0; i<integrator.getNumDestMilestoneGroups(); i++) {
+        bool foundForceGroup=false;
+        for (int j=0; j<system.getNumForces(); j++) {
+            if (system.getForce(j).getForceGroup() == integrator.getDestMilestoneGroup(i))
+                foundForceGroup=true;
+        }
+        if (foundForceGroup == false)
+            throw OpenMMException("System contains no force groups used to detect Elber boundary crossings. Check for mismatches between force group assignments and the groups added to the Elber integrator.");
+        destMilestoneGroups.push_back(integrator.getDestMilestoneGroup(i));
+        destMilestoneValues.push_back(-INFINITY);
+    }
+    srcbitvector.clear();
+    for (int i=0; i<integrator.getNumSrcMilestoneGroups(); i++) {
+        srcbitvector.push_back(pow(2,integrator.getSrcMilestoneGroup(i)));
+    }
+    destbitvector.clear();
+    for (int i=0; i<integrator.getNumDestMilestoneGroups(); i++) {
+        destbitvector.push_back(pow(2,integrator.getDestMilestoneGroup(i)));
+    }
+    assert(cc.getStepCount() == 0);
+    assert(cc.getTime() == 0.0);
+    // see whether the file already exists
+    ifstream datafile;
+    datafile.open(outputFileName);
+    if (datafile) {
+        output_file_already_exists = true;
+    } else {
+        output_file_already_exists = false;
+    }
+    datafile.close();
+    if (output_file_already_exists == false) {
+        ofstream datafile; // open datafile for writing
+        datafile.open(outputFileName, std::ios_base::app); // write new file
+        datafile << "#\"Crossed boundary ID\",\"crossing counter\",\"total time (ps)\"\n";
+        datafile << "# An asterisk(*) indicates that source milestone was never crossed - asterisked statistics are invalid and should be excluded.\n";
+        datafile.close(); // close data file
+    }
+}
+
+void CommonIntegrateElberLangevinMiddleStepKernel::execute(ContextImpl& context, const ElberLangevinMiddleIntegrator& integrator) {
+    cc.setAsCurrent();
+    IntegrationUtilities& integration = cc.getIntegrationUtilities();
+    int numAtoms = cc.getNumAtoms();
+    double temperature = integrator.getTemperature();
+    double friction = integrator.getFriction();
+    double stepSize = integrator.getStepSize();
+    integration.setNextStepSize(stepSize);
+    if (temperature != prevTemp || friction != prevFriction || stepSize != prevStepSize) {
+        // Calculate the integration parameters.
+
+        double kT = BOLTZ*temperature;
+        double vscale = exp(-stepSize*friction);
+        double noisescale = sqrt(kT*(1-vscale*vscale));
+        vector<double> p(params.getSize());
+        p[0] = vscale;
+        p[1] = noisescale;
+        params.upload(p, true);
+        prevTemp = temperature;
+        prevFriction = friction;
+        prevStepSize = stepSize;
+    }
+    {
+        TraceEventRecorder::Scope scope(tracer, "dynamics");
+        
+        // Call the first integration kernel.
+
+        kernel1->execute(numAtoms, 128);
+        
+        // Apply velocity constraints.
+
+        integration.applyVelocityConstraints(integrator.getConstraintTolerance());
+        
+        // Call the second integration kernel.
+
+        kernel2->setArg(7, integration.prepareRandomNumbers(cc.getPaddedNumAtoms()));
+        kernel2->execute(numAtoms, 128);
+        
+        // Apply constraints.
+
+        integration.applyConstraints(integrator.getConstraintTolerance());
+
+        // Call the third integration kernel.
+
+        kernel3->execute(numAtoms, 128);
+        integration.computeVirtualSites();
+    }
+    
+    // Monitor for one or more milestone crossings
+    float value = 0.0;
+    float oldvalue = 0.0;
+    bool includeForces = false;
+    bool includeEnergy = true;
+    int endMilestoneGroup = 0;
+    int num_bounced_surfaces = 0;
+    string trajectoryEvent;
+    if (endSimulation == false) {
+        // first check source milestone crossings
+        for (int i=0; i<integrator.getNumSrcMilestoneGroups(); i++) {
+            {
+                TraceEventRecorder::Scope scope(tracer, "boundary evaluation");
+                value = context.calcForcesAndEnergy(includeForces, includeEnergy, srcbitvector[i]);
+            }
+            if (srcMilestoneValues[i] == -INFINITY) {
+                // First timestep
+                srcMilestoneValues[i] = value;
+            }
+            oldvalue = srcMilestoneValues[i];
+            if (((value - oldvalue) != 0.0) && (cc.getTime() != 0.0)) {
+                // The source milestone has been crossed
+                if (endOnSrcMilestone == true) {
+                    endSimulation = true;
+                    num_bounced_surfaces++;
+                    TraceEventRecorder::Scope scope(tracer, "event write");
+                    ofstream datafile;
+                    datafile.open(outputFileName, std::ios_base::app);
+                    datafile << integrator.getSrcMilestoneGroup(i) << "," << crossingCounter << "," << context.getTime() << "\n";
+                    endMilestoneGroup = integrator.getSrcMilestoneGroup(i);
+                    firstPassageTimeHistograms[endMilestoneGroup].addValue(context.getTime());
+                    datafile.close();
+                } else {
+                    crossedSrcMilestone = true;
+                    context.setTime(0.0); // reset the timer
+                    srcMilestoneValues[i] = value;
+                }
+            } 
+        }
+        // then check destination milestone crossings
+        for (int i=0; i<integrator.getNumDestMilestoneGroups(); i++) {
+            {
+                TraceEventRecorder::Scope scope(tracer, "boundary evaluation");
+                value = context.calcForcesAndEnergy(includeForces, includeEnergy, destbitvector[i]);
+            }
+            if (destMilestoneValues[i] == -INFINITY) {
+                // First timestep
+                destMilestoneValues[i] = value;
+            }
+            oldvalue = destMilestoneValues[i];
+            if (((value - oldvalue) != 0.0) && (cc.getTime() != 0.0)) {
+                // The destination milestone has been crossed
+                endSimulation = true;
+                num_bounced_surfaces++;
+                TraceEventRecorder::Scope scope(tracer, "event write");
+                ofstream datafile;
+                datafile.open(outputFileName, std::ios_base::app);
+                if ((crossedSrcMilestone == true) || (endOnSrcMilestone == true)) {
+                    datafile << integrator.getDestMilestoneGroup(i) << "," << crossingCounter << "," << context.getTime() << "\n";
+                    firstPassageTimeHistograms[integrator.getDestMilestoneGroup(i)].addValue(context.getTime());
+                } else {
+                    datafile << integrator.getDestMilestoneGroup(i) << "*," << crossingCounter << "," << context.getTime() << "\n";
+                }
+                endMilestoneGroup = integrator.getDestMilestoneGroup(i);
+                datafile.close();
+            } 
+        }
+        if (endSimulation == true) {
+            // Then a crossing event has just occurred.
+            if (saveStateBool == true && num_bounced_surfaces == 1) {
+                TraceEventRecorder::Scope scope(tracer, "state serialization");
+                stringstream number_str;
+                number_str << "_" << endMilestoneGroup;
+                crossingState.capture(context);
+                crossingState.write(saveStateFileName + number_str.str());
+            }
+            if (trajectory.isEnabled()) {
+                stringstream event_str;
+                event_str << "_" << crossingCounter << "_" << endMilestoneGroup;
+                trajectoryEvent = event_str.str();
+            }
+            crossingCounter ++;
+        }
+    }
+    
+    // Update timesteps
+    cc.setTime(cc.getTime()+stepSize);
+    cc.setStepCount(cc.getStepCount()+1);
+    
+    // The frame at a crossing is always written to its trajectory.
+    
+    if (trajectory.isFrameStep(cc.getStepCount()) || !trajectoryEvent.empty())
+        trajectory.recordFrame(context);
+    if (!trajectoryEvent.empty()) {
+        TraceEventRecorder::Scope scope(tracer, "trajectory write");
+        trajectory.trigger(context, trajectoryEvent);
+    }
+    cc.reorderAtoms();
+}
+
+double CommonIntegrateElberLangevinMiddleStepKernel::computeKineticEnergy(ContextImpl& context, const ElberLangevinMiddleIntegrator& integrator) {
+    return cc.getIntegrationUtilities().computeKineticEnergy(0.5*integrator.getStepSize());
+}
+
+void CommonIntegrateElberLangevinMiddleStepKernel::resetCrossingState(ContextImpl& context, const ElberLangevinMiddleIntegrator& integrator) {
+    for (int i=0; i<srcMilestoneValues.size(); i++) {
+        srcMilestoneValues[i] = -INFINITY;
+    }
+    for (int i=0; i<destMilestoneValues.size(); i++) {
+        destMilestoneValues[i] = -INFINITY;
+    }
+    crossedSrcMilestone = false;
+    endSimulation = false;
+}
+
+void CommonIntegrateElberLangevinMiddleStepKernel::getFirstPassageTimeHistogram(ContextImpl& context, int milestoneGroup, LogBinnedHistogram& histogram) {
+    map<int, LogBinnedHistogram>::const_iterator entry = firstPassageTimeHistograms.find(milestoneGroup);
+    histogram = (entry == firstPassageTimeHistograms.end() ? LogBinnedHistogram() : entry->second);
+}
+
+void CommonIntegrateElberLangevinMiddleStepKernel::flushTrace(ContextImpl& context) {
+    tracer.flush();
+}
@@ -0,0 +1,270 @@
+#ifndef COMMON_SEEKR2_KERNELS_H_
+#define COMMON_SEEKR2_KERNELS_H_
+
+/*
+   Copyright 2019 by Lane Votapka
+   All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2014 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "Seekr2Kernels.h"
+#include "MmvtStatusSegment.h"
+#include "internal/CrossingStateReservoir.h"
+#include "internal/CrossingStateWriter.h"
+#include "internal/CrossingTrajectoryRecorder.h"
+#include "internal/MmvtBoundaryCheckScheduler.h"
+#include "internal/MmvtBounceCheckpoint.h"
+#include "internal/TraceEventRecorder.h"
+#include "openmm/kernels.h"
+#include "openmm/System.h"
+#include "openmm/common/ComputeArray.h"
+#include "openmm/common/ComputeContext.h"
+#include <map>
+
+namespace Seekr2Plugin {
+
+/**
+ * This kernel is invoked by MmvtLangevinMiddleIntegrator to take one time step.
+ * It is written against OpenMM's common compute framework, so the same code
+ * runs on both the CUDA and OpenCL platforms.
+ */
+class CommonIntegrateMmvtLangevinMiddleStepKernel : public IntegrateMmvtLangevinMiddleStepKernel {
+public:
+    CommonIntegrateMmvtLangevinMiddleStepKernel(std::string name, const OpenMM::Platform& platform, OpenMM::ComputeContext& cc);
+    /**
+     * Allocate memory for the device arrays
+     *
+     * @param integrator     the MmvtLangevinMiddleIntegrator to obtain the info from
+     */
+    void allocateMemory(const MmvtLangevinMiddleIntegrator& integrator);
+     /**
+     * Initialize the kernel, setting up the particle masses.
+     *
+     * @param system     the System this kernel will be applied to
+     * @param integrator the MmvtLangevinMiddleIntegrator this kernel will be used for
+     */
+    void initialize(const OpenMM::System& system, const MmvtLangevinMiddleIntegrator& integrator);
+    /**
+     * Execute the kernel.
+     *
+     * @param context    the context in which to execute this kernel
+     * @param integrator the MmvtLangevinMiddleIntegrator this kernel is being used for
+     */
+    void execute(OpenMM::ContextImpl& context, const MmvtLangevinMiddleIntegrator& integrator);
+    /**
+     * Compute the kinetic energy.
+     * 
+     * @param context    the context in which to execute this kernel
+     * @param integrator the MmvtLangevinMiddleIntegrator this kernel is being used for
+     */
+    double computeKineticEnergy(OpenMM::ContextImpl& context, const MmvtLangevinMiddleIntegrator& integrator);
+    /**
+     * Get the transition statistics accumulated so far.
+     * 
+     * @param context    the context in which to execute this kernel
+     * @param statistics on exit, the accumulated statistics
+     */
+    void getStatistics(OpenMM::ContextImpl& context, MmvtAnchorStatistics& statistics);
+    /**
+     * Check the boundaries for any steps taken since they were last checked,
+     * and bounce if one was crossed.
+     * 
+     * @param context    the context in which to execute this kernel
+     * @param integrator the MmvtLangevinMiddleIntegrator this kernel is being used for
+     */
+    void checkPendingBoundaries(OpenMM::ContextImpl& context, const MmvtLangevinMiddleIntegrator& integrator);
+    /**
+     * Get the counters describing the work spent monitoring the boundaries.
+     * 
+     * @param context    the context in which to execute this kernel
+     * @param counters   on exit, the performance counters
+     */
+    void getPerformanceCounters(OpenMM::ContextImpl& context, MmvtPerformanceCounters& counters);
+    /**
+     * Add the current forces, multiplied by a time step and divided by the
+     * particle masses, to the velocities.
+     * 
+     * @param context    the context in which to execute this kernel
+     * @param integrator the MmvtLangevinMiddleIntegrator this kernel is being used for
+     * @param dt         the time step over which the forces act
+     */
+    void kickVelocities(OpenMM::ContextImpl& context, const MmvtLangevinMiddleIntegrator& integrator, double dt);
+    /**
+     * Write the trace events recorded so far to the trace file.
+     * 
+     * @param context    the context in which to execute this kernel
+     */
+    void flushTrace(OpenMM::ContextImpl& context);
+    /**
+     * Write the bounce counter, the transition statistics and the incubation
+     * under way to a checkpoint.
+     * 
+     * @param context    the context in which to execute this kernel
+     * @param stream     the stream to write the checkpoint to
+     */
+    void createCheckpoint(OpenMM::ContextImpl& context, std::ostream& stream) const;
+    /**
+     * Load a checkpoint written by createCheckpoint().
+     * 
+     * @param context    the context in which to execute this kernel
+     * @param stream     the stream to read the checkpoint from
+     */
+    void loadCheckpoint(OpenMM::ContextImpl& context, std::istream& stream);
+private:
+    double findMaxDisplacement(int firstSlot, int numSlots);
+    void copyPositions(OpenMM::ArrayInterface& source, int sourceSlot, OpenMM::ArrayInterface& dest, int destSlot);
+    void copyVelocities(OpenMM::ArrayInterface& source, int sourceSlot, OpenMM::ArrayInterface& dest, int destSlot);
+    void checkBoundaries(OpenMM::ContextImpl& context, const MmvtLangevinMiddleIntegrator& integrator);
+    void recordBounce(OpenMM::ContextImpl& context, const MmvtLangevinMiddleIntegrator& integrator, float value);
+    void publishStatus();
+    OpenMM::ComputeContext& cc;
+    double prevTemp, prevFriction, prevStepSize;
+    std::vector<int> N_alpha_beta;
+    std::vector<std::vector <int> > Nij_alpha;
+    std::vector<double> Ri_alpha;
+    std::vector<std::vector<LogBinnedHistogram> > incubationTimeHistograms;
+    double T_alpha;
+    std::string outputFileName;
+    OpenMM::ComputeArray params;
+    OpenMM::ComputeKernel kernel1, kernel2, kernel3, kernelBounce, kernelMaxDisplacement, kernelKick;
+    OpenMM::ComputeKernel kernelCopyPositions, kernelCopyVelocities;
+    OpenMM::ComputeArray oldPosq;
+    OpenMM::ComputeArray oldPosqCorrection;
+    OpenMM::ComputeArray oldVelm;
+    OpenMM::ComputeArray oldDelta;
+    std::vector<int> milestoneGroups;
+    bool saveStateBool = false;
+    std::string saveStateFileName;
+    bool saveStateBeforeCrossing, saveFirstHitsOnly;
+    CrossingStateWriter crossingState;
+    CrossingStateReservoir reservoir;
+    CrossingTrajectoryRecorder trajectory;
+    bool saveStatisticsBool = false;
+    std::string saveStatisticsFileName;
+    CrossingSnapshotQueue* crossingSnapshotQueue;
+    int numMilestoneGroups, bounceCounter, previousMilestoneCrossed;
+    double incubationTime;
+    double firstCrossingTime;
+    int boundaryCheckInterval, numFrames;
+    std::vector<double> frameTimes, frameIncubationTimes;
+    std::vector<long long> frameStepCounts;
+    int safeStepDistanceGroup;
+    double safeDistance, safeDisplacement;
+    MmvtBoundaryCheckScheduler scheduler;
+    MmvtStatusSegment status;
+    TraceEventRecorder tracer;
+    OpenMM::ComputeArray maxDisplacement;
+};
+
+/**
+ * This kernel is invoked by ElberLangevinMiddleIntegrator to take one time step.
+ */
+class CommonIntegrateElberLangevinMiddleStepKernel : public IntegrateElberLangevinMiddleStepKernel {
+public:
+    CommonIntegrateElberLangevinMiddleStepKernel(std::string name, const OpenMM::Platform& platform, OpenMM::ComputeContext& cc);
+    /**
+     * Allocate memory for the device arrays
+     *
+     * @param integrator     the ElberLangevinMiddleIntegrator to obtain the info from
+     */
+    void allocateMemory(const ElberLangevinMiddleIntegrator& integrator);
+     /**
+     * Initialize the kernel, setting up the particle masses.
+     *
+     * @param system     the System this kernel will be applied to
+     * @param integrator the ElberLangevinMiddleIntegrator this kernel will be used for
+     */
+    void initialize(const OpenMM::System& system, const ElberLangevinMiddleIntegrator& integrator);
+    /**
+     * Execute the kernel.
+     *
+     * @param context    the context in which to execute this kernel
+     * @param integrator the ElberLangevinMiddleIntegrator this kernel is being used for
+     */
+    void execute(OpenMM::ContextImpl& context, const ElberLangevinMiddleIntegrator& integrator);
+    /**
+     * Compute the kinetic energy.
+     * 
+     * @param context    the context in which to execute this kernel
+     * @param integrator the ElberLangevinMiddleIntegrator this kernel is being used for
+     */
+    double computeKineticEnergy(OpenMM::ContextImpl& context, const ElberLangevinMiddleIntegrator& integrator);
+    /**
+     * Forget any milestone crossings seen so far.
+     * 
+     * @param context    the context in which to execute this kernel
+     * @param integrator the ElberLangevinMiddleIntegrator this kernel is being used for
+     */
+    void resetCrossingState(OpenMM::ContextImpl& context, const ElberLangevinMiddleIntegrator& integrator);
+    /**
+     * Get the distribution of the first passage times of the trajectories
+     * that ended on a milestone.
+     * 
+     * @param context        the context in which to execute this kernel
+     * @param milestoneGroup the milestone group the trajectories ended on
+     * @param histogram      on exit, the distribution of first passage times
+     */
+    void getFirstPassageTimeHistogram(OpenMM::ContextImpl& context, int milestoneGroup, LogBinnedHistogram& histogram);
+    /**
+     * Write the trace events recorded so far to the trace file.
+     * 
+     * @param context    the context in which to execute this kernel
+     */
+    void flushTrace(OpenMM::ContextImpl& context);
+private:
+    OpenMM::ComputeContext& cc;
+    double prevTemp, prevFriction, prevStepSize;
+    std::string outputFileName;
+    OpenMM::ComputeArray params;
+    OpenMM::ComputeKernel kernel1, kernel2, kernel3;
+    OpenMM::ComputeArray oldDelta;
+    std::vector<int> srcbitvector;
+    std::vector<int> destbitvector;
+    std::vector<int> srcMilestoneGroups;
+    std::vector<int> destMilestoneGroups;
+    std::vector<double> srcMilestoneValues; // the force group potential energy "value" to detect crossings
+    std::vector<double> destMilestoneValues;
+    bool endOnSrcMilestone = true; // whether to end on one of the source milestone
+    bool crossedSrcMilestone = false; // need to see if source milestone was crossed - only way to have valid statistics
+    bool endSimulation = false; // If an ending milestone was crossed, then don't log any more crossings
+    bool saveStateBool = false;
+    std::string saveStateFileName;
+    CrossingStateWriter crossingState;
+    CrossingTrajectoryRecorder trajectory;
+    std::map<int, LogBinnedHistogram> firstPassageTimeHistograms;
+    TraceEventRecorder tracer;
+    int numSrcMilestoneGroups, numDestMilestoneGroups;
+    int crossingCounter;
+};
+
+} // namespace Seekr2Plugin
+
+#endif /*COMMON_SEEKR2_KERNELS_H_*/
@@ -0,0 +1,292 @@
+enum {VelScale, NoiseScale};
+
+/**
+ * Perform the first step of Langevin Middle integration: velocity step.
+ */
+
+KERNEL void integrateMmvtLangevinMiddlePart1(int numAtoms, 
+            int paddedNumAtoms, GLOBAL mixed4* RESTRICT velm, 
+            GLOBAL const mm_long* RESTRICT force, 
+            GLOBAL const mixed2* RESTRICT dt) {
+    mixed fscale = dt[0].y/(mixed) 0x100000000;
+    for (int index = GLOBAL_ID; index < numAtoms; index += GLOBAL_SIZE) {
+        mixed4 velocity = velm[index];
+        if (velocity.w != 0.0) {
+            velocity.x += fscale*velocity.w*force[index];
+            velocity.y += fscale*velocity.w*force[index+paddedNumAtoms];
+            velocity.z += fscale*velocity.w*force[index+paddedNumAtoms*2];
+            velm[index] = velocity;
+        }
+    }
+}
+
+/**
+ * Perform the second part of integration: position half step, then interact with heat bath,
+ * then another position half step. The velocities at the start of the step
+ * are saved in the given slot of oldVelm.
+ */
+
+KERNEL void integrateMmvtLangevinMiddlePart2(int numAtoms, 
+        GLOBAL mixed4* RESTRICT velm, GLOBAL mixed4* RESTRICT posDelta,
+        GLOBAL mixed4* RESTRICT oldDelta, GLOBAL const mixed* RESTRICT paramBuffer, 
+        GLOBAL const mixed2* RESTRICT dt, GLOBAL mixed4* RESTRICT oldVelm, int slot,
+        GLOBAL const float4* RESTRICT random, unsigned int randomIndex
+        ) {
+    mixed vscale = paramBuffer[VelScale];
+    mixed noisescale = paramBuffer[NoiseScale];
+    mixed halfdt = 0.5f*dt[0].y;
+    int index = GLOBAL_ID;
+    randomIndex += index;
+    oldVelm += slot*numAtoms;
+    while (index < numAtoms) {
+        mixed4 velocity = velm[index];
+        oldVelm[index] = velocity;
+        if (velocity.w != 0.0) {
+            mixed4 delta = make_mixed4(halfdt*velocity.x, halfdt*velocity.y, halfdt*velocity.z, 0);
+            mixed sqrtInvMass = SQRT(velocity.w);
+            velocity.x = vscale*velocity.x + noisescale*sqrtInvMass*random[randomIndex].x;
+            velocity.y = vscale*velocity.y + noisescale*sqrtInvMass*random[randomIndex].y;
+            velocity.z = vscale*velocity.z + noisescale*sqrtInvMass*random[randomIndex].z;
+            velm[index] = velocity;
+            delta.x += halfdt*velocity.x;
+            delta.y += halfdt*velocity.y;
+            delta.z += halfdt*velocity.z;
+            posDelta[index] = delta;
+            oldDelta[index] = delta;
+        }
+        randomIndex += GLOBAL_SIZE;
+        index += GLOBAL_SIZE;
+    }
+}
+
+/**
+ * Perform the third part of integration: apply constraint forces to velocities, then record
+ * the constrained positions. The positions at the start of the step are saved
+ * in the given slot of oldPosq.
+ */
+
+KERNEL void integrateMmvtLangevinMiddlePart3(int numAtoms, 
+         GLOBAL real4* RESTRICT posq, GLOBAL mixed4* RESTRICT velm,
+         GLOBAL const mixed4* RESTRICT posDelta, GLOBAL mixed4* RESTRICT oldDelta, 
+         GLOBAL const mixed2* RESTRICT dt, GLOBAL real4* RESTRICT oldPosq, int slot
+#ifdef USE_MIXED_PRECISION
+         , GLOBAL real4* RESTRICT posqCorrection
+#endif
+         ) {
+    mixed invDt = 1/dt[0].y;
+    oldPosq += slot*numAtoms;
+    for (int index = GLOBAL_ID; index < numAtoms; index += GLOBAL_SIZE) {
+        mixed4 velocity = velm[index];
+        oldPosq[index] = posq[index];
+        if (velocity.w != 0.0) {
+            mixed4 delta = posDelta[index];
+            velocity.x += (delta.x-oldDelta[index].x)*invDt;
+            velocity.y += (delta.y-oldDelta[index].y)*invDt;
+            velocity.z += (delta.z-oldDelta[index].z)*invDt;
+            velm[index] = velocity;
+#ifdef USE_MIXED_PRECISION
+            real4 pos1 = posq[index];
+            real4 pos2 = posqCorrection[index];
+            mixed4 pos = make_mixed4(pos1.x+(mixed)pos2.x, pos1.y+(mixed)pos2.y, pos1.z+(mixed)pos2.z, pos1.w);
+#else
+            real4 pos = posq[index];
+#endif
+            pos.x += delta.x;
+            pos.y += delta.y;
+            pos.z += delta.z;
+#ifdef USE_MIXED_PRECISION
+            posq[index] = make_real4((real) pos.x, (real) pos.y, (real) pos.z, (real) pos.w);
+            posqCorrection[index] = make_real4(pos.x-(real) pos.x, pos.y-(real) pos.y, pos.z-(real) pos.z, 0);
+#else
+            posq[index] = pos;
+#endif
+        }
+    }
+}
+
+KERNEL void integrateElberLangevinMiddlePart1(int numAtoms, 
+            int paddedNumAtoms, GLOBAL mixed4* RESTRICT velm, 
+            GLOBAL const mm_long* RESTRICT force, 
+            GLOBAL const mixed2* RESTRICT dt) {
+    mixed fscale = dt[0].y/(mixed) 0x100000000;
+    for (int index = GLOBAL_ID; index < numAtoms; index += GLOBAL_SIZE) {
+        mixed4 velocity = velm[index];
+        if (velocity.w != 0.0) {
+            velocity.x += fscale*velocity.w*force[index];
+            velocity.y += fscale*velocity.w*force[index+paddedNumAtoms];
+            velocity.z += fscale*velocity.w*force[index+paddedNumAtoms*2];
+            velm[index] = velocity;
+        }
+    }
+}
+
+/**
+ * Perform the second part of integration: position half step, then interact with heat bath,
+ * then another position half step.
+ */
+
+KERNEL void integrateElberLangevinMiddlePart2(int numAtoms, 
+        GLOBAL mixed4* RESTRICT velm, GLOBAL mixed4* RESTRICT posDelta,
+        GLOBAL mixed4* RESTRICT oldDelta, GLOBAL const mixed* RESTRICT paramBuffer, 
+        GLOBAL const mixed2* RESTRICT dt,
+        GLOBAL const float4* RESTRICT random, unsigned int randomIndex
+        ) {
+    mixed vscale = paramBuffer[VelScale];
+    mixed noisescale = paramBuffer[NoiseScale];
+    mixed halfdt = 0.5f*dt[0].y;
+    int index = GLOBAL_ID;
+    randomIndex += index;
+    while (index < numAtoms) {
+        mixed4 velocity = velm[index];
+        if (velocity.w != 0.0) {
+            mixed4 delta = make_mixed4(halfdt*velocity.x, halfdt*velocity.y, halfdt*velocity.z, 0);
+            mixed sqrtInvMass = SQRT(velocity.w);
+            velocity.x = vscale*velocity.x + noisescale*sqrtInvMass*random[randomIndex].x;
+            velocity.y = vscale*velocity.y + noisescale*sqrtInvMass*random[randomIndex].y;
+            velocity.z = vscale*velocity.z + noisescale*sqrtInvMass*random[randomIndex].z;
+            velm[index] = velocity;
+            delta.x += halfdt*velocity.x;
+            delta.y += halfdt*velocity.y;
+            delta.z += halfdt*velocity.z;
+            posDelta[index] = delta;
+            oldDelta[index] = delta;
+        }
+        randomIndex += GLOBAL_SIZE;
+        index += GLOBAL_SIZE;
+    }
+}
+
+/**
+ * Perform the third part of integration: apply constraint forces to velocities, then record
+ * the constrained positions.
+ */
+
+KERNEL void integrateElberLangevinMiddlePart3(int numAtoms, 
+         GLOBAL real4* RESTRICT posq, GLOBAL mixed4* RESTRICT velm,
+         GLOBAL const mixed4* RESTRICT posDelta, GLOBAL mixed4* RESTRICT oldDelta, 
+         GLOBAL const mixed2* RESTRICT dt
+#ifdef USE_MIXED_PRECISION
+         , GLOBAL real4* RESTRICT posqCorrection
+#endif
+         ) {
+    mixed invDt = 1/dt[0].y;
+    for (int index = GLOBAL_ID; index < numAtoms; index += GLOBAL_SIZE) {
+        mixed4 velocity = velm[index];
+        if (velocity.w != 0.0) {
+            mixed4 delta = posDelta[index];
+            velocity.x += (delta.x-oldDelta[index].x)*invDt;
+            velocity.y += (delta.y-oldDelta[index].y)*invDt;
+            velocity.z += (delta.z-oldDelta[index].z)*invDt;
+            velm[index] = velocity;
+#ifdef USE_MIXED_PRECISION
+            real4 pos1 = posq[index];
+            real4 pos2 = posqCorrection[index];
+            mixed4 pos = make_mixed4(pos1.x+(mixed)pos2.x, pos1.y+(mixed)pos2.y, pos1.z+(mixed)pos2.z, pos1.w);
+#else
+            real4 pos = posq[index];
+#endif
+            pos.x += delta.x;
+            pos.y += delta.y;
+            pos.z += delta.z;
+#ifdef USE_MIXED_PRECISION
+            posq[index] = make_real4((real) pos.x, (real) pos.y, (real) pos.z, (real) pos.w);
+            posqCorrection[index] = make_real4(pos.x-(real) pos.x, pos.y-(real) pos.y, pos.z-(real) pos.z, 0);
+#else
+            posq[index] = pos;
+#endif
+        }
+    }
+}
+
+/**
+ * Add the forces, scaled by a time step, to the velocities. This applies the
+ * slow forces of a multiple time step integrator.
+ */
+KERNEL void mmvtKickVelocities(int numAtoms, 
+            int paddedNumAtoms, GLOBAL mixed4* RESTRICT velm, 
+            GLOBAL const mm_long* RESTRICT force, mixed dt) {
+    mixed fscale = dt/(mixed) 0x100000000;
+    for (int index = GLOBAL_ID; index < numAtoms; index += GLOBAL_SIZE) {
+        mixed4 velocity = velm[index];
+        if (velocity.w != 0.0) {
+            velocity.x += fscale*velocity.w*force[index];
+            velocity.y += fscale*velocity.w*force[index+paddedNumAtoms];
+            velocity.z += fscale*velocity.w*force[index+paddedNumAtoms*2];
+            velm[index] = velocity;
+        }
+    }
+}
+
+/**
+ * Take a step back in time and reverse velocities, restoring the state saved
+ * in the given slot.
+ */
+KERNEL void mmvtBounce(int numAtoms, int paddedNumAtoms, 
+            GLOBAL real4* RESTRICT posq,
+            GLOBAL mixed4* RESTRICT velm, 
+            GLOBAL const real4* RESTRICT oldPosq, 
+            GLOBAL const mixed4* RESTRICT oldVelm, int slot) { 
+    oldPosq += slot*numAtoms;
+    oldVelm += slot*numAtoms;
+    for (int index = GLOBAL_ID; index < numAtoms; index += GLOBAL_SIZE) {
+        mixed4 velocity = oldVelm[index];
+        posq[index] = oldPosq[index];
+        velm[index] = make_mixed4(-velocity.x, -velocity.y, -velocity.z, velocity.w);
+    }
+}
+
+/**
+ * Copy the positions of the atoms from one slot of an array to a slot of
+ * another. This is used for posq and posqCorrection.
+ */
+KERNEL void mmvtCopyPositions(int numAtoms, GLOBAL const real4* RESTRICT source, int sourceSlot,
+            GLOBAL real4* RESTRICT dest, int destSlot) {
+    source += sourceSlot*numAtoms;
+    dest += destSlot*numAtoms;
+    for (int index = GLOBAL_ID; index < numAtoms; index += GLOBAL_SIZE)
+        dest[index] = source[index];
+}
+
+/**
+ * Copy the velocities of the atoms from one slot of an array to a slot of
+ * another.
+ */
+KERNEL void mmvtCopyVelocities(int numAtoms, GLOBAL const mixed4* RESTRICT source, int sourceSlot,
+            GLOBAL mixed4* RESTRICT dest, int destSlot) {
+    source += sourceSlot*numAtoms;
+    dest += destSlot*numAtoms;
+    for (int index = GLOBAL_ID; index < numAtoms; index += GLOBAL_SIZE)
+        dest[index] = source[index];
+}
+
+/**
+ * Find the largest squared displacement of any atom relative to the positions
+ * saved in a range of slots. This is executed by a single thread block, which
+ * reduces the values in local memory.
+ */
+KERNEL void mmvtMaxDisplacement(int numAtoms, 
+            GLOBAL const real4* RESTRICT posq,
+            GLOBAL const real4* RESTRICT oldPosq, int firstSlot, int numSlots,
+            GLOBAL float* RESTRICT maxDisplacement) {
+    LOCAL float blockMax[128];
+    float threadMax = 0.0f;
+    for (int slot = firstSlot; slot < firstSlot+numSlots; slot++) {
+        for (int index = LOCAL_ID; index < numAtoms; index += LOCAL_SIZE) {
+            real4 pos = posq[index];
+            real4 oldPos = oldPosq[slot*numAtoms+index];
+            mixed dx = pos.x-oldPos.x;
+            mixed dy = pos.y-oldPos.y;
+            mixed dz = pos.z-oldPos.z;
+            threadMax = max(threadMax, (float) (dx*dx+dy*dy+dz*dz));
+        }
+    }
+    blockMax[LOCAL_ID] = threadMax;
+    SYNC_THREADS;
+    for (int step = LOCAL_SIZE/2; step > 0; step >>= 1) {
+        if (LOCAL_ID < step)
+            blockMax[LOCAL_ID] = max(blockMax[LOCAL_ID], blockMax[LOCAL_ID+step]);
+        SYNC_THREADS;
+    }
+    if (LOCAL_ID == 0)
+        maxDisplacement[0] = blockMax[0];
+}
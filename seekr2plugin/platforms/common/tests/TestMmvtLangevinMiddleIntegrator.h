@@ -0,0 +1,728 @@
+/*
+   Copyright 2018 by Lane Votapka
+   All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2014 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * This holds the tests of MmvtLangevinMiddleIntegrator shared by the CUDA and
+ * OpenCL platforms, which cover the parts of the common kernels beyond the
+ * integration itself. Each platform's test includes this file and calls
+ * runCommonKernelTests(). The files and status segments each test creates
+ * are named after the platform and precision, so that the tests of different
+ * precisions may run at the same time.
+ */
+
+#include "MmvtLangevinMiddleIntegrator.h"
+#include "MmvtMTSLangevinIntegrator.h"
+#include "MmvtStatusSegment.h"
+#include "openmm/internal/AssertionUtilities.h"
+#include "openmm/CustomExternalForce.h"
+#include "openmm/HarmonicBondForce.h"
+#include "openmm/Context.h"
+#include "openmm/Platform.h"
+#include "openmm/State.h"
+#include "openmm/System.h"
+#include "openmm/serialization/XmlSerializer.h"
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace OpenMM;
+using namespace Seekr2Plugin;
+using namespace std;
+
+/**
+ * Read the lines of a crossing log and delete it.
+ */
+vector<string> readCrossingLog(const string& fileName) {
+    ifstream file(fileName.c_str());
+    vector<string> lines;
+    string line;
+    while (getline(file, line))
+        lines.push_back(line);
+    file.close();
+    remove(fileName.c_str());
+    return lines;
+}
+
+/**
+ * Run a particle bouncing between two walls without friction or noise, and
+ * return the lines of its crossing log.
+ */
+vector<string> runBouncingParticle(Platform& platform, const string& prefix, int boundaryCheckInterval, bool adaptive,
+            int numSteps, double& finalTime, MmvtPerformanceCounters& counters) {
+    System system;
+    system.addParticle(1.0);
+    string fileName = prefix+"check_interval.txt";
+    MmvtLangevinMiddleIntegrator integrator(0.0, 0.0, 0.01, fileName);
+    integrator.addMilestoneGroup(1);
+    integrator.addMilestoneGroup(2);
+    integrator.setBoundaryCheckInterval(boundaryCheckInterval);
+    integrator.setAdaptiveBoundaryChecks(adaptive);
+    CustomExternalForce* boundaries = new CustomExternalForce("step(x-1.0)+2*step(-1.0-x)");
+    boundaries->addParticle(0);
+    boundaries->setForceGroup(1);
+    system.addForce(boundaries);
+    Context context(system, integrator, platform);
+    
+    // Start so that the first crossing falls inside a check interval, not at
+    // its end.
+    
+    context.setPositions(vector<Vec3>(1, Vec3(0.0345, 0, 0)));
+    context.setVelocities(vector<Vec3>(1, Vec3(1.0, 0, 0)));
+    for (int i = 0; i < numSteps; i += 100) {
+        integrator.step(100);
+        
+        // Between calls to step(), the particle is never out of bounds.
+        
+        double x = context.getState(State::Positions).getPositions()[0][0];
+        ASSERT(x < 1.0 && x > -1.0);
+    }
+    finalTime = context.getState(State::Positions).getTime();
+    counters = integrator.getPerformanceCounters();
+    return readCrossingLog(fileName);
+}
+
+void testBoundaryCheckInterval(Platform& platform, const string& prefix) {
+    // Checking the boundaries only every few steps must find the same
+    // bounces, at the same times, as checking after every step. Steps taken
+    // past a crossing are rolled back and discarded.
+    
+    double time1, time8;
+    MmvtPerformanceCounters counters1, counters8;
+    vector<string> lines1 = runBouncingParticle(platform, prefix, 1, false, 2000, time1, counters1);
+    vector<string> lines8 = runBouncingParticle(platform, prefix, 8, false, 2000, time8, counters8);
+    ASSERT_EQUAL_TOL(20.0, time1, 1e-6);
+    ASSERT(time8 < time1);
+    ASSERT(lines8.size() >= 8);
+    ASSERT(lines8.size() <= lines1.size());
+    for (int i = 0; i < lines8.size(); i++)
+        ASSERT_EQUAL(lines1[i], lines8[i]);
+    ASSERT_EQUAL(2000, counters1.numSteps);
+    ASSERT_EQUAL(counters1.numSteps, counters1.numBoundaryEvaluations);
+    ASSERT_EQUAL(0, counters1.numDiscardedSteps);
+    ASSERT_EQUAL(1, counters1.boundaryCheckInterval);
+    ASSERT_EQUAL(8, counters8.boundaryCheckInterval);
+    ASSERT(counters8.numDiscardedSteps > 0);
+}
+
+void testAdaptiveBoundaryChecks(Platform& platform, const string& prefix) {
+    // The adaptive schedule must find the same bounces as checking every
+    // step, while evaluating the boundaries far less often.
+    
+    double time1, timeAdaptive;
+    MmvtPerformanceCounters counters1, countersAdaptive;
+    vector<string> lines1 = runBouncingParticle(platform, prefix, 1, false, 2000, time1, counters1);
+    vector<string> linesAdaptive = runBouncingParticle(platform, prefix, 64, true, 2000, timeAdaptive, countersAdaptive);
+    ASSERT(linesAdaptive.size() >= 8);
+    ASSERT(linesAdaptive.size() <= lines1.size());
+    for (int i = 0; i < linesAdaptive.size(); i++)
+        ASSERT_EQUAL(lines1[i], linesAdaptive[i]);
+    ASSERT_EQUAL(2000, countersAdaptive.numSteps);
+    ASSERT_EQUAL(linesAdaptive.size(), countersAdaptive.numRollbacks);
+    ASSERT(countersAdaptive.numDiscardedSteps < countersAdaptive.numSteps/4);
+    ASSERT(countersAdaptive.getChecksPerStep() < 0.5);
+    ASSERT(countersAdaptive.boundaryCheckInterval <= 50);
+}
+
+/**
+ * Run a particle diffusing between two walls, optionally with a safe step
+ * distance group, and return the lines of its crossing log.
+ */
+vector<string> runDiffusingParticle(Platform& platform, const string& prefix, bool prescreen, Vec3& finalPosition) {
+    System system;
+    system.addParticle(10.0);
+    string fileName = prefix+"safe_step.txt";
+    MmvtLangevinMiddleIntegrator integrator(300.0, 5.0, 0.002, fileName);
+    integrator.addMilestoneGroup(1);
+    integrator.addMilestoneGroup(2);
+    integrator.setRandomNumberSeed(7);
+    CustomExternalForce* boundaries = new CustomExternalForce("step(x-0.5)+2*step(-0.5-x)");
+    boundaries->addParticle(0);
+    boundaries->setForceGroup(1);
+    system.addForce(boundaries);
+    if (prescreen) {
+        CustomExternalForce* distance = new CustomExternalForce("min(0.5-x, x+0.5)");
+        distance->addParticle(0);
+        distance->setForceGroup(3);
+        system.addForce(distance);
+        integrator.setSafeStepDistanceGroup(3);
+    }
+    Context context(system, integrator, platform);
+    context.setPositions(vector<Vec3>(1, Vec3(0.1, 0, 0)));
+    context.setVelocitiesToTemperature(300.0, 3);
+    integrator.step(5000);
+    finalPosition = context.getState(State::Positions).getPositions()[0];
+    return readCrossingLog(fileName);
+}
+
+void testSafeStepDistance(Platform& platform, const string& prefix) {
+    // Skipping the boundary evaluation while no crossing is possible must not
+    // change the trajectory.
+    
+    Vec3 position1, position2;
+    vector<string> lines1 = runDiffusingParticle(platform, prefix, false, position1);
+    vector<string> lines2 = runDiffusingParticle(platform, prefix, true, position2);
+    ASSERT(lines1.size() > 0);
+    ASSERT_EQUAL(lines1.size(), lines2.size());
+    for (int i = 0; i < lines1.size(); i++)
+        ASSERT_EQUAL(lines1[i], lines2[i]);
+    ASSERT_EQUAL_VEC(position1, position2, 1e-5);
+}
+
+/**
+ * Run a particle oscillating in a harmonic well centered just inside the wall
+ * at x = 1, so that each swing takes it across the wall and back within a few
+ * steps, and return the lines of its crossing log.
+ */
+vector<string> runOscillatingParticle(Platform& platform, const string& prefix, int boundaryCheckInterval, bool prescreen,
+            Vec3& finalPosition) {
+    System system;
+    system.addParticle(1.0);
+    string fileName = prefix+"safe_step_interval.txt";
+    MmvtLangevinMiddleIntegrator integrator(0.0, 0.0, 0.01, fileName);
+    integrator.addMilestoneGroup(1);
+    integrator.addMilestoneGroup(2);
+    integrator.setBoundaryCheckInterval(boundaryCheckInterval);
+    CustomExternalForce* well = new CustomExternalForce("0.5*k*(x-0.9)^2");
+    well->addGlobalParameter("k", 987.0);
+    well->addParticle(0);
+    system.addForce(well);
+    CustomExternalForce* boundaries = new CustomExternalForce("step(x-1.0)+2*step(-1.0-x)");
+    boundaries->addParticle(0);
+    boundaries->setForceGroup(1);
+    system.addForce(boundaries);
+    if (prescreen) {
+        CustomExternalForce* distance = new CustomExternalForce("min(1.0-x, x+1.0)");
+        distance->addParticle(0);
+        distance->setForceGroup(3);
+        system.addForce(distance);
+        integrator.setSafeStepDistanceGroup(3);
+    }
+    Context context(system, integrator, platform);
+    context.setPositions(vector<Vec3>(1, Vec3(0.9, 0, 0)));
+    context.setVelocities(vector<Vec3>(1, Vec3(4.71, 0, 0)));
+    integrator.step(200);
+    finalPosition = context.getState(State::Positions).getPositions()[0];
+    return readCrossingLog(fileName);
+}
+
+void testSafeStepDistanceInterval(Platform& platform, const string& prefix) {
+    // A crossing in the middle of a check interval that is back in bounds by
+    // its end must still be bounced when a safe step distance group is set.
+    
+    Vec3 position1, position8;
+    vector<string> lines1 = runOscillatingParticle(platform, prefix, 1, false, position1);
+    vector<string> lines8 = runOscillatingParticle(platform, prefix, 8, true, position8);
+    ASSERT(lines1.size() > 0);
+    ASSERT_EQUAL(lines1.size(), lines8.size());
+    for (int i = 0; i < lines1.size(); i++)
+        ASSERT_EQUAL(lines1[i], lines8[i]);
+    ASSERT_EQUAL_VEC(position1, position8, 1e-5);
+}
+
+void testMultipleTimeSteps(Platform& platform, const string& prefix) {
+    // A stiff bond is integrated with the inner steps and a weak one with
+    // the outer steps. Without friction, energy must be conserved.
+    
+    System system;
+    system.addParticle(2.0);
+    system.addParticle(2.0);
+    HarmonicBondForce* fastForce = new HarmonicBondForce();
+    fastForce->addBond(0, 1, 1.5, 1);
+    system.addForce(fastForce);
+    HarmonicBondForce* slowForce = new HarmonicBondForce();
+    slowForce->addBond(0, 1, 1.0, 0.05);
+    slowForce->setForceGroup(3);
+    system.addForce(slowForce);
+    string fileName = prefix+"mts.txt";
+    MmvtMTSLangevinIntegrator integrator(0.0, 0.0, 0.04, fileName, 4);
+    integrator.addSlowForceGroup(3);
+    Context context(system, integrator, platform);
+    vector<Vec3> positions(2);
+    positions[0] = Vec3(-1, 0, 0);
+    positions[1] = Vec3(1, 0, 0);
+    context.setPositions(positions);
+    State state = context.getState(State::Energy);
+    double initialEnergy = state.getKineticEnergy()+state.getPotentialEnergy();
+    for (int i = 0; i < 250; ++i) {
+        integrator.step(1);
+        state = context.getState(State::Energy);
+        double energy = state.getKineticEnergy()+state.getPotentialEnergy();
+        ASSERT_EQUAL_TOL(initialEnergy, energy, 0.01);
+    }
+    ASSERT_EQUAL_TOL(10.0, state.getTime(), 1e-6);
+    ASSERT_EQUAL(1000, context.getStepCount());
+    remove(fileName.c_str());
+}
+
+void testMultipleTimeStepBounces(Platform& platform, const string& prefix) {
+    // With no slow forces acting, a particle bouncing between two walls must
+    // be bounced at exactly the same inner steps as with an ordinary step of
+    // the same size.
+    
+    double time1;
+    MmvtPerformanceCounters counters1;
+    vector<string> lines1 = runBouncingParticle(platform, prefix, 1, false, 2000, time1, counters1);
+    System system;
+    system.addParticle(1.0);
+    string fileName = prefix+"mts_bounces.txt";
+    MmvtMTSLangevinIntegrator integrator(0.0, 0.0, 0.04, fileName, 4);
+    integrator.addMilestoneGroup(1);
+    integrator.addMilestoneGroup(2);
+    integrator.addSlowForceGroup(3);
+    CustomExternalForce* boundaries = new CustomExternalForce("step(x-1.0)+2*step(-1.0-x)");
+    boundaries->addParticle(0);
+    boundaries->setForceGroup(1);
+    system.addForce(boundaries);
+    CustomExternalForce* slowForce = new CustomExternalForce("0*x");
+    slowForce->addParticle(0);
+    slowForce->setForceGroup(3);
+    system.addForce(slowForce);
+    Context context(system, integrator, platform);
+    context.setPositions(vector<Vec3>(1, Vec3(0.0345, 0, 0)));
+    context.setVelocities(vector<Vec3>(1, Vec3(1.0, 0, 0)));
+    integrator.step(500);
+    ASSERT_EQUAL_TOL(time1, context.getState(State::Positions).getTime(), 1e-6);
+    vector<string> lines = readCrossingLog(fileName);
+    ASSERT(lines.size() >= 8);
+    ASSERT_EQUAL(lines1.size(), lines.size());
+    for (int i = 0; i < lines.size(); i++)
+        ASSERT_EQUAL(lines1[i], lines[i]);
+}
+
+/**
+ * Run a particle between walls at x = -1 and x = 1 without friction, either
+ * for 1000 steps in one Context, or for 500 steps, checkpointed, and then
+ * continued from the checkpoint in a new Context after running on for 200
+ * more steps that are thrown away.
+ */
+vector<string> runCheckpointedWalls(Platform& platform, const string& prefix, bool interrupt,
+            MmvtAnchorStatistics& statistics) {
+    System system;
+    system.addParticle(1.0);
+    CustomExternalForce* boundaries = new CustomExternalForce("step(x-1.0)+2*step(-1.0-x)");
+    boundaries->addParticle(0);
+    boundaries->setForceGroup(1);
+    system.addForce(boundaries);
+    string fileName = prefix+"checkpoint.txt";
+    MmvtLangevinMiddleIntegrator integrator(0.0, 0.0, 0.01, fileName);
+    integrator.addMilestoneGroup(1);
+    integrator.addMilestoneGroup(2);
+    Context context(system, integrator, platform);
+    context.setPositions(vector<Vec3>(1, Vec3(0.0345, 0, 0)));
+    context.setVelocities(vector<Vec3>(1, Vec3(1.0, 0, 0)));
+    if (interrupt) {
+        integrator.step(500);
+        State state = context.getState(State::Positions | State::Velocities);
+        stringstream checkpoint;
+        integrator.createCheckpoint(checkpoint);
+        integrator.step(200);
+        MmvtLangevinMiddleIntegrator integrator2(0.0, 0.0, 0.01, fileName);
+        integrator2.addMilestoneGroup(1);
+        integrator2.addMilestoneGroup(2);
+        Context context2(system, integrator2, platform);
+        context2.setState(state);
+        integrator2.loadCheckpoint(checkpoint);
+        MmvtAnchorStatistics restored = integrator2.getStatistics();
+        ASSERT_EQUAL(3, restored.N_alpha_beta[0]+restored.N_alpha_beta[1]);
+        integrator2.step(500);
+        statistics = integrator2.getStatistics();
+    }
+    else {
+        integrator.step(1000);
+        statistics = integrator.getStatistics();
+    }
+    return readCrossingLog(fileName);
+}
+
+void testCheckpoint(Platform& platform, const string& prefix) {
+    // Continuing from a checkpoint gives the same crossing log and statistics
+    // as running without interruption.
+    
+    MmvtAnchorStatistics whole, pieces;
+    vector<string> wholeLines = runCheckpointedWalls(platform, prefix, false, whole);
+    vector<string> lines = runCheckpointedWalls(platform, prefix, true, pieces);
+    ASSERT_EQUAL(5, whole.N_alpha_beta[0]+whole.N_alpha_beta[1]);
+    ASSERT_EQUAL(wholeLines.size(), lines.size());
+    for (int i = 0; i < lines.size(); i++)
+        ASSERT_EQUAL(wholeLines[i], lines[i]);
+    for (int i = 0; i < 2; i++) {
+        ASSERT_EQUAL(whole.N_alpha_beta[i], pieces.N_alpha_beta[i]);
+        ASSERT_EQUAL_TOL(whole.Ri_alpha[i], pieces.Ri_alpha[i], 1e-6);
+        for (int j = 0; j < 2; j++) {
+            ASSERT_EQUAL(whole.Nij_alpha[i][j], pieces.Nij_alpha[i][j]);
+            ASSERT_EQUAL(whole.incubationTimeHistograms[i][j].getTotalCount(), pieces.incubationTimeHistograms[i][j].getTotalCount());
+        }
+    }
+    ASSERT_EQUAL_TOL(whole.T_alpha, pieces.T_alpha, 1e-6);
+}
+
+void testCrossingSnapshotQueue(Platform& platform, const string& prefix) {
+    // The particle should bounce exactly once, and the state that crossed the
+    // boundary should be in the queue.
+    
+    System system;
+    system.addParticle(1.0);
+    string fileName = prefix+"snapshot.txt";
+    MmvtLangevinMiddleIntegrator integrator(0.0, 0.0, 0.01, fileName);
+    integrator.addMilestoneGroup(1);
+    CustomExternalForce* boundary = new CustomExternalForce("step(x-1.0)");
+    boundary->addParticle(0);
+    boundary->setForceGroup(1);
+    system.addForce(boundary);
+    CrossingSnapshotQueue queue(4);
+    integrator.setCrossingSnapshotQueue(&queue);
+    Context context(system, integrator, platform);
+    context.setPositions(vector<Vec3>(1, Vec3(0.9, 0, 0)));
+    context.setVelocities(vector<Vec3>(1, Vec3(1.0, 0, 0)));
+    integrator.step(100);
+    ASSERT_EQUAL(1, queue.getSize());
+    CrossingSnapshot snapshot;
+    ASSERT(queue.tryPop(snapshot));
+    ASSERT_EQUAL(1, snapshot.milestoneGroup);
+    ASSERT_EQUAL(0, snapshot.bounceIndex);
+    ASSERT_EQUAL(1, (int) snapshot.positions.size());
+    ASSERT(snapshot.positions[0][0] > 1.0);
+    ASSERT_EQUAL_VEC(Vec3(1.0, 0, 0), snapshot.velocities[0], 1e-5);
+    State state = context.getState(State::Positions | State::Velocities);
+    ASSERT(state.getPositions()[0][0] < 1.0);
+    ASSERT_EQUAL_VEC(Vec3(-1.0, 0, 0), state.getVelocities()[0], 1e-5);
+    ASSERT(!queue.tryPop(snapshot));
+    ASSERT_EQUAL(1, integrator.getStatistics().N_alpha_beta[0]);
+    remove(fileName.c_str());
+}
+
+void testSaveStateReservoir(Platform& platform, const string& prefix) {
+    // A particle bouncing between two walls every 200 steps bounces against
+    // each one every 400 steps, so with a spacing of 500 steps only every
+    // other bounce is a candidate. No more than three states may be kept per
+    // boundary.
+    
+    System system;
+    system.addParticle(1.0);
+    string fileName = prefix+"reservoir.txt";
+    MmvtLangevinMiddleIntegrator integrator(0.0, 0.0, 0.01, fileName);
+    integrator.addMilestoneGroup(1);
+    integrator.addMilestoneGroup(2);
+    integrator.setSaveStateFileName(prefix+"reservoir");
+    integrator.setSaveStateReservoirSize(3);
+    integrator.setSaveStateReservoirSpacing(500);
+    integrator.setRandomNumberSeed(5);
+    CustomExternalForce* boundaries = new CustomExternalForce("step(x-1.0)+2*step(-1.0-x)");
+    boundaries->addParticle(0);
+    boundaries->setForceGroup(1);
+    system.addForce(boundaries);
+    Context context(system, integrator, platform);
+    context.setPositions(vector<Vec3>(1, Vec3(0.9, 0, 0)));
+    context.setVelocities(vector<Vec3>(1, Vec3(1.0, 0, 0)));
+    integrator.step(8000);
+    ASSERT(integrator.getBounceCounter() >= 30);
+    for (int group = 1; group <= 2; group++) {
+        vector<double> times;
+        for (int slot = 0; slot < 4; slot++) {
+            stringstream stateFileName;
+            stateFileName << prefix << "reservoir_reservoir_" << group << "_" << slot;
+            ifstream file(stateFileName.str().c_str());
+            if (slot == 3) {
+                ASSERT(!file.good());
+                continue;
+            }
+            ASSERT(file.good());
+            State* state = XmlSerializer::deserialize<State>(file);
+            file.close();
+            remove(stateFileName.str().c_str());
+            times.push_back(state->getTime());
+            delete state;
+        }
+        for (int i = 0; i < times.size(); i++)
+            for (int j = 0; j < i; j++)
+                ASSERT(fabs(times[i]-times[j]) >= 5.0);
+    }
+    ifstream file((prefix+"reservoir_0_1").c_str());
+    ASSERT(!file.good());
+    remove(fileName.c_str());
+}
+
+/**
+ * Read the x coordinates, in Angstroms, of the frames in a DCD file of one
+ * particle written by the crossing trajectory recorder, and delete it.
+ */
+vector<float> readTrajectory(const string& fileName) {
+    ifstream file(fileName.c_str(), ios_base::binary);
+    ASSERT(file.good());
+    string data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    file.close();
+    remove(fileName.c_str());
+    const int headerSize = 276, frameSize = 36;
+    ASSERT_EQUAL(string("CORD"), data.substr(4, 4));
+    int numFrames;
+    memcpy(&numFrames, &data[8], 4);
+    ASSERT_EQUAL(headerSize+numFrames*frameSize, (int) data.size());
+    vector<float> x(numFrames);
+    for (int i = 0; i < numFrames; i++)
+        memcpy(&x[i], &data[headerSize+i*frameSize+4], 4);
+    return x;
+}
+
+void testCrossingTrajectory(Platform& platform, const string& prefix) {
+    // Only the frames just before and after the bounce should be written to
+    // the trajectory.
+    
+    System system;
+    system.addParticle(1.0);
+    string fileName = prefix+"trajectory.txt";
+    MmvtLangevinMiddleIntegrator integrator(0.0, 0.0, 0.01, fileName);
+    integrator.addMilestoneGroup(1);
+    integrator.setTrajectoryFileName(prefix+"trajectory");
+    integrator.setTrajectoryInterval(2);
+    integrator.setTrajectoryFramesBeforeCrossing(3);
+    integrator.setTrajectoryFramesAfterCrossing(2);
+    CustomExternalForce* boundary = new CustomExternalForce("step(x-1.0)");
+    boundary->addParticle(0);
+    boundary->setForceGroup(1);
+    system.addForce(boundary);
+    Context context(system, integrator, platform);
+    context.setPositions(vector<Vec3>(1, Vec3(0.905, 0, 0)));
+    context.setVelocities(vector<Vec3>(1, Vec3(1.0, 0, 0)));
+    integrator.step(40);
+    vector<float> x = readTrajectory(prefix+"trajectory_0_1.dcd");
+    ASSERT_EQUAL(5, (int) x.size());
+    ASSERT(x[0] < x[1] && x[1] < x[2]);
+    ASSERT(x[2] <= 10.0f);
+    ASSERT(x[3] < x[2] && x[4] < x[3]);
+    
+    // With a longer boundary check interval, steps past a crossing are
+    // discarded when it is found, and none of them may be written.
+    
+    System system2;
+    system2.addParticle(1.0);
+    MmvtLangevinMiddleIntegrator integrator2(0.0, 0.0, 0.01, fileName);
+    integrator2.addMilestoneGroup(1);
+    integrator2.addMilestoneGroup(2);
+    integrator2.setBoundaryCheckInterval(8);
+    integrator2.setTrajectoryFileName(prefix+"trajectory");
+    integrator2.setTrajectoryInterval(1);
+    integrator2.setTrajectoryFramesBeforeCrossing(2);
+    integrator2.setTrajectoryFramesAfterCrossing(15);
+    CustomExternalForce* walls = new CustomExternalForce("step(x-1.0)+2*step(0.9-x)");
+    walls->addParticle(0);
+    walls->setForceGroup(1);
+    system2.addForce(walls);
+    Context context2(system2, integrator2, platform);
+    context2.setPositions(vector<Vec3>(1, Vec3(0.905, 0, 0)));
+    context2.setVelocities(vector<Vec3>(1, Vec3(1.0, 0, 0)));
+    integrator2.step(60);
+    x = readTrajectory(prefix+"trajectory_0_1.dcd");
+    ASSERT(x.size() > 10);
+    for (int i = 0; i < x.size(); i++)
+        ASSERT(x[i] > 8.999f && x[i] < 10.001f);
+    remove(fileName.c_str());
+}
+
+void testStatusSegment(Platform& platform, const string& prefix, const string& segmentName) {
+    // The status segment holds the same step count, statistics and counters
+    // that the integrator reports, a reader polling while the simulation runs
+    // sees a consistent status, and the segment is removed with the Context.
+    
+    System system;
+    system.addParticle(10.0);
+    string fileName = prefix+"status_segment.txt";
+    MmvtLangevinMiddleIntegrator integrator(300.0, 5.0, 0.002, fileName);
+    integrator.addMilestoneGroup(1);
+    integrator.addMilestoneGroup(2);
+    integrator.setRandomNumberSeed(7);
+    integrator.setStatusSegmentName(segmentName);
+    CustomExternalForce* boundaries = new CustomExternalForce("step(x-0.5)+2*step(-0.5-x)");
+    boundaries->addParticle(0);
+    boundaries->setForceGroup(1);
+    system.addForce(boundaries);
+    Context* context = new Context(system, integrator, platform);
+    context->setPositions(vector<Vec3>(1, Vec3(0.1, 0, 0)));
+    context->setVelocitiesToTemperature(300.0, 3);
+    MmvtStatusSegment segment;
+    segment.attach(segmentName);
+    integrator.step(3000);
+    MmvtStatus status;
+    segment.read(status);
+    MmvtAnchorStatistics statistics = integrator.getStatistics();
+    MmvtPerformanceCounters counters = integrator.getPerformanceCounters();
+    ASSERT(statistics.N_alpha_beta[0]+statistics.N_alpha_beta[1] > 0);
+    ASSERT_EQUAL(3000, status.stepCount);
+    ASSERT_EQUAL_TOL(context->getState(0).getTime(), status.time, 1e-10);
+    for (int i = 0; i < 2; i++) {
+        ASSERT_EQUAL(statistics.N_alpha_beta[i], status.statistics.N_alpha_beta[i]);
+        ASSERT_EQUAL_TOL(statistics.Ri_alpha[i], status.statistics.Ri_alpha[i], 1e-10);
+        for (int j = 0; j < 2; j++)
+            ASSERT_EQUAL(statistics.Nij_alpha[i][j], status.statistics.Nij_alpha[i][j]);
+    }
+    ASSERT_EQUAL_TOL(statistics.T_alpha, status.statistics.T_alpha, 1e-10);
+    ASSERT_EQUAL(counters.numSteps, status.counters.numSteps);
+    ASSERT_EQUAL(counters.numBoundaryEvaluations, status.counters.numBoundaryEvaluations);
+    atomic<bool> running(true);
+    bool consistent = true;
+    thread reader([&] () {
+        try {
+            MmvtStatusSegment readerSegment;
+            readerSegment.attach(segmentName);
+            long long lastStep = 0;
+            while (running) {
+                MmvtStatus current;
+                readerSegment.read(current);
+                if (current.stepCount < lastStep || current.counters.numSteps != current.stepCount)
+                    consistent = false;
+                lastStep = current.stepCount;
+            }
+        }
+        catch (const exception& ex) {
+            consistent = false;
+        }
+    });
+    integrator.step(3000);
+    running = false;
+    reader.join();
+    ASSERT(consistent);
+    segment.read(status);
+    ASSERT_EQUAL(6000, status.stepCount);
+    
+    // Destroying the Context removes the segment, while a reader that is
+    // already attached keeps the last status.
+    
+    delete context;
+    segment.read(status);
+    ASSERT_EQUAL(6000, status.stepCount);
+    MmvtStatusSegment removed;
+    bool threwException = false;
+    try {
+        removed.attach(segmentName);
+    }
+    catch (const OpenMMException& ex) {
+        threwException = true;
+    }
+    ASSERT(threwException);
+    remove(fileName.c_str());
+}
+
+void testTraceFile(Platform& platform, const string& prefix) {
+    // The trace file is a JSON array of complete events covering each phase
+    // of a step, and is terminated when the Context is destroyed.
+    
+    System system;
+    system.addParticle(10.0);
+    string fileName = prefix+"trace_file.txt";
+    string traceFileName = prefix+"trace_file.json";
+    MmvtLangevinMiddleIntegrator integrator(300.0, 5.0, 0.002, fileName);
+    integrator.addMilestoneGroup(1);
+    integrator.addMilestoneGroup(2);
+    integrator.setRandomNumberSeed(7);
+    integrator.setTraceFileName(traceFileName);
+    CustomExternalForce* boundaries = new CustomExternalForce("step(x-0.5)+2*step(-0.5-x)");
+    boundaries->addParticle(0);
+    boundaries->setForceGroup(1);
+    system.addForce(boundaries);
+    Context* context = new Context(system, integrator, platform);
+    context->setPositions(vector<Vec3>(1, Vec3(0.1, 0, 0)));
+    context->setVelocitiesToTemperature(300.0, 3);
+    integrator.step(3000);
+    MmvtAnchorStatistics statistics = integrator.getStatistics();
+    ASSERT(statistics.N_alpha_beta[0]+statistics.N_alpha_beta[1] > 0);
+    
+    // Flushing writes the events recorded so far without closing the array.
+    
+    integrator.flushTrace();
+    ifstream flushed(traceFileName.c_str());
+    stringstream flushedContents;
+    flushedContents << flushed.rdbuf();
+    flushed.close();
+    string trace = flushedContents.str();
+    ASSERT(trace.size() > 0 && trace[0] == '[');
+    ASSERT(trace.find("\"name\":\"dynamics\",\"cat\":\"mmvt\",\"ph\":\"X\"") != string::npos);
+    delete context;
+    ifstream closed(traceFileName.c_str());
+    stringstream closedContents;
+    closedContents << closed.rdbuf();
+    closed.close();
+    trace = closedContents.str();
+    ASSERT(trace.size() > flushedContents.str().size());
+    size_t last = trace.find_last_not_of(" \n");
+    ASSERT(last != string::npos && trace[last] == ']');
+    const char* phases[] = {"dynamics", "boundary evaluation", "bounce restore", "event write"};
+    for (int i = 0; i < 4; i++) {
+        string event = string("\"name\":\"")+phases[i]+"\",\"cat\":\"mmvt\",\"ph\":\"X\"";
+        ASSERT(trace.find(event) != string::npos);
+    }
+    remove(fileName.c_str());
+    remove(traceFileName.c_str());
+}
+
+/**
+ * Run all the tests of the common kernels on a platform.
+ *
+ * @param platform    the platform to test
+ * @param precision   the precision it has been set to use, which is used to name the files the tests create
+ */
+void runCommonKernelTests(Platform& platform, const string& precision) {
+    string prefix = "/tmp/seekr2_"+platform.getName()+"_"+precision+"_";
+    string segmentName = "/seekr2_test_"+platform.getName()+"_"+precision;
+    cout << "running testBoundaryCheckInterval\n";
+    testBoundaryCheckInterval(platform, prefix);
+    cout << "running testSafeStepDistance\n";
+    testSafeStepDistance(platform, prefix);
+    cout << "running testSafeStepDistanceInterval\n";
+    testSafeStepDistanceInterval(platform, prefix);
+    cout << "running testAdaptiveBoundaryChecks\n";
+    testAdaptiveBoundaryChecks(platform, prefix);
+    cout << "running testMultipleTimeSteps\n";
+    testMultipleTimeSteps(platform, prefix);
+    cout << "running testMultipleTimeStepBounces\n";
+    testMultipleTimeStepBounces(platform, prefix);
+    cout << "running testCheckpoint\n";
+    testCheckpoint(platform, prefix);
+    cout << "running testCrossingSnapshotQueue\n";
+    testCrossingSnapshotQueue(platform, prefix);
+    cout << "running testSaveStateReservoir\n";
+    testSaveStateReservoir(platform, prefix);
+    cout << "running testCrossingTrajectory\n";
+    testCrossingTrajectory(platform, prefix);
+    cout << "running testStatusSegment\n";
+    testStatusSegment(platform, prefix, segmentName);
+    cout << "running testTraceFile\n";
+    testTraceFile(platform, prefix);
+}
@@ -35,7 +35,8 @@
 #include <exception>
 
 #include "CudaSeekr2KernelFactory.h"
-#include "CudaSeekr2Kernels.h"
+#include "CommonSeekr2Kernels.h"
+#include "openmm/cuda/CudaPlatform.h"
 #include "openmm/internal/windowsExport.h"
 #include "openmm/internal/ContextImpl.h"
 #include "openmm/OpenMMException.h"
@@ -71,14 +72,14 @@ extern "C" OPENMM_EXPORT void registerSeekr2CudaKernelFactories() {
 }
 
 KernelImpl* CudaSeekr2KernelFactory::createKernelImpl(std::string name, const Platform& platform, ContextImpl& context) const {
-    CudaContext& cu = *static_cast<CudaPlatform::PlatformData*>(context.getPlatformData())->contexts[0];
+    ComputeContext& cc = *static_cast<CudaPlatform::PlatformData*>(context.getPlatformData())->contexts[0];
     //if (name == IntegrateMmvtLangevinStepKernel::Name())
     //    return new CudaIntegrateMmvtLangevinStepKernel(name, platform, cu);
     //if (name == IntegrateElberLangevinStepKernel::Name())
     //    return new CudaIntegrateElberLangevinStepKernel(name, platform, cu);
     if (name == IntegrateMmvtLangevinMiddleStepKernel::Name())
-        return new CudaIntegrateMmvtLangevinMiddleStepKernel(name, platform, cu);
+        return new CommonIntegrateMmvtLangevinMiddleStepKernel(name, platform, cc);
     if (name == IntegrateElberLangevinMiddleStepKernel::Name())
-        return new CudaIntegrateElberLangevinMiddleStepKernel(name, platform, cu);
+        return new CommonIntegrateElberLangevinMiddleStepKernel(name, platform, cc);
     throw OpenMMException((std::string("Tried to create kernel with illegal kernel name '")+name+"'").c_str());
 }
@@ -49,6 +49,7 @@
 #include <cmath>
 #include <iostream>
 #include <vector>
+#include "TestMmvtLangevinMiddleIntegrator.h"
 
 using namespace Seekr2Plugin;
 using namespace OpenMM;
@@ -298,6 +299,7 @@ int main(int argc, char* argv[]) {
         testConstrainedMasslessParticles();
         std::cout << "running testRandomSeed\n";
         testRandomSeed();
+        runCommonKernelTests(Platform::getPlatformByName("CUDA"), argc > 1 ? string(argv[1]) : string("default"));
     }
     catch(const std::exception& e) {
         std::cout << "exception: " << e.what() << std::endl;
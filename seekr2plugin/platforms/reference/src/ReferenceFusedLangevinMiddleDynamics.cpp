@@ -0,0 +1,234 @@
+/*
+   Copyright 2019 by Lane Votapka
+   All rights reserved
+   
+   -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2014 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "ReferenceFusedLangevinMiddleDynamics.h"
+#include "openmm/OpenMMException.h"
+#include "openmm/reference/SimTKOpenMMRealType.h"
+#include "openmm/reference/SimTKOpenMMUtilities.h"
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SEEKR2_X86_SIMD
+#include <immintrin.h>
+#endif
+
+using namespace Seekr2Plugin;
+using namespace OpenMM;
+using namespace std;
+
+namespace {
+
+// Each kernel takes a step for coordinates [start, end) of the flat arrays,
+// optionally saving their values at the start of the step. The operations
+// are done in the same order as in ReferenceLangevinMiddleDynamics.
+
+template <bool SAVE>
+void updateScalar(int start, int end, double* x, double* v, const double* f, const double* forceScale, const double* noiseScale,
+        const double* noise, double velocityScale, double halfStepSize, double* savedX, double* savedV, double* savedF) {
+    for (int i = start; i < end; i++) {
+        double pos = x[i], vel = v[i], force = f[i];
+        if (SAVE) {
+            savedX[i] = pos;
+            savedV[i] = vel;
+            savedF[i] = force;
+        }
+        double v1 = vel+force*forceScale[i];
+        double v2 = velocityScale*v1+noiseScale[i]*noise[i];
+        v[i] = v2;
+        x[i] = pos+v1*halfStepSize+v2*halfStepSize;
+    }
+}
+
+#ifdef SEEKR2_X86_SIMD
+template <bool SAVE>
+__attribute__((target("avx2,fma")))
+void updateAvx2(int end, double* x, double* v, const double* f, const double* forceScale, const double* noiseScale,
+        const double* noise, double velocityScale, double halfStepSize, double* savedX, double* savedV, double* savedF) {
+    const __m256d vscale = _mm256_set1_pd(velocityScale);
+    const __m256d halfdt = _mm256_set1_pd(halfStepSize);
+    int i = 0;
+    for (; i+4 <= end; i += 4) {
+        __m256d pos = _mm256_loadu_pd(x+i);
+        __m256d vel = _mm256_loadu_pd(v+i);
+        __m256d force = _mm256_loadu_pd(f+i);
+        if (SAVE) {
+            _mm256_storeu_pd(savedX+i, pos);
+            _mm256_storeu_pd(savedV+i, vel);
+            _mm256_storeu_pd(savedF+i, force);
+        }
+        __m256d v1 = _mm256_fmadd_pd(force, _mm256_loadu_pd(forceScale+i), vel);
+        __m256d v2 = _mm256_fmadd_pd(_mm256_loadu_pd(noiseScale+i), _mm256_loadu_pd(noise+i), _mm256_mul_pd(vscale, v1));
+        _mm256_storeu_pd(v+i, v2);
+        _mm256_storeu_pd(x+i, _mm256_fmadd_pd(v2, halfdt, _mm256_fmadd_pd(v1, halfdt, pos)));
+    }
+    updateScalar<SAVE>(i, end, x, v, f, forceScale, noiseScale, noise, velocityScale, halfStepSize, savedX, savedV, savedF);
+}
+
+template <bool SAVE>
+__attribute__((target("avx512f")))
+void updateAvx512(int end, double* x, double* v, const double* f, const double* forceScale, const double* noiseScale,
+        const double* noise, double velocityScale, double halfStepSize, double* savedX, double* savedV, double* savedF) {
+    const __m512d vscale = _mm512_set1_pd(velocityScale);
+    const __m512d halfdt = _mm512_set1_pd(halfStepSize);
+    int i = 0;
+    for (; i+8 <= end; i += 8) {
+        __m512d pos = _mm512_loadu_pd(x+i);
+        __m512d vel = _mm512_loadu_pd(v+i);
+        __m512d force = _mm512_loadu_pd(f+i);
+        if (SAVE) {
+            _mm512_storeu_pd(savedX+i, pos);
+            _mm512_storeu_pd(savedV+i, vel);
+            _mm512_storeu_pd(savedF+i, force);
+        }
+        __m512d v1 = _mm512_fmadd_pd(force, _mm512_loadu_pd(forceScale+i), vel);
+        __m512d v2 = _mm512_fmadd_pd(_mm512_loadu_pd(noiseScale+i), _mm512_loadu_pd(noise+i), _mm512_mul_pd(vscale, v1));
+        _mm512_storeu_pd(v+i, v2);
+        _mm512_storeu_pd(x+i, _mm512_fmadd_pd(v2, halfdt, _mm512_fmadd_pd(v1, halfdt, pos)));
+    }
+    updateScalar<SAVE>(i, end, x, v, f, forceScale, noiseScale, noise, velocityScale, halfStepSize, savedX, savedV, savedF);
+}
+#endif
+
+template <bool SAVE>
+void updateCoordinates(ReferenceFusedLangevinMiddleDynamics::InstructionSet instructionSet, int end, double* x, double* v, const double* f,
+        const double* forceScale, const double* noiseScale, const double* noise, double velocityScale, double halfStepSize,
+        double* savedX, double* savedV, double* savedF) {
+#ifdef SEEKR2_X86_SIMD
+    if (instructionSet == ReferenceFusedLangevinMiddleDynamics::Avx512) {
+        updateAvx512<SAVE>(end, x, v, f, forceScale, noiseScale, noise, velocityScale, halfStepSize, savedX, savedV, savedF);
+        return;
+    }
+    if (instructionSet == ReferenceFusedLangevinMiddleDynamics::Avx2) {
+        updateAvx2<SAVE>(end, x, v, f, forceScale, noiseScale, noise, velocityScale, halfStepSize, savedX, savedV, savedF);
+        return;
+    }
+#endif
+    updateScalar<SAVE>(0, end, x, v, f, forceScale, noiseScale, noise, velocityScale, halfStepSize, savedX, savedV, savedF);
+}
+
+} // namespace
+
+ReferenceFusedLangevinMiddleDynamics::ReferenceFusedLangevinMiddleDynamics(const vector<double>& masses, double stepSize, double friction, double temperature) {
+    instructionSet = getBestInstructionSet();
+    halfStepSize = 0.5*stepSize;
+    velocityScale = exp(-stepSize*friction);
+    double kT = BOLTZ*temperature;
+    double noiseFraction = sqrt(1-velocityScale*velocityScale);
+    int numParticles = masses.size();
+    forceScale.resize(3*numParticles, 0.0);
+    noiseScale.resize(3*numParticles, 0.0);
+    noise.resize(3*numParticles, 0.0);
+    for (int i = 0; i < numParticles; i++) {
+        if (masses[i] == 0.0) {
+            masslessParticles.push_back(i);
+            continue;
+        }
+        double inverseMass = 1.0/masses[i];
+        for (int j = 0; j < 3; j++) {
+            forceScale[3*i+j] = inverseMass*stepSize;
+            noiseScale[3*i+j] = noiseFraction*sqrt(kT*inverseMass);
+        }
+    }
+    masslessState.resize(2*masslessParticles.size());
+}
+
+bool ReferenceFusedLangevinMiddleDynamics::isSupported(const System& system) {
+    if (system.getNumConstraints() > 0)
+        return false;
+    for (int i = 0; i < system.getNumParticles(); i++)
+        if (system.isVirtualSite(i))
+            return false;
+    return true;
+}
+
+ReferenceFusedLangevinMiddleDynamics::InstructionSet ReferenceFusedLangevinMiddleDynamics::getBestInstructionSet() {
+#ifdef SEEKR2_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return Avx512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return Avx2;
+#endif
+    return Scalar;
+}
+
+string ReferenceFusedLangevinMiddleDynamics::getInstructionSetName(InstructionSet instructionSet) {
+    if (instructionSet == Avx512)
+        return "AVX-512";
+    if (instructionSet == Avx2)
+        return "AVX2";
+    return "scalar";
+}
+
+void ReferenceFusedLangevinMiddleDynamics::setInstructionSet(InstructionSet instructionSet) {
+    if (instructionSet > getBestInstructionSet())
+        throw OpenMMException("The "+getInstructionSetName(instructionSet)+" instruction set is not supported by this CPU");
+    this->instructionSet = instructionSet;
+}
+
+void ReferenceFusedLangevinMiddleDynamics::update(vector<Vec3>& positions, vector<Vec3>& velocities, const vector<Vec3>& forces,
+        Vec3* savedPositions, Vec3* savedVelocities, Vec3* savedForces) {
+    // Draw the noise in the same order as ReferenceLangevinMiddleDynamics.
+    // It is drawn even when the friction is zero and the noise is scaled by
+    // zero, so the same random numbers are consumed.
+    
+    int numParticles = positions.size();
+    for (int i = 0; i < numParticles; i++) {
+        if (forceScale[3*i] == 0.0)
+            continue;
+        for (int j = 0; j < 3; j++)
+            noise[3*i+j] = SimTKOpenMMUtilities::getNormallyDistributedRandomNumber();
+    }
+    
+    // Massless particles never move, so remember where they were.
+    
+    for (int i = 0; i < masslessParticles.size(); i++) {
+        masslessState[2*i] = positions[masslessParticles[i]];
+        masslessState[2*i+1] = velocities[masslessParticles[i]];
+    }
+    double* x = reinterpret_cast<double*>(&positions[0]);
+    double* v = reinterpret_cast<double*>(&velocities[0]);
+    const double* f = reinterpret_cast<const double*>(&forces[0]);
+    if (savedPositions != NULL)
+        updateCoordinates<true>(instructionSet, 3*numParticles, x, v, f, &forceScale[0], &noiseScale[0], &noise[0], velocityScale, halfStepSize,
+                reinterpret_cast<double*>(savedPositions), reinterpret_cast<double*>(savedVelocities), reinterpret_cast<double*>(savedForces));
+    else
+        updateCoordinates<false>(instructionSet, 3*numParticles, x, v, f, &forceScale[0], &noiseScale[0], &noise[0], velocityScale, halfStepSize,
+                NULL, NULL, NULL);
+    for (int i = 0; i < masslessParticles.size(); i++) {
+        positions[masslessParticles[i]] = masslessState[2*i];
+        velocities[masslessParticles[i]] = masslessState[2*i+1];
+    }
+}
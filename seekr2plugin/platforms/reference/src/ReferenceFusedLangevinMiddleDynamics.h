@@ -0,0 +1,123 @@
+#ifndef REFERENCE_FUSED_LANGEVIN_MIDDLE_DYNAMICS_H_
+#define REFERENCE_FUSED_LANGEVIN_MIDDLE_DYNAMICS_H_
+
+/*
+   Copyright 2019 by Lane Votapka
+   All rights reserved
+   
+   -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2014 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "openmm/System.h"
+#include "openmm/Vec3.h"
+#include <string>
+#include <vector>
+
+namespace Seekr2Plugin {
+
+/**
+ * This class takes LangevinMiddle steps for a System without constraints or
+ * virtual sites. It gives the same dynamics as ReferenceLangevinMiddleDynamics
+ * and draws the same random numbers from the same generator, but treats the
+ * positions, velocities and forces as flat arrays of coordinates and updates
+ * them in a single pass, using AVX-512 or AVX2 instructions when the CPU
+ * supports them. The same pass can also save the state at the start of the
+ * step, for kernels that may need to roll the step back.
+ */
+
+class ReferenceFusedLangevinMiddleDynamics {
+public:
+    /**
+     * The instruction sets the update may be computed with.
+     */
+    enum InstructionSet {
+        Scalar = 0,
+        Avx2 = 1,
+        Avx512 = 2
+    };
+    /**
+     * Create a ReferenceFusedLangevinMiddleDynamics.
+     *
+     * @param masses        the mass of each particle
+     * @param stepSize      the step size, in ps
+     * @param friction      the friction coefficient, in 1/ps
+     * @param temperature   the temperature of the heat bath, in K
+     */
+    ReferenceFusedLangevinMiddleDynamics(const std::vector<double>& masses, double stepSize, double friction, double temperature);
+    /**
+     * Get whether a System can be integrated by this class. Systems with
+     * constraints or virtual sites must use ReferenceLangevinMiddleDynamics.
+     */
+    static bool isSupported(const OpenMM::System& system);
+    /**
+     * Get the fastest instruction set supported by this CPU.
+     */
+    static InstructionSet getBestInstructionSet();
+    /**
+     * Get the name of an instruction set.
+     */
+    static std::string getInstructionSetName(InstructionSet instructionSet);
+    /**
+     * Get the instruction set used to compute the update.
+     */
+    InstructionSet getInstructionSet() const {
+        return instructionSet;
+    }
+    /**
+     * Set the instruction set used to compute the update. This is the best
+     * one supported by the CPU by default.
+     */
+    void setInstructionSet(InstructionSet instructionSet);
+    /**
+     * Take a step.
+     *
+     * @param positions       the particle positions, which are updated
+     * @param velocities      the particle velocities, which are updated
+     * @param forces          the forces acting on the particles
+     * @param savedPositions  if not NULL, on exit the positions at the start of the step
+     * @param savedVelocities on exit the velocities at the start of the step. This
+     *                        may only be NULL if savedPositions is NULL.
+     * @param savedForces     on exit a copy of the forces. This may only be NULL if
+     *                        savedPositions is NULL.
+     */
+    void update(std::vector<OpenMM::Vec3>& positions, std::vector<OpenMM::Vec3>& velocities, const std::vector<OpenMM::Vec3>& forces,
+            OpenMM::Vec3* savedPositions, OpenMM::Vec3* savedVelocities, OpenMM::Vec3* savedForces);
+private:
+    InstructionSet instructionSet;
+    double halfStepSize, velocityScale;
+    std::vector<double> forceScale, noiseScale, noise;
+    std::vector<int> masslessParticles;
+    std::vector<OpenMM::Vec3> masslessState;
+};
+
+} // namespace Seekr2Plugin
+
+#endif /*REFERENCE_FUSED_LANGEVIN_MIDDLE_DYNAMICS_H_*/
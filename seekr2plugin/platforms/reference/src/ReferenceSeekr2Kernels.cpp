@@ -35,6 +35,7 @@
 
 
 #include "ReferenceSeekr2Kernels.h"
+#include "ReferenceFusedLangevinMiddleDynamics.h"
 #include "MmvtLangevinMiddleIntegrator.h"
 #include "ElberLangevinMiddleIntegrator.h"
 #include "openmm/OpenMMException.h"
@@ -47,9 +48,8 @@
 #include "openmm/reference/ReferenceConstraints.h"
 #include "openmm/reference/ReferenceVirtualSites.h"
 #include "openmm/reference/ReferenceTabulatedFunction.h"
-#include "openmm/State.h"
-#include "openmm/serialization/XmlSerializer.h"
 #include <string.h>
+#include <algorithm>
 #include <sstream>
 #include <iostream>
 #include <fstream>
@@ -85,9 +85,11 @@ static const ReferenceVirtualSites& extractVirtualSites(ContextImpl& context) {
 }
 /**
  * Compute the kinetic energy of the system, possibly shifting the velocities in time to account
- * for a leapfrog integrator.
+ * for a leapfrog integrator. The shifted velocities are stored in a buffer owned by the caller,
+ * so that no memory is allocated once it has grown to the size of the system.
  */
-static double computeShiftedKineticEnergy(ContextImpl& context, vector<double>& masses, double timeShift) {
+static double computeShiftedKineticEnergy(ContextImpl& context, vector<double>& masses, vector<double>& inverseMasses, 
+        vector<Vec3>& shiftedVel, double timeShift) {
     vector<Vec3>& posData = extractPositions(context);
     vector<Vec3>& velData = extractVelocities(context);
     vector<Vec3>& forceData = extractForces(context);
@@ -95,7 +97,7 @@ static double computeShiftedKineticEnergy(ContextImpl& context, vector<double>&
     
     // Compute the shifted velocities.
     
-    vector<Vec3> shiftedVel(numParticles);
+    shiftedVel.resize(numParticles);
     for (int i = 0; i < numParticles; ++i) {
         if (masses[i] > 0)
             shiftedVel[i] = velData[i]+forceData[i]*(timeShift/masses[i]);
@@ -105,9 +107,6 @@ static double computeShiftedKineticEnergy(ContextImpl& context, vector<double>&
     
     // Apply constraints to them.
     
-    vector<double> inverseMasses(numParticles);
-    for (int i = 0; i < numParticles; i++)
-        inverseMasses[i] = (masses[i] == 0 ? 0 : 1/masses[i]);
     extractConstraints(context).applyToVelocities(posData, shiftedVel, inverseMasses, 1e-4);
     
     // Compute the kinetic energy.
@@ -122,14 +121,19 @@ static double computeShiftedKineticEnergy(ContextImpl& context, vector<double>&
 ReferenceIntegrateMmvtLangevinMiddleStepKernel::~ReferenceIntegrateMmvtLangevinMiddleStepKernel() {
     if (dynamics)
         delete dynamics;
+    if (fusedDynamics)
+        delete fusedDynamics;
 }
 
 void ReferenceIntegrateMmvtLangevinMiddleStepKernel::initialize(const System& system, const MmvtLangevinMiddleIntegrator& integrator) {
     int numParticles = system.getNumParticles();
     bool output_file_already_exists;
     masses.resize(numParticles);
-    for (int i = 0; i < numParticles; ++i)
+    inverseMasses.resize(numParticles);
+    for (int i = 0; i < numParticles; ++i) {
         masses[i] = system.getParticleMass(i);
+        inverseMasses[i] = (masses[i] == 0 ? 0 : 1/masses[i]);
+    }
     SimTKOpenMMUtilities::setRandomNumberSeed((unsigned int) integrator.getRandomNumberSeed());
     
     N_alpha_beta = vector<int> (integrator.getNumMilestoneGroups());
@@ -147,6 +151,7 @@ void ReferenceIntegrateMmvtLangevinMiddleStepKernel::initialize(const System& sy
     for (int i=0; i<integrator.getNumMilestoneGroups(); i++) {
         Ri_alpha[i] = 0.0;
     }
+    incubationTimeHistograms.assign(integrator.getNumMilestoneGroups(), vector<LogBinnedHistogram>(integrator.getNumMilestoneGroups()));
     T_alpha = 0.0;
     outputFileName = integrator.getOutputFileName();
     
@@ -165,13 +170,34 @@ void ReferenceIntegrateMmvtLangevinMiddleStepKernel::initialize(const System& sy
     } else {
         saveStatisticsBool = true;
     }
+    saveStateBeforeCrossing = integrator.getSaveStateBeforeCrossing();
+    saveFirstHitsOnly = integrator.getSaveFirstHitsOnly();
+    crossingSnapshotQueue = integrator.getCrossingSnapshotQueue();
+    crossingState.initialize(numParticles, integrator.getSaveStateAtomSelection(), integrator.getFullSaveStateInterval(),
+            integrator.getSaveStateEncoder());
+    reservoir.initialize(integrator.getNumMilestoneGroups(), integrator.getSaveStateReservoirSize(),
+            integrator.getSaveStateReservoirSpacing(), integrator.getRandomNumberSeed());
+    trajectory.initialize(integrator.getTrajectoryFileName(), system.getNumParticles(), system.usesPeriodicBoundaryConditions(),
+            integrator.getInnerStepSize(), integrator.getTrajectoryInterval(), integrator.getTrajectoryFramesBeforeCrossing(),
+            integrator.getTrajectoryFramesAfterCrossing(), integrator.getBoundaryCheckInterval());
+    boundaryCheckInterval = integrator.getBoundaryCheckInterval();
+    frames.resize(boundaryCheckInterval+1);
+    numFrames = 0;
+    safeStepDistanceGroup = integrator.getSafeStepDistanceGroup();
+    safeDistance = 0.0;
+    safeDisplacement = 0.0;
+    scheduler.initialize(boundaryCheckInterval, integrator.getAdaptiveBoundaryChecks());
+    if (!integrator.getStatusSegmentName().empty())
+        status.create(integrator.getStatusSegmentName(), milestoneGroups);
+    tracer.initialize(integrator.getTraceFileName(), "mmvt");
     bounceCounter = integrator.getBounceCounter();
     incubationTime = 0.0;
     firstCrossingTime = 0.0;
     previousMilestoneCrossed = -1;
     assert(data.stepCount == 0);
     assert(data.time == 0.0);
-    ofstream datafile; // open datafile for writing
+    // see whether the file already exists
+    ifstream datafile;
     datafile.open(outputFileName);
     if (datafile) {
         output_file_already_exists = true;
@@ -185,40 +211,50 @@ void ReferenceIntegrateMmvtLangevinMiddleStepKernel::initialize(const System& sy
         datafile << "#\"Bounced boundary ID\",\"bounce index\",\"total time (ps)\"\n";
         datafile.close(); // close data file
     }
+    
+    // Keep the crossing log open for the life of the kernel, rather than
+    // reopening it for every bounce.
+    
+    crossingLog.open(outputFileName, std::ios_base::app);
+    crossingLog.setf(std::ios::fixed,std::ios::floatfield);
+    crossingLog.precision(3);
 }
 
 void ReferenceIntegrateMmvtLangevinMiddleStepKernel::execute(ContextImpl& context, const MmvtLangevinMiddleIntegrator& integrator) {
     double temperature = integrator.getTemperature();
     double friction = integrator.getFriction();
-    double stepSize = integrator.getStepSize();
+    double stepSize = integrator.getInnerStepSize();
     bool includeForces = false;
     bool includeEnergy = true;
     double value = 0.0; // The value to monitor for crossing events
     
     vector<Vec3>& posData = extractPositions(context);
-    vector<Vec3> oldPosData(posData); // this will create an exact copy of old positions
     vector<Vec3>& velData = extractVelocities(context);
-    vector<Vec3> oldVelData(velData); // this will create an exact copy of old velocities
     vector<Vec3>& forceData = extractForces(context);
-    vector<Vec3> oldForceData(forceData); // this will create an exact copy of old forces
-    
-    map<string, double> globalParameters;
-    for (auto& name : globalParameterNames)
-        globalParameters[name] = context.getParameter(name);
     
     
-    if (dynamics == 0 || temperature != prevTemp || friction != prevFriction || stepSize != prevStepSize) {
-        // Recreate the computation objects with the new parameters.
+    if ((dynamics == 0 && fusedDynamics == 0) || temperature != prevTemp || friction != prevFriction || stepSize != prevStepSize) {
+        // Recreate the computation objects with the new parameters. Systems
+        // without constraints or virtual sites use the faster fused update.
         if (dynamics) {
             delete dynamics;
+            dynamics = 0;
+        }
+        if (fusedDynamics) {
+            delete fusedDynamics;
+            fusedDynamics = 0;
+        }
+        if (ReferenceFusedLangevinMiddleDynamics::isSupported(context.getSystem()))
+            fusedDynamics = new ReferenceFusedLangevinMiddleDynamics(masses, stepSize, friction, temperature);
+        else {
+            dynamics = new ReferenceLangevinMiddleDynamics(
+                    context.getSystem().getNumParticles(), 
+                    stepSize, 
+                    friction, 
+                    temperature);
+            dynamics->setReferenceConstraintAlgorithm(&extractConstraints(context));
+            dynamics->setVirtualSites(extractVirtualSites(context));
         }
-        dynamics = new ReferenceLangevinMiddleDynamics(
-                context.getSystem().getNumParticles(), 
-                stepSize, 
-                friction, 
-                temperature);
-        dynamics->setReferenceConstraintAlgorithm(&extractConstraints(context));
-        dynamics->setVirtualSites(extractVirtualSites(context));
         prevTemp = temperature;
         prevFriction = friction;
         prevStepSize = stepSize;
@@ -231,123 +267,413 @@ void ReferenceIntegrateMmvtLangevinMiddleStepKernel::execute(ContextImpl& contex
         }
     }
     
-    dynamics->update(context, posData, velData, masses, integrator.getConstraintTolerance());
-    // EXTRACT POSITIONS HERE AND TEST FOR CRITERIA
-    // NOTE: context positions and velocities are changed by reference
-    // test if criteria satisfied
-    // then reverse velocities by reference
-    // restore old positions
+    // Save the state at the start of the step, so that the simulation can
+    // be rolled back to it if the step turns out to cross a boundary. The
+    // fused update saves it in the same pass that takes the step.
+    
+    Frame& frame = frames[numFrames++];
+    frame.time = data.time;
+    frame.stepCount = data.stepCount;
+    frame.incubationTime = incubationTime;
+    {
+        TraceEventRecorder::Scope scope(tracer, "dynamics");
+        if (fusedDynamics) {
+            frame.positions.resize(posData.size());
+            frame.velocities.resize(velData.size());
+            frame.forces.resize(forceData.size());
+            fusedDynamics->update(posData, velData, forceData, &frame.positions[0], &frame.velocities[0], &frame.forces[0]);
+        }
+        else {
+            frame.positions = posData;
+            frame.velocities = velData;
+            frame.forces = forceData;
+            dynamics->update(context, posData, velData, masses, integrator.getConstraintTolerance());
+        }
+    }
+    data.time += stepSize;
+    data.stepCount++;
+    incubationTime += stepSize;
+    if (trajectory.isFrameStep(data.stepCount))
+        trajectory.recordFrame(context);
+    
+    // No boundary can have been crossed while the atoms have moved less than
+    // the safe distance since it was last evaluated.
+    
+    if (safeStepDistanceGroup >= 0) {
+        double maxDisplacement2 = 0.0;
+        for (int i = 0; i < posData.size(); i++) {
+            Vec3 delta = posData[i]-frame.positions[i];
+            maxDisplacement2 = max(maxDisplacement2, delta.dot(delta));
+        }
+        double displacement = sqrt(maxDisplacement2);
+        scheduler.stepTaken(displacement);
+        safeDisplacement += displacement;
+        if (safeDisplacement < safeDistance) {
+            scheduler.stepSafe();
+            numFrames = 0;
+            trajectory.stepsChecked(data.stepCount);
+            publishStatus();
+            return;
+        }
+    }
+    else
+        scheduler.stepTaken(-1.0);
+    if (numFrames >= scheduler.getInterval())
+        checkBoundaries(context, integrator);
+    
+    // Frames are only written to the trajectory once their steps can no
+    // longer be rolled back.
+    
+    if (numFrames == 0)
+        trajectory.stepsChecked(data.stepCount);
+    publishStatus();
+}
+
+void ReferenceIntegrateMmvtLangevinMiddleStepKernel::checkPendingBoundaries(ContextImpl& context, const MmvtLangevinMiddleIntegrator& integrator) {
+    checkBoundaries(context, integrator);
+    trajectory.stepsChecked(data.stepCount);
+    
+    // The positions may be changed before the next step, so the safe
+    // distance must be evaluated again.
+    
+    safeDistance = 0.0;
+    publishStatus();
+}
+
+void ReferenceIntegrateMmvtLangevinMiddleStepKernel::checkBoundaries(ContextImpl& context, const MmvtLangevinMiddleIntegrator& integrator) {
+    if (numFrames == 0)
+        return;
+    vector<Vec3>& posData = extractPositions(context);
+    vector<Vec3>& velData = extractVelocities(context);
+    vector<Vec3>& forceData = extractForces(context);
+    
+    // The safe distance only covers the current positions. The positions at
+    // the end of each earlier step in the interval are also in bounds if
+    // every atom is closer to them than the safe distance. Otherwise one of
+    // them may have crossed a boundary even though the current positions are
+    // back in bounds, so every saved step is checked.
+    
+    bool checkEveryStep = false;
+    if (safeStepDistanceGroup >= 0) {
+        {
+            TraceEventRecorder::Scope scope(tracer, "safe distance evaluation");
+            safeDistance = context.calcForcesAndEnergy(false, true, 1<<safeStepDistanceGroup);
+        }
+        safeDisplacement = 0.0;
+        scheduler.safeDistanceEvaluated(safeDistance);
+        if (safeDistance > 0.0) {
+            double maxDisplacement2 = 0.0;
+            for (int i = 1; i < numFrames; i++)
+                for (int j = 0; j < posData.size(); j++) {
+                    Vec3 delta = posData[j]-frames[i].positions[j];
+                    maxDisplacement2 = max(maxDisplacement2, delta.dot(delta));
+                }
+            if (sqrt(maxDisplacement2) < safeDistance) {
+                scheduler.checkPassed();
+                numFrames = 0;
+                return;
+            }
+        }
+        checkEveryStep = true;
+    }
+    double value = 0.0;
+    int crossingStep = -1;
+    if (!checkEveryStep) {
+        {
+            TraceEventRecorder::Scope scope(tracer, "boundary evaluation");
+            value = context.calcForcesAndEnergy(false, true, 2);
+        }
+        scheduler.boundariesEvaluated();
+        if (value <= 0.0) {
+            scheduler.checkPassed();
+            numFrames = 0;
+            return;
+        }
+        crossingStep = numFrames-1;
+    }
+    
+    // Find the first step that crossed a boundary. The state at the end of
+    // each step is the one saved at the start of the next, so the saved
+    // positions are checked in order until one is out of bounds.
+    
+    if (numFrames > 1) {
+        TraceEventRecorder::Scope scope(tracer, "boundary evaluation");
+        frames[numFrames].positions = posData;
+        frames[numFrames].velocities = velData;
+        for (int i = 1; i < numFrames; i++) {
+            posData = frames[i].positions;
+            double frameValue = context.calcForcesAndEnergy(false, true, 2);
+            scheduler.boundariesEvaluated();
+            if (frameValue > 0.0) {
+                crossingStep = i-1;
+                value = frameValue;
+                break;
+            }
+        }
+        posData = frames[numFrames].positions;
+    }
+    if (crossingStep == -1) {
+        // No earlier step crossed a boundary, so only the last one can have.
+        
+        {
+            TraceEventRecorder::Scope scope(tracer, "boundary evaluation");
+            value = context.calcForcesAndEnergy(false, true, 2);
+        }
+        scheduler.boundariesEvaluated();
+        if (value <= 0.0) {
+            scheduler.checkPassed();
+            numFrames = 0;
+            return;
+        }
+        crossingStep = numFrames-1;
+    }
+    if (numFrames > 1) {
+        posData = frames[crossingStep+1].positions;
+        velData = frames[crossingStep+1].velocities;
+    }
+    
+    // Record the bounce as of the crossing step, then take a step back and
+    // reverse the velocities of the particles.
+    
+    const Frame& start = frames[crossingStep];
+    data.time = start.time;
+    data.stepCount = start.stepCount;
+    incubationTime = start.incubationTime;
+    scheduler.rolledBack(numFrames-1-crossingStep, start.stepCount);
+    recordBounce(context, integrator, value, start);
+    {
+        TraceEventRecorder::Scope scope(tracer, "bounce restore");
+        posData = start.positions;
+        for (int j=0; j<velData.size(); j++) {
+            velData[j] = start.velocities[j] * -1.0;
+        }
+        forceData = start.forces;
+    }
+    data.time += integrator.getInnerStepSize();
+    data.stepCount++;
+    incubationTime += integrator.getInnerStepSize();
+    numFrames = 0;
+    safeDistance = 0.0;
+}
+
+void ReferenceIntegrateMmvtLangevinMiddleStepKernel::recordBounce(ContextImpl& context, const MmvtLangevinMiddleIntegrator& integrator, double value, const Frame& start) {
     int bitcode;
-    bool bounced = false;
     int num_bounced_surfaces = 0;
-    // Handle bit string here
-    value = context.calcForcesAndEnergy(includeForces, includeEnergy, 2);
-    if (value > 0.0) { // take a step back and reverse velocities
-        ofstream datafile; // open datafile for writing
-        datafile.open(outputFileName, std::ios_base::app); // append to file
-        datafile.setf(std::ios::fixed,std::ios::floatfield);
-        datafile.precision(3);
-        bitcode = static_cast<int>(value);
-        // check for corner bounce so as not to save state
-        for (int i=0; i<milestoneGroups.size(); i++) {
-            if ((bitcode % 2) != 0) {
-                // count the number of bounced surfaces
-                num_bounced_surfaces++;
-            }
+    bitcode = static_cast<int>(value);
+    // check for corner bounce so as not to save state
+    for (int i=0; i<milestoneGroups.size(); i++) {
+        if ((bitcode % 2) != 0) {
+            // count the number of bounced surfaces
+            num_bounced_surfaces++;
+        }
+        bitcode = bitcode >> 1;
+    }
+    bitcode = static_cast<int>(value);
+    for (int i=0; i<milestoneGroups.size(); i++) {
+        // Write to output file
+        if ((bitcode % 2) == 0) {
+            // if value is not showing this as crossed, continue
             bitcode = bitcode >> 1;
+            continue;
         }
-        bitcode = static_cast<int>(value);
-        for (int i=0; i<milestoneGroups.size(); i++) {
-            bounced = true;
-            // Write to output file
-            if ((bitcode % 2) == 0) {
-                // if value is not showing this as crossed, continue
-                bitcode = bitcode >> 1;
-                continue;
+        bitcode = bitcode >> 1;
+        crossingLog << milestoneGroups[i] << "," << bounceCounter << ","<< context.getTime() << "\n";
+        if (trajectory.isEnabled()) {
+            TraceEventRecorder::Scope scope(tracer, "trajectory write");
+            stringstream event_str;
+            event_str << "_" << bounceCounter << "_" << milestoneGroups[i];
+            trajectory.trigger(context, event_str.str());
+        }
+        // A bounce only samples the first hitting point distribution if the
+        // previous one was against a different boundary.
+        
+        bool firstHit = (previousMilestoneCrossed != -1 && previousMilestoneCrossed != i);
+        bool keepState = (num_bounced_surfaces == 1 && (firstHit || !saveFirstHitsOnly));
+        bool publishSnapshot = (crossingSnapshotQueue != NULL && keepState 
+                && crossingSnapshotQueue->acceptsMilestoneGroup(milestoneGroups[i]));
+        bool saveState = (saveStateBool == true && keepState);
+        int reservoirSlot = -1;
+        if (saveState && reservoir.isEnabled()) {
+            reservoirSlot = reservoir.offer(i, context.getStepCount());
+            saveState = (reservoirSlot >= 0);
+        }
+        if (saveState || publishSnapshot == true) {
+            // The positions and velocities still hold the end of the step
+            // that crossed the boundary, and the frame holds its start.
+            
+            TraceEventRecorder::Scope scope(tracer, "state serialization");
+            if (saveStateBeforeCrossing)
+                crossingState.capture(context, start.positions, start.velocities);
+            else
+                crossingState.capture(context, extractPositions(context), extractVelocities(context));
+            if (publishSnapshot == true) {
+                CrossingSnapshot snapshot;
+                snapshot.milestoneGroup = milestoneGroups[i];
+                snapshot.bounceIndex = bounceCounter;
+                crossingState.copyTo(snapshot);
+                crossingSnapshotQueue->publish(snapshot);
             }
-            bitcode = bitcode >> 1;
-            datafile << milestoneGroups[i] << "," << bounceCounter << ","<< context.getTime() << "\n";
-            if (saveStateBool == true && num_bounced_surfaces == 1) {
-                State myState = context.getOwner().getState(State::Positions | State::Velocities);
-                stringstream buffer;
+            if (saveState) {
                 stringstream number_str;
-                number_str << "_" << bounceCounter << "_" << milestoneGroups[i] ;
-                string trueFileName = saveStateFileName + number_str.str();
-                XmlSerializer::serialize<State>(&myState, "State", buffer);
-                ofstream statefile; // open datafile for writing
-                statefile.open(trueFileName, std::ios_base::out); // append to file
-                statefile << buffer.rdbuf();
-                statefile.close(); // close data file
-            }
-            
-            N_alpha_beta[i] += 1;
-            if (previousMilestoneCrossed != i) {
-                if (previousMilestoneCrossed != -1) { // if this isn't the first time a bounce has occurred
-                    Nij_alpha[previousMilestoneCrossed][i] += 1; 
-                    Ri_alpha[previousMilestoneCrossed] += incubationTime;
-                } else {
-                    firstCrossingTime = data.time;
-                }
-                incubationTime = 0.0;
+                if (reservoirSlot >= 0)
+                    number_str << "_reservoir_" << milestoneGroups[i] << "_" << reservoirSlot;
+                else
+                    number_str << "_" << bounceCounter << "_" << milestoneGroups[i];
+                crossingState.write(saveStateFileName + number_str.str());
             }
-            T_alpha = data.time - firstCrossingTime;
-            
-            previousMilestoneCrossed = i;
-            bounceCounter++;
         }
-        datafile.close(); // close data file
-        if (saveStatisticsBool == true) {
-            ofstream stats;
-            stats.open(saveStatisticsFileName, ios_base::trunc);
-            stats.setf(std::ios::fixed,std::ios::floatfield);
-            stats.precision(3);
-            for (int i = 0; i < N_alpha_beta.size(); i++) {
-                stats << "N_alpha_" << milestoneGroups[i] << ": " << N_alpha_beta[i] << "\n";
-            }
-            int nij_index = 0;
-            for (int i = 0; i < integrator.getNumMilestoneGroups(); i++) {
-                for (int j = 0; j < integrator.getNumMilestoneGroups(); j++) {
-                    stats << "N_" << milestoneGroups[i] << "_" << milestoneGroups[j] << "_alpha: " << Nij_alpha[i][j] << "\n"; 
-                    nij_index += 1;
-                }
-            }
-            for (int i = 0; i < integrator.getNumMilestoneGroups(); i++) {
-                stats << "R_" << milestoneGroups[i] << "_alpha: " << Ri_alpha[i] << "\n";       
+        
+        N_alpha_beta[i] += 1;
+        if (previousMilestoneCrossed != i) {
+            if (previousMilestoneCrossed != -1) { // if this isn't the first time a bounce has occurred
+                Nij_alpha[previousMilestoneCrossed][i] += 1; 
+                Ri_alpha[previousMilestoneCrossed] += incubationTime;
+                incubationTimeHistograms[previousMilestoneCrossed][i].addValue(incubationTime);
+            } else {
+                firstCrossingTime = data.time;
             }
-            stats << "T_alpha: " << T_alpha << "\n";  
-            stats.close();
+            incubationTime = 0.0;
         }
+        T_alpha = data.time - firstCrossingTime;
+        
+        previousMilestoneCrossed = i;
+        bounceCounter++;
     }
-    if (bounced == true) {
-        posData = oldPosData;
-        for (int j=0; j<velData.size(); j++) {
-            velData[j] = oldVelData[j] * -1.0; // take a step back and reverse the velocities of the particles
+    TraceEventRecorder::Scope scope(tracer, "event write");
+    crossingLog.flush();
+    if (saveStatisticsBool == true) {
+        ofstream stats;
+        stats.open(saveStatisticsFileName, ios_base::trunc);
+        stats.setf(std::ios::fixed,std::ios::floatfield);
+        stats.precision(3);
+        for (int i = 0; i < N_alpha_beta.size(); i++) {
+            stats << "N_alpha_" << milestoneGroups[i] << ": " << N_alpha_beta[i] << "\n";
         }
-        forceData = oldForceData;
+        int nij_index = 0;
+        for (int i = 0; i < integrator.getNumMilestoneGroups(); i++) {
+            for (int j = 0; j < integrator.getNumMilestoneGroups(); j++) {
+                stats << "N_" << milestoneGroups[i] << "_" << milestoneGroups[j] << "_alpha: " << Nij_alpha[i][j] << "\n"; 
+                nij_index += 1;
+            }
+        }
+        for (int i = 0; i < integrator.getNumMilestoneGroups(); i++) {
+            stats << "R_" << milestoneGroups[i] << "_alpha: " << Ri_alpha[i] << "\n";       
+        }
+        for (int i = 0; i < integrator.getNumMilestoneGroups(); i++) {
+            for (int j = 0; j < integrator.getNumMilestoneGroups(); j++) {
+                if (Nij_alpha[i][j] > 0)
+                    stats << "H_" << milestoneGroups[i] << "_" << milestoneGroups[j] << "_alpha: " << incubationTimeHistograms[i][j].toString() << "\n";
+            }
+        }
+        stats << "T_alpha: " << T_alpha << "\n";  
+        stats.close();
     }
-
-    data.time += stepSize;
-    data.stepCount++;
-    incubationTime += stepSize;
 }
 
 double ReferenceIntegrateMmvtLangevinMiddleStepKernel::computeKineticEnergy(ContextImpl& context, const MmvtLangevinMiddleIntegrator& integrator) {
-    return computeShiftedKineticEnergy(context, masses, 0.5*integrator.getStepSize());
+    // With multiple time steps, the velocities at the end of a step are not
+    // offset by half a step, so they are used as they are.
+    
+    bool multipleTimeSteps = (integrator.getNumInnerSteps() > 1 || integrator.getSlowForceGroups() != 0);
+    double timeShift = (multipleTimeSteps ? 0.0 : 0.5*integrator.getStepSize());
+    return computeShiftedKineticEnergy(context, masses, inverseMasses, shiftedVelocities, timeShift);
+}
+
+void ReferenceIntegrateMmvtLangevinMiddleStepKernel::kickVelocities(ContextImpl& context, const MmvtLangevinMiddleIntegrator& integrator, double dt) {
+    vector<Vec3>& posData = extractPositions(context);
+    vector<Vec3>& velData = extractVelocities(context);
+    vector<Vec3>& forceData = extractForces(context);
+    for (int i = 0; i < velData.size(); i++)
+        velData[i] += forceData[i]*(dt*inverseMasses[i]);
+    extractConstraints(context).applyToVelocities(posData, velData, inverseMasses, integrator.getConstraintTolerance());
+}
+
+void ReferenceIntegrateMmvtLangevinMiddleStepKernel::publishStatus() {
+    if (status.isOpen())
+        status.publish(data.stepCount, data.time, bounceCounter, N_alpha_beta, Nij_alpha, Ri_alpha, T_alpha, scheduler.getCounters());
+}
+
+void ReferenceIntegrateMmvtLangevinMiddleStepKernel::getStatistics(ContextImpl& context, MmvtAnchorStatistics& statistics) {
+    statistics.milestoneGroups = milestoneGroups;
+    statistics.N_alpha_beta = N_alpha_beta;
+    statistics.Nij_alpha = Nij_alpha;
+    statistics.Ri_alpha = Ri_alpha;
+    statistics.incubationTimeHistograms = incubationTimeHistograms;
+    statistics.T_alpha = T_alpha;
+}
+
+void ReferenceIntegrateMmvtLangevinMiddleStepKernel::getPerformanceCounters(ContextImpl& context, MmvtPerformanceCounters& counters) {
+    counters = scheduler.getCounters();
+}
+
+void ReferenceIntegrateMmvtLangevinMiddleStepKernel::flushTrace(ContextImpl& context) {
+    tracer.flush();
+}
+
+void ReferenceIntegrateMmvtLangevinMiddleStepKernel::createCheckpoint(ContextImpl& context, ostream& stream) const {
+    MmvtBounceCheckpoint checkpoint;
+    checkpoint.statistics.milestoneGroups = milestoneGroups;
+    checkpoint.statistics.N_alpha_beta = N_alpha_beta;
+    checkpoint.statistics.Nij_alpha = Nij_alpha;
+    checkpoint.statistics.Ri_alpha = Ri_alpha;
+    checkpoint.statistics.incubationTimeHistograms = incubationTimeHistograms;
+    checkpoint.statistics.T_alpha = T_alpha;
+    checkpoint.bounceCounter = bounceCounter;
+    checkpoint.previousMilestoneCrossed = previousMilestoneCrossed;
+    checkpoint.incubationTime = incubationTime;
+    checkpoint.firstCrossingTime = firstCrossingTime;
+    checkpoint.crossingLogSize = MmvtBounceCheckpoint::getCrossingLogSize(outputFileName);
+    checkpoint.write(stream);
+    reservoir.createCheckpoint(stream);
+}
+
+void ReferenceIntegrateMmvtLangevinMiddleStepKernel::loadCheckpoint(ContextImpl& context, istream& stream) {
+    MmvtBounceCheckpoint checkpoint;
+    checkpoint.read(stream);
+    checkpoint.checkMilestoneGroups(milestoneGroups);
+    reservoir.loadCheckpoint(stream);
+    crossingLog.close();
+    checkpoint.restoreCrossingLog(outputFileName);
+    crossingLog.open(outputFileName, std::ios_base::app);
+    N_alpha_beta = checkpoint.statistics.N_alpha_beta;
+    Nij_alpha = checkpoint.statistics.Nij_alpha;
+    Ri_alpha = checkpoint.statistics.Ri_alpha;
+    if (!checkpoint.statistics.incubationTimeHistograms.empty())
+        incubationTimeHistograms = checkpoint.statistics.incubationTimeHistograms;
+    T_alpha = checkpoint.statistics.T_alpha;
+    bounceCounter = checkpoint.bounceCounter;
+    previousMilestoneCrossed = checkpoint.previousMilestoneCrossed;
+    incubationTime = checkpoint.incubationTime;
+    firstCrossingTime = checkpoint.firstCrossingTime;
+    
+    // The positions were replaced along with the State, so nothing is known
+    // about how far they are from the boundaries.
+    
+    numFrames = 0;
+    safeDistance = 0.0;
+    safeDisplacement = 0.0;
+    publishStatus();
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 ReferenceIntegrateElberLangevinMiddleStepKernel::~ReferenceIntegrateElberLangevinMiddleStepKernel() {
-    
+    if (dynamics)
+        delete dynamics;
+    if (fusedDynamics)
+        delete fusedDynamics;
 }
 
 void ReferenceIntegrateElberLangevinMiddleStepKernel::initialize(const System& system, const ElberLangevinMiddleIntegrator& integrator) {
     int numParticles = system.getNumParticles();
     bool output_file_already_exists;
     masses.resize(numParticles);
-    for (int i = 0; i < numParticles; ++i)
+    inverseMasses.resize(numParticles);
+    for (int i = 0; i < numParticles; ++i) {
         masses[i] = system.getParticleMass(i);
+        inverseMasses[i] = (masses[i] == 0 ? 0 : 1/masses[i]);
+    }
     SimTKOpenMMUtilities::setRandomNumberSeed((unsigned int) integrator.getRandomNumberSeed());
     
     outputFileName = integrator.getOutputFileName();
@@ -381,6 +707,10 @@ void ReferenceIntegrateElberLangevinMiddleStepKernel::initialize(const System& s
     } else {
         saveStateBool = true;
     }
+    crossingState.initialize(numParticles);
+    trajectory.initialize(integrator.getTrajectoryFileName(), system.getNumParticles(), system.usesPeriodicBoundaryConditions(),
+            integrator.getStepSize(), integrator.getTrajectoryInterval(), integrator.getTrajectoryFramesBeforeCrossing(),
+            integrator.getTrajectoryFramesAfterCrossing());
     
     srcbitvector.clear();
     for (int i=0; i<srcMilestoneGroups.size(); i++) {
@@ -391,6 +721,7 @@ void ReferenceIntegrateElberLangevinMiddleStepKernel::initialize(const System& s
         destbitvector.push_back(pow(2,destMilestoneGroups[i]));
     }
     crossingCounter = integrator.getCrossingCounter();
+    tracer.initialize(integrator.getTraceFileName(), "elber");
     assert(data.stepCount == 0);
     assert(data.time == 0.0);
     ofstream datafile; // open datafile for writing
@@ -419,29 +750,41 @@ void ReferenceIntegrateElberLangevinMiddleStepKernel::execute(ContextImpl& conte
     vector<Vec3>& velData = extractVelocities(context);
     vector<Vec3>& forceData = extractForces(context);    
     
-    map<string, double> globalParameters;
-    for (auto& name : globalParameterNames)
-        globalParameters[name] = context.getParameter(name);
-    
     
-    if (dynamics == 0 || temperature != prevTemp || friction != prevFriction || stepSize != prevStepSize) {
-        // Recreate the computation objects with the new parameters.
+    if ((dynamics == 0 && fusedDynamics == 0) || temperature != prevTemp || friction != prevFriction || stepSize != prevStepSize) {
+        // Recreate the computation objects with the new parameters. Systems
+        // without constraints or virtual sites use the faster fused update.
         if (dynamics) {
             delete dynamics;
+            dynamics = 0;
+        }
+        if (fusedDynamics) {
+            delete fusedDynamics;
+            fusedDynamics = 0;
+        }
+        if (ReferenceFusedLangevinMiddleDynamics::isSupported(context.getSystem()))
+            fusedDynamics = new ReferenceFusedLangevinMiddleDynamics(masses, stepSize, friction, temperature);
+        else {
+            dynamics = new ReferenceLangevinMiddleDynamics(
+                    context.getSystem().getNumParticles(), 
+                    stepSize, 
+                    friction, 
+                    temperature);
+            dynamics->setReferenceConstraintAlgorithm(&extractConstraints(context));
+            dynamics->setVirtualSites(extractVirtualSites(context));
         }
-        dynamics = new ReferenceLangevinMiddleDynamics(
-                context.getSystem().getNumParticles(), 
-                stepSize, 
-                friction, 
-                temperature);
-        dynamics->setReferenceConstraintAlgorithm(&extractConstraints(context));
-        dynamics->setVirtualSites(extractVirtualSites(context));
         prevTemp = temperature;
         prevFriction = friction;
         prevStepSize = stepSize;
     }
     
-    dynamics->update(context, posData, velData, masses, integrator.getConstraintTolerance());
+    {
+        TraceEventRecorder::Scope scope(tracer, "dynamics");
+        if (fusedDynamics)
+            fusedDynamics->update(posData, velData, forceData, NULL, NULL, NULL);
+        else
+            dynamics->update(context, posData, velData, masses, integrator.getConstraintTolerance());
+    }
     // EXTRACT POSITIONS HERE AND TEST FOR CRITERIA
     // NOTE: context positions and velocities are changed by reference
     // test if criteria satisfied
@@ -453,11 +796,16 @@ void ReferenceIntegrateElberLangevinMiddleStepKernel::execute(ContextImpl& conte
     float oldvalue = 0.0;
     bool includeForces = false;
     bool includeEnergy = true;
+    int endMilestoneGroup = 0;
+    string trajectoryEvent;
     
     if (endSimulation == false) {
         // first check source milestone crossings
         for (int i=0; i<integrator.getNumSrcMilestoneGroups(); i++) {
-            value = context.calcForcesAndEnergy(includeForces, includeEnergy, srcbitvector[i]);
+            {
+                TraceEventRecorder::Scope scope(tracer, "boundary evaluation");
+                value = context.calcForcesAndEnergy(includeForces, includeEnergy, srcbitvector[i]);
+            }
             if (srcMilestoneValues[i] == -INFINITY) {
                 // First timestep
                 srcMilestoneValues[i] = value;
@@ -466,11 +814,14 @@ void ReferenceIntegrateElberLangevinMiddleStepKernel::execute(ContextImpl& conte
             if ((value - oldvalue) != 0.0) {
                 // The source milestone has been crossed
                 if (endOnSrcMilestone == true) {
+                    TraceEventRecorder::Scope scope(tracer, "event write");
                     endSimulation = true;
                     num_bounced_surfaces++;
                     ofstream datafile;
                     datafile.open(outputFileName, std::ios_base::app);
                     datafile << integrator.getSrcMilestoneGroup(i) << "," << crossingCounter << "," << context.getTime() << "\n";
+                    endMilestoneGroup = integrator.getSrcMilestoneGroup(i);
+                    firstPassageTimeHistograms[endMilestoneGroup].addValue(context.getTime());
                     datafile.close();
                 } else {
                     crossedSrcMilestone = true;
@@ -482,7 +833,10 @@ void ReferenceIntegrateElberLangevinMiddleStepKernel::execute(ContextImpl& conte
         
         // then check destination milestone crossings
         for (int i=0; i<integrator.getNumDestMilestoneGroups(); i++) {
-            value = context.calcForcesAndEnergy(includeForces, includeEnergy, destbitvector[i]);
+            {
+                TraceEventRecorder::Scope scope(tracer, "boundary evaluation");
+                value = context.calcForcesAndEnergy(includeForces, includeEnergy, destbitvector[i]);
+            }
             if (destMilestoneValues[i] == -INFINITY) {
                 // First timestep
                 destMilestoneValues[i] = value;
@@ -490,15 +844,18 @@ void ReferenceIntegrateElberLangevinMiddleStepKernel::execute(ContextImpl& conte
             oldvalue = destMilestoneValues[i];
             if ((value - oldvalue) != 0.0) {
                 // The destination milestone has been crossed
+                TraceEventRecorder::Scope scope(tracer, "event write");
                 endSimulation = true;
                 num_bounced_surfaces++;
                 ofstream datafile;
                 datafile.open(outputFileName, std::ios_base::app);
                 if ((crossedSrcMilestone == true) || (endOnSrcMilestone == true)) {
                     datafile << integrator.getDestMilestoneGroup(i) << "," << crossingCounter << "," << context.getTime() << "\n";
+                    firstPassageTimeHistograms[integrator.getDestMilestoneGroup(i)].addValue(context.getTime());
                 } else {
                     datafile << integrator.getDestMilestoneGroup(i) << "*," << crossingCounter << "," << context.getTime() << "\n";
                 }
+                endMilestoneGroup = integrator.getDestMilestoneGroup(i);
                 datafile.close();
             } 
         }
@@ -506,24 +863,53 @@ void ReferenceIntegrateElberLangevinMiddleStepKernel::execute(ContextImpl& conte
         if (endSimulation == true) {
             // Then a crossing event has just occurred.
             if (saveStateBool == true && num_bounced_surfaces == 1) {
-                State myState = context.getOwner().getState(State::Positions | State::Velocities);
-                stringstream buffer;
+                TraceEventRecorder::Scope scope(tracer, "state serialization");
                 stringstream number_str;
                 number_str << "_" << crossingCounter << "_" << crossingCounter;
-                string trueFileName = saveStateFileName + number_str.str();
-                XmlSerializer::serialize<State>(&myState, "State", buffer);
-                ofstream statefile; // open datafile for writing
-                statefile.open(trueFileName, std::ios_base::trunc); // append to file
-                statefile << buffer.rdbuf();
-                statefile.close(); // close data file
+                crossingState.capture(context, posData, velData);
+                crossingState.write(saveStateFileName + number_str.str());
+            }
+            if (trajectory.isEnabled()) {
+                stringstream event_str;
+                event_str << "_" << crossingCounter << "_" << endMilestoneGroup;
+                trajectoryEvent = event_str.str();
             }
             crossingCounter ++;
         }
     }
     data.time += stepSize;
     data.stepCount++;
+    
+    // The frame at a crossing is always written to its trajectory.
+    
+    if (trajectory.isFrameStep(data.stepCount) || !trajectoryEvent.empty())
+        trajectory.recordFrame(context);
+    if (!trajectoryEvent.empty()) {
+        TraceEventRecorder::Scope scope(tracer, "trajectory write");
+        trajectory.trigger(context, trajectoryEvent);
+    }
 }
 
 double ReferenceIntegrateElberLangevinMiddleStepKernel::computeKineticEnergy(ContextImpl& context, const ElberLangevinMiddleIntegrator& integrator) {
-    return computeShiftedKineticEnergy(context, masses, 0.5*integrator.getStepSize());
+    return computeShiftedKineticEnergy(context, masses, inverseMasses, shiftedVelocities, 0.5*integrator.getStepSize());
+}
+
+void ReferenceIntegrateElberLangevinMiddleStepKernel::resetCrossingState(ContextImpl& context, const ElberLangevinMiddleIntegrator& integrator) {
+    for (int i=0; i<srcMilestoneValues.size(); i++) {
+        srcMilestoneValues[i] = -INFINITY;
+    }
+    for (int i=0; i<destMilestoneValues.size(); i++) {
+        destMilestoneValues[i] = -INFINITY;
+    }
+    crossedSrcMilestone = false;
+    endSimulation = false;
+}
+
+void ReferenceIntegrateElberLangevinMiddleStepKernel::getFirstPassageTimeHistogram(ContextImpl& context, int milestoneGroup, LogBinnedHistogram& histogram) {
+    map<int, LogBinnedHistogram>::const_iterator entry = firstPassageTimeHistograms.find(milestoneGroup);
+    histogram = (entry == firstPassageTimeHistograms.end() ? LogBinnedHistogram() : entry->second);
+}
+
+void ReferenceIntegrateElberLangevinMiddleStepKernel::flushTrace(ContextImpl& context) {
+    tracer.flush();
 }
@@ -41,16 +41,26 @@
 #include "openmm/reference/ReferenceLangevinMiddleDynamics.h"
 #include "openmm/reference/RealVec.h"
 #include "Seekr2Kernels.h"
+#include "MmvtStatusSegment.h"
+#include "internal/CrossingStateReservoir.h"
+#include "internal/CrossingStateWriter.h"
+#include "internal/CrossingTrajectoryRecorder.h"
+#include "internal/MmvtBoundaryCheckScheduler.h"
+#include "internal/MmvtBounceCheckpoint.h"
+#include "internal/TraceEventRecorder.h"
 #include "openmm/Platform.h"
-#include <vector>
+#include <fstream>
 #include <map>
+#include <vector>
 
 namespace Seekr2Plugin {
 
+class ReferenceFusedLangevinMiddleDynamics;
+
 class ReferenceIntegrateMmvtLangevinMiddleStepKernel : public IntegrateMmvtLangevinMiddleStepKernel {
 public:
     ReferenceIntegrateMmvtLangevinMiddleStepKernel(std::string name, const OpenMM::Platform& platform, OpenMM::ReferencePlatform::PlatformData& data) : IntegrateMmvtLangevinMiddleStepKernel(name, platform),
-        data(data), dynamics(0) {
+        data(data), dynamics(0), fusedDynamics(0), crossingSnapshotQueue(0) {
     }
     ~ReferenceIntegrateMmvtLangevinMiddleStepKernel();
     /**
@@ -74,33 +84,107 @@ public:
      * @param integrator the MmvtLangevinMiddleIntegrator this kernel is being used for
      */
     double computeKineticEnergy(OpenMM::ContextImpl& context, const MmvtLangevinMiddleIntegrator& integrator);
-    
+    /**
+     * Get the transition statistics accumulated so far.
+     * 
+     * @param context    the context in which to execute this kernel
+     * @param statistics on exit, the accumulated statistics
+     */
+    void getStatistics(OpenMM::ContextImpl& context, MmvtAnchorStatistics& statistics);
+    /**
+     * Check the boundaries for any steps taken since they were last checked,
+     * and bounce if one was crossed.
+     * 
+     * @param context    the context in which to execute this kernel
+     * @param integrator the MmvtLangevinMiddleIntegrator this kernel is being used for
+     */
+    void checkPendingBoundaries(OpenMM::ContextImpl& context, const MmvtLangevinMiddleIntegrator& integrator);
+    /**
+     * Get the counters describing the work spent monitoring the boundaries.
+     * 
+     * @param context    the context in which to execute this kernel
+     * @param counters   on exit, the performance counters
+     */
+    void getPerformanceCounters(OpenMM::ContextImpl& context, MmvtPerformanceCounters& counters);
+    /**
+     * Add the current forces, multiplied by a time step and divided by the
+     * particle masses, to the velocities.
+     * 
+     * @param context    the context in which to execute this kernel
+     * @param integrator the MmvtLangevinMiddleIntegrator this kernel is being used for
+     * @param dt         the time step over which the forces act
+     */
+    void kickVelocities(OpenMM::ContextImpl& context, const MmvtLangevinMiddleIntegrator& integrator, double dt);
+    /**
+     * Write the trace events recorded so far to the trace file.
+     * 
+     * @param context    the context in which to execute this kernel
+     */
+    void flushTrace(OpenMM::ContextImpl& context);
+    /**
+     * Write the bounce counter, the transition statistics and the incubation
+     * under way to a checkpoint.
+     * 
+     * @param context    the context in which to execute this kernel
+     * @param stream     the stream to write the checkpoint to
+     */
+    void createCheckpoint(OpenMM::ContextImpl& context, std::ostream& stream) const;
+    /**
+     * Load a checkpoint written by createCheckpoint().
+     * 
+     * @param context    the context in which to execute this kernel
+     * @param stream     the stream to read the checkpoint from
+     */
+    void loadCheckpoint(OpenMM::ContextImpl& context, std::istream& stream);
     
 private:
+    /**
+     * The state at the start of a step that has not yet been checked for
+     * boundary crossings.
+     */
+    struct Frame {
+        std::vector<OpenMM::Vec3> positions, velocities, forces;
+        double time, incubationTime;
+        long long stepCount;
+    };
+    void checkBoundaries(OpenMM::ContextImpl& context, const MmvtLangevinMiddleIntegrator& integrator);
+    void recordBounce(OpenMM::ContextImpl& context, const MmvtLangevinMiddleIntegrator& integrator, double value, const Frame& start);
+    void publishStatus();
     OpenMM::ReferencePlatform::PlatformData& data;
     OpenMM::ReferenceLangevinMiddleDynamics* dynamics;
-    std::vector<double> masses;
+    ReferenceFusedLangevinMiddleDynamics* fusedDynamics;
+    std::vector<double> masses, inverseMasses;
+    std::vector<OpenMM::Vec3> shiftedVelocities;
     double prevTemp, prevFriction, prevStepSize;
-    std::vector<OpenMM::Vec3> oldPosData;
-    std::vector<OpenMM::Vec3> oldVelData;
-    std::vector<OpenMM::Vec3> oldForceData;
     
     std::vector<int> N_alpha_beta;
     std::vector<std::vector <int> > Nij_alpha;
     std::vector<double> Ri_alpha;
+    std::vector<std::vector<LogBinnedHistogram> > incubationTimeHistograms;
     double T_alpha;
     std::string outputFileName;
+    std::ofstream crossingLog;
     std::vector<int> milestoneGroups;
     bool saveStateBool = false;
     std::string saveStateFileName;
+    bool saveStateBeforeCrossing, saveFirstHitsOnly;
+    CrossingStateWriter crossingState;
+    CrossingStateReservoir reservoir;
+    CrossingTrajectoryRecorder trajectory;
     bool saveStatisticsBool = false;
     std::string saveStatisticsFileName;
+    CrossingSnapshotQueue* crossingSnapshotQueue;
     //std::vector<int> bitvector; // TODO: marked for removal
-    std::vector<std::string> globalParameterNames;
     int numMilestoneGroups, bounceCounter, previousMilestoneCrossed;
     double firstCrossingTime;
     double incubationTime;
-    
+    std::vector<Frame> frames;
+    int boundaryCheckInterval, numFrames;
+    int safeStepDistanceGroup;
+    double safeDistance, safeDisplacement;
+    MmvtBoundaryCheckScheduler scheduler;
+    MmvtStatusSegment status;
+    TraceEventRecorder tracer;
 };
 
 /**
@@ -111,7 +195,7 @@ private:
 class ReferenceIntegrateElberLangevinMiddleStepKernel : public IntegrateElberLangevinMiddleStepKernel {
 public:
     ReferenceIntegrateElberLangevinMiddleStepKernel(std::string name, const OpenMM::Platform& platform, OpenMM::ReferencePlatform::PlatformData& data) : IntegrateElberLangevinMiddleStepKernel(name, platform),
-        data(data), dynamics(0) {
+        data(data), dynamics(0), fusedDynamics(0) {
     }
     ~ReferenceIntegrateElberLangevinMiddleStepKernel();
     /**
@@ -135,11 +219,35 @@ public:
      * @param integrator the ElberLangevinMiddleIntegrator this kernel is being used for
      */
     double computeKineticEnergy(OpenMM::ContextImpl& context, const ElberLangevinMiddleIntegrator& integrator);
+    /**
+     * Forget any milestone crossings seen so far.
+     * 
+     * @param context    the context in which to execute this kernel
+     * @param integrator the ElberLangevinMiddleIntegrator this kernel is being used for
+     */
+    void resetCrossingState(OpenMM::ContextImpl& context, const ElberLangevinMiddleIntegrator& integrator);
+    /**
+     * Get the distribution of the first passage times of the trajectories
+     * that ended on a milestone.
+     * 
+     * @param context        the context in which to execute this kernel
+     * @param milestoneGroup the milestone group the trajectories ended on
+     * @param histogram      on exit, the distribution of first passage times
+     */
+    void getFirstPassageTimeHistogram(OpenMM::ContextImpl& context, int milestoneGroup, LogBinnedHistogram& histogram);
+    /**
+     * Write the trace events recorded so far to the trace file.
+     * 
+     * @param context    the context in which to execute this kernel
+     */
+    void flushTrace(OpenMM::ContextImpl& context);
     
 private:
     OpenMM::ReferencePlatform::PlatformData& data;
     OpenMM::ReferenceLangevinMiddleDynamics* dynamics;
-    std::vector<double> masses;
+    ReferenceFusedLangevinMiddleDynamics* fusedDynamics;
+    std::vector<double> masses, inverseMasses;
+    std::vector<OpenMM::Vec3> shiftedVelocities;
     double prevTemp, prevFriction, prevStepSize;
     
     std::string outputFileName;
@@ -154,7 +262,10 @@ private:
     bool endSimulation = false; // If an ending milestone was crossed, then don't log any more crossings
     bool saveStateBool = false;
     std::string saveStateFileName;
-    std::vector<std::string> globalParameterNames;
+    CrossingStateWriter crossingState;
+    CrossingTrajectoryRecorder trajectory;
+    std::map<int, LogBinnedHistogram> firstPassageTimeHistograms;
+    TraceEventRecorder tracer;
     int numSrcMilestoneGroups, numDestMilestoneGroups;
     int crossingCounter;
 };
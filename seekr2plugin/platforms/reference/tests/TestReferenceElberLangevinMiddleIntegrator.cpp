@@ -39,6 +39,7 @@
 
 #include "ElberLangevinMiddleIntegrator.h"
 #include "openmm/internal/AssertionUtilities.h"
+#include "openmm/CustomExternalForce.h"
 #include "openmm/HarmonicBondForce.h"
 #include "openmm/NonbondedForce.h"
 #include "openmm/Context.h"
@@ -49,7 +50,10 @@
 #include "openmm/reference/ReferencePlatform.h"
 #include "sfmt/SFMT.h"
 #include <cmath>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include <vector>
 
 using namespace Seekr2Plugin;
@@ -283,6 +287,102 @@ void testRandomSeed() {
     }
 }
 
+void testFirstPassageTimeHistogram() {
+    // Without friction, a particle moving at 1 nm/ps reaches the destination
+    // milestone at x=1 after a time equal to its starting distance from it.
+    
+    Platform& platform = Platform::getPlatformByName("Reference");
+    System system;
+    system.addParticle(1.0);
+    const char* fileName = "/tmp/dummy_first_passage.txt";
+    ElberLangevinMiddleIntegrator integrator(0.0, 0.0, 0.01, fileName);
+    integrator.addSrcMilestoneGroup(1);
+    integrator.addDestMilestoneGroup(2);
+    integrator.setEndOnSrcMilestone(true);
+    CustomExternalForce* source = new CustomExternalForce("step(-1.0-x)");
+    source->addParticle(0);
+    source->setForceGroup(1);
+    system.addForce(source);
+    CustomExternalForce* destination = new CustomExternalForce("step(x-1.0)");
+    destination->addParticle(0);
+    destination->setForceGroup(2);
+    system.addForce(destination);
+    Context context(system, integrator, platform);
+    vector<Vec3> positions(1);
+    vector<Vec3> velocities(1);
+    positions[0] = Vec3(0.0, 0, 0);
+    velocities[0] = Vec3(1.0, 0, 0);
+    context.setPositions(positions);
+    context.setVelocities(velocities);
+    integrator.step(200);
+    LogBinnedHistogram histogram = integrator.getFirstPassageTimeHistogram(2);
+    ASSERT_EQUAL(1, (int) histogram.getTotalCount());
+    ASSERT_EQUAL_TOL(1.0, histogram.getMean(), 0.02);
+    
+    // A second trajectory adds to the same histogram.
+    
+    CrossingSnapshot snapshot;
+    system.getDefaultPeriodicBoxVectors(snapshot.periodicBoxVectors[0], snapshot.periodicBoxVectors[1], snapshot.periodicBoxVectors[2]);
+    snapshot.positions.push_back(Vec3(0.5, 0, 0));
+    snapshot.velocities.push_back(Vec3(1.0, 0, 0));
+    integrator.loadCrossingSnapshot(snapshot);
+    integrator.step(200);
+    histogram = integrator.getFirstPassageTimeHistogram(2);
+    ASSERT_EQUAL(2, (int) histogram.getTotalCount());
+    ASSERT_EQUAL_TOL(1.5, histogram.getSum(), 0.02);
+    ASSERT_EQUAL(0, (int) integrator.getFirstPassageTimeHistogram(1).getTotalCount());
+    remove(fileName);
+}
+
+void testTraceFile() {
+    // A trajectory that reaches the destination milestone records the
+    // dynamics, the milestone evaluations and the write of the crossing.
+    
+    Platform& platform = Platform::getPlatformByName("Reference");
+    System system;
+    system.addParticle(1.0);
+    const char* fileName = "/tmp/dummy_elber_trace.txt";
+    const char* traceFileName = "/tmp/dummy_elber_trace.json";
+    ElberLangevinMiddleIntegrator integrator(0.0, 0.0, 0.01, fileName);
+    integrator.addSrcMilestoneGroup(1);
+    integrator.addDestMilestoneGroup(2);
+    integrator.setEndOnSrcMilestone(true);
+    integrator.setTraceFileName(traceFileName);
+    CustomExternalForce* source = new CustomExternalForce("step(-1.0-x)");
+    source->addParticle(0);
+    source->setForceGroup(1);
+    system.addForce(source);
+    CustomExternalForce* destination = new CustomExternalForce("step(x-1.0)");
+    destination->addParticle(0);
+    destination->setForceGroup(2);
+    system.addForce(destination);
+    Context* context = new Context(system, integrator, platform);
+    vector<Vec3> positions(1);
+    vector<Vec3> velocities(1);
+    positions[0] = Vec3(0.0, 0, 0);
+    velocities[0] = Vec3(1.0, 0, 0);
+    context->setPositions(positions);
+    context->setVelocities(velocities);
+    integrator.step(200);
+    ASSERT_EQUAL(1, (int) integrator.getFirstPassageTimeHistogram(2).getTotalCount());
+    delete context;
+    ifstream traceFile(traceFileName);
+    stringstream contents;
+    contents << traceFile.rdbuf();
+    traceFile.close();
+    string trace = contents.str();
+    ASSERT(trace.size() > 0 && trace[0] == '[');
+    size_t last = trace.find_last_not_of(" \n");
+    ASSERT(last != string::npos && trace[last] == ']');
+    const char* phases[] = {"dynamics", "boundary evaluation", "event write"};
+    for (int i = 0; i < 3; i++) {
+        string event = string("\"name\":\"")+phases[i]+"\",\"cat\":\"elber\",\"ph\":\"X\"";
+        ASSERT(trace.find(event) != string::npos);
+    }
+    remove(fileName);
+    remove(traceFileName);
+}
+
 void runPlatformTests();
 
 int main() {
@@ -301,6 +401,10 @@ int main() {
         testConstrainedMasslessParticles();
         std::cout << "running testRandomSeed\n";
         testRandomSeed();
+        std::cout << "running testFirstPassageTimeHistogram\n";
+        testFirstPassageTimeHistogram();
+        std::cout << "running testTraceFile\n";
+        testTraceFile();
         //runPlatformTests();
         //testIntegrator();
     }
@@ -0,0 +1,189 @@
+/*
+   Copyright 2019 by Lane Votapka
+   All rights reserved
+   
+   -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2014 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * This tests ReferenceFusedLangevinMiddleDynamics with every instruction set
+ * the CPU supports, against the scalar code and against OpenMM's
+ * LangevinMiddleIntegrator.
+ */
+
+#include "ReferenceFusedLangevinMiddleDynamics.h"
+#include "openmm/OpenMMException.h"
+#include "openmm/internal/AssertionUtilities.h"
+#include "openmm/reference/SimTKOpenMMUtilities.h"
+#include "openmm/Context.h"
+#include "openmm/HarmonicBondForce.h"
+#include "openmm/LangevinMiddleIntegrator.h"
+#include "openmm/Platform.h"
+#include "openmm/System.h"
+#include "openmm/VerletIntegrator.h"
+#include <iostream>
+#include <vector>
+
+using namespace Seekr2Plugin;
+using namespace OpenMM;
+using namespace std;
+
+const int numParticles = 13;
+const int numSteps = 50;
+const int seed = 11;
+const double temperature = 300.0;
+const double stepSize = 0.002;
+
+/**
+ * Build a chain of particles with a range of masses, including a massless
+ * one. The number of coordinates is not a multiple of the vector width, so
+ * the scalar remainder of each SIMD loop is exercised too.
+ */
+void createSystem(System& system, vector<Vec3>& positions, vector<Vec3>& velocities) {
+    HarmonicBondForce* bonds = new HarmonicBondForce();
+    for (int i = 0; i < numParticles; i++) {
+        system.addParticle(i == 4 ? 0.0 : 1.0+1.5*i);
+        positions.push_back(Vec3(0.12*i, 0.05*(i%3), -0.02*(i%4)));
+        velocities.push_back(i == 4 ? Vec3() : Vec3(0.3*(i%5)-0.6, 0.1*(i%2), 0.25-0.05*i));
+        if (i > 0)
+            bonds->addBond(i-1, i, 0.1, 5000.0);
+    }
+    system.addForce(bonds);
+}
+
+/**
+ * Integrate with ReferenceFusedLangevinMiddleDynamics, computing the forces
+ * with a separate Context. Every other step also saves the state at its
+ * start, which must not change the result.
+ */
+void integrateFused(const System& system, double friction, ReferenceFusedLangevinMiddleDynamics::InstructionSet instructionSet,
+        vector<Vec3>& positions, vector<Vec3>& velocities) {
+    VerletIntegrator integrator(stepSize);
+    Context context(system, integrator, Platform::getPlatformByName("Reference"));
+    vector<double> masses;
+    for (int i = 0; i < numParticles; i++)
+        masses.push_back(system.getParticleMass(i));
+    ReferenceFusedLangevinMiddleDynamics dynamics(masses, stepSize, friction, temperature);
+    dynamics.setInstructionSet(instructionSet);
+    ASSERT_EQUAL(instructionSet, dynamics.getInstructionSet());
+    vector<Vec3> savedPositions(numParticles), savedVelocities(numParticles), savedForces(numParticles);
+    SimTKOpenMMUtilities::setRandomNumberSeed(seed);
+    for (int step = 0; step < numSteps; step++) {
+        context.setPositions(positions);
+        vector<Vec3> forces = context.getState(State::Forces).getForces();
+        if (step%2 == 0) {
+            vector<Vec3> startPositions = positions, startVelocities = velocities;
+            dynamics.update(positions, velocities, forces, &savedPositions[0], &savedVelocities[0], &savedForces[0]);
+            for (int i = 0; i < numParticles; i++) {
+                ASSERT_EQUAL_VEC(startPositions[i], savedPositions[i], 0.0);
+                ASSERT_EQUAL_VEC(startVelocities[i], savedVelocities[i], 0.0);
+                ASSERT_EQUAL_VEC(forces[i], savedForces[i], 0.0);
+            }
+        }
+        else
+            dynamics.update(positions, velocities, forces, NULL, NULL, NULL);
+    }
+}
+
+void testInstructionSets(double friction) {
+    System system;
+    vector<Vec3> initialPositions, initialVelocities;
+    createSystem(system, initialPositions, initialVelocities);
+    
+    // Integrate with OpenMM's LangevinMiddleIntegrator, then draw one more
+    // random number to see how many it consumed.
+    
+    LangevinMiddleIntegrator integrator(temperature, friction, stepSize);
+    integrator.setRandomNumberSeed(seed);
+    Context context(system, integrator, Platform::getPlatformByName("Reference"));
+    context.setPositions(initialPositions);
+    context.setVelocities(initialVelocities);
+    integrator.step(numSteps);
+    State state = context.getState(State::Positions | State::Velocities);
+    double nextRandom = SimTKOpenMMUtilities::getNormallyDistributedRandomNumber();
+    
+    // Every instruction set must reproduce it, and consume the same random
+    // numbers. The SIMD code uses fused multiply-adds, so it may differ from
+    // the scalar code in the last bits.
+    
+    vector<Vec3> scalarPositions, scalarVelocities;
+    for (int set = ReferenceFusedLangevinMiddleDynamics::Scalar; set <= ReferenceFusedLangevinMiddleDynamics::getBestInstructionSet(); set++) {
+        ReferenceFusedLangevinMiddleDynamics::InstructionSet instructionSet = (ReferenceFusedLangevinMiddleDynamics::InstructionSet) set;
+        std::cout << "    " << ReferenceFusedLangevinMiddleDynamics::getInstructionSetName(instructionSet) << ", friction " << friction << "\n";
+        vector<Vec3> positions = initialPositions, velocities = initialVelocities;
+        integrateFused(system, friction, instructionSet, positions, velocities);
+        ASSERT_EQUAL(nextRandom, SimTKOpenMMUtilities::getNormallyDistributedRandomNumber());
+        if (instructionSet == ReferenceFusedLangevinMiddleDynamics::Scalar) {
+            scalarPositions = positions;
+            scalarVelocities = velocities;
+        }
+        for (int i = 0; i < numParticles; i++) {
+            ASSERT_EQUAL_VEC(scalarPositions[i], positions[i], 1e-13);
+            ASSERT_EQUAL_VEC(scalarVelocities[i], velocities[i], 1e-13);
+            ASSERT_EQUAL_VEC(state.getPositions()[i], positions[i], 1e-10);
+            ASSERT_EQUAL_VEC(state.getVelocities()[i], velocities[i], 1e-10);
+        }
+        ASSERT_EQUAL_VEC(initialPositions[4], positions[4], 0.0);
+        ASSERT_EQUAL_VEC(Vec3(), velocities[4], 0.0);
+    }
+}
+
+void testUnsupportedInstructionSet() {
+    vector<double> masses(2, 1.0);
+    ReferenceFusedLangevinMiddleDynamics dynamics(masses, stepSize, 1.0, temperature);
+    ASSERT_EQUAL(ReferenceFusedLangevinMiddleDynamics::getBestInstructionSet(), dynamics.getInstructionSet());
+    if (dynamics.getInstructionSet() == ReferenceFusedLangevinMiddleDynamics::Avx512)
+        return;
+    bool failed = false;
+    try {
+        dynamics.setInstructionSet(ReferenceFusedLangevinMiddleDynamics::Avx512);
+    }
+    catch (OpenMMException& ex) {
+        failed = true;
+    }
+    ASSERT(failed);
+}
+
+int main() {
+    try {
+        std::cout << "running testInstructionSets\n";
+        testInstructionSets(5.0);
+        testInstructionSets(0.0);
+        std::cout << "running testUnsupportedInstructionSet\n";
+        testUnsupportedInstructionSet();
+    }
+    catch(const std::exception& e) {
+        std::cout << "exception: " << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << "Done" << std::endl;
+    return 0;
+}
@@ -0,0 +1,131 @@
+/*
+   Copyright 2019 by Lane Votapka
+   All rights reserved
+   
+   -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2014 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * This tests that steps of the Reference implementation of
+ * MmvtLangevinMiddleIntegrator which do not bounce allocate no memory.
+ */
+
+#include "MmvtLangevinMiddleIntegrator.h"
+#include "openmm/internal/AssertionUtilities.h"
+#include "openmm/HarmonicBondForce.h"
+#include "openmm/Context.h"
+#include "openmm/Platform.h"
+#include "openmm/System.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <vector>
+
+using namespace Seekr2Plugin;
+using namespace OpenMM;
+using namespace std;
+
+extern "C" OPENMM_EXPORT void registerSeekr2ReferenceKernelFactories();
+
+// Every allocation made through operator new while counting is enabled is
+// counted. The Reference platform runs on a single thread, so no locking is
+// needed.
+
+static bool countAllocations = false;
+static long long numAllocations = 0;
+
+void* operator new(size_t size) {
+    if (countAllocations)
+        numAllocations++;
+    void* pointer = malloc(size == 0 ? 1 : size);
+    if (pointer == NULL)
+        throw bad_alloc();
+    return pointer;
+}
+
+void operator delete(void* pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t size) noexcept {
+    free(pointer);
+}
+
+void testNoAllocationsPerStep(int boundaryCheckInterval, bool adaptive) {
+    // There are no boundaries, so no step ever bounces.
+    
+    Platform& platform = Platform::getPlatformByName("Reference");
+    System system;
+    system.addParticle(2.0);
+    system.addParticle(2.0);
+    HarmonicBondForce* bonds = new HarmonicBondForce();
+    bonds->addBond(0, 1, 1.5, 100.0);
+    system.addForce(bonds);
+    const char* fileName = "/tmp/dummy_allocations.txt";
+    MmvtLangevinMiddleIntegrator integrator(300.0, 1.0, 0.002, fileName);
+    integrator.setBoundaryCheckInterval(boundaryCheckInterval);
+    integrator.setAdaptiveBoundaryChecks(adaptive);
+    Context context(system, integrator, platform);
+    vector<Vec3> positions(2);
+    positions[0] = Vec3(-0.75, 0, 0);
+    positions[1] = Vec3(0.75, 0, 0);
+    context.setPositions(positions);
+    context.setVelocitiesToTemperature(300.0);
+    
+    // The first steps may allocate buffers, including every slot of the
+    // rollback ring buffer.
+    
+    integrator.step(100);
+    numAllocations = 0;
+    countAllocations = true;
+    for (int i = 0; i < 100; i++)
+        integrator.step(1);
+    integrator.step(100);
+    countAllocations = false;
+    remove(fileName);
+    ASSERT_EQUAL(0, numAllocations);
+}
+
+int main() {
+    try {
+        registerSeekr2ReferenceKernelFactories();
+        testNoAllocationsPerStep(1, false);
+        testNoAllocationsPerStep(8, false);
+        testNoAllocationsPerStep(16, true);
+    }
+    catch(const std::exception& e) {
+        std::cout << "exception: " << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << "Done" << std::endl;
+    return 0;
+}
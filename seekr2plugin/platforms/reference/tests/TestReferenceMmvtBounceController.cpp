@@ -0,0 +1,188 @@
+/*
+   Copyright 2019 by Lane Votapka
+   All rights reserved
+   
+   -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2014 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * This tests MmvtBounceController with ordinary OpenMM integrators on the
+ * Reference platform.
+ */
+
+#include "MmvtBounceController.h"
+#include "MmvtLangevinMiddleIntegrator.h"
+#include "openmm/internal/AssertionUtilities.h"
+#include "openmm/CustomExternalForce.h"
+#include "openmm/Context.h"
+#include "openmm/LangevinMiddleIntegrator.h"
+#include "openmm/Platform.h"
+#include "openmm/System.h"
+#include "openmm/VerletIntegrator.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace Seekr2Plugin;
+using namespace OpenMM;
+using namespace std;
+
+extern "C" OPENMM_EXPORT void registerSeekr2ReferenceKernelFactories();
+
+/**
+ * Create a system of one particle between two walls, at x = -1 and x = 1.
+ */
+System* createWallSystem() {
+    System* system = new System();
+    system->addParticle(1.0);
+    CustomExternalForce* boundaries = new CustomExternalForce("step(x-1.0)+2*step(-1.0-x)");
+    boundaries->addParticle(0);
+    boundaries->setForceGroup(1);
+    system->addForce(boundaries);
+    return system;
+}
+
+vector<string> readLines(const char* fileName) {
+    ifstream file(fileName);
+    vector<string> lines;
+    string line;
+    while (getline(file, line))
+        lines.push_back(line);
+    file.close();
+    remove(fileName);
+    return lines;
+}
+
+void testMatchesMmvtIntegrator() {
+    // Without friction or noise, a VerletIntegrator wrapped in a controller
+    // must bounce at the same times as MmvtLangevinMiddleIntegrator.
+    
+    Platform& platform = Platform::getPlatformByName("Reference");
+    System* system = createWallSystem();
+    vector<Vec3> positions(1, Vec3(0.0345, 0, 0));
+    vector<Vec3> velocities(1, Vec3(1.0, 0, 0));
+    const char* mmvtFileName = "/tmp/dummy_controller_mmvt.txt";
+    MmvtLangevinMiddleIntegrator mmvtIntegrator(0.0, 0.0, 0.01, mmvtFileName);
+    mmvtIntegrator.addMilestoneGroup(1);
+    mmvtIntegrator.addMilestoneGroup(2);
+    Context mmvtContext(*system, mmvtIntegrator, platform);
+    mmvtContext.setPositions(positions);
+    mmvtContext.setVelocities(velocities);
+    mmvtIntegrator.step(2000);
+    MmvtAnchorStatistics mmvtStatistics = mmvtIntegrator.getStatistics();
+    
+    const char* fileName = "/tmp/dummy_controller.txt";
+    VerletIntegrator integrator(0.01);
+    Context context(*system, integrator, platform);
+    context.setPositions(positions);
+    context.setVelocities(velocities);
+    MmvtBounceController controller(context, fileName);
+    controller.addMilestoneGroup(1);
+    controller.addMilestoneGroup(2);
+    for (int i = 0; i < 20; i++) {
+        controller.step(100);
+        double x = context.getState(State::Positions).getPositions()[0][0];
+        ASSERT(x < 1.0 && x > -1.0);
+    }
+    ASSERT_EQUAL_TOL(20.0, context.getState(State::Positions).getTime(), 1e-6);
+    MmvtAnchorStatistics statistics = controller.getStatistics();
+    
+    vector<string> mmvtLines = readLines(mmvtFileName);
+    vector<string> lines = readLines(fileName);
+    ASSERT(lines.size() >= 8);
+    ASSERT_EQUAL(mmvtLines.size(), lines.size());
+    for (int i = 0; i < lines.size(); i++)
+        ASSERT_EQUAL(mmvtLines[i], lines[i]);
+    ASSERT_EQUAL(lines.size()-1, controller.getBounceCounter());
+    for (int i = 0; i < 2; i++) {
+        ASSERT_EQUAL(mmvtStatistics.N_alpha_beta[i], statistics.N_alpha_beta[i]);
+        ASSERT_EQUAL_TOL(mmvtStatistics.Ri_alpha[i], statistics.Ri_alpha[i], 1e-6);
+        for (int j = 0; j < 2; j++)
+            ASSERT_EQUAL(mmvtStatistics.Nij_alpha[i][j], statistics.Nij_alpha[i][j]);
+    }
+    ASSERT_EQUAL_TOL(mmvtStatistics.T_alpha, statistics.T_alpha, 1e-6);
+    delete system;
+}
+
+void testLangevinMiddle() {
+    // Wrap OpenMM's own LangevinMiddleIntegrator. The particle must never
+    // be left outside the walls, and every bounce must be counted.
+    
+    Platform& platform = Platform::getPlatformByName("Reference");
+    System* system = createWallSystem();
+    const char* fileName = "/tmp/dummy_controller_langevin.txt";
+    LangevinMiddleIntegrator integrator(300.0, 5.0, 0.002);
+    integrator.setRandomNumberSeed(5);
+    Context context(*system, integrator, platform);
+    context.setPositions(vector<Vec3>(1, Vec3(0.1, 0, 0)));
+    context.setVelocitiesToTemperature(300.0, 3);
+    MmvtBounceController controller(context, fileName);
+    controller.addMilestoneGroup(1);
+    controller.addMilestoneGroup(2);
+    for (int i = 0; i < 100; i++) {
+        controller.step(100);
+        double x = context.getState(State::Positions).getPositions()[0][0];
+        ASSERT(x < 1.0 && x > -1.0);
+    }
+    MmvtAnchorStatistics statistics = controller.getStatistics();
+    vector<string> lines = readLines(fileName);
+    ASSERT(controller.getBounceCounter() > 0);
+    ASSERT_EQUAL(lines.size()-1, controller.getBounceCounter());
+    ASSERT_EQUAL(controller.getBounceCounter(), statistics.N_alpha_beta[0]+statistics.N_alpha_beta[1]);
+    
+    // Milestone groups cannot be added once the simulation has started.
+    
+    bool failed = false;
+    try {
+        controller.addMilestoneGroup(3);
+    }
+    catch (exception& ex) {
+        failed = true;
+    }
+    ASSERT(failed);
+    delete system;
+}
+
+int main() {
+    try {
+        registerSeekr2ReferenceKernelFactories();
+        testMatchesMmvtIntegrator();
+        testLangevinMiddle();
+    }
+    catch(const std::exception& e) {
+        std::cout << "exception: " << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << "Done" << std::endl;
+    return 0;
+}
@@ -38,7 +38,11 @@
  */
 
 #include "MmvtLangevinMiddleIntegrator.h"
+#include "MmvtMTSLangevinIntegrator.h"
+#include "MmvtStatusSegment.h"
+#include "internal/CrossingStateReservoir.h"
 #include "openmm/internal/AssertionUtilities.h"
+#include "openmm/CustomExternalForce.h"
 #include "openmm/HarmonicBondForce.h"
 #include "openmm/NonbondedForce.h"
 #include "openmm/Context.h"
@@ -47,10 +51,23 @@
 #include "openmm/VerletIntegrator.h"
 #include "openmm/reference/SimTKOpenMMRealType.h"
 #include "openmm/reference/ReferencePlatform.h"
+#include "openmm/serialization/XmlSerializer.h"
 #include "sfmt/SFMT.h"
+#include <atomic>
 #include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <thread>
 #include <vector>
+#ifndef _WIN32
+    #include <sys/wait.h>
+    #include <unistd.h>
+#endif
 
 using namespace Seekr2Plugin;
 using namespace OpenMM;
@@ -224,6 +241,39 @@ void testConstrainedMasslessParticles() {
     ASSERT_EQUAL(0.0, state.getVelocities()[0][0]);
 }
 
+void testMasslessParticles() {
+    // Without constraints, massless particles must stay where they are while
+    // the others move.
+    
+    Platform& platform = Platform::getPlatformByName("Reference");
+    System system;
+    system.addParticle(0.0);
+    system.addParticle(1.0);
+    system.addParticle(0.0);
+    system.addParticle(2.0);
+    HarmonicBondForce* bonds = new HarmonicBondForce();
+    bonds->addBond(0, 1, 1.0, 100.0);
+    bonds->addBond(2, 3, 1.0, 100.0);
+    system.addForce(bonds);
+    vector<Vec3> positions(4);
+    positions[0] = Vec3(0, 0, 0);
+    positions[1] = Vec3(1.2, 0, 0);
+    positions[2] = Vec3(0, 1, 0);
+    positions[3] = Vec3(0.5, 1, 0);
+    MmvtLangevinMiddleIntegrator integrator(300.0, 2.0, 0.002, "/tmp/dummy.txt");
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+    context.setVelocitiesToTemperature(300.0);
+    integrator.step(100);
+    State state = context.getState(State::Positions | State::Velocities);
+    ASSERT_EQUAL_VEC(positions[0], state.getPositions()[0], 0.0);
+    ASSERT_EQUAL_VEC(positions[2], state.getPositions()[2], 0.0);
+    ASSERT_EQUAL_VEC(Vec3(0, 0, 0), state.getVelocities()[0], 0.0);
+    ASSERT_EQUAL_VEC(Vec3(0, 0, 0), state.getVelocities()[2], 0.0);
+    ASSERT((state.getPositions()[1]-positions[1]).dot(state.getPositions()[1]-positions[1]) > 0.0);
+    ASSERT((state.getPositions()[3]-positions[3]).dot(state.getPositions()[3]-positions[3]) > 0.0);
+}
+
 void testRandomSeed() {
     const int numParticles = 8;
     const double temp = 100.0;
@@ -283,6 +333,1185 @@ void testRandomSeed() {
     }
 }
 
+void testCrossingSnapshotQueue() {
+    Platform& platform = Platform::getPlatformByName("Reference");
+    System system;
+    system.addParticle(1.0);
+    MmvtLangevinMiddleIntegrator integrator(0.0, 0.0, 0.01, "/tmp/dummy_snapshot.txt");
+    integrator.addMilestoneGroup(1);
+    CustomExternalForce* boundary = new CustomExternalForce("step(x-1.0)");
+    boundary->addParticle(0);
+    boundary->setForceGroup(1);
+    system.addForce(boundary);
+    CrossingSnapshotQueue queue(4);
+    integrator.setCrossingSnapshotQueue(&queue);
+    Context context(system, integrator, platform);
+    vector<Vec3> positions(1);
+    vector<Vec3> velocities(1);
+    positions[0] = Vec3(0.9, 0, 0);
+    velocities[0] = Vec3(1.0, 0, 0);
+    context.setPositions(positions);
+    context.setVelocities(velocities);
+    
+    // The particle should bounce exactly once, and the state that crossed the
+    // boundary should be in the queue.
+    
+    integrator.step(100);
+    ASSERT_EQUAL(1, queue.getSize());
+    CrossingSnapshot snapshot;
+    ASSERT(queue.tryPop(snapshot));
+    ASSERT_EQUAL(1, snapshot.milestoneGroup);
+    ASSERT_EQUAL(0, snapshot.bounceIndex);
+    ASSERT_EQUAL(1, (int) snapshot.positions.size());
+    ASSERT(snapshot.positions[0][0] > 1.0);
+    ASSERT_EQUAL_VEC(Vec3(1.0, 0, 0), snapshot.velocities[0], TOL);
+    State state = context.getState(State::Positions | State::Velocities);
+    ASSERT(state.getPositions()[0][0] < 1.0);
+    ASSERT_EQUAL_VEC(Vec3(-1.0, 0, 0), state.getVelocities()[0], TOL);
+    ASSERT(!queue.tryPop(snapshot));
+    
+    // The bounce is also recorded in the statistics.
+    
+    MmvtAnchorStatistics statistics = integrator.getStatistics();
+    ASSERT_EQUAL(1, (int) statistics.milestoneGroups.size());
+    ASSERT_EQUAL(1, statistics.milestoneGroups[0]);
+    ASSERT_EQUAL(1, statistics.N_alpha_beta[0]);
+    
+    // Snapshots from milestone groups the queue does not accept, or that
+    // arrive once the queue is full, are discarded.
+    
+    CrossingSnapshotQueue filtered(1);
+    filtered.addMilestoneGroup(2);
+    snapshot.milestoneGroup = 1;
+    ASSERT(!filtered.publish(snapshot));
+    snapshot.milestoneGroup = 2;
+    ASSERT(filtered.publish(snapshot));
+    ASSERT(!filtered.publish(snapshot));
+    ASSERT_EQUAL(1, filtered.getSize());
+    ASSERT_EQUAL(1, (int) filtered.getNumDropped());
+    filtered.close();
+    ASSERT(filtered.pop(snapshot));
+    ASSERT(!filtered.pop(snapshot));
+}
+
+void testSaveStateBeforeCrossing() {
+    // The saved state and the published snapshot hold either the end of the
+    // step that crossed the boundary, or its start, which is in bounds.
+    
+    for (int before = 0; before < 2; before++) {
+        Platform& platform = Platform::getPlatformByName("Reference");
+        System system;
+        system.addParticle(1.0);
+        MmvtLangevinMiddleIntegrator integrator(0.0, 0.0, 0.01, "/tmp/dummy_save_state.txt");
+        integrator.addMilestoneGroup(1);
+        integrator.setSaveStateFileName("/tmp/dummy_save_state");
+        integrator.setSaveStateBeforeCrossing(before == 1);
+        CustomExternalForce* boundary = new CustomExternalForce("step(x-1.0)");
+        boundary->addParticle(0);
+        boundary->setForceGroup(1);
+        system.addForce(boundary);
+        CrossingSnapshotQueue queue(4);
+        integrator.setCrossingSnapshotQueue(&queue);
+        Context context(system, integrator, platform);
+        vector<Vec3> positions(1);
+        vector<Vec3> velocities(1);
+        positions[0] = Vec3(0.9, 0, 0);
+        velocities[0] = Vec3(1.0, 0, 0);
+        context.setPositions(positions);
+        context.setVelocities(velocities);
+        integrator.step(100);
+        CrossingSnapshot snapshot;
+        ASSERT(queue.tryPop(snapshot));
+        ifstream file("/tmp/dummy_save_state_0_1");
+        ASSERT(file.good());
+        State* state = XmlSerializer::deserialize<State>(file);
+        file.close();
+        remove("/tmp/dummy_save_state_0_1");
+        remove("/tmp/dummy_save_state.txt");
+        if (before == 1) {
+            ASSERT(snapshot.positions[0][0] < 1.0);
+            ASSERT(state->getPositions()[0][0] < 1.0);
+        }
+        else {
+            ASSERT(snapshot.positions[0][0] > 1.0);
+            ASSERT(state->getPositions()[0][0] > 1.0);
+        }
+        ASSERT_EQUAL_VEC(snapshot.positions[0], state->getPositions()[0], TOL);
+        ASSERT_EQUAL_VEC(Vec3(1.0, 0, 0), snapshot.velocities[0], TOL);
+        ASSERT_EQUAL_VEC(Vec3(1.0, 0, 0), state->getVelocities()[0], TOL);
+        ASSERT_EQUAL_TOL(snapshot.time, state->getTime(), TOL);
+        delete state;
+    }
+}
+
+void testSaveStateAtomSelection() {
+    // Only the selected atoms are written to the state files, except for the
+    // first one and every second one after it, which hold every atom.
+    
+    Platform& platform = Platform::getPlatformByName("Reference");
+    System system;
+    for (int i = 0; i < 3; i++)
+        system.addParticle(1.0);
+    MmvtLangevinMiddleIntegrator integrator(0.0, 0.0, 0.01, "/tmp/dummy_atom_selection.txt");
+    integrator.addMilestoneGroup(1);
+    integrator.addMilestoneGroup(2);
+    integrator.setSaveStateFileName("/tmp/dummy_atom_selection");
+    vector<int> atoms;
+    atoms.push_back(2);
+    atoms.push_back(0);
+    integrator.setSaveStateAtomSelection(atoms);
+    integrator.setFullSaveStateInterval(2);
+    CustomExternalForce* boundaries = new CustomExternalForce("step(x-1.0)+2*step(-1.0-x)");
+    boundaries->addParticle(0);
+    boundaries->setForceGroup(1);
+    system.addForce(boundaries);
+    Context context(system, integrator, platform);
+    vector<Vec3> positions(3);
+    vector<Vec3> velocities(3);
+    positions[0] = Vec3(0.9, 0, 0);
+    positions[1] = Vec3(0, 3, 0);
+    positions[2] = Vec3(0, 5, 0);
+    velocities[0] = Vec3(1.0, 0, 0);
+    context.setPositions(positions);
+    context.setVelocities(velocities);
+    integrator.step(500);
+    const char* fileNames[] = {"/tmp/dummy_atom_selection_0_1", "/tmp/dummy_atom_selection_1_2", "/tmp/dummy_atom_selection_2_1"};
+    for (int i = 0; i < 3; i++) {
+        ifstream file(fileNames[i]);
+        ASSERT(file.good());
+        State* state = XmlSerializer::deserialize<State>(file);
+        file.close();
+        remove(fileNames[i]);
+        if (i == 1) {
+            ASSERT_EQUAL(2, (int) state->getPositions().size());
+            ASSERT_EQUAL_VEC(Vec3(0, 5, 0), state->getPositions()[0], TOL);
+            ASSERT(state->getPositions()[1][0] < -1.0);
+            ASSERT_EQUAL_VEC(Vec3(-1.0, 0, 0), state->getVelocities()[1], TOL);
+        }
+        else {
+            ASSERT_EQUAL(3, (int) state->getPositions().size());
+            ASSERT(state->getPositions()[0][0] > 1.0);
+            ASSERT_EQUAL_VEC(Vec3(0, 3, 0), state->getPositions()[1], TOL);
+        }
+        delete state;
+    }
+    remove("/tmp/dummy_atom_selection.txt");
+    
+    // Atoms that are not in the System cannot be selected.
+    
+    MmvtLangevinMiddleIntegrator integrator2(0.0, 0.0, 0.01, "/tmp/dummy_atom_selection.txt");
+    integrator2.addMilestoneGroup(1);
+    integrator2.addMilestoneGroup(2);
+    integrator2.setSaveStateFileName("/tmp/dummy_atom_selection");
+    atoms.push_back(3);
+    integrator2.setSaveStateAtomSelection(atoms);
+    bool failed = false;
+    try {
+        Context context2(system, integrator2, platform);
+    }
+    catch (OpenMMException& ex) {
+        failed = true;
+    }
+    ASSERT(failed);
+}
+
+void testSaveFirstHitsOnly() {
+    // A particle is pushed into the wall at x=1 after bouncing once off the
+    // one at x=-1, so only the first bounce at x=1 is a first hit, and the
+    // later ones against the same wall are not saved.
+    
+    Platform& platform = Platform::getPlatformByName("Reference");
+    System system;
+    system.addParticle(1.0);
+    const char* logFileName = "/tmp/dummy_first_hits.txt";
+    const string prefix = "/tmp/dummy_first_hits";
+    MmvtLangevinMiddleIntegrator integrator(0.0, 0.5, 0.01, logFileName);
+    integrator.addMilestoneGroup(1);
+    integrator.addMilestoneGroup(2);
+    integrator.setSaveStateFileName(prefix);
+    integrator.setSaveFirstHitsOnly(true);
+    CrossingSnapshotQueue queue(10);
+    integrator.setCrossingSnapshotQueue(&queue);
+    CustomExternalForce* push = new CustomExternalForce("-2*x");
+    push->addParticle(0);
+    system.addForce(push);
+    CustomExternalForce* boundaries = new CustomExternalForce("step(x-1.0)+2*step(-1.0-x)");
+    boundaries->addParticle(0);
+    boundaries->setForceGroup(1);
+    system.addForce(boundaries);
+    Context context(system, integrator, platform);
+    vector<Vec3> positions(1);
+    vector<Vec3> velocities(1);
+    positions[0] = Vec3(0.0, 0, 0);
+    velocities[0] = Vec3(-2.5, 0, 0);
+    context.setPositions(positions);
+    context.setVelocities(velocities);
+    integrator.step(600);
+    
+    // A state file exists for each bounce in the crossing log that followed
+    // a bounce against the other wall.
+    
+    ifstream log(logFileName);
+    string line;
+    int previousGroup = -1, numFirstHits = 0, numOtherHits = 0;
+    while (getline(log, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        int group, bounce;
+        char comma;
+        stringstream fields(line);
+        fields >> group >> comma >> bounce;
+        bool firstHit = (previousGroup != -1 && previousGroup != group);
+        stringstream fileName;
+        fileName << prefix << "_" << bounce << "_" << group;
+        ASSERT_EQUAL(firstHit, ifstream(fileName.str()).good());
+        remove(fileName.str().c_str());
+        if (firstHit) {
+            numFirstHits++;
+            CrossingSnapshot snapshot;
+            ASSERT(queue.tryPop(snapshot));
+            ASSERT_EQUAL(group, snapshot.milestoneGroup);
+            ASSERT_EQUAL(bounce, snapshot.bounceIndex);
+        }
+        else
+            numOtherHits++;
+        previousGroup = group;
+    }
+    log.close();
+    remove(logFileName);
+    ASSERT(numFirstHits > 0);
+    ASSERT(numOtherHits > 1);
+    ASSERT_EQUAL(0, queue.getSize());
+}
+
+void testSaveStateEncoder() {
+    // States written in a binary format relative to a reference structure
+    // should be read back with the same positions and velocities.
+    
+    Platform& platform = Platform::getPlatformByName("Reference");
+    System system;
+    for (int i = 0; i < 3; i++)
+        system.addParticle(1.0);
+    MmvtLangevinMiddleIntegrator integrator(0.0, 0.0, 0.01, "/tmp/dummy_encoder.txt");
+    integrator.addMilestoneGroup(1);
+    integrator.setSaveStateFileName("/tmp/dummy_encoder");
+    vector<Vec3> positions(3);
+    vector<Vec3> velocities(3);
+    positions[0] = Vec3(0.9, 0, 0);
+    positions[1] = Vec3(0, 3, 0);
+    positions[2] = Vec3(0, 5, 0);
+    velocities[0] = Vec3(1.0, 0, 0);
+    CrossingStateEncoder encoder;
+    encoder.setFormat(CrossingStateEncoder::FixedPoint);
+    encoder.setReferencePositions(positions);
+    encoder.setCompression(CrossingStateEncoder::isCompressionAvailable());
+    integrator.setSaveStateEncoder(encoder);
+    CustomExternalForce* boundaries = new CustomExternalForce("step(x-1.0)");
+    boundaries->addParticle(0);
+    boundaries->setForceGroup(1);
+    system.addForce(boundaries);
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+    context.setVelocities(velocities);
+    integrator.step(20);
+    State state = encoder.readState("/tmp/dummy_encoder_0_1");
+    ASSERT_EQUAL(3, (int) state.getPositions().size());
+    ASSERT(state.getPositions()[0][0] > 1.0);
+    ASSERT_EQUAL_VEC(Vec3(0, 3, 0), state.getPositions()[1], 1e-4);
+    ASSERT_EQUAL_VEC(Vec3(0, 5, 0), state.getPositions()[2], 1e-4);
+    ASSERT_EQUAL_VEC(Vec3(-1.0, 0, 0), state.getVelocities()[0], 1e-4);
+    
+    // Without the reference structure, the file cannot be read.
+    
+    bool failed = false;
+    try {
+        CrossingStateEncoder().readState("/tmp/dummy_encoder_0_1");
+    }
+    catch (OpenMMException& ex) {
+        failed = true;
+    }
+    ASSERT(failed);
+    remove("/tmp/dummy_encoder_0_1");
+    remove("/tmp/dummy_encoder.txt");
+}
+
+void testCrossingTrajectory() {
+    // Only the frames just before and after the bounce should be written to
+    // the trajectory.
+    
+    Platform& platform = Platform::getPlatformByName("Reference");
+    System system;
+    system.addParticle(1.0);
+    MmvtLangevinMiddleIntegrator integrator(0.0, 0.0, 0.01, "/tmp/dummy_trajectory.txt");
+    integrator.addMilestoneGroup(1);
+    integrator.setTrajectoryFileName("/tmp/dummy_trajectory");
+    integrator.setTrajectoryInterval(2);
+    integrator.setTrajectoryFramesBeforeCrossing(3);
+    integrator.setTrajectoryFramesAfterCrossing(2);
+    CustomExternalForce* boundaries = new CustomExternalForce("step(x-1.0)");
+    boundaries->addParticle(0);
+    boundaries->setForceGroup(1);
+    system.addForce(boundaries);
+    Context context(system, integrator, platform);
+    vector<Vec3> positions(1, Vec3(0.905, 0, 0));
+    vector<Vec3> velocities(1, Vec3(1.0, 0, 0));
+    context.setPositions(positions);
+    context.setVelocities(velocities);
+    integrator.step(40);
+    ifstream file("/tmp/dummy_trajectory_0_1.dcd", ios_base::binary);
+    ASSERT(file.good());
+    string data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    file.close();
+    remove("/tmp/dummy_trajectory_0_1.dcd");
+    remove("/tmp/dummy_trajectory.txt");
+    
+    // The header is followed by 5 frames, each holding the x, y, and z
+    // coordinates of one particle, in Angstroms.
+    
+    const int headerSize = 276, frameSize = 36;
+    ASSERT_EQUAL(headerSize+5*frameSize, (int) data.size());
+    ASSERT_EQUAL(string("CORD"), data.substr(4, 4));
+    int numFrames;
+    memcpy(&numFrames, &data[8], 4);
+    ASSERT_EQUAL(5, numFrames);
+    vector<float> x(5);
+    for (int i = 0; i < 5; i++)
+        memcpy(&x[i], &data[headerSize+i*frameSize+4], 4);
+    ASSERT(x[0] < x[1] && x[1] < x[2]);
+    ASSERT(x[2] <= 10.0f);
+    ASSERT(x[3] < x[2] && x[4] < x[3]);
+    
+    // With a longer boundary check interval, steps past a crossing are
+    // discarded when it is found. A particle bouncing between walls 0.1 nm
+    // apart crosses again while the frames after the previous crossing are
+    // being written, and none of the discarded steps, which lie beyond a
+    // wall, may be written.
+    
+    System system2;
+    system2.addParticle(1.0);
+    MmvtLangevinMiddleIntegrator integrator2(0.0, 0.0, 0.01, "/tmp/dummy_trajectory.txt");
+    integrator2.addMilestoneGroup(1);
+    integrator2.addMilestoneGroup(2);
+    integrator2.setBoundaryCheckInterval(8);
+    integrator2.setTrajectoryFileName("/tmp/dummy_trajectory");
+    integrator2.setTrajectoryInterval(1);
+    integrator2.setTrajectoryFramesBeforeCrossing(2);
+    integrator2.setTrajectoryFramesAfterCrossing(15);
+    CustomExternalForce* walls = new CustomExternalForce("step(x-1.0)+2*step(0.9-x)");
+    walls->addParticle(0);
+    walls->setForceGroup(1);
+    system2.addForce(walls);
+    Context context2(system2, integrator2, platform);
+    context2.setPositions(positions);
+    context2.setVelocities(velocities);
+    integrator2.step(60);
+    ifstream file2("/tmp/dummy_trajectory_0_1.dcd", ios_base::binary);
+    ASSERT(file2.good());
+    string data2((istreambuf_iterator<char>(file2)), istreambuf_iterator<char>());
+    file2.close();
+    remove("/tmp/dummy_trajectory_0_1.dcd");
+    remove("/tmp/dummy_trajectory.txt");
+    memcpy(&numFrames, &data2[8], 4);
+    ASSERT(numFrames > 10);
+    ASSERT_EQUAL(headerSize+numFrames*frameSize, (int) data2.size());
+    for (int i = 0; i < numFrames; i++) {
+        float frameX;
+        memcpy(&frameX, &data2[headerSize+i*frameSize+4], 4);
+        ASSERT(frameX > 8.999f && frameX < 10.001f);
+    }
+}
+
+void testSaveStateReservoir() {
+    // Each candidate should be equally likely to end up in the reservoir.
+    
+    CrossingStateReservoir reservoir;
+    const int numTrials = 20000;
+    vector<int> counts(10, 0);
+    for (int trial = 0; trial < numTrials; trial++) {
+        reservoir.initialize(1, 2, 0, trial+1);
+        vector<int> slots(2, -1);
+        for (int i = 0; i < 10; i++) {
+            int slot = reservoir.offer(0, i);
+            if (slot >= 0)
+                slots[slot] = i;
+        }
+        counts[slots[0]]++;
+        counts[slots[1]]++;
+    }
+    for (int i = 0; i < 10; i++)
+        ASSERT_EQUAL_TOL(0.2, counts[i]/(double) numTrials, 0.03);
+    
+    // Candidates closer together than the spacing are skipped.
+    
+    reservoir.initialize(2, 5, 100, 1);
+    ASSERT_EQUAL(0, reservoir.offer(0, 0));
+    ASSERT_EQUAL(-1, reservoir.offer(0, 50));
+    ASSERT_EQUAL(0, reservoir.offer(1, 60));
+    ASSERT_EQUAL(1, reservoir.offer(0, 100));
+    ASSERT_EQUAL(2, (int) reservoir.getNumCandidates(0));
+    
+    // A particle bouncing between two walls every 200 steps bounces against
+    // each one every 400 steps, so with a spacing of 500 steps only every
+    // other bounce is a candidate. No more than three states may be kept per
+    // boundary.
+    
+    Platform& platform = Platform::getPlatformByName("Reference");
+    System system;
+    system.addParticle(1.0);
+    MmvtLangevinMiddleIntegrator integrator(0.0, 0.0, 0.01, "/tmp/dummy_reservoir.txt");
+    integrator.addMilestoneGroup(1);
+    integrator.addMilestoneGroup(2);
+    integrator.setSaveStateFileName("/tmp/dummy_reservoir");
+    integrator.setSaveStateReservoirSize(3);
+    integrator.setSaveStateReservoirSpacing(500);
+    integrator.setRandomNumberSeed(5);
+    CustomExternalForce* boundaries = new CustomExternalForce("step(x-1.0)+2*step(-1.0-x)");
+    boundaries->addParticle(0);
+    boundaries->setForceGroup(1);
+    system.addForce(boundaries);
+    Context context(system, integrator, platform);
+    vector<Vec3> positions(1);
+    vector<Vec3> velocities(1);
+    positions[0] = Vec3(0.9, 0, 0);
+    velocities[0] = Vec3(1.0, 0, 0);
+    context.setPositions(positions);
+    context.setVelocities(velocities);
+    integrator.step(8000);
+    ASSERT(integrator.getBounceCounter() >= 30);
+    for (int group = 1; group <= 2; group++) {
+        vector<double> times;
+        for (int slot = 0; slot < 4; slot++) {
+            stringstream fileName;
+            fileName << "/tmp/dummy_reservoir_reservoir_" << group << "_" << slot;
+            ifstream file(fileName.str());
+            if (slot == 3) {
+                ASSERT(!file.good());
+                continue;
+            }
+            ASSERT(file.good());
+            State* state = XmlSerializer::deserialize<State>(file);
+            file.close();
+            remove(fileName.str().c_str());
+            times.push_back(state->getTime());
+            delete state;
+        }
+        for (int i = 0; i < times.size(); i++)
+            for (int j = 0; j < i; j++)
+                ASSERT(fabs(times[i]-times[j]) >= 5.0);
+    }
+    ifstream file("/tmp/dummy_reservoir_0_1");
+    ASSERT(!file.good());
+    remove("/tmp/dummy_reservoir.txt");
+}
+
+void testConvergenceStopping() {
+    // A particle bouncing back and forth between two walls without friction
+    // gives statistics that converge after a few blocks, so step() should
+    // return long before taking all the steps it was asked for.
+    
+    Platform& platform = Platform::getPlatformByName("Reference");
+    System system;
+    system.addParticle(1.0);
+    MmvtLangevinMiddleIntegrator integrator(0.0, 0.0, 0.01, "/tmp/dummy_convergence.txt");
+    integrator.addMilestoneGroup(1);
+    integrator.addMilestoneGroup(2);
+    integrator.setConvergenceBlockSteps(1000);
+    integrator.setConvergenceTolerance(0.1);
+    CustomExternalForce* boundaries = new CustomExternalForce("step(x-1.0)+2*step(-1.0-x)");
+    boundaries->addParticle(0);
+    boundaries->setForceGroup(1);
+    system.addForce(boundaries);
+    Context context(system, integrator, platform);
+    vector<Vec3> positions(1);
+    vector<Vec3> velocities(1);
+    positions[0] = Vec3(0.0, 0, 0);
+    velocities[0] = Vec3(1.0, 0, 0);
+    context.setPositions(positions);
+    context.setVelocities(velocities);
+    integrator.step(1000000);
+    ASSERT(integrator.isConverged());
+    const MmvtConvergenceMonitor& monitor = integrator.getConvergenceMonitor();
+    ASSERT(monitor.getNumBlocks() >= monitor.getMinBlocks());
+    ASSERT(monitor.getMaxRelativeError() <= 0.1);
+    double time = context.getState(State::Positions).getTime();
+    ASSERT_EQUAL_TOL(monitor.getNumBlocks()*1000*0.01, time, 1e-6);
+    
+    // Once converged, step() does nothing.
+    
+    integrator.step(10);
+    ASSERT_EQUAL_TOL(time, context.getState(State::Positions).getTime(), 1e-6);
+}
+
+void testIncubationTimeHistograms() {
+    // A particle bouncing between two walls without friction takes 2 ps to
+    // cross from one to the other, so every incubation time falls in the bins
+    // around 2 ps, and the histograms add up to Nij_alpha and Ri_alpha.
+    
+    Platform& platform = Platform::getPlatformByName("Reference");
+    System system;
+    system.addParticle(1.0);
+    const char* statisticsFileName = "/tmp/dummy_histogram_statistics.txt";
+    MmvtLangevinMiddleIntegrator integrator(0.0, 0.0, 0.01, "/tmp/dummy_histogram.txt");
+    integrator.addMilestoneGroup(1);
+    integrator.addMilestoneGroup(2);
+    integrator.setSaveStatisticsFileName(statisticsFileName);
+    CustomExternalForce* boundaries = new CustomExternalForce("step(x-1.0)+2*step(-1.0-x)");
+    boundaries->addParticle(0);
+    boundaries->setForceGroup(1);
+    system.addForce(boundaries);
+    Context context(system, integrator, platform);
+    vector<Vec3> positions(1);
+    vector<Vec3> velocities(1);
+    positions[0] = Vec3(0.0, 0, 0);
+    velocities[0] = Vec3(1.0, 0, 0);
+    context.setPositions(positions);
+    context.setVelocities(velocities);
+    integrator.step(2000);
+    MmvtAnchorStatistics statistics = integrator.getStatistics();
+    ASSERT_EQUAL(2, (int) statistics.incubationTimeHistograms.size());
+    ASSERT(statistics.Nij_alpha[0][1] > 0);
+    ASSERT(statistics.Nij_alpha[1][0] > 0);
+    for (int i = 0; i < 2; i++) {
+        double sum = 0.0;
+        for (int j = 0; j < 2; j++) {
+            const LogBinnedHistogram& histogram = statistics.incubationTimeHistograms[i][j];
+            ASSERT_EQUAL(statistics.Nij_alpha[i][j], (int) histogram.getTotalCount());
+            ASSERT_EQUAL(0, (int) histogram.getUnderflowCount());
+            ASSERT_EQUAL(0, (int) histogram.getOverflowCount());
+            for (int bin = 0; bin < histogram.getNumBins(); bin++)
+                if (histogram.getBinCount(bin) > 0)
+                    ASSERT(histogram.getBinLowerEdge(bin) < 2.1 && histogram.getBinUpperEdge(bin) > 1.9);
+            sum += histogram.getSum();
+        }
+        ASSERT_EQUAL_TOL(statistics.Ri_alpha[i], sum, 1e-6);
+    }
+    ASSERT_EQUAL_TOL(2.0, statistics.incubationTimeHistograms[0][1].getMean(), 0.02);
+    
+    // The histograms are also written to the statistics file.
+    
+    ifstream file(statisticsFileName);
+    string line;
+    int numHistogramLines = 0;
+    while (getline(file, line)) {
+        if (line.compare(0, 2, "H_") == 0) {
+            numHistogramLines++;
+            ASSERT(line.compare(0, 13, "H_1_2_alpha: ") == 0 || line.compare(0, 13, "H_2_1_alpha: ") == 0);
+            LogBinnedHistogram histogram = LogBinnedHistogram::fromString(line.substr(13));
+            int i = (line[2] == '1' ? 0 : 1);
+            ASSERT_EQUAL(statistics.incubationTimeHistograms[i][1-i].getTotalCount(), histogram.getTotalCount());
+        }
+    }
+    file.close();
+    ASSERT_EQUAL(2, numHistogramLines);
+    remove(statisticsFileName);
+    remove("/tmp/dummy_histogram.txt");
+}
+
+/**
+ * Run a particle bouncing between two walls without friction or noise, and
+ * return the lines of its crossing log.
+ */
+vector<string> runBouncingParticle(int boundaryCheckInterval, bool adaptive, int stepsPerCall, int numSteps, double& finalTime, MmvtPerformanceCounters& counters) {
+    Platform& platform = Platform::getPlatformByName("Reference");
+    System system;
+    system.addParticle(1.0);
+    const char* fileName = "/tmp/dummy_check_interval.txt";
+    MmvtLangevinMiddleIntegrator integrator(0.0, 0.0, 0.01, fileName);
+    integrator.addMilestoneGroup(1);
+    integrator.addMilestoneGroup(2);
+    integrator.setBoundaryCheckInterval(boundaryCheckInterval);
+    integrator.setAdaptiveBoundaryChecks(adaptive);
+    CustomExternalForce* boundaries = new CustomExternalForce("step(x-1.0)+2*step(-1.0-x)");
+    boundaries->addParticle(0);
+    boundaries->setForceGroup(1);
+    system.addForce(boundaries);
+    Context context(system, integrator, platform);
+    vector<Vec3> positions(1);
+    vector<Vec3> velocities(1);
+    
+    // Start so that the first crossing falls inside a check interval, not at
+    // its end.
+    
+    positions[0] = Vec3(0.0345, 0, 0);
+    velocities[0] = Vec3(1.0, 0, 0);
+    context.setPositions(positions);
+    context.setVelocities(velocities);
+    for (int i = 0; i < numSteps; i += stepsPerCall) {
+        integrator.step(stepsPerCall);
+        
+        // Between calls to step(), the particle is never out of bounds.
+        
+        double x = context.getState(State::Positions).getPositions()[0][0];
+        ASSERT(x < 1.0 && x > -1.0);
+    }
+    finalTime = context.getState(State::Positions).getTime();
+    counters = integrator.getPerformanceCounters();
+    ifstream file(fileName);
+    vector<string> lines;
+    string line;
+    while (getline(file, line))
+        lines.push_back(line);
+    file.close();
+    remove(fileName);
+    return lines;
+}
+
+void testBoundaryCheckInterval() {
+    // Checking the boundaries only every few steps must find the same
+    // bounces, at the same times, as checking after every step. Steps taken
+    // past a crossing are discarded, so less time is simulated.
+    
+    double time1, time8;
+    MmvtPerformanceCounters counters1, counters8;
+    vector<string> lines1 = runBouncingParticle(1, false, 100, 2000, time1, counters1);
+    vector<string> lines8 = runBouncingParticle(8, false, 100, 2000, time8, counters8);
+    ASSERT_EQUAL_TOL(20.0, time1, 1e-6);
+    ASSERT(time8 < time1);
+    ASSERT(lines8.size() >= 8);
+    ASSERT(lines8.size() <= lines1.size());
+    for (int i = 0; i < lines8.size(); i++)
+        ASSERT_EQUAL(lines1[i], lines8[i]);
+    ASSERT_EQUAL(2000, counters1.numSteps);
+    ASSERT_EQUAL(counters1.numSteps, counters1.numBoundaryEvaluations);
+    ASSERT_EQUAL(0, counters1.numDiscardedSteps);
+    ASSERT_EQUAL(1, counters1.boundaryCheckInterval);
+    ASSERT_EQUAL(8, counters8.boundaryCheckInterval);
+    ASSERT(counters8.numDiscardedSteps > 0);
+}
+
+void testAdaptiveBoundaryChecks() {
+    // The adaptive schedule must find the same bounces as checking every
+    // step, while evaluating the boundaries far less often.
+    
+    double time1, timeAdaptive;
+    MmvtPerformanceCounters counters1, countersAdaptive;
+    vector<string> lines1 = runBouncingParticle(1, false, 100, 2000, time1, counters1);
+    vector<string> linesAdaptive = runBouncingParticle(64, true, 100, 2000, timeAdaptive, countersAdaptive);
+    ASSERT(linesAdaptive.size() >= 8);
+    ASSERT(linesAdaptive.size() <= lines1.size());
+    for (int i = 0; i < linesAdaptive.size(); i++)
+        ASSERT_EQUAL(lines1[i], linesAdaptive[i]);
+    ASSERT_EQUAL(2000, countersAdaptive.numSteps);
+    ASSERT_EQUAL(linesAdaptive.size(), countersAdaptive.numRollbacks);
+    ASSERT(countersAdaptive.numDiscardedSteps < countersAdaptive.numSteps/4);
+    ASSERT(countersAdaptive.getChecksPerStep() < 0.5);
+    ASSERT_EQUAL_TOL(1.0, counters1.getChecksPerStep(), 1e-10);
+    
+    // The interval stays below a quarter of the 200 steps between bounces.
+    
+    ASSERT(countersAdaptive.boundaryCheckInterval <= 50);
+}
+
+/**
+ * Run a particle diffusing between two walls, optionally with a safe step
+ * distance group, and return the lines of its crossing log.
+ */
+vector<string> runDiffusingParticle(bool prescreen, Vec3& finalPosition) {
+    Platform& platform = Platform::getPlatformByName("Reference");
+    System system;
+    system.addParticle(10.0);
+    const char* fileName = "/tmp/dummy_safe_step.txt";
+    MmvtLangevinMiddleIntegrator integrator(300.0, 5.0, 0.002, fileName);
+    integrator.addMilestoneGroup(1);
+    integrator.addMilestoneGroup(2);
+    integrator.setRandomNumberSeed(7);
+    CustomExternalForce* boundaries = new CustomExternalForce("step(x-0.5)+2*step(-0.5-x)");
+    boundaries->addParticle(0);
+    boundaries->setForceGroup(1);
+    system.addForce(boundaries);
+    if (prescreen) {
+        CustomExternalForce* distance = new CustomExternalForce("min(0.5-x, x+0.5)");
+        distance->addParticle(0);
+        distance->setForceGroup(3);
+        system.addForce(distance);
+        integrator.setSafeStepDistanceGroup(3);
+    }
+    Context context(system, integrator, platform);
+    vector<Vec3> positions(1);
+    positions[0] = Vec3(0.1, 0, 0);
+    context.setPositions(positions);
+    context.setVelocitiesToTemperature(300.0, 3);
+    integrator.step(5000);
+    finalPosition = context.getState(State::Positions).getPositions()[0];
+    ifstream file(fileName);
+    vector<string> lines;
+    string line;
+    while (getline(file, line))
+        lines.push_back(line);
+    file.close();
+    remove(fileName);
+    return lines;
+}
+
+void testSafeStepDistance() {
+    // Skipping the boundary evaluation while no crossing is possible must not
+    // change the trajectory at all.
+    
+    Vec3 position1, position2;
+    vector<string> lines1 = runDiffusingParticle(false, position1);
+    vector<string> lines2 = runDiffusingParticle(true, position2);
+    ASSERT(lines1.size() > 0);
+    ASSERT_EQUAL(lines1.size(), lines2.size());
+    for (int i = 0; i < lines1.size(); i++)
+        ASSERT_EQUAL(lines1[i], lines2[i]);
+    ASSERT_EQUAL_VEC(position1, position2, 1e-10);
+}
+
+/**
+ * Run a particle oscillating in a harmonic well centered just inside the wall
+ * at x = 1, so that each swing takes it across the wall and back within a few
+ * steps, and return the lines of its crossing log.
+ */
+vector<string> runOscillatingParticle(int boundaryCheckInterval, bool prescreen, Vec3& finalPosition) {
+    Platform& platform = Platform::getPlatformByName("Reference");
+    System system;
+    system.addParticle(1.0);
+    const char* fileName = "/tmp/dummy_safe_step_interval.txt";
+    MmvtLangevinMiddleIntegrator integrator(0.0, 0.0, 0.01, fileName);
+    integrator.addMilestoneGroup(1);
+    integrator.addMilestoneGroup(2);
+    integrator.setBoundaryCheckInterval(boundaryCheckInterval);
+    CustomExternalForce* well = new CustomExternalForce("0.5*k*(x-0.9)^2");
+    well->addGlobalParameter("k", 987.0);
+    well->addParticle(0);
+    system.addForce(well);
+    CustomExternalForce* boundaries = new CustomExternalForce("step(x-1.0)+2*step(-1.0-x)");
+    boundaries->addParticle(0);
+    boundaries->setForceGroup(1);
+    system.addForce(boundaries);
+    if (prescreen) {
+        CustomExternalForce* distance = new CustomExternalForce("min(1.0-x, x+1.0)");
+        distance->addParticle(0);
+        distance->setForceGroup(3);
+        system.addForce(distance);
+        integrator.setSafeStepDistanceGroup(3);
+    }
+    Context context(system, integrator, platform);
+    
+    // The first swing peaks about five steps in and is back inside the wall
+    // by the eighth, in the middle of the first check interval.
+    
+    context.setPositions(vector<Vec3>(1, Vec3(0.9, 0, 0)));
+    context.setVelocities(vector<Vec3>(1, Vec3(4.71, 0, 0)));
+    integrator.step(200);
+    finalPosition = context.getState(State::Positions).getPositions()[0];
+    ifstream file(fileName);
+    vector<string> lines;
+    string line;
+    while (getline(file, line))
+        lines.push_back(line);
+    file.close();
+    remove(fileName);
+    return lines;
+}
+
+void testSafeStepDistanceInterval() {
+    // With a longer check interval, a safe distance measured at the end of the
+    // interval says nothing about the steps before it. A crossing in the
+    // middle of the interval that is back in bounds by its end must still be
+    // bounced at the same step as when checking every step.
+    
+    Vec3 position1, position8;
+    vector<string> lines1 = runOscillatingParticle(1, false, position1);
+    vector<string> lines8 = runOscillatingParticle(8, true, position8);
+    ASSERT(lines1.size() > 0);
+    ASSERT_EQUAL(lines1.size(), lines8.size());
+    for (int i = 0; i < lines1.size(); i++)
+        ASSERT_EQUAL(lines1[i], lines8[i]);
+    ASSERT_EQUAL_VEC(position1, position8, 1e-10);
+}
+
+void testStatusSegment() {
+    // The status segment holds the same step count, statistics and counters
+    // that the integrator reports, and is removed with the Context.
+    
+    Platform& platform = Platform::getPlatformByName("Reference");
+    System system;
+    system.addParticle(10.0);
+    const char* fileName = "/tmp/dummy_status_segment.txt";
+    const char* segmentName = "/seekr2_test_status_segment";
+    MmvtLangevinMiddleIntegrator integrator(300.0, 5.0, 0.002, fileName);
+    integrator.addMilestoneGroup(1);
+    integrator.addMilestoneGroup(2);
+    integrator.setRandomNumberSeed(7);
+    integrator.setStatusSegmentName(segmentName);
+    CustomExternalForce* boundaries = new CustomExternalForce("step(x-0.5)+2*step(-0.5-x)");
+    boundaries->addParticle(0);
+    boundaries->setForceGroup(1);
+    system.addForce(boundaries);
+    Context* context = new Context(system, integrator, platform);
+    vector<Vec3> positions(1);
+    positions[0] = Vec3(0.1, 0, 0);
+    context->setPositions(positions);
+    context->setVelocitiesToTemperature(300.0, 3);
+    MmvtStatusSegment segment;
+    segment.attach(segmentName);
+    integrator.step(3000);
+    MmvtStatus status;
+    segment.read(status);
+    MmvtAnchorStatistics statistics = integrator.getStatistics();
+    MmvtPerformanceCounters counters = integrator.getPerformanceCounters();
+    ASSERT(statistics.N_alpha_beta[0]+statistics.N_alpha_beta[1] > 0);
+    ASSERT_EQUAL(3000, status.stepCount);
+    ASSERT(status.numUpdates >= 3000);
+    ASSERT_EQUAL_TOL(context->getState(0).getTime(), status.time, 1e-10);
+    ASSERT_EQUAL(statistics.milestoneGroups.size(), status.statistics.milestoneGroups.size());
+    for (int i = 0; i < 2; i++) {
+        ASSERT_EQUAL(statistics.milestoneGroups[i], status.statistics.milestoneGroups[i]);
+        ASSERT_EQUAL(statistics.N_alpha_beta[i], status.statistics.N_alpha_beta[i]);
+        ASSERT_EQUAL_TOL(statistics.Ri_alpha[i], status.statistics.Ri_alpha[i], 1e-10);
+        for (int j = 0; j < 2; j++)
+            ASSERT_EQUAL(statistics.Nij_alpha[i][j], status.statistics.Nij_alpha[i][j]);
+    }
+    ASSERT_EQUAL_TOL(statistics.T_alpha, status.statistics.T_alpha, 1e-10);
+    ASSERT_EQUAL(counters.numSteps, status.counters.numSteps);
+    ASSERT_EQUAL(counters.numBoundaryEvaluations, status.counters.numBoundaryEvaluations);
+    
+    // A reader polling while the simulation runs always sees a consistent
+    // status that never goes backward.
+    
+    atomic<bool> running(true);
+    bool consistent = true;
+    thread reader([&] () {
+        try {
+            MmvtStatusSegment readerSegment;
+            readerSegment.attach(segmentName);
+            long long lastStep = 0;
+            while (running) {
+                MmvtStatus current;
+                readerSegment.read(current);
+                const MmvtAnchorStatistics& stats = current.statistics;
+                if (current.stepCount < lastStep || current.counters.numSteps != current.stepCount
+                        || stats.N_alpha_beta[0]+stats.N_alpha_beta[1] < stats.Nij_alpha[0][1]+stats.Nij_alpha[1][0])
+                    consistent = false;
+                lastStep = current.stepCount;
+            }
+        }
+        catch (const exception& ex) {
+            consistent = false;
+        }
+    });
+    integrator.step(3000);
+    running = false;
+    reader.join();
+    ASSERT(consistent);
+    segment.read(status);
+    ASSERT_EQUAL(6000, status.stepCount);
+    
+    // Destroying the Context removes the segment, while a reader that is
+    // already attached keeps the last status.
+    
+    delete context;
+    segment.read(status);
+    ASSERT_EQUAL(6000, status.stepCount);
+    MmvtStatusSegment removed;
+    bool threwException = false;
+    try {
+        removed.attach(segmentName);
+    }
+    catch (const OpenMMException& ex) {
+        threwException = true;
+    }
+    ASSERT(threwException);
+    remove(fileName);
+}
+
+#ifndef _WIN32
+void testStatusSegmentInUse() {
+    // A segment held by a running process is never replaced, whether it is
+    // created directly or by a second Context.
+    
+    const char* segmentName = "/seekr2_test_status_segment_in_use";
+    vector<int> milestoneGroups(1, 1);
+    MmvtStatusSegment first;
+    first.create(segmentName, milestoneGroups);
+    MmvtStatusSegment second;
+    bool threwException = false;
+    try {
+        second.create(segmentName, milestoneGroups);
+    }
+    catch (const OpenMMException& ex) {
+        threwException = true;
+    }
+    ASSERT(threwException);
+    System system;
+    system.addParticle(10.0);
+    const char* fileName = "/tmp/dummy_status_segment_in_use.txt";
+    MmvtLangevinMiddleIntegrator integrator(300.0, 5.0, 0.002, fileName);
+    integrator.addMilestoneGroup(1);
+    integrator.setStatusSegmentName(segmentName);
+    CustomExternalForce* boundary = new CustomExternalForce("step(x-0.5)");
+    boundary->addParticle(0);
+    boundary->setForceGroup(1);
+    system.addForce(boundary);
+    threwException = false;
+    try {
+        Context context(system, integrator, Platform::getPlatformByName("Reference"));
+    }
+    catch (const OpenMMException& ex) {
+        threwException = true;
+    }
+    ASSERT(threwException);
+    MmvtStatus status;
+    MmvtStatusSegment reader;
+    reader.attach(segmentName);
+    reader.read(status);
+    ASSERT_EQUAL(getpid(), status.processId);
+    reader.close();
+    first.close();
+    
+    // A segment left behind by a process that has exited is replaced.
+    
+    pid_t child = fork();
+    if (child == 0) {
+        MmvtStatusSegment* abandoned = new MmvtStatusSegment();
+        abandoned->create(segmentName, milestoneGroups);
+        _exit(0);
+    }
+    int childStatus;
+    ASSERT_EQUAL(child, waitpid(child, &childStatus, 0));
+    reader.attach(segmentName);
+    reader.read(status);
+    ASSERT_EQUAL(child, status.processId);
+    reader.close();
+    second.create(segmentName, milestoneGroups);
+    reader.attach(segmentName);
+    reader.read(status);
+    ASSERT_EQUAL(getpid(), status.processId);
+    reader.close();
+    second.close();
+    remove(fileName);
+}
+#endif
+
+void testTraceFile() {
+    // The trace file is a JSON array of complete events covering each phase
+    // of a step, and is terminated when the Context is destroyed.
+    
+    Platform& platform = Platform::getPlatformByName("Reference");
+    System system;
+    system.addParticle(10.0);
+    const char* fileName = "/tmp/dummy_trace_file.txt";
+    const char* traceFileName = "/tmp/dummy_trace_file.json";
+    MmvtLangevinMiddleIntegrator integrator(300.0, 5.0, 0.002, fileName);
+    integrator.addMilestoneGroup(1);
+    integrator.addMilestoneGroup(2);
+    integrator.setRandomNumberSeed(7);
+    integrator.setTraceFileName(traceFileName);
+    CustomExternalForce* boundaries = new CustomExternalForce("step(x-0.5)+2*step(-0.5-x)");
+    boundaries->addParticle(0);
+    boundaries->setForceGroup(1);
+    system.addForce(boundaries);
+    Context* context = new Context(system, integrator, platform);
+    vector<Vec3> positions(1);
+    positions[0] = Vec3(0.1, 0, 0);
+    context->setPositions(positions);
+    context->setVelocitiesToTemperature(300.0, 3);
+    integrator.step(3000);
+    MmvtAnchorStatistics statistics = integrator.getStatistics();
+    ASSERT(statistics.N_alpha_beta[0]+statistics.N_alpha_beta[1] > 0);
+    
+    // Flushing writes the events recorded so far without closing the array.
+    
+    integrator.flushTrace();
+    ifstream flushed(traceFileName);
+    stringstream flushedContents;
+    flushedContents << flushed.rdbuf();
+    flushed.close();
+    string trace = flushedContents.str();
+    ASSERT(trace.size() > 0 && trace[0] == '[');
+    ASSERT(trace.find("\"name\":\"dynamics\",\"cat\":\"mmvt\",\"ph\":\"X\"") != string::npos);
+    delete context;
+    ifstream closed(traceFileName);
+    stringstream closedContents;
+    closedContents << closed.rdbuf();
+    closed.close();
+    trace = closedContents.str();
+    ASSERT(trace.size() > flushedContents.str().size());
+    size_t last = trace.find_last_not_of(" \n");
+    ASSERT(last != string::npos && trace[last] == ']');
+    const char* phases[] = {"dynamics", "boundary evaluation", "bounce restore", "event write"};
+    for (int i = 0; i < 4; i++) {
+        string event = string("\"name\":\"")+phases[i]+"\",\"cat\":\"mmvt\",\"ph\":\"X\"";
+        ASSERT(trace.find(event) != string::npos);
+    }
+    remove(fileName);
+    remove(traceFileName);
+}
+
+/**
+ * Run a particle between walls at x = -1 and x = 1 without friction, either
+ * for 1000 steps in one Context, or for 500 steps, checkpointed, and then
+ * continued from the checkpoint in a new Context after running on for 200
+ * more steps that are thrown away.
+ */
+vector<string> runCheckpointedWalls(bool interrupt, MmvtAnchorStatistics& statistics) {
+    Platform& platform = Platform::getPlatformByName("Reference");
+    System system;
+    system.addParticle(1.0);
+    CustomExternalForce* boundaries = new CustomExternalForce("step(x-1.0)+2*step(-1.0-x)");
+    boundaries->addParticle(0);
+    boundaries->setForceGroup(1);
+    system.addForce(boundaries);
+    const char* fileName = "/tmp/dummy_checkpoint.txt";
+    MmvtLangevinMiddleIntegrator integrator(0.0, 0.0, 0.01, fileName);
+    integrator.addMilestoneGroup(1);
+    integrator.addMilestoneGroup(2);
+    Context context(system, integrator, platform);
+    context.setPositions(vector<Vec3>(1, Vec3(0.0345, 0, 0)));
+    context.setVelocities(vector<Vec3>(1, Vec3(1.0, 0, 0)));
+    if (interrupt) {
+        integrator.step(500);
+        State state = context.getState(State::Positions | State::Velocities);
+        stringstream checkpoint;
+        integrator.createCheckpoint(checkpoint);
+        integrator.step(200);
+        MmvtLangevinMiddleIntegrator integrator2(0.0, 0.0, 0.01, fileName);
+        integrator2.addMilestoneGroup(1);
+        integrator2.addMilestoneGroup(2);
+        Context context2(system, integrator2, platform);
+        context2.setState(state);
+        integrator2.loadCheckpoint(checkpoint);
+        MmvtAnchorStatistics restored = integrator2.getStatistics();
+        ASSERT_EQUAL(3, restored.N_alpha_beta[0]+restored.N_alpha_beta[1]);
+        integrator2.step(500);
+        statistics = integrator2.getStatistics();
+    }
+    else {
+        integrator.step(1000);
+        statistics = integrator.getStatistics();
+    }
+    ifstream file(fileName);
+    vector<string> lines;
+    string line;
+    while (getline(file, line))
+        lines.push_back(line);
+    file.close();
+    remove(fileName);
+    return lines;
+}
+
+void testCheckpoint() {
+    // Continuing from a checkpoint gives the same crossing log and statistics
+    // as running without interruption: the bounce indices continue, the
+    // bounce logged after the checkpoint is not repeated, and the counts
+    // include the bounces before it.
+    
+    MmvtAnchorStatistics whole, pieces;
+    vector<string> wholeLines = runCheckpointedWalls(false, whole);
+    vector<string> lines = runCheckpointedWalls(true, pieces);
+    ASSERT_EQUAL(5, whole.N_alpha_beta[0]+whole.N_alpha_beta[1]);
+    ASSERT_EQUAL(wholeLines.size(), lines.size());
+    for (int i = 0; i < lines.size(); i++)
+        ASSERT_EQUAL(wholeLines[i], lines[i]);
+    for (int i = 0; i < 2; i++) {
+        ASSERT_EQUAL(whole.N_alpha_beta[i], pieces.N_alpha_beta[i]);
+        ASSERT_EQUAL_TOL(whole.Ri_alpha[i], pieces.Ri_alpha[i], 1e-6);
+        for (int j = 0; j < 2; j++) {
+            ASSERT_EQUAL(whole.Nij_alpha[i][j], pieces.Nij_alpha[i][j]);
+            ASSERT_EQUAL(whole.incubationTimeHistograms[i][j].getTotalCount(), pieces.incubationTimeHistograms[i][j].getTotalCount());
+        }
+    }
+    ASSERT_EQUAL_TOL(whole.T_alpha, pieces.T_alpha, 1e-6);
+}
+
+void testMultipleTimeSteps() {
+    // A stiff bond is integrated with the inner steps and a weak one with
+    // the outer steps. Without friction, energy must be conserved.
+    
+    System system;
+    Platform& platform = Platform::getPlatformByName("Reference");
+    system.addParticle(2.0);
+    system.addParticle(2.0);
+    HarmonicBondForce* fastForce = new HarmonicBondForce();
+    fastForce->addBond(0, 1, 1.5, 1);
+    system.addForce(fastForce);
+    HarmonicBondForce* slowForce = new HarmonicBondForce();
+    slowForce->addBond(0, 1, 1.0, 0.05);
+    slowForce->setForceGroup(3);
+    system.addForce(slowForce);
+    MmvtMTSLangevinIntegrator integrator(0.0, 0.0, 0.04, "/tmp/dummy.txt", 4);
+    integrator.addSlowForceGroup(3);
+    ASSERT_EQUAL_TOL(0.01, integrator.getInnerStepSize(), 1e-12);
+    Context context(system, integrator, platform);
+    vector<Vec3> positions(2);
+    positions[0] = Vec3(-1, 0, 0);
+    positions[1] = Vec3(1, 0, 0);
+    context.setPositions(positions);
+    State state = context.getState(State::Energy);
+    double initialEnergy = state.getKineticEnergy()+state.getPotentialEnergy();
+    for (int i = 0; i < 250; ++i) {
+        integrator.step(1);
+        state = context.getState(State::Energy);
+        double energy = state.getKineticEnergy()+state.getPotentialEnergy();
+        ASSERT_EQUAL_TOL(initialEnergy, energy, 0.01);
+    }
+    
+    // The time and step count advance with every inner step.
+    
+    ASSERT_EQUAL_TOL(10.0, state.getTime(), 1e-6);
+    ASSERT_EQUAL(1000, context.getStepCount());
+    
+    // The boundaries cannot be a slow force group.
+    
+    MmvtMTSLangevinIntegrator integrator2(0.0, 0.0, 0.04, "/tmp/dummy.txt", 4);
+    integrator2.addSlowForceGroup(1);
+    bool failed = false;
+    try {
+        Context context2(system, integrator2, platform);
+    }
+    catch (exception& ex) {
+        failed = true;
+    }
+    ASSERT(failed);
+}
+
+void testMultipleTimeStepBounces() {
+    // With no slow forces acting, a particle bouncing between two walls must
+    // be bounced at exactly the same inner steps as with an ordinary step of
+    // the same size.
+    
+    double time1;
+    MmvtPerformanceCounters counters1;
+    vector<string> lines1 = runBouncingParticle(1, false, 100, 2000, time1, counters1);
+    Platform& platform = Platform::getPlatformByName("Reference");
+    System system;
+    system.addParticle(1.0);
+    const char* fileName = "/tmp/dummy_mts.txt";
+    MmvtMTSLangevinIntegrator integrator(0.0, 0.0, 0.04, fileName, 4);
+    integrator.addMilestoneGroup(1);
+    integrator.addMilestoneGroup(2);
+    integrator.addSlowForceGroup(3);
+    CustomExternalForce* boundaries = new CustomExternalForce("step(x-1.0)+2*step(-1.0-x)");
+    boundaries->addParticle(0);
+    boundaries->setForceGroup(1);
+    system.addForce(boundaries);
+    CustomExternalForce* slowForce = new CustomExternalForce("0*x");
+    slowForce->addParticle(0);
+    slowForce->setForceGroup(3);
+    system.addForce(slowForce);
+    Context context(system, integrator, platform);
+    vector<Vec3> positions(1);
+    vector<Vec3> velocities(1);
+    positions[0] = Vec3(0.0345, 0, 0);
+    velocities[0] = Vec3(1.0, 0, 0);
+    context.setPositions(positions);
+    context.setVelocities(velocities);
+    integrator.step(500);
+    ASSERT_EQUAL_TOL(time1, context.getState(State::Positions).getTime(), 1e-6);
+    ifstream file(fileName);
+    vector<string> lines;
+    string line;
+    while (getline(file, line))
+        lines.push_back(line);
+    file.close();
+    remove(fileName);
+    ASSERT(lines.size() >= 8);
+    ASSERT_EQUAL(lines1.size(), lines.size());
+    for (int i = 0; i < lines.size(); i++)
+        ASSERT_EQUAL(lines1[i], lines[i]);
+}
+
 void runPlatformTests();
 
 int main() {
@@ -299,8 +1528,48 @@ int main() {
         testConstraints();
         std::cout << "running testConstrainedMasslessParticles\n";
         testConstrainedMasslessParticles();
+        std::cout << "running testMasslessParticles\n";
+        testMasslessParticles();
         std::cout << "running testRandomSeed\n";
         testRandomSeed();
+        std::cout << "running testCrossingSnapshotQueue\n";
+        testCrossingSnapshotQueue();
+        std::cout << "running testSaveStateBeforeCrossing\n";
+        testSaveStateBeforeCrossing();
+        std::cout << "running testSaveStateAtomSelection\n";
+        testSaveStateAtomSelection();
+        std::cout << "running testSaveFirstHitsOnly\n";
+        testSaveFirstHitsOnly();
+        std::cout << "running testSaveStateReservoir\n";
+        testSaveStateEncoder();
+        testCrossingTrajectory();
+        testSaveStateReservoir();
+        std::cout << "running testConvergenceStopping\n";
+        testConvergenceStopping();
+        std::cout << "running testIncubationTimeHistograms\n";
+        testIncubationTimeHistograms();
+        std::cout << "running testBoundaryCheckInterval\n";
+        testBoundaryCheckInterval();
+        std::cout << "running testSafeStepDistance\n";
+        testSafeStepDistance();
+        std::cout << "running testSafeStepDistanceInterval\n";
+        testSafeStepDistanceInterval();
+        std::cout << "running testAdaptiveBoundaryChecks\n";
+        testAdaptiveBoundaryChecks();
+        std::cout << "running testStatusSegment\n";
+        testStatusSegment();
+#ifndef _WIN32
+        std::cout << "running testStatusSegmentInUse\n";
+        testStatusSegmentInUse();
+#endif
+        std::cout << "running testTraceFile\n";
+        testTraceFile();
+        std::cout << "running testCheckpoint\n";
+        testCheckpoint();
+        std::cout << "running testMultipleTimeSteps\n";
+        testMultipleTimeSteps();
+        std::cout << "running testMultipleTimeStepBounces\n";
+        testMultipleTimeStepBounces();
         //runPlatformTests();
         //testIntegrator();
     }
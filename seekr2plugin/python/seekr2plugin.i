@@ -19,13 +19,24 @@
 namespace std {
   %template(vectord) vector<double>;
   %template(vectori) vector<int>;
+  %template(vectorvectori) vector<vector<int> >;
 };
 
 %include "std_string.i"
 
 %{
+#include "CrossingStateEncoder.h"
+#include "LogBinnedHistogram.h"
 #include "MmvtLangevinMiddleIntegrator.h"
+#include "MmvtMTSLangevinIntegrator.h"
+#include "MmvtBounceController.h"
 #include "ElberLangevinMiddleIntegrator.h"
+#include "MmvtAnchorStatistics.h"
+#include "MmvtKineticsEstimator.h"
+#include "MmvtConvergenceMonitor.h"
+#include "MmvtPerformanceCounters.h"
+#include "MmvtStatusSegment.h"
+#include "MmvtBootstrap.h"
 #include "OpenMM.h"
 #include "OpenMMAmoeba.h"
 #include "OpenMMDrude.h"
@@ -252,6 +263,255 @@ except:
 
 namespace Seekr2Plugin {
 
+class LogBinnedHistogram {
+public:
+    LogBinnedHistogram(double minValue=0.001, int numDecades=10, int binsPerDecade=10);
+    
+    double getMinValue() const;
+    
+    double getMaxValue() const;
+    
+    int getNumDecades() const;
+    
+    int getBinsPerDecade() const;
+    
+    int getNumBins() const;
+    
+    double getBinLowerEdge(int bin) const;
+    
+    double getBinUpperEdge(int bin) const;
+    
+    long long getBinCount(int bin) const;
+    
+    long long getUnderflowCount() const;
+    
+    long long getOverflowCount() const;
+    
+    long long getTotalCount() const;
+    
+    double getSum() const;
+    
+    double getMean() const;
+    
+    void addValue(double value);
+    
+    void addHistogram(const LogBinnedHistogram& other);
+    
+    void clear();
+    
+    std::string toString() const;
+    
+    static LogBinnedHistogram fromString(const std::string& text);
+};
+
+} // namespace Seekr2Plugin
+
+namespace std {
+  %template(vectorhistogram) vector<Seekr2Plugin::LogBinnedHistogram>;
+  %template(vectorvectorhistogram) vector<vector<Seekr2Plugin::LogBinnedHistogram> >;
+};
+
+namespace Seekr2Plugin {
+
+struct MmvtAnchorStatistics {
+    MmvtAnchorStatistics();
+    
+    std::vector<int> milestoneGroups;
+    
+    std::vector<int> N_alpha_beta;
+    
+    std::vector<std::vector<int> > Nij_alpha;
+    
+    std::vector<double> Ri_alpha;
+    
+    std::vector<std::vector<LogBinnedHistogram> > incubationTimeHistograms;
+    
+    double T_alpha;
+};
+
+struct MmvtPerformanceCounters {
+    MmvtPerformanceCounters();
+    
+    long long numSteps;
+    
+    long long numBoundaryEvaluations;
+    
+    long long numSafeDistanceEvaluations;
+    
+    long long numSafeSteps;
+    
+    long long numRollbacks;
+    
+    long long numDiscardedSteps;
+    
+    int boundaryCheckInterval;
+    
+    double getChecksPerStep() const;
+};
+
+struct MmvtStatus {
+    MmvtStatus();
+    
+    int processId;
+    
+    long long numUpdates;
+    
+    long long stepCount;
+    
+    double time;
+    
+    int bounceCounter;
+    
+    MmvtAnchorStatistics statistics;
+    
+    MmvtPerformanceCounters counters;
+};
+
+class MmvtStatusSegment {
+public:
+    MmvtStatusSegment();
+    
+    void attach(const std::string& name);
+    
+    void close();
+    
+    bool isOpen() const;
+    
+    const std::string& getName() const;
+    
+    %extend {
+        MmvtStatus read() const {
+            Seekr2Plugin::MmvtStatus status;
+            self->read(status);
+            return status;
+        }
+    }
+};
+
+class MmvtConvergenceMonitor {
+public:
+    MmvtConvergenceMonitor();
+    
+    void reset();
+    
+    int getMinBlocks() const;
+    
+    void setMinBlocks(int blocks);
+    
+    void addBlock(const MmvtAnchorStatistics& statistics);
+    
+    int getNumBlocks() const;
+    
+    int getNumTrackedRates() const;
+    
+    double getBounceRateRelativeError(int index) const;
+    
+    double getTransitionRateRelativeError(int from, int to) const;
+    
+    double getMaxRelativeError() const;
+    
+    bool isConverged(double tolerance) const;
+};
+
+class MmvtKineticsEstimator {
+public:
+    MmvtKineticsEstimator();
+    
+    int addAnchor();
+    
+    int getNumAnchors() const;
+    
+    int getNumMilestones() const;
+    
+    void addAnchorBoundary(int anchor, int milestoneGroup, int milestone, int neighborAnchor);
+    
+    void setAnchorStatistics(int anchor, const MmvtAnchorStatistics& statistics);
+    
+    void readAnchorStatisticsFile(int anchor, const std::string& fileName);
+    
+    bool hasAnchorStatistics(int anchor) const;
+    
+    static MmvtAnchorStatistics readStatisticsFile(const std::string& fileName);
+    
+    void computeKinetics();
+    
+    std::vector<double> getAnchorProbabilities() const;
+    
+    double getTransitionCount(int fromMilestone, int toMilestone) const;
+    
+    double getResidenceTime(int milestone) const;
+    
+    double getRate(int fromMilestone, int toMilestone) const;
+    
+    std::vector<double> computeMFPTs(const std::vector<int>& sinkMilestones) const;
+    
+    double computeMFPT(int sourceMilestone, const std::vector<int>& sinkMilestones) const;
+};
+
+struct MmvtBootstrapResult {
+    MmvtBootstrapResult();
+    
+    int numResamples;
+    
+    int numFailed;
+    
+    double mfpt, mfptMean, mfptStdDev, mfptLower, mfptUpper;
+    
+    double rate, rateLower, rateUpper;
+    
+    std::vector<double> mfptSamples;
+};
+
+class MmvtBootstrap {
+public:
+    MmvtBootstrap(const MmvtKineticsEstimator& estimator);
+    
+    void readAnchorCrossingLog(int anchor, const std::string& fileName);
+    
+    int getNumAnchorSegments(int anchor) const;
+    
+    int getNumThreads() const;
+    
+    void setNumThreads(int threads);
+    
+    int getRandomNumberSeed() const;
+    
+    void setRandomNumberSeed(int seed);
+    
+    MmvtBootstrapResult run(int numResamples, int sourceMilestone, const std::vector<int>& sinkMilestones, double confidence=0.95) const;
+};
+
+class CrossingStateEncoder {
+public:
+    enum Format {
+        Xml = 0,
+        Double = 1,
+        Float = 2,
+        FixedPoint = 3
+    };
+    CrossingStateEncoder();
+    
+    Format getFormat() const;
+    
+    void setFormat(Format format);
+    
+    double getResolution() const;
+    
+    void setResolution(double resolution);
+    
+    const std::vector<Vec3>& getReferencePositions() const;
+    
+    void setReferencePositions(const std::vector<Vec3>& positions);
+    
+    bool getCompression() const;
+    
+    void setCompression(bool compress);
+    
+    static bool isCompressionAvailable();
+    
+    OpenMM::State readState(const std::string& fileName) const;
+};
+
 class MmvtLangevinMiddleIntegrator : public OpenMM::Integrator {
 public:
     MmvtLangevinMiddleIntegrator(double temperature, double frictionCoeff, 
@@ -300,6 +560,135 @@ public:
     int getBounceCounter() const;
     
     void setBounceCounter(int counter);
+    
+    MmvtAnchorStatistics getStatistics();
+    
+    int getConvergenceBlockSteps() const;
+    
+    void setConvergenceBlockSteps(int steps);
+    
+    double getConvergenceTolerance() const;
+    
+    void setConvergenceTolerance(double tolerance);
+    
+    const MmvtConvergenceMonitor& getConvergenceMonitor() const;
+    
+    bool isConverged() const;
+    
+    int getBoundaryCheckInterval() const;
+    
+    void setBoundaryCheckInterval(int interval);
+    
+    int getSafeStepDistanceGroup() const;
+    
+    void setSafeStepDistanceGroup(int group);
+    
+    bool getAdaptiveBoundaryChecks() const;
+    
+    void setAdaptiveBoundaryChecks(bool adaptive);
+    
+    bool getSaveStateBeforeCrossing() const;
+    
+    void setSaveStateBeforeCrossing(bool before);
+    
+    bool getSaveFirstHitsOnly() const;
+    
+    void setSaveFirstHitsOnly(bool firstHitsOnly);
+    
+    const std::vector<int>& getSaveStateAtomSelection() const;
+    
+    void setSaveStateAtomSelection(const std::vector<int>& atoms);
+    
+    int getFullSaveStateInterval() const;
+    
+    void setFullSaveStateInterval(int interval);
+    
+    int getSaveStateReservoirSize() const;
+    
+    void setSaveStateReservoirSize(int size);
+    
+    int getSaveStateReservoirSpacing() const;
+    
+    void setSaveStateReservoirSpacing(int steps);
+    
+    const CrossingStateEncoder& getSaveStateEncoder() const;
+    
+    void setSaveStateEncoder(const CrossingStateEncoder& encoder);
+    
+    std::string getTrajectoryFileName() const;
+    
+    void setTrajectoryFileName(std::string fileName);
+    
+    int getTrajectoryInterval() const;
+    
+    void setTrajectoryInterval(int steps);
+    
+    int getTrajectoryFramesBeforeCrossing() const;
+    
+    void setTrajectoryFramesBeforeCrossing(int frames);
+    
+    int getTrajectoryFramesAfterCrossing() const;
+    
+    void setTrajectoryFramesAfterCrossing(int frames);
+    
+    std::string getStatusSegmentName() const;
+    
+    void setStatusSegmentName(std::string name);
+    
+    std::string getTraceFileName() const;
+    
+    void setTraceFileName(std::string fileName);
+    
+    void flushTrace();
+    
+    MmvtPerformanceCounters getPerformanceCounters();
+    
+    virtual int getNumInnerSteps() const;
+    
+    virtual int getSlowForceGroups() const;
+    
+    double getInnerStepSize() const;
+};
+
+class MmvtMTSLangevinIntegrator : public MmvtLangevinMiddleIntegrator {
+public:
+    MmvtMTSLangevinIntegrator(double temperature, double frictionCoeff, 
+        double stepSize, std::string fileName, int numInnerSteps);
+    
+    int getNumInnerSteps() const;
+    
+    void setNumInnerSteps(int steps);
+    
+    int getSlowForceGroups() const;
+    
+    void addSlowForceGroup(int group);
+    
+    bool isSlowForceGroup(int group) const;
+};
+
+class MmvtBounceController {
+public:
+    MmvtBounceController(OpenMM::Context& context, std::string fileName);
+    
+    const std::string& getOutputFileName() const;
+    
+    const std::string& getSaveStateFileName() const;
+    
+    void setSaveStateFileName(std::string fileName);
+    
+    int getNumMilestoneGroups() const;
+    
+    int getMilestoneGroup(int index) const;
+    
+    int addMilestoneGroup(int milestoneGroup);
+    
+    int getBounceCounter() const;
+    
+    void setBounceCounter(int counter);
+    
+    MmvtAnchorStatistics getStatistics() const;
+    
+    void step(int steps);
 };
 
 class ElberLangevinMiddleIntegrator : public OpenMM::Integrator {
@@ -333,6 +722,28 @@ public:
     
     void setSaveStateFileName(std::string fileName);
     
+    std::string getTrajectoryFileName() const;
+    
+    void setTrajectoryFileName(std::string fileName);
+    
+    int getTrajectoryInterval() const;
+    
+    void setTrajectoryInterval(int steps);
+    
+    int getTrajectoryFramesBeforeCrossing() const;
+    
+    void setTrajectoryFramesBeforeCrossing(int frames);
+    
+    int getTrajectoryFramesAfterCrossing() const;
+    
+    void setTrajectoryFramesAfterCrossing(int frames);
+    
+    std::string getTraceFileName() const;
+    
+    void setTraceFileName(std::string fileName);
+    
+    void flushTrace();
+    
     int getSrcMilestoneGroup(int index) const;
     
     int getNumSrcMilestoneGroups() const;
@@ -356,6 +767,8 @@ public:
     bool getEndOnSrcMilestone() const;
     
     void setEndOnSrcMilestone(bool endOnSrc);
+    
+    LogBinnedHistogram getFirstPassageTimeHistogram(int milestoneGroup);
 };
 
 }
\ No newline at end of file
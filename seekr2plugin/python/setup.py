@@ -6,6 +6,7 @@ import platform
 
 openmm_dir = '@OPENMM_DIR@'
 seekr2plugin_header_dir = '@SEEKR2PLUGIN_HEADER_DIR@'
+seekr2plugin_analysis_header_dir = '@SEEKR2PLUGIN_ANALYSIS_HEADER_DIR@'
 seekr2plugin_library_dir = '@SEEKR2PLUGIN_LIBRARY_DIR@'
 
 # setup extra compile and link arguments on Mac
@@ -19,7 +20,7 @@ if platform.system() == 'Darwin':
 extension = Extension(name='_seekr2plugin',
                       sources=['Seekr2PluginWrapper.cpp'],
                       libraries=['OpenMM', 'Seekr2Plugin'],
-                      include_dirs=[os.path.join(openmm_dir, 'include'), seekr2plugin_header_dir],
+                      include_dirs=[os.path.join(openmm_dir, 'include'), seekr2plugin_header_dir, seekr2plugin_analysis_header_dir],
                       library_dirs=[os.path.join(openmm_dir, 'lib'), seekr2plugin_library_dir],
                       extra_compile_args=extra_compile_args,
                       extra_link_args=extra_link_args
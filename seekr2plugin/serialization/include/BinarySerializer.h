@@ -0,0 +1,119 @@
+#ifndef OPENMM_SEEKR2_BINARY_SERIALIZER_H_
+#define OPENMM_SEEKR2_BINARY_SERIALIZER_H_
+
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "openmm/serialization/SerializationNode.h"
+#include "openmm/serialization/SerializationProxy.h"
+#include "internal/windowsExportSeekr2.h"
+#include <iosfwd>
+#include <string>
+#include <typeinfo>
+
+namespace OpenMM {
+
+/**
+ * BinarySerializer is a faster and more compact alternative to XmlSerializer.
+ * It uses the same SerializationProxy objects (so it works for Systems,
+ * States, and the MMVT and Elber integrators registered in
+ * Seekr2SerializationProxyRegistration), but encodes the resulting
+ * SerializationNode tree in a binary format instead of XML.
+ *
+ * Node and property names are stored once in a string table. SerializationNode
+ * holds every property as text, so property values that are numbers are stored
+ * as their decimal digits, packed into a variable length integer, together with
+ * the layout of the sign, decimal point, and exponent. Decoding rebuilds the
+ * text with integer arithmetic alone, without converting through floating
+ * point, and always reproduces exactly the string that was stored in the node.
+ * Any other value is stored as a string.
+ */
+
+class OPENMM_EXPORT_SEEKR2 BinarySerializer {
+public:
+    /**
+     * Serialize an object as binary data.
+     *
+     * @param object    the object to serialize
+     * @param rootName  the name of the root node
+     * @param stream    an output stream to write the data to
+     */
+    template <class T>
+    static void serialize(const T* object, const std::string& rootName, std::ostream& stream) {
+        const SerializationProxy& proxy = SerializationProxy::getProxy(typeid(*object));
+        SerializationNode node;
+        node.setName(rootName);
+        proxy.serialize(object, node);
+        if (typeid(*object) != typeid(T))
+            node.setStringProperty("type", proxy.getTypeName());
+        serialize(node, stream);
+    }
+    /**
+     * Reconstruct an object from its binary representation.
+     *
+     * @param stream    an input stream to read the data from
+     * @return a newly created object. The caller assumes ownership of it.
+     */
+    template <class T>
+    static T* deserialize(std::istream& stream) {
+        return reinterpret_cast<T*>(deserializeStream(stream));
+    }
+    /**
+     * Write a SerializationNode tree as binary data.
+     *
+     * @param node      the root of the tree to write
+     * @param stream    an output stream to write the data to
+     */
+    static void serialize(const SerializationNode& node, std::ostream& stream);
+    /**
+     * Read a SerializationNode tree from binary data.
+     *
+     * @param node      on exit, the root of the tree that was read
+     * @param stream    an input stream to read the data from
+     */
+    static void deserialize(SerializationNode& node, std::istream& stream);
+    /**
+     * Get whether a stream contains binary serialized data, by looking at its
+     * first bytes. The position of the stream is not changed.
+     *
+     * @param stream    the input stream to examine
+     */
+    static bool isBinary(std::istream& stream);
+private:
+    static void* deserializeStream(std::istream& stream);
+};
+
+} // namespace OpenMM
+
+#endif /*OPENMM_SEEKR2_BINARY_SERIALIZER_H_*/
@@ -35,7 +35,9 @@
  * -------------------------------------------------------------------------- */
 
 #include "openmm/serialization/SerializationProxy.h"
+#include "MmvtLangevinMiddleIntegrator.h"
 #include "internal/windowsExportSeekr2.h"
+#include <string>
 
 namespace OpenMM {
 
@@ -48,6 +50,17 @@ public:
     MmvtLangevinMiddleIntegratorProxy();
     void serialize(const void* object, SerializationNode& node) const;
     void* deserialize(const SerializationNode& node) const;
+protected:
+    MmvtLangevinMiddleIntegratorProxy(const std::string& typeName);
+    /**
+     * Record all the settings of an integrator.
+     */
+    static void serializeSettings(const Seekr2Plugin::MmvtLangevinMiddleIntegrator& integrator, SerializationNode& node);
+    /**
+     * Restore the settings of an integrator that are not passed to its
+     * constructor.
+     */
+    static void deserializeSettings(const SerializationNode& node, Seekr2Plugin::MmvtLangevinMiddleIntegrator& integrator);
 };
 
 } // namespace OpenMM
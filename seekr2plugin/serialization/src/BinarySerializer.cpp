@@ -0,0 +1,389 @@
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "BinarySerializer.h"
+#include "openmm/OpenMMException.h"
+#include <cstring>
+#include <istream>
+#include <iterator>
+#include <map>
+#include <ostream>
+#include <vector>
+
+using namespace OpenMM;
+using namespace std;
+
+static const char MAGIC[] = {'S', 'E', 'E', 'K', 'R', '2', 'B', 'N'};
+static const int MAGIC_LENGTH = sizeof(MAGIC);
+static const int FORMAT_VERSION = 1;
+
+// Tags identifying how a property value is stored.
+
+static const unsigned char TAG_STRING = 0;
+static const unsigned char TAG_INTEGER = 1;
+static const unsigned char TAG_DECIMAL = 2;
+
+static const int MAX_DIGITS = 19;
+static const int MAX_EXPONENT_DIGITS = 4;
+
+namespace {
+
+/**
+ * A number written in decimal notation, such as "-1.2345678901234567e-05",
+ * split into its digits and the layout of its sign, decimal point, and
+ * exponent.  Writing the text back out only takes integer arithmetic, and
+ * reproduces it exactly, including leading zeros and the width of the
+ * exponent.
+ */
+struct DecimalNumber {
+    DecimalNumber() : negative(false), hasPoint(false), hasExponent(false), negativeExponent(false),
+            numDigits(0), integerDigits(0), exponentDigits(0), digits(0), exponent(0) {
+    }
+    /**
+     * Split text of the form [-]D+[.D+][e(+|-)D+] into its parts.  Returns
+     * false if the text has any other form, or too many digits to store.
+     */
+    bool parse(const string& text) {
+        const char* c = text.c_str();
+        negative = (*c == '-');
+        if (negative)
+            c++;
+        digits = 0;
+        numDigits = 0;
+        integerDigits = readDigits(c, digits, numDigits, MAX_DIGITS);
+        if (integerDigits == 0)
+            return false;
+        hasPoint = (*c == '.');
+        if (hasPoint) {
+            c++;
+            if (readDigits(c, digits, numDigits, MAX_DIGITS) == 0)
+                return false;
+        }
+        hasExponent = (*c == 'e');
+        if (hasExponent) {
+            c++;
+            if (*c != '+' && *c != '-')
+                return false;
+            negativeExponent = (*c++ == '-');
+            exponent = 0;
+            exponentDigits = 0;
+            if (readDigits(c, exponent, exponentDigits, MAX_EXPONENT_DIGITS) == 0)
+                return false;
+        }
+        return (*c == '\0');
+    }
+    /**
+     * Get whether the number is an integer written the way it would be
+     * formatted, without a leading zero or a negative sign on zero, so it can
+     * be stored as an integer instead.
+     */
+    bool isCanonicalInteger() const {
+        if (hasPoint || hasExponent || numDigits > 18)
+            return false;
+        if (numDigits == 1)
+            return !(negative && digits == 0);
+        return digits >= POWERS_OF_TEN[numDigits-1];
+    }
+    void format(string& text) const {
+        char buffer[MAX_DIGITS+MAX_EXPONENT_DIGITS+4];
+        char* c = buffer;
+        if (negative)
+            *c++ = '-';
+        char* start = c;
+        c = writeDigits(c, digits, numDigits);
+        if (hasPoint) {
+            int fractionDigits = numDigits-integerDigits;
+            memmove(start+integerDigits+1, start+integerDigits, fractionDigits);
+            start[integerDigits] = '.';
+            c++;
+        }
+        if (hasExponent) {
+            *c++ = 'e';
+            *c++ = (negativeExponent ? '-' : '+');
+            c = writeDigits(c, exponent, exponentDigits);
+        }
+        text.assign(buffer, c-buffer);
+    }
+    static int readDigits(const char*& c, unsigned long long& value, int& count, int maxCount) {
+        int read = 0;
+        for (; *c >= '0' && *c <= '9'; c++, read++) {
+            if (count == maxCount)
+                return 0;
+            value = 10*value+(*c-'0');
+            count++;
+        }
+        return read;
+    }
+    static char* writeDigits(char* c, unsigned long long value, int count) {
+        for (int i = count-1; i >= 0; i--) {
+            c[i] = (char) ('0'+value%10);
+            value /= 10;
+        }
+        return c+count;
+    }
+    static const unsigned long long POWERS_OF_TEN[MAX_DIGITS+1];
+    bool negative, hasPoint, hasExponent, negativeExponent;
+    int numDigits, integerDigits, exponentDigits;
+    unsigned long long digits, exponent;
+};
+
+const unsigned long long DecimalNumber::POWERS_OF_TEN[MAX_DIGITS+1] = {1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL,
+        100000ULL, 1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL,
+        1000000000000ULL, 10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+        100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL};
+
+/**
+ * Format an integer the way SerializationNode stores it.
+ */
+void formatInteger(long long value, string& text) {
+    char buffer[24];
+    char* end = buffer+sizeof(buffer);
+    char* c = end;
+    unsigned long long magnitude = (value < 0 ? 0ULL-(unsigned long long) value : (unsigned long long) value);
+    do {
+        *--c = (char) ('0'+magnitude%10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+    if (value < 0)
+        *--c = '-';
+    text.assign(c, end-c);
+}
+
+class Encoder {
+public:
+    void collectNames(const SerializationNode& node) {
+        addName(node.getName());
+        for (auto& prop : node.getProperties())
+            addName(prop.first);
+        for (auto& child : node.getChildren())
+            collectNames(child);
+    }
+    void writeHeader() {
+        buffer.append(MAGIC, MAGIC_LENGTH);
+        writeVarint(FORMAT_VERSION);
+        writeVarint(names.size());
+        for (auto& name : names)
+            writeString(name);
+    }
+    void writeNode(const SerializationNode& node) {
+        writeVarint(nameIndex[node.getName()]);
+        writeVarint(node.getProperties().size());
+        for (auto& prop : node.getProperties()) {
+            writeVarint(nameIndex[prop.first]);
+            writeValue(prop.second);
+        }
+        writeVarint(node.getChildren().size());
+        for (auto& child : node.getChildren())
+            writeNode(child);
+    }
+    const string& getBuffer() const {
+        return buffer;
+    }
+private:
+    void addName(const string& name) {
+        if (nameIndex.find(name) == nameIndex.end()) {
+            nameIndex[name] = names.size();
+            names.push_back(name);
+        }
+    }
+    void writeVarint(unsigned long long value) {
+        while (value >= 0x80) {
+            buffer.push_back((char) ((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        buffer.push_back((char) value);
+    }
+    void writeString(const string& value) {
+        writeVarint(value.size());
+        buffer.append(value);
+    }
+    void writeValue(const string& value) {
+        DecimalNumber number;
+        if (number.parse(value)) {
+            if (number.isCanonicalInteger()) {
+                long long intValue = (number.negative ? -(long long) number.digits : (long long) number.digits);
+                buffer.push_back((char) TAG_INTEGER);
+                writeVarint((((unsigned long long) intValue) << 1) ^ (unsigned long long) (intValue >> 63));
+            }
+            else {
+                buffer.push_back((char) TAG_DECIMAL);
+                writeVarint(number.negative | (number.hasPoint << 1) | (number.hasExponent << 2) | (number.negativeExponent << 3) |
+                        (number.numDigits << 4) | (number.integerDigits << 9) | (number.exponentDigits << 14));
+                writeVarint(number.digits);
+                if (number.hasExponent)
+                    writeVarint(number.exponent);
+            }
+            return;
+        }
+        buffer.push_back((char) TAG_STRING);
+        writeString(value);
+    }
+    map<string, int> nameIndex;
+    vector<string> names;
+    string buffer;
+};
+
+class Decoder {
+public:
+    Decoder(const string& data) : data(data), pos(0) {
+    }
+    void readHeader() {
+        if (data.size() < MAGIC_LENGTH || memcmp(data.data(), MAGIC, MAGIC_LENGTH) != 0)
+            throw OpenMMException("BinarySerializer: the input is not in the binary serialization format");
+        pos = MAGIC_LENGTH;
+        if (readVarint() != FORMAT_VERSION)
+            throw OpenMMException("BinarySerializer: unsupported format version");
+        unsigned long long numNames = readVarint();
+        names.clear();
+        for (unsigned long long i = 0; i < numNames; i++) {
+            names.push_back(string());
+            readString(names.back());
+        }
+    }
+    void readNode(SerializationNode& node) {
+        node.setName(readName());
+        unsigned long long numProperties = readVarint();
+        string value;
+        for (unsigned long long i = 0; i < numProperties; i++) {
+            const string& name = readName();
+            readValue(value);
+            node.setStringProperty(name, value);
+        }
+        unsigned long long numChildren = readVarint();
+        for (unsigned long long i = 0; i < numChildren; i++) {
+            SerializationNode& child = node.createChildNode("");
+            readNode(child);
+        }
+    }
+private:
+    void checkAvailable(size_t length) {
+        if (length > data.size()-pos)
+            throw OpenMMException("BinarySerializer: unexpected end of data");
+    }
+    unsigned long long readVarint() {
+        unsigned long long value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            checkAvailable(1);
+            unsigned char byte = (unsigned char) data[pos++];
+            value |= ((unsigned long long) (byte & 0x7F)) << shift;
+            if ((byte & 0x80) == 0)
+                return value;
+        }
+        throw OpenMMException("BinarySerializer: malformed integer");
+    }
+    void readString(string& value) {
+        unsigned long long length = readVarint();
+        checkAvailable(length);
+        value.assign(data, pos, length);
+        pos += length;
+    }
+    const string& readName() {
+        unsigned long long index = readVarint();
+        if (index >= names.size())
+            throw OpenMMException("BinarySerializer: illegal name index");
+        return names[index];
+    }
+    void readValue(string& value) {
+        checkAvailable(1);
+        unsigned char tag = (unsigned char) data[pos++];
+        if (tag == TAG_STRING)
+            readString(value);
+        else if (tag == TAG_INTEGER) {
+            unsigned long long encoded = readVarint();
+            formatInteger((long long) (encoded >> 1) ^ -((long long) (encoded & 1)), value);
+        }
+        else if (tag == TAG_DECIMAL) {
+            DecimalNumber number;
+            unsigned long long layout = readVarint();
+            number.negative = (layout & 1);
+            number.hasPoint = (layout & 2);
+            number.hasExponent = (layout & 4);
+            number.negativeExponent = (layout & 8);
+            number.numDigits = (layout >> 4) & 31;
+            number.integerDigits = (layout >> 9) & 31;
+            number.exponentDigits = (layout >> 14) & 7;
+            number.digits = readVarint();
+            if (number.hasExponent)
+                number.exponent = readVarint();
+            bool valid = (number.numDigits >= 1 && number.numDigits <= MAX_DIGITS && number.digits < DecimalNumber::POWERS_OF_TEN[number.numDigits]);
+            if (number.hasPoint)
+                valid &= (number.integerDigits >= 1 && number.integerDigits < number.numDigits);
+            if (number.hasExponent)
+                valid &= (number.exponentDigits >= 1 && number.exponentDigits <= MAX_EXPONENT_DIGITS && number.exponent < DecimalNumber::POWERS_OF_TEN[number.exponentDigits]);
+            if (!valid || (layout >> 17) != 0)
+                throw OpenMMException("BinarySerializer: malformed number");
+            number.format(value);
+        }
+        else
+            throw OpenMMException("BinarySerializer: illegal property type");
+    }
+    const string& data;
+    size_t pos;
+    vector<string> names;
+};
+
+} // namespace
+
+void BinarySerializer::serialize(const SerializationNode& node, ostream& stream) {
+    Encoder encoder;
+    encoder.collectNames(node);
+    encoder.writeHeader();
+    encoder.writeNode(node);
+    const string& buffer = encoder.getBuffer();
+    stream.write(buffer.data(), buffer.size());
+}
+
+void BinarySerializer::deserialize(SerializationNode& node, istream& stream) {
+    string data((istreambuf_iterator<char>(stream)), istreambuf_iterator<char>());
+    Decoder decoder(data);
+    decoder.readHeader();
+    decoder.readNode(node);
+}
+
+bool BinarySerializer::isBinary(istream& stream) {
+    char header[MAGIC_LENGTH];
+    streampos start = stream.tellg();
+    stream.read(header, MAGIC_LENGTH);
+    bool matches = (stream.gcount() == MAGIC_LENGTH && memcmp(header, MAGIC, MAGIC_LENGTH) == 0);
+    stream.clear();
+    stream.seekg(start);
+    return matches;
+}
+
+void* BinarySerializer::deserializeStream(istream& stream) {
+    SerializationNode node;
+    deserialize(node, stream);
+    const SerializationProxy& proxy = SerializationProxy::getProxy(node.hasProperty("type") ? node.getStringProperty("type") : node.getName());
+    return proxy.deserialize(node);
+}
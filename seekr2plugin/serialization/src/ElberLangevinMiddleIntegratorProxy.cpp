@@ -53,6 +53,11 @@ void ElberLangevinMiddleIntegratorProxy::serialize(const void* object, Serializa
     node.setIntProperty("randomSeed", integrator.getRandomNumberSeed());
     node.setStringProperty("outputFileName", integrator.getOutputFileName());
     node.setStringProperty("saveStateFileName", integrator.getSaveStateFileName());
+    node.setStringProperty("trajectoryFileName", integrator.getTrajectoryFileName());
+    node.setIntProperty("trajectoryInterval", integrator.getTrajectoryInterval());
+    node.setIntProperty("trajectoryFramesBeforeCrossing", integrator.getTrajectoryFramesBeforeCrossing());
+    node.setIntProperty("trajectoryFramesAfterCrossing", integrator.getTrajectoryFramesAfterCrossing());
+    node.setStringProperty("traceFileName", integrator.getTraceFileName());
     SerializationNode& perSrcMilestoneGroups = node.createChildNode("srcMilestoneGroups");
     for (int i = 0; i < integrator.getNumSrcMilestoneGroups(); i++) {
         perSrcMilestoneGroups.createChildNode("srcMilestoneGroup").setIntProperty("forceGroupNumber", integrator.getSrcMilestoneGroup(i));
@@ -71,6 +76,11 @@ void* ElberLangevinMiddleIntegratorProxy::deserialize(const SerializationNode& n
     integrator->setConstraintTolerance(node.getDoubleProperty("constraintTolerance"));
     integrator->setRandomNumberSeed(node.getIntProperty("randomSeed"));
     integrator->setSaveStateFileName(node.getStringProperty("saveStateFileName"));
+    integrator->setTrajectoryFileName(node.getStringProperty("trajectoryFileName", ""));
+    integrator->setTrajectoryInterval(node.getIntProperty("trajectoryInterval", 10));
+    integrator->setTrajectoryFramesBeforeCrossing(node.getIntProperty("trajectoryFramesBeforeCrossing", 100));
+    integrator->setTrajectoryFramesAfterCrossing(node.getIntProperty("trajectoryFramesAfterCrossing", 100));
+    integrator->setTraceFileName(node.getStringProperty("traceFileName", ""));
     const SerializationNode& perSrcMilestoneGroups = node.getChildNode("srcMilestoneGroups");
     for (auto& group : perSrcMilestoneGroups.getChildren())
         integrator->addSrcMilestoneGroup(group.getIntProperty("forceGroupNumber"));
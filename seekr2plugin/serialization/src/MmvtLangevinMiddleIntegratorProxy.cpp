@@ -43,9 +43,25 @@ using namespace std;
 MmvtLangevinMiddleIntegratorProxy::MmvtLangevinMiddleIntegratorProxy() : SerializationProxy("MmvtLangevinMiddleIntegrator") {
 }
 
+MmvtLangevinMiddleIntegratorProxy::MmvtLangevinMiddleIntegratorProxy(const string& typeName) : SerializationProxy(typeName) {
+}
+
 void MmvtLangevinMiddleIntegratorProxy::serialize(const void* object, SerializationNode& node) const {
     node.setIntProperty("version", 1);
     const MmvtLangevinMiddleIntegrator& integrator = *reinterpret_cast<const MmvtLangevinMiddleIntegrator*>(object);
+    serializeSettings(integrator, node);
+}
+
+void* MmvtLangevinMiddleIntegratorProxy::deserialize(const SerializationNode& node) const {
+    if (node.getIntProperty("version") != 1)
+        throw OpenMMException("Unsupported version number");
+    MmvtLangevinMiddleIntegrator *integrator = new MmvtLangevinMiddleIntegrator(node.getDoubleProperty("temperature"),
+            node.getDoubleProperty("friction"), node.getDoubleProperty("stepSize"), node.getStringProperty("outputFileName"));
+    deserializeSettings(node, *integrator);
+    return integrator;
+}
+
+void MmvtLangevinMiddleIntegratorProxy::serializeSettings(const MmvtLangevinMiddleIntegrator& integrator, SerializationNode& node) {
     node.setDoubleProperty("stepSize", integrator.getStepSize());
     node.setDoubleProperty("constraintTolerance", integrator.getConstraintTolerance());
     node.setDoubleProperty("temperature", integrator.getTemperature());
@@ -55,25 +71,80 @@ void MmvtLangevinMiddleIntegratorProxy::serialize(const void* object, Serializat
     node.setStringProperty("outputFileName", integrator.getOutputFileName());
     node.setStringProperty("saveStateFileName", integrator.getSaveStateFileName());
     node.setStringProperty("saveStatisticsFileName", integrator.getSaveStatisticsFileName());
+    node.setIntProperty("convergenceBlockSteps", integrator.getConvergenceBlockSteps());
+    node.setDoubleProperty("convergenceTolerance", integrator.getConvergenceTolerance());
+    node.setIntProperty("boundaryCheckInterval", integrator.getBoundaryCheckInterval());
+    node.setIntProperty("safeStepDistanceGroup", integrator.getSafeStepDistanceGroup());
+    node.setBoolProperty("adaptiveBoundaryChecks", integrator.getAdaptiveBoundaryChecks());
+    node.setBoolProperty("saveStateBeforeCrossing", integrator.getSaveStateBeforeCrossing());
+    node.setBoolProperty("saveFirstHitsOnly", integrator.getSaveFirstHitsOnly());
+    node.setIntProperty("fullSaveStateInterval", integrator.getFullSaveStateInterval());
+    node.setIntProperty("saveStateReservoirSize", integrator.getSaveStateReservoirSize());
+    node.setIntProperty("saveStateReservoirSpacing", integrator.getSaveStateReservoirSpacing());
+    node.setStringProperty("trajectoryFileName", integrator.getTrajectoryFileName());
+    node.setIntProperty("trajectoryInterval", integrator.getTrajectoryInterval());
+    node.setIntProperty("trajectoryFramesBeforeCrossing", integrator.getTrajectoryFramesBeforeCrossing());
+    node.setIntProperty("trajectoryFramesAfterCrossing", integrator.getTrajectoryFramesAfterCrossing());
+    node.setStringProperty("statusSegmentName", integrator.getStatusSegmentName());
+    node.setStringProperty("traceFileName", integrator.getTraceFileName());
+    SerializationNode& saveStateAtoms = node.createChildNode("saveStateAtoms");
+    for (int atom : integrator.getSaveStateAtomSelection())
+        saveStateAtoms.createChildNode("atom").setIntProperty("index", atom);
+    const CrossingStateEncoder& encoder = integrator.getSaveStateEncoder();
+    node.setIntProperty("saveStateFormat", encoder.getFormat());
+    node.setDoubleProperty("saveStateResolution", encoder.getResolution());
+    node.setBoolProperty("saveStateCompression", encoder.getCompression());
+    SerializationNode& saveStateReference = node.createChildNode("saveStateReference");
+    for (const Vec3& pos : encoder.getReferencePositions())
+        saveStateReference.createChildNode("position").setDoubleProperty("x", pos[0]).setDoubleProperty("y", pos[1]).setDoubleProperty("z", pos[2]);
     SerializationNode& perMilestoneGroups = node.createChildNode("milestoneGroups");
     for (int i = 0; i < integrator.getNumMilestoneGroups(); i++) {
         perMilestoneGroups.createChildNode("milestoneGroup").setIntProperty("forceGroupNumber", integrator.getMilestoneGroup(i));
     }
 }
 
-void* MmvtLangevinMiddleIntegratorProxy::deserialize(const SerializationNode& node) const {
-    if (node.getIntProperty("version") != 1)
-        throw OpenMMException("Unsupported version number");
-    MmvtLangevinMiddleIntegrator *integrator = new MmvtLangevinMiddleIntegrator(node.getDoubleProperty("temperature"),
-            node.getDoubleProperty("friction"), node.getDoubleProperty("stepSize"), node.getStringProperty("outputFileName"));
-    integrator->setConstraintTolerance(node.getDoubleProperty("constraintTolerance"));
-    integrator->setRandomNumberSeed(node.getIntProperty("randomSeed"));
-    integrator->setBounceCounter(node.getIntProperty("bounceCounter"));
-    integrator->setSaveStateFileName(node.getStringProperty("saveStateFileName"));
-    integrator->setSaveStatisticsFileName(node.getStringProperty("saveStatisticsFileName"));
+void MmvtLangevinMiddleIntegratorProxy::deserializeSettings(const SerializationNode& node, MmvtLangevinMiddleIntegrator& integrator) {
+    integrator.setConstraintTolerance(node.getDoubleProperty("constraintTolerance"));
+    integrator.setRandomNumberSeed(node.getIntProperty("randomSeed"));
+    integrator.setBounceCounter(node.getIntProperty("bounceCounter"));
+    integrator.setSaveStateFileName(node.getStringProperty("saveStateFileName"));
+    integrator.setSaveStatisticsFileName(node.getStringProperty("saveStatisticsFileName"));
+    integrator.setConvergenceBlockSteps(node.getIntProperty("convergenceBlockSteps", 0));
+    integrator.setConvergenceTolerance(node.getDoubleProperty("convergenceTolerance", 0.0));
+    integrator.setBoundaryCheckInterval(node.getIntProperty("boundaryCheckInterval", 1));
+    integrator.setSafeStepDistanceGroup(node.getIntProperty("safeStepDistanceGroup", -1));
+    integrator.setAdaptiveBoundaryChecks(node.getBoolProperty("adaptiveBoundaryChecks", false));
+    integrator.setSaveStateBeforeCrossing(node.getBoolProperty("saveStateBeforeCrossing", false));
+    integrator.setSaveFirstHitsOnly(node.getBoolProperty("saveFirstHitsOnly", false));
+    integrator.setFullSaveStateInterval(node.getIntProperty("fullSaveStateInterval", 0));
+    integrator.setSaveStateReservoirSize(node.getIntProperty("saveStateReservoirSize", 0));
+    integrator.setSaveStateReservoirSpacing(node.getIntProperty("saveStateReservoirSpacing", 0));
+    integrator.setTrajectoryFileName(node.getStringProperty("trajectoryFileName", ""));
+    integrator.setTrajectoryInterval(node.getIntProperty("trajectoryInterval", 10));
+    integrator.setTrajectoryFramesBeforeCrossing(node.getIntProperty("trajectoryFramesBeforeCrossing", 100));
+    integrator.setTrajectoryFramesAfterCrossing(node.getIntProperty("trajectoryFramesAfterCrossing", 100));
+    integrator.setStatusSegmentName(node.getStringProperty("statusSegmentName", ""));
+    integrator.setTraceFileName(node.getStringProperty("traceFileName", ""));
+    CrossingStateEncoder encoder;
+    encoder.setFormat((CrossingStateEncoder::Format) node.getIntProperty("saveStateFormat", CrossingStateEncoder::Xml));
+    encoder.setResolution(node.getDoubleProperty("saveStateResolution", encoder.getResolution()));
+    encoder.setCompression(node.getBoolProperty("saveStateCompression", false));
+    for (auto& child : node.getChildren()) {
+        if (child.getName() == "saveStateAtoms") {
+            vector<int> atoms;
+            for (auto& atom : child.getChildren())
+                atoms.push_back(atom.getIntProperty("index"));
+            integrator.setSaveStateAtomSelection(atoms);
+        }
+        else if (child.getName() == "saveStateReference") {
+            vector<Vec3> positions;
+            for (auto& pos : child.getChildren())
+                positions.push_back(Vec3(pos.getDoubleProperty("x"), pos.getDoubleProperty("y"), pos.getDoubleProperty("z")));
+            encoder.setReferencePositions(positions);
+        }
+    }
+    integrator.setSaveStateEncoder(encoder);
     const SerializationNode& perMilestoneGroups = node.getChildNode("milestoneGroups");
     for (auto& group : perMilestoneGroups.getChildren())
-        integrator->addMilestoneGroup(group.getIntProperty("forceGroupNumber"));
-    
-    return integrator;
+        integrator.addMilestoneGroup(group.getIntProperty("forceGroupNumber"));
 }
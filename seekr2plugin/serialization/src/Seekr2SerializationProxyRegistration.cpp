@@ -43,11 +43,13 @@
 #include "openmm/OpenMMException.h"
 
 #include "MmvtLangevinMiddleIntegrator.h"
+#include "MmvtMTSLangevinIntegrator.h"
 #include "ElberLangevinMiddleIntegrator.h"
 
 #include "openmm/serialization/SerializationProxy.h"
 
 #include "MmvtLangevinMiddleIntegratorProxy.h"
+#include "MmvtMTSLangevinIntegratorProxy.h"
 #include "ElberLangevinMiddleIntegratorProxy.h"
 
 #if defined(WIN32)
@@ -74,6 +76,7 @@ using namespace Seekr2Plugin;
 
 extern "C" OPENMM_EXPORT_SEEKR2 void registerMmvtSerializationProxies() {
     SerializationProxy::registerProxy(typeid(MmvtLangevinMiddleIntegrator), new MmvtLangevinMiddleIntegratorProxy());
+    SerializationProxy::registerProxy(typeid(MmvtMTSLangevinIntegrator), new MmvtMTSLangevinIntegratorProxy());
 }
 extern "C" OPENMM_EXPORT_SEEKR2 void registerElberSerializationProxies() {
     SerializationProxy::registerProxy(typeid(ElberLangevinMiddleIntegrator), new ElberLangevinMiddleIntegratorProxy());
@@ -0,0 +1,193 @@
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "CrossingStateEncoder.h"
+#include "openmm/OpenMMException.h"
+#include "openmm/internal/AssertionUtilities.h"
+#include "sfmt/SFMT.h"
+#include <iostream>
+#include <sstream>
+
+using namespace OpenMM;
+using namespace Seekr2Plugin;
+using namespace std;
+
+const int NUM_PARTICLES = 100;
+
+void createState(vector<Vec3>& reference, vector<Vec3>& positions, vector<Vec3>& velocities, Vec3* box) {
+    OpenMM_SFMT::SFMT sfmt;
+    init_gen_rand(0, sfmt);
+    reference.resize(NUM_PARTICLES);
+    positions.resize(NUM_PARTICLES);
+    velocities.resize(NUM_PARTICLES);
+    for (int i = 0; i < NUM_PARTICLES; i++) {
+        reference[i] = Vec3(genrand_real2(sfmt), genrand_real2(sfmt), genrand_real2(sfmt))*5.0;
+        positions[i] = reference[i]+Vec3(genrand_real2(sfmt)-0.5, genrand_real2(sfmt)-0.5, genrand_real2(sfmt)-0.5)*0.2;
+        velocities[i] = Vec3(genrand_real2(sfmt)-0.5, genrand_real2(sfmt)-0.5, genrand_real2(sfmt)-0.5)*4.0;
+    }
+    box[0] = Vec3(5.0, 0.0, 0.0);
+    box[1] = Vec3(0.5, 5.5, 0.0);
+    box[2] = Vec3(-0.5, 0.25, 6.0);
+}
+
+void roundTrip(CrossingStateEncoder& encoder, const vector<int>& atoms, const vector<Vec3>& positions,
+               const vector<Vec3>& velocities, const Vec3* box, double tol) {
+    stringstream buffer;
+    encoder.encode(1.25, 625, box, atoms, positions, velocities, buffer);
+    CrossingSnapshot snapshot;
+    vector<int> decodedAtoms;
+    encoder.decode(buffer, snapshot, decodedAtoms);
+    ASSERT_EQUAL(1.25, snapshot.time);
+    for (int i = 0; i < 3; i++)
+        ASSERT_EQUAL_VEC(box[i], snapshot.periodicBoxVectors[i], 0.0);
+    if (encoder.getFormat() != CrossingStateEncoder::Xml)
+        ASSERT_EQUAL_CONTAINERS(atoms, decodedAtoms);
+    ASSERT_EQUAL(positions.size(), snapshot.positions.size());
+    ASSERT_EQUAL(velocities.size(), snapshot.velocities.size());
+    for (int i = 0; i < positions.size(); i++) {
+        for (int j = 0; j < 3; j++) {
+            ASSERT(fabs(positions[i][j]-snapshot.positions[i][j]) <= tol);
+            ASSERT(fabs(velocities[i][j]-snapshot.velocities[i][j]) <= tol);
+        }
+    }
+}
+
+void testFormats() {
+    vector<Vec3> reference, positions, velocities;
+    Vec3 box[3];
+    createState(reference, positions, velocities, box);
+    vector<int> subset;
+    vector<Vec3> subsetPositions, subsetVelocities;
+    for (int i = 3; i < NUM_PARTICLES; i += 7) {
+        subset.push_back(i);
+        subsetPositions.push_back(positions[i]);
+        subsetVelocities.push_back(velocities[i]);
+    }
+    vector<bool> compressionOptions(1, false);
+    if (CrossingStateEncoder::isCompressionAvailable())
+        compressionOptions.push_back(true);
+    for (bool compress : compressionOptions) {
+        for (int useReference = 0; useReference < 2; useReference++) {
+            CrossingStateEncoder encoder;
+            encoder.setCompression(compress);
+            if (useReference)
+                encoder.setReferencePositions(reference);
+            encoder.setFormat(CrossingStateEncoder::Xml);
+            roundTrip(encoder, vector<int>(), positions, velocities, box, 1e-10);
+            encoder.setFormat(CrossingStateEncoder::Double);
+            roundTrip(encoder, vector<int>(), positions, velocities, box, 0.0);
+            roundTrip(encoder, subset, subsetPositions, subsetVelocities, box, 0.0);
+            encoder.setFormat(CrossingStateEncoder::Float);
+            roundTrip(encoder, vector<int>(), positions, velocities, box, 1e-6);
+            roundTrip(encoder, subset, subsetPositions, subsetVelocities, box, 1e-6);
+            encoder.setFormat(CrossingStateEncoder::FixedPoint);
+            encoder.setResolution(1e-4);
+            roundTrip(encoder, vector<int>(), positions, velocities, box, 0.5e-4+1e-12);
+            roundTrip(encoder, subset, subsetPositions, subsetVelocities, box, 0.5e-4+1e-12);
+        }
+    }
+}
+
+void testCompactness() {
+    // Positions stored relative to a nearby reference structure are small,
+    // so fixed point values relative to it should compress much better than
+    // the absolute positions.
+
+    if (!CrossingStateEncoder::isCompressionAvailable())
+        return;
+    vector<Vec3> reference, positions, velocities;
+    Vec3 box[3];
+    createState(reference, positions, velocities, box);
+    CrossingStateEncoder encoder;
+    encoder.setFormat(CrossingStateEncoder::FixedPoint);
+    encoder.setCompression(true);
+    stringstream absolute, relative;
+    encoder.encode(0.0, 0, box, vector<int>(), positions, velocities, absolute);
+    encoder.setReferencePositions(reference);
+    encoder.encode(0.0, 0, box, vector<int>(), positions, velocities, relative);
+    ASSERT(relative.str().size() < absolute.str().size());
+}
+
+void testErrors() {
+    vector<Vec3> reference, positions, velocities;
+    Vec3 box[3];
+    createState(reference, positions, velocities, box);
+    CrossingStateEncoder encoder;
+    encoder.setFormat(CrossingStateEncoder::Float);
+    encoder.setReferencePositions(reference);
+    stringstream buffer;
+    encoder.encode(0.0, 0, box, vector<int>(), positions, velocities, buffer);
+
+    // A file written relative to a reference structure cannot be read without one.
+
+    CrossingStateEncoder decoder;
+    CrossingSnapshot snapshot;
+    vector<int> atoms;
+    bool threw = false;
+    try {
+        decoder.decode(buffer, snapshot, atoms);
+    }
+    catch (const OpenMMException& ex) {
+        threw = true;
+    }
+    ASSERT(threw);
+
+    // Values too large for the fixed point resolution are rejected.
+
+    encoder.setFormat(CrossingStateEncoder::FixedPoint);
+    encoder.setResolution(1e-12);
+    threw = false;
+    try {
+        stringstream buffer2;
+        encoder.encode(0.0, 0, box, vector<int>(), positions, velocities, buffer2);
+    }
+    catch (const OpenMMException& ex) {
+        threw = true;
+    }
+    ASSERT(threw);
+}
+
+int main() {
+    try {
+        testFormats();
+        testCompactness();
+        testErrors();
+    }
+    catch(const exception& e) {
+        cout << "exception: " << e.what() << endl;
+        return 1;
+    }
+    cout << "Done" << endl;
+    return 0;
+}
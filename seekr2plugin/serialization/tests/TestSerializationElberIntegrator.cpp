@@ -34,6 +34,7 @@
 #include "openmm/Platform.h"
 #include "openmm/internal/AssertionUtilities.h"
 #include "ElberLangevinMiddleIntegrator.h"
+#include "BinarySerializer.h"
 #include "openmm/serialization/XmlSerializer.h"
 #include <iostream>
 #include <sstream>
@@ -70,10 +71,42 @@ void testSerializationMiddle() {
     ASSERT_EQUAL(integ1.getSaveStateFileName(), integ2.getSaveStateFileName());
 }
 
+void testBinarySerializationMiddle() {
+    ElberLangevinMiddleIntegrator integrator(300.0, 2.0, 0.002, "/tmp/elber_output.txt");
+    integrator.setRandomNumberSeed(23);
+    integrator.addSrcMilestoneGroup(1);
+    integrator.addDestMilestoneGroup(2);
+    integrator.addDestMilestoneGroup(3);
+    integrator.setTrajectoryFileName("/tmp/elber_traj");
+    integrator.setTrajectoryInterval(5);
+    integrator.setTrajectoryFramesAfterCrossing(0);
+    integrator.setTraceFileName("/tmp/elber_trace.json");
+    stringstream buffer;
+    BinarySerializer::serialize<Integrator>(&integrator, "Integrator", buffer);
+    ElberLangevinMiddleIntegrator* copy = dynamic_cast<ElberLangevinMiddleIntegrator*>(BinarySerializer::deserialize<Integrator>(buffer));
+    ASSERT(copy != NULL);
+    ASSERT_EQUAL(integrator.getTemperature(), copy->getTemperature());
+    ASSERT_EQUAL(integrator.getStepSize(), copy->getStepSize());
+    ASSERT_EQUAL(integrator.getRandomNumberSeed(), copy->getRandomNumberSeed());
+    ASSERT_EQUAL(integrator.getOutputFileName(), copy->getOutputFileName());
+    ASSERT_EQUAL(integrator.getNumSrcMilestoneGroups(), copy->getNumSrcMilestoneGroups());
+    ASSERT_EQUAL(integrator.getSrcMilestoneGroup(0), copy->getSrcMilestoneGroup(0));
+    ASSERT_EQUAL(integrator.getNumDestMilestoneGroups(), copy->getNumDestMilestoneGroups());
+    for (int i = 0; i < integrator.getNumDestMilestoneGroups(); i++)
+        ASSERT_EQUAL(integrator.getDestMilestoneGroup(i), copy->getDestMilestoneGroup(i));
+    ASSERT_EQUAL(integrator.getTrajectoryFileName(), copy->getTrajectoryFileName());
+    ASSERT_EQUAL(integrator.getTrajectoryInterval(), copy->getTrajectoryInterval());
+    ASSERT_EQUAL(integrator.getTrajectoryFramesBeforeCrossing(), copy->getTrajectoryFramesBeforeCrossing());
+    ASSERT_EQUAL(integrator.getTrajectoryFramesAfterCrossing(), copy->getTrajectoryFramesAfterCrossing());
+    ASSERT_EQUAL(integrator.getTraceFileName(), copy->getTraceFileName());
+    delete copy;
+}
+
 int main() {
     try {
         registerElberSerializationProxies();
         testSerializationMiddle();
+        testBinarySerializationMiddle();
     }
     catch(const exception& e) {
         cout << "exception: " << e.what() << endl;
@@ -34,6 +34,10 @@
 #include "openmm/Platform.h"
 #include "openmm/internal/AssertionUtilities.h"
 #include "MmvtLangevinMiddleIntegrator.h"
+#include "MmvtMTSLangevinIntegrator.h"
+#include "BinarySerializer.h"
+#include "openmm/HarmonicBondForce.h"
+#include "openmm/System.h"
 #include "openmm/serialization/XmlSerializer.h"
 #include <iostream>
 #include <sstream>
@@ -70,10 +74,215 @@ void testSerializationMiddle() {
     ASSERT_EQUAL(integ1.getSaveStatisticsFileName(), integ2.getSaveStatisticsFileName());
 }
 
+void testSerializationMTS() {
+    // Create an Integrator.
+
+    MmvtMTSLangevinIntegrator integ1(302.5, 1.5, 0.004, "/tmp/dummyMTS.txt", 3);
+    integ1.setRandomNumberSeed(7);
+    integ1.addMilestoneGroup(2);
+    integ1.addSlowForceGroup(0);
+    integ1.addSlowForceGroup(5);
+    integ1.setBoundaryCheckInterval(4);
+
+    // Serialize and then deserialize it.
+
+    stringstream buffer;
+    XmlSerializer::serialize<MmvtLangevinMiddleIntegrator>(&integ1, "Integrator", buffer);
+    MmvtLangevinMiddleIntegrator* copy = XmlSerializer::deserialize<MmvtLangevinMiddleIntegrator>(buffer);
+
+    // Compare the two integrators to see if they are identical.
+    
+    MmvtMTSLangevinIntegrator* integ2 = dynamic_cast<MmvtMTSLangevinIntegrator*>(copy);
+    ASSERT(integ2 != NULL);
+    ASSERT_EQUAL(integ1.getTemperature(), integ2->getTemperature());
+    ASSERT_EQUAL(integ1.getFriction(), integ2->getFriction());
+    ASSERT_EQUAL(integ1.getStepSize(), integ2->getStepSize());
+    ASSERT_EQUAL(integ1.getRandomNumberSeed(), integ2->getRandomNumberSeed());
+    ASSERT_EQUAL(integ1.getMilestoneGroup(0), integ2->getMilestoneGroup(0));
+    ASSERT_EQUAL(integ1.getBoundaryCheckInterval(), integ2->getBoundaryCheckInterval());
+    ASSERT_EQUAL(3, integ2->getNumInnerSteps());
+    ASSERT_EQUAL(integ1.getSlowForceGroups(), integ2->getSlowForceGroups());
+    ASSERT(integ2->isSlowForceGroup(5));
+    ASSERT(!integ2->isSlowForceGroup(1));
+    delete copy;
+}
+
+void assertNodesEqual(const SerializationNode& node1, const SerializationNode& node2) {
+    ASSERT_EQUAL(node1.getName(), node2.getName());
+    ASSERT(node1.getProperties() == node2.getProperties());
+    ASSERT_EQUAL(node1.getChildren().size(), node2.getChildren().size());
+    for (int i = 0; i < node1.getChildren().size(); i++)
+        assertNodesEqual(node1.getChildren()[i], node2.getChildren()[i]);
+}
+
+void testBinaryNodeRoundTrip() {
+    // Values that look like numbers but would not be reproduced exactly by
+    // formatting the number must come back unchanged.
+    
+    SerializationNode node;
+    node.setName("Root");
+    node.setIntProperty("int", -12345);
+    node.setLongProperty("long", -9223372036854775807LL);
+    node.setDoubleProperty("double", 0.1);
+    node.setDoubleProperty("tiny", 1e-310);
+    node.setDoubleProperty("huge", -1.7976931348623157e308);
+    node.setDoubleProperty("negativeExponent", -1.2345678901234567e-05);
+    node.setBoolProperty("bool", true);
+    node.setStringProperty("leadingZero", "007");
+    node.setStringProperty("exponent", "1e5");
+    node.setStringProperty("negativeZero", "-0");
+    node.setStringProperty("overflow", "12345678901234567890");
+    node.setStringProperty("longFraction", "1.23456789012345678901");
+    node.setStringProperty("exponentWidth", "-2.5e-005");
+    node.setStringProperty("exponentCase", "2.5E-05");
+    node.setStringProperty("notANumber", "nan");
+    node.setStringProperty("padded", " 5");
+    node.setStringProperty("empty", "");
+    node.setStringProperty("text", "/tmp/mmvt_output.txt");
+    for (int i = 0; i < 100; i++)
+        node.createChildNode("Particle").setDoubleProperty("m", 1.008*i).createChildNode("Child").setIntProperty("index", i);
+    stringstream buffer;
+    BinarySerializer::serialize(node, buffer);
+    ASSERT(BinarySerializer::isBinary(buffer));
+    SerializationNode copy;
+    BinarySerializer::deserialize(copy, buffer);
+    assertNodesEqual(node, copy);
+    
+    // XML input must not be mistaken for binary data.
+    
+    stringstream xml("<?xml version=\"1.0\" ?>\n<Root int=\"-12345\"/>\n");
+    ASSERT(!BinarySerializer::isBinary(xml));
+    bool failed = false;
+    try {
+        SerializationNode bad;
+        BinarySerializer::deserialize(bad, xml);
+    }
+    catch (OpenMMException& ex) {
+        failed = true;
+    }
+    ASSERT(failed);
+}
+
+void testBinarySerializationMiddle() {
+    MmvtLangevinMiddleIntegrator integrator(300.0, 2.0, 0.002, "/tmp/mmvt_output.txt");
+    integrator.setConstraintTolerance(1e-6);
+    integrator.setRandomNumberSeed(17);
+    integrator.setBounceCounter(42);
+    integrator.setSaveStateFileName("/tmp/mmvt_state");
+    integrator.setSaveStatisticsFileName("/tmp/mmvt_statistics.txt");
+    integrator.addMilestoneGroup(1);
+    integrator.addMilestoneGroup(2);
+    integrator.setConvergenceBlockSteps(5000);
+    integrator.setConvergenceTolerance(0.05);
+    integrator.setBoundaryCheckInterval(4);
+    integrator.setSafeStepDistanceGroup(3);
+    integrator.setAdaptiveBoundaryChecks(true);
+    integrator.setSaveStateBeforeCrossing(true);
+    integrator.setSaveFirstHitsOnly(true);
+    vector<int> atoms;
+    atoms.push_back(5);
+    atoms.push_back(2);
+    integrator.setSaveStateAtomSelection(atoms);
+    integrator.setFullSaveStateInterval(10);
+    integrator.setSaveStateReservoirSize(200);
+    integrator.setSaveStateReservoirSpacing(5000);
+    CrossingStateEncoder encoder;
+    encoder.setFormat(CrossingStateEncoder::FixedPoint);
+    encoder.setResolution(2e-5);
+    vector<Vec3> reference;
+    reference.push_back(Vec3(0.1, 0.2, 0.3));
+    reference.push_back(Vec3(-1.5, 2.5, 4.0));
+    encoder.setReferencePositions(reference);
+    integrator.setSaveStateEncoder(encoder);
+    integrator.setTrajectoryFileName("/tmp/mmvt_traj");
+    integrator.setTrajectoryInterval(25);
+    integrator.setTrajectoryFramesBeforeCrossing(40);
+    integrator.setTrajectoryFramesAfterCrossing(60);
+    integrator.setStatusSegmentName("/seekr2_anchor_3");
+    integrator.setTraceFileName("/tmp/anchor_3_trace.json");
+    stringstream buffer;
+    BinarySerializer::serialize<Integrator>(&integrator, "Integrator", buffer);
+    MmvtLangevinMiddleIntegrator* copy = dynamic_cast<MmvtLangevinMiddleIntegrator*>(BinarySerializer::deserialize<Integrator>(buffer));
+    ASSERT(copy != NULL);
+    ASSERT_EQUAL(integrator.getTemperature(), copy->getTemperature());
+    ASSERT_EQUAL(integrator.getFriction(), copy->getFriction());
+    ASSERT_EQUAL(integrator.getStepSize(), copy->getStepSize());
+    ASSERT_EQUAL(integrator.getConstraintTolerance(), copy->getConstraintTolerance());
+    ASSERT_EQUAL(integrator.getRandomNumberSeed(), copy->getRandomNumberSeed());
+    ASSERT_EQUAL(integrator.getBounceCounter(), copy->getBounceCounter());
+    ASSERT_EQUAL(integrator.getOutputFileName(), copy->getOutputFileName());
+    ASSERT_EQUAL(integrator.getSaveStateFileName(), copy->getSaveStateFileName());
+    ASSERT_EQUAL(integrator.getSaveStatisticsFileName(), copy->getSaveStatisticsFileName());
+    ASSERT_EQUAL(integrator.getConvergenceBlockSteps(), copy->getConvergenceBlockSteps());
+    ASSERT_EQUAL(integrator.getConvergenceTolerance(), copy->getConvergenceTolerance());
+    ASSERT_EQUAL(integrator.getBoundaryCheckInterval(), copy->getBoundaryCheckInterval());
+    ASSERT_EQUAL(integrator.getSafeStepDistanceGroup(), copy->getSafeStepDistanceGroup());
+    ASSERT_EQUAL(integrator.getAdaptiveBoundaryChecks(), copy->getAdaptiveBoundaryChecks());
+    ASSERT_EQUAL(integrator.getSaveStateBeforeCrossing(), copy->getSaveStateBeforeCrossing());
+    ASSERT_EQUAL(integrator.getSaveFirstHitsOnly(), copy->getSaveFirstHitsOnly());
+    ASSERT_EQUAL_CONTAINERS(integrator.getSaveStateAtomSelection(), copy->getSaveStateAtomSelection());
+    ASSERT_EQUAL(integrator.getFullSaveStateInterval(), copy->getFullSaveStateInterval());
+    ASSERT_EQUAL(integrator.getSaveStateReservoirSize(), copy->getSaveStateReservoirSize());
+    ASSERT_EQUAL(integrator.getSaveStateReservoirSpacing(), copy->getSaveStateReservoirSpacing());
+    ASSERT_EQUAL(encoder.getFormat(), copy->getSaveStateEncoder().getFormat());
+    ASSERT_EQUAL(encoder.getResolution(), copy->getSaveStateEncoder().getResolution());
+    ASSERT_EQUAL(encoder.getCompression(), copy->getSaveStateEncoder().getCompression());
+    ASSERT_EQUAL(reference.size(), copy->getSaveStateEncoder().getReferencePositions().size());
+    for (int i = 0; i < reference.size(); i++)
+        ASSERT_EQUAL_VEC(reference[i], copy->getSaveStateEncoder().getReferencePositions()[i], 0.0);
+    ASSERT_EQUAL(integrator.getTrajectoryFileName(), copy->getTrajectoryFileName());
+    ASSERT_EQUAL(integrator.getTrajectoryInterval(), copy->getTrajectoryInterval());
+    ASSERT_EQUAL(integrator.getTrajectoryFramesBeforeCrossing(), copy->getTrajectoryFramesBeforeCrossing());
+    ASSERT_EQUAL(integrator.getTrajectoryFramesAfterCrossing(), copy->getTrajectoryFramesAfterCrossing());
+    ASSERT_EQUAL(integrator.getStatusSegmentName(), copy->getStatusSegmentName());
+    ASSERT_EQUAL(integrator.getTraceFileName(), copy->getTraceFileName());
+    ASSERT_EQUAL(integrator.getNumMilestoneGroups(), copy->getNumMilestoneGroups());
+    for (int i = 0; i < integrator.getNumMilestoneGroups(); i++)
+        ASSERT_EQUAL(integrator.getMilestoneGroup(i), copy->getMilestoneGroup(i));
+    delete copy;
+}
+
+void testBinarySystem() {
+    System system;
+    HarmonicBondForce* bonds = new HarmonicBondForce();
+    for (int i = 0; i < 1000; i++) {
+        system.addParticle(1.0+0.001*i);
+        if (i > 0)
+            bonds->addBond(i-1, i, 0.1+0.0001*i, 1000.0);
+    }
+    system.addForce(bonds);
+    stringstream xml, binary;
+    XmlSerializer::serialize<System>(&system, "System", xml);
+    BinarySerializer::serialize<System>(&system, "System", binary);
+    ASSERT(binary.str().size() < xml.str().size());
+    System* copy = BinarySerializer::deserialize<System>(binary);
+    ASSERT_EQUAL(system.getNumParticles(), copy->getNumParticles());
+    for (int i = 0; i < system.getNumParticles(); i++)
+        ASSERT_EQUAL(system.getParticleMass(i), copy->getParticleMass(i));
+    ASSERT_EQUAL(1, copy->getNumForces());
+    HarmonicBondForce& bondsCopy = dynamic_cast<HarmonicBondForce&>(copy->getForce(0));
+    ASSERT_EQUAL(bonds->getNumBonds(), bondsCopy.getNumBonds());
+    for (int i = 0; i < bonds->getNumBonds(); i++) {
+        int p1, p2, q1, q2;
+        double length1, k1, length2, k2;
+        bonds->getBondParameters(i, p1, p2, length1, k1);
+        bondsCopy.getBondParameters(i, q1, q2, length2, k2);
+        ASSERT_EQUAL(p1, q1);
+        ASSERT_EQUAL(p2, q2);
+        ASSERT_EQUAL(length1, length2);
+        ASSERT_EQUAL(k1, k2);
+    }
+    delete copy;
+}
+
 int main() {
     try {
         registerMmvtSerializationProxies();
         testSerializationMiddle();
+        testSerializationMTS();
+        testBinaryNodeRoundTrip();
+        testBinarySerializationMiddle();
+        testBinarySystem();
     }
     catch(const exception& e) {
         cout << "exception: " << e.what() << endl;
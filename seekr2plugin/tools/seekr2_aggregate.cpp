@@ -0,0 +1,135 @@
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * seekr2_aggregate: summarize the crossing logs written by MMVT and Elber
+ * integrators.
+ *
+ * Every log is memory mapped and parsed in parallel. For each log, the
+ * transition statistics are printed in the same format as the statistics
+ * file written by MmvtLangevinMiddleIntegrator, and all of them may also be
+ * saved as a single binary table (see CrossingLogAggregator).
+ */
+
+#include "CrossingLogAggregator.h"
+#include "openmm/OpenMMException.h"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace Seekr2Plugin;
+using namespace OpenMM;
+using namespace std;
+
+static void printUsage(const char* program) {
+    cerr << "Usage: " << program << " [options] LOG [LOG ...]\n"
+         << "\n"
+         << "Options:\n"
+         << "  --threads N                  number of threads (default: 0, one per hardware thread)\n"
+         << "  --output FILE                binary table to write the summaries to\n"
+         << "  --quiet                      do not print the summaries\n";
+}
+
+static void printSummary(const CrossingLogSummary& summary) {
+    const MmvtAnchorStatistics& statistics = summary.statistics;
+    int numGroups = statistics.milestoneGroups.size();
+    cout << "# " << summary.fileName << ": " << summary.numRows << " rows, " << summary.numInvalidRows << " invalid\n";
+    for (int i = 0; i < numGroups; i++)
+        cout << "N_alpha_" << statistics.milestoneGroups[i] << ": " << statistics.N_alpha_beta[i] << "\n";
+    for (int i = 0; i < numGroups; i++)
+        for (int j = 0; j < numGroups; j++)
+            if (i != j)
+                cout << "N_" << statistics.milestoneGroups[i] << "_" << statistics.milestoneGroups[j] << "_alpha: " << statistics.Nij_alpha[i][j] << "\n";
+    for (int i = 0; i < numGroups; i++)
+        cout << "R_" << statistics.milestoneGroups[i] << "_alpha: " << statistics.Ri_alpha[i] << "\n";
+    cout << "T_alpha: " << statistics.T_alpha << "\n";
+}
+
+int main(int argc, char* argv[]) {
+    CrossingLogAggregator aggregator;
+    string outputFileName;
+    bool quiet = false;
+    try {
+        for (int i = 1; i < argc; i++) {
+            string option = argv[i];
+            if (option == "-h" || option == "--help") {
+                printUsage(argv[0]);
+                return 0;
+            }
+            if (option == "--quiet")
+                quiet = true;
+            else if (option == "--threads" || option == "--output") {
+                if (i+1 >= argc)
+                    throw OpenMMException("Missing value for "+option);
+                string value = argv[++i];
+                if (option == "--output")
+                    outputFileName = value;
+                else {
+                    char* end;
+                    long threads = strtol(value.c_str(), &end, 10);
+                    if (value.empty() || *end != '\0' || threads < 0)
+                        throw OpenMMException("Illegal value for "+option+": "+value);
+                    aggregator.setNumThreads(threads);
+                }
+            }
+            else if (option.size() > 1 && option[0] == '-')
+                throw OpenMMException("Unknown option: "+option);
+            else
+                aggregator.addFile(option);
+        }
+        if (aggregator.getNumFiles() == 0) {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    catch (const exception& e) {
+        cerr << "seekr2_aggregate: " << e.what() << endl;
+        printUsage(argv[0]);
+        return 1;
+    }
+    
+    try {
+        aggregator.run();
+        if (!quiet)
+            for (int i = 0; i < aggregator.getNumFiles(); i++)
+                printSummary(aggregator.getSummary(i));
+        if (!outputFileName.empty())
+            aggregator.writeTable(outputFileName);
+    }
+    catch (const exception& e) {
+        cerr << "seekr2_aggregate: " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,661 @@
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * seekr2_mpi_run: run many MMVT or Elber anchors from serialized XML files
+ * across the ranks of an MPI job.
+ *
+ * The anchors are listed in a manifest file, one per line, as a name
+ * followed by the System, State and integrator files of the anchor:
+ *
+ *     anchor_0  anchor_0/system.xml  anchor_0/state.xml  anchor_0/integrator.xml
+ *
+ * Rank 0 coordinates the run. Each of the other ranks repeatedly asks it for
+ * work and is given an anchor and a block of steps to run. A rank keeps the
+ * Context of its anchor between blocks, and is given the same anchor again
+ * until the anchor has converged or run all its steps. The rank then moves
+ * on to the unclaimed anchor that has run the fewest steps, so that ranks
+ * freed by anchors that converge early take over the anchors still waiting
+ * to run, rather than sitting idle as they would with one job per anchor.
+ * Ranks that find no anchor left to run exit.
+ *
+ * After every block, the worker writes a checkpoint of the anchor and sends
+ * the cumulative MMVT statistics of its Context to rank 0, which judges
+ * convergence with an MmvtConvergenceMonitor and at the end writes the
+ * statistics of every anchor to a file in the same format as the
+ * integrator's statistics file. Run with a single rank, the same process
+ * coordinates and runs every block itself.
+ *
+ * The checkpoints are written in the same format as those of seekr2_run,
+ * with the integrator's statistics and the number of steps run beside the
+ * State. A rank given an anchor that has already run steps continues it from
+ * its checkpoint, so the output directory must be shared by all ranks. With
+ * --resume, a new job likewise continues every anchor that has a checkpoint
+ * in the output directory.
+ */
+
+#include "MmvtLangevinMiddleIntegrator.h"
+#include "BinarySerializer.h"
+#include "MmvtConvergenceMonitor.h"
+#include "MmvtKineticsEstimator.h"
+#include "openmm/Context.h"
+#include "openmm/Integrator.h"
+#include "openmm/OpenMMException.h"
+#include "openmm/Platform.h"
+#include "openmm/State.h"
+#include "openmm/System.h"
+#include "openmm/serialization/XmlSerializer.h"
+#include <mpi.h>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace Seekr2Plugin;
+using namespace OpenMM;
+using namespace std;
+
+static const int REPORT_TAG = 1;
+static const int STATISTICS_TAG = 2;
+static const int ASSIGNMENT_TAG = 3;
+static const int BASELINE_TAG = 4;
+
+static void printUsage(const char* program) {
+    cerr << "Usage: mpirun -n RANKS " << program << " --anchors FILE --steps N [options]\n"
+         << "\n"
+         << "Required arguments:\n"
+         << "  --anchors FILE               manifest listing the name, System, State and integrator of each anchor\n"
+         << "  --steps N                    largest number of steps to run each anchor for\n"
+         << "\n"
+         << "Options:\n"
+         << "  --block-steps N              steps per block of work (default: 10000)\n"
+         << "  --tolerance X                stop an MMVT anchor once the relative errors of its rates are\n"
+         << "                               below X (default: 0, run every step)\n"
+         << "  --min-blocks N               blocks before an anchor may be converged (default: 10)\n"
+         << "  --output-dir DIR             directory to write checkpoints and statistics to (default: .)\n"
+         << "  --resume                     continue each anchor from its checkpoint in the output directory\n"
+         << "  --platform NAME              platform to run on (default: fastest available)\n"
+         << "  --property KEY=VALUE         platform property, may be given more than once\n"
+         << "  --plugin-dir DIR             additional directory to load OpenMM plugins from\n";
+}
+
+/**
+ * Read an object written either by XmlSerializer or by BinarySerializer.
+ */
+template <class T>
+static T* readSerialized(const string& fileName) {
+    ifstream file(fileName.c_str(), ios_base::in | ios_base::binary);
+    if (!file)
+        throw OpenMMException("Could not open file for reading: "+fileName);
+    if (BinarySerializer::isBinary(file))
+        return BinarySerializer::deserialize<T>(file);
+    return XmlSerializer::deserialize<T>(file);
+}
+
+/**
+ * Write a file to a temporary file and then move it over the original, so
+ * that an interruption never leaves behind a truncated file.
+ */
+static void writeAtomically(const string& fileName, const function<void(ostream&)>& write) {
+    string tempFileName = fileName+".tmp";
+    {
+        ofstream file(tempFileName.c_str(), ios_base::out | ios_base::trunc | ios_base::binary);
+        if (!file)
+            throw OpenMMException("Could not open file for writing: "+tempFileName);
+        write(file);
+        file.close();
+        if (!file)
+            throw OpenMMException("Error writing file: "+tempFileName);
+    }
+    if (rename(tempFileName.c_str(), fileName.c_str()) != 0)
+        throw OpenMMException("Could not move "+tempFileName+" to "+fileName);
+}
+
+/**
+ * Write the State to the checkpoint, and the number of steps run and the
+ * integrator's own checkpoint to the file beside it, in the format used by
+ * seekr2_run.
+ */
+static void writeCheckpoint(const Context& context, const Integrator& integrator, long long stepsDone, const string& fileName) {
+    State state = context.getState(State::Positions | State::Velocities | State::Parameters, true);
+    const MmvtLangevinMiddleIntegrator* mmvtIntegrator = dynamic_cast<const MmvtLangevinMiddleIntegrator*>(&integrator);
+    writeAtomically(fileName+".integrator", [&] (ostream& file) {
+        long long stepCount = context.getStepCount();
+        bool isMmvt = (mmvtIntegrator != NULL);
+        file.write((char*) &stepsDone, sizeof(long long));
+        file.write((char*) &stepCount, sizeof(long long));
+        file.write((char*) &isMmvt, sizeof(bool));
+        if (isMmvt)
+            mmvtIntegrator->createCheckpoint(file);
+    });
+    writeAtomically(fileName, [&] (ostream& file) {
+        XmlSerializer::serialize<State>(&state, "State", file);
+    });
+}
+
+/**
+ * Read the number of steps run before a checkpoint, or return -1 if there is
+ * no checkpoint.
+ */
+static long long readStepsDone(const string& fileName) {
+    string integratorFileName = fileName+".integrator";
+    ifstream file(integratorFileName.c_str(), ios_base::in | ios_base::binary);
+    if (!file)
+        return -1;
+    long long stepsDone;
+    file.read((char*) &stepsDone, sizeof(long long));
+    if (!file)
+        throw OpenMMException("Error reading file: "+integratorFileName);
+    return stepsDone;
+}
+
+/**
+ * Restore the integrator from the file written beside a checkpoint, after the
+ * State has been set on the Context, and return the number of steps run
+ * before the checkpoint.
+ */
+static long long loadCheckpoint(const Context& context, Integrator& integrator, const string& fileName) {
+    string integratorFileName = fileName+".integrator";
+    ifstream file(integratorFileName.c_str(), ios_base::in | ios_base::binary);
+    if (!file)
+        throw OpenMMException("Could not open file for reading: "+integratorFileName);
+    long long stepsDone, stepCount;
+    bool isMmvt;
+    file.read((char*) &stepsDone, sizeof(long long));
+    file.read((char*) &stepCount, sizeof(long long));
+    file.read((char*) &isMmvt, sizeof(bool));
+    if (!file)
+        throw OpenMMException("Error reading file: "+integratorFileName);
+    if (stepCount != context.getStepCount())
+        throw OpenMMException(integratorFileName+" was not written with the State in "+fileName);
+    MmvtLangevinMiddleIntegrator* mmvtIntegrator = dynamic_cast<MmvtLangevinMiddleIntegrator*>(&integrator);
+    if (isMmvt != (mmvtIntegrator != NULL))
+        throw OpenMMException(integratorFileName+" was written for a different integrator");
+    if (isMmvt)
+        mmvtIntegrator->loadCheckpoint(file);
+    return stepsDone;
+}
+
+static long long parseCount(const string& option, const string& value) {
+    char* end;
+    long long count = strtoll(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0' || count < 0)
+        throw OpenMMException("Illegal value for "+option+": "+value);
+    return count;
+}
+
+struct AnchorInput {
+    string name, systemFileName, stateFileName, integratorFileName;
+};
+
+static vector<AnchorInput> readManifest(const string& fileName) {
+    ifstream file(fileName.c_str());
+    if (!file)
+        throw OpenMMException("Could not open file for reading: "+fileName);
+    vector<AnchorInput> anchors;
+    string line;
+    while (getline(file, line)) {
+        size_t comment = line.find('#');
+        if (comment != string::npos)
+            line = line.substr(0, comment);
+        stringstream fields(line);
+        AnchorInput anchor;
+        if (!(fields >> anchor.name))
+            continue;
+        string extra;
+        if (!(fields >> anchor.systemFileName >> anchor.stateFileName >> anchor.integratorFileName) || (fields >> extra))
+            throw OpenMMException("Anchor manifest lines must hold a name and three file names: "+line);
+        anchors.push_back(anchor);
+    }
+    if (anchors.empty())
+        throw OpenMMException("No anchors listed in "+fileName);
+    return anchors;
+}
+
+/**
+ * A block of steps of one anchor given to a rank. A negative anchor index
+ * tells the rank to exit. If resume is set, the anchor has already run steps
+ * and must be continued from its checkpoint.
+ */
+struct Assignment {
+    Assignment() : anchor(-1), steps(0), resume(0) {
+    }
+    long long anchor, steps, resume;
+};
+
+/**
+ * The result of running a block, along with the cumulative statistics of the
+ * Context that ran it. A negative anchor index means no block was run. When
+ * the block continued a checkpoint, the baseline holds the statistics
+ * restored from it.
+ */
+struct Report {
+    Report() : anchor(-1), steps(0), converged(0) {
+    }
+    long long anchor, steps, converged;
+    string statistics, baseline;
+};
+
+/**
+ * Runs the blocks assigned to one rank.
+ */
+class AnchorRunner {
+public:
+    AnchorRunner(const vector<AnchorInput>& anchors, const string& outputDir, const string& platformName, const map<string, string>& properties) :
+            anchors(anchors), outputDir(outputDir), platformName(platformName), properties(properties), currentAnchor(-1) {
+    }
+    Report run(const Assignment& assignment) {
+        int anchor = (int) assignment.anchor;
+        bool resumed = (anchor != currentAnchor && assignment.resume);
+        if (anchor != currentAnchor)
+            createContext(anchor, resumed);
+        MmvtLangevinMiddleIntegrator* mmvtIntegrator = dynamic_cast<MmvtLangevinMiddleIntegrator*>(integrator.get());
+        Report report;
+        if (resumed && mmvtIntegrator != NULL) {
+            stringstream statistics;
+            MmvtKineticsEstimator::writeStatistics(mmvtIntegrator->getStatistics(), statistics);
+            report.baseline = statistics.str();
+        }
+        long long startStep = context->getStepCount();
+        long long stepsDone = 0;
+        while (stepsDone < assignment.steps) {
+            int steps = (int) min(assignment.steps-stepsDone, (long long) INT_MAX);
+            integrator->step(steps);
+            stepsDone += steps;
+            if (mmvtIntegrator != NULL && mmvtIntegrator->isConverged())
+                break;
+        }
+        writeCheckpoint(*context, *integrator, context->getStepCount()-firstStep, getCheckpointFileName(anchor));
+        report.anchor = anchor;
+        
+        // An integrator that converges on its own may stop early, so count
+        // the steps the Context has actually taken.
+        
+        report.steps = context->getStepCount()-startStep;
+        if (mmvtIntegrator != NULL) {
+            report.converged = mmvtIntegrator->isConverged();
+            stringstream statistics;
+            MmvtKineticsEstimator::writeStatistics(mmvtIntegrator->getStatistics(), statistics);
+            report.statistics = statistics.str();
+        }
+        return report;
+    }
+private:
+    string getCheckpointFileName(int anchor) const {
+        return outputDir+"/"+anchors[anchor].name+".checkpoint.xml";
+    }
+    /**
+     * Create the Context for an anchor, either from its input files or, if
+     * the anchor has already run steps on this or another rank, from its
+     * checkpoint, so that its statistics and step count carry on.
+     */
+    void createContext(int anchor, bool resume) {
+        context.reset();
+        const AnchorInput& input = anchors[anchor];
+        system.reset(readSerialized<System>(input.systemFileName));
+        integrator.reset(readSerialized<Integrator>(input.integratorFileName));
+        string checkpointFileName = getCheckpointFileName(anchor);
+        unique_ptr<State> state(readSerialized<State>(resume ? checkpointFileName : input.stateFileName));
+        if (platformName.empty())
+            context.reset(new Context(*system, *integrator));
+        else {
+            Platform& platform = Platform::getPlatformByName(platformName);
+            context.reset(new Context(*system, *integrator, platform, properties));
+        }
+        context->setState(*state);
+        long long stepsDone = (resume ? loadCheckpoint(*context, *integrator, checkpointFileName) : 0);
+        firstStep = context->getStepCount()-stepsDone;
+        currentAnchor = anchor;
+    }
+    const vector<AnchorInput>& anchors;
+    string outputDir, platformName;
+    map<string, string> properties;
+    unique_ptr<System> system;
+    unique_ptr<Integrator> integrator;
+    unique_ptr<Context> context;
+    long long firstStep;
+    int currentAnchor;
+};
+
+/**
+ * Decides which block each rank runs next, and collects the results.
+ */
+class Coordinator {
+public:
+    Coordinator(int numAnchors, long long maxSteps, long long blockSteps, double tolerance, int minBlocks) :
+            anchors(numAnchors), maxSteps(maxSteps), blockSteps(blockSteps), tolerance(tolerance) {
+        for (auto& anchor : anchors)
+            anchor.monitor.setMinBlocks(minBlocks);
+    }
+    /**
+     * Record that an anchor has already run steps in an earlier job, and
+     * must be continued from its checkpoint.
+     */
+    void setStepsDone(int index, long long steps) {
+        anchors[index].stepsDone = steps;
+    }
+    /**
+     * Record the result of a block run by a rank.
+     */
+    void addReport(int rank, const Report& report) {
+        if (report.anchor < 0)
+            return;
+        Anchor& anchor = anchors[report.anchor];
+        anchor.running = false;
+        anchor.stepsDone += report.steps;
+        if (report.steps == 0) {
+            // The integrator would not take any more steps, so give up on
+            // the anchor rather than assigning it again and again.
+            
+            anchor.stepsDone = maxSteps;
+        }
+        anchor.numBlocks++;
+        if (!report.baseline.empty() && !hasStatistics(report.anchor)) {
+            // The anchor was continued from a checkpoint written by an
+            // earlier job, so measure its first block from there.
+            
+            stringstream input(report.baseline);
+            anchor.monitor.reset(MmvtKineticsEstimator::readStatistics(input));
+        }
+        if (!report.statistics.empty()) {
+            stringstream input(report.statistics);
+            anchor.statistics = MmvtKineticsEstimator::readStatistics(input);
+            anchor.monitor.addBlock(anchor.statistics);
+            if (tolerance > 0.0 && anchor.monitor.isConverged(tolerance))
+                anchor.converged = true;
+        }
+        if (report.converged)
+            anchor.converged = true;
+    }
+    /**
+     * Choose the next block for a rank to run. A rank keeps its anchor while
+     * the anchor needs more steps; otherwise it takes the unclaimed anchor
+     * that has run the fewest steps.
+     */
+    Assignment nextAssignment(int rank) {
+        int choice = -1;
+        for (int i = 0; i < anchors.size(); i++) {
+            if (!isRunnable(i))
+                continue;
+            if (anchors[i].lastRank == rank) {
+                choice = i;
+                break;
+            }
+            if (choice == -1 || anchors[i].stepsDone < anchors[choice].stepsDone)
+                choice = i;
+        }
+        Assignment assignment;
+        if (choice == -1)
+            return assignment;
+        Anchor& anchor = anchors[choice];
+        assignment.anchor = choice;
+        assignment.steps = min(blockSteps, maxSteps-anchor.stepsDone);
+        assignment.resume = (anchor.stepsDone > 0);
+        anchor.lastRank = rank;
+        anchor.running = true;
+        return assignment;
+    }
+    const MmvtAnchorStatistics& getStatistics(int index) const {
+        return anchors[index].statistics;
+    }
+    bool hasStatistics(int index) const {
+        return !anchors[index].statistics.milestoneGroups.empty();
+    }
+    long long getStepsDone(int index) const {
+        return anchors[index].stepsDone;
+    }
+    int getNumBlocks(int index) const {
+        return anchors[index].numBlocks;
+    }
+    bool isConverged(int index) const {
+        return anchors[index].converged;
+    }
+    double getMaxRelativeError(int index) const {
+        return anchors[index].monitor.getMaxRelativeError();
+    }
+private:
+    struct Anchor {
+        Anchor() : stepsDone(0), numBlocks(0), lastRank(-1), running(false), converged(false) {
+        }
+        long long stepsDone;
+        int numBlocks, lastRank;
+        bool running, converged;
+        MmvtAnchorStatistics statistics;
+        MmvtConvergenceMonitor monitor;
+    };
+    bool isRunnable(int index) const {
+        const Anchor& anchor = anchors[index];
+        return (!anchor.running && !anchor.converged && anchor.stepsDone < maxSteps);
+    }
+    vector<Anchor> anchors;
+    long long maxSteps, blockSteps;
+    double tolerance;
+};
+
+static void sendReport(const Report& report) {
+    long long header[5] = {report.anchor, report.steps, report.converged, (long long) report.statistics.size(), (long long) report.baseline.size()};
+    MPI_Send(header, 5, MPI_LONG_LONG, 0, REPORT_TAG, MPI_COMM_WORLD);
+    if (!report.statistics.empty())
+        MPI_Send(report.statistics.data(), report.statistics.size(), MPI_CHAR, 0, STATISTICS_TAG, MPI_COMM_WORLD);
+    if (!report.baseline.empty())
+        MPI_Send(report.baseline.data(), report.baseline.size(), MPI_CHAR, 0, BASELINE_TAG, MPI_COMM_WORLD);
+}
+
+static Report receiveReport(int& rank) {
+    long long header[5];
+    MPI_Status status;
+    MPI_Recv(header, 5, MPI_LONG_LONG, MPI_ANY_SOURCE, REPORT_TAG, MPI_COMM_WORLD, &status);
+    rank = status.MPI_SOURCE;
+    Report report;
+    report.anchor = header[0];
+    report.steps = header[1];
+    report.converged = header[2];
+    if (header[3] > 0) {
+        vector<char> statistics(header[3]);
+        MPI_Recv(statistics.data(), header[3], MPI_CHAR, rank, STATISTICS_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        report.statistics.assign(statistics.begin(), statistics.end());
+    }
+    if (header[4] > 0) {
+        vector<char> baseline(header[4]);
+        MPI_Recv(baseline.data(), header[4], MPI_CHAR, rank, BASELINE_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        report.baseline.assign(baseline.begin(), baseline.end());
+    }
+    return report;
+}
+
+static void sendAssignment(const Assignment& assignment, int rank) {
+    long long message[3] = {assignment.anchor, assignment.steps, assignment.resume};
+    MPI_Send(message, 3, MPI_LONG_LONG, rank, ASSIGNMENT_TAG, MPI_COMM_WORLD);
+}
+
+static Assignment receiveAssignment() {
+    long long message[3];
+    MPI_Recv(message, 3, MPI_LONG_LONG, 0, ASSIGNMENT_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    Assignment assignment;
+    assignment.anchor = message[0];
+    assignment.steps = message[1];
+    assignment.resume = message[2];
+    return assignment;
+}
+
+static void writeResults(const Coordinator& coordinator, const vector<AnchorInput>& anchors, const string& outputDir) {
+    cout << "Anchor                 Steps  Blocks  Converged  Max relative error\n";
+    for (int i = 0; i < anchors.size(); i++) {
+        cout << left << setw(20) << anchors[i].name << right << setw(8) << coordinator.getStepsDone(i) << setw(8) << coordinator.getNumBlocks(i)
+             << setw(11) << (coordinator.isConverged(i) ? "yes" : "no") << "  " << coordinator.getMaxRelativeError(i) << "\n";
+        if (!coordinator.hasStatistics(i))
+            continue;
+        string fileName = outputDir+"/"+anchors[i].name+".statistics.txt";
+        ofstream file(fileName.c_str());
+        if (!file)
+            throw OpenMMException("Could not open file for writing: "+fileName);
+        MmvtKineticsEstimator::writeStatistics(coordinator.getStatistics(i), file);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    MPI_Init(&argc, &argv);
+    int rank, numRanks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numRanks);
+    string anchorsFileName, platformName;
+    string outputDir = ".";
+    vector<string> pluginDirs;
+    map<string, string> properties;
+    long long numSteps = -1;
+    long long blockSteps = 10000;
+    double tolerance = 0.0;
+    int minBlocks = 10;
+    bool resume = false;
+    try {
+        for (int i = 1; i < argc; i++) {
+            string option = argv[i];
+            if (option == "-h" || option == "--help") {
+                if (rank == 0)
+                    printUsage(argv[0]);
+                MPI_Finalize();
+                return 0;
+            }
+            if (option == "--resume") {
+                resume = true;
+                continue;
+            }
+            if (i+1 >= argc)
+                throw OpenMMException("Missing value for "+option);
+            string value = argv[++i];
+            if (option == "--anchors")
+                anchorsFileName = value;
+            else if (option == "--steps")
+                numSteps = parseCount(option, value);
+            else if (option == "--block-steps")
+                blockSteps = parseCount(option, value);
+            else if (option == "--tolerance")
+                tolerance = atof(value.c_str());
+            else if (option == "--min-blocks")
+                minBlocks = (int) parseCount(option, value);
+            else if (option == "--output-dir")
+                outputDir = value;
+            else if (option == "--platform")
+                platformName = value;
+            else if (option == "--plugin-dir")
+                pluginDirs.push_back(value);
+            else if (option == "--property") {
+                size_t split = value.find('=');
+                if (split == string::npos)
+                    throw OpenMMException("Platform properties must be given as KEY=VALUE: "+value);
+                properties[value.substr(0, split)] = value.substr(split+1);
+            }
+            else
+                throw OpenMMException("Unknown option: "+option);
+        }
+        if (anchorsFileName.empty() || numSteps < 0 || blockSteps < 1)
+            throw OpenMMException("--anchors and --steps are required, and --block-steps must be positive");
+    }
+    catch (const exception& e) {
+        if (rank == 0) {
+            cerr << "seekr2_mpi_run: " << e.what() << endl;
+            printUsage(argv[0]);
+        }
+        MPI_Finalize();
+        return 1;
+    }
+    
+    // An error on any rank ends the whole job, since the others would
+    // otherwise wait for it forever.
+    
+    try {
+        vector<AnchorInput> anchors = readManifest(anchorsFileName);
+        if (rank == 0) {
+            Coordinator coordinator(anchors.size(), numSteps, blockSteps, tolerance, minBlocks);
+            if (resume) {
+                for (int i = 0; i < anchors.size(); i++) {
+                    long long stepsDone = readStepsDone(outputDir+"/"+anchors[i].name+".checkpoint.xml");
+                    if (stepsDone > 0)
+                        coordinator.setStepsDone(i, stepsDone);
+                }
+            }
+            if (numRanks == 1) {
+                Platform::loadPluginsFromDirectory(Platform::getDefaultPluginsDirectory());
+                for (auto& dir : pluginDirs)
+                    Platform::loadPluginsFromDirectory(dir);
+                AnchorRunner runner(anchors, outputDir, platformName, properties);
+                for (Assignment assignment = coordinator.nextAssignment(0); assignment.anchor >= 0; assignment = coordinator.nextAssignment(0))
+                    coordinator.addReport(0, runner.run(assignment));
+            }
+            else {
+                int numWorkers = numRanks-1;
+                while (numWorkers > 0) {
+                    int worker;
+                    Report report = receiveReport(worker);
+                    coordinator.addReport(worker, report);
+                    Assignment assignment = coordinator.nextAssignment(worker);
+                    sendAssignment(assignment, worker);
+                    if (assignment.anchor < 0)
+                        numWorkers--;
+                }
+            }
+            writeResults(coordinator, anchors, outputDir);
+        }
+        else {
+            Platform::loadPluginsFromDirectory(Platform::getDefaultPluginsDirectory());
+            for (auto& dir : pluginDirs)
+                Platform::loadPluginsFromDirectory(dir);
+            AnchorRunner runner(anchors, outputDir, platformName, properties);
+            Report report;
+            while (true) {
+                sendReport(report);
+                Assignment assignment = receiveAssignment();
+                if (assignment.anchor < 0)
+                    break;
+                report = runner.run(assignment);
+                cout << "Rank " << rank << ": anchor " << anchors[assignment.anchor].name << ", " << report.steps << " steps" << endl;
+            }
+        }
+    }
+    catch (const exception& e) {
+        cerr << "seekr2_mpi_run (rank " << rank << "): " << e.what() << endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+        return 1;
+    }
+    MPI_Finalize();
+    return 0;
+}
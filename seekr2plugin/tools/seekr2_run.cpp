@@ -0,0 +1,303 @@
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * seekr2_run: run an MMVT or Elber simulation from serialized XML files,
+ * without Python.
+ *
+ * The System, State and integrator are read from files written with
+ * OpenMM's XmlSerializer or with BinarySerializer (the integrator may be any Integrator for which a
+ * serialization proxy is registered, including MmvtLangevinMiddleIntegrator
+ * and ElberLangevinMiddleIntegrator). The simulation is run for the requested
+ * number of steps, and the State is periodically written to a checkpoint file.
+ * Alongside it, a second file with the suffix ".integrator" holds the number
+ * of steps run and, for MmvtLangevinMiddleIntegrator, the bounce counter and
+ * transition statistics, so that an interrupted run restarted with
+ * --restart-from continues them rather than counting again from zero.
+ */
+
+#include "MmvtLangevinMiddleIntegrator.h"
+#include "ElberLangevinMiddleIntegrator.h"
+#include "BinarySerializer.h"
+#include "openmm/Context.h"
+#include "openmm/Integrator.h"
+#include "openmm/OpenMMException.h"
+#include "openmm/Platform.h"
+#include "openmm/State.h"
+#include "openmm/System.h"
+#include "openmm/serialization/XmlSerializer.h"
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace Seekr2Plugin;
+using namespace OpenMM;
+using namespace std;
+
+static void printUsage(const char* program) {
+    cerr << "Usage: " << program << " --system FILE (--state FILE | --restart-from FILE) --integrator FILE --steps N [options]\n"
+         << "\n"
+         << "Required arguments:\n"
+         << "  --system FILE                serialized System (XML or binary)\n"
+         << "  --state FILE                 serialized State to start from (XML or binary)\n"
+         << "  --integrator FILE            serialized MMVT or Elber integrator (XML or binary)\n"
+         << "  --steps N                    total number of steps to run, including those run before a restart\n"
+         << "\n"
+         << "Options:\n"
+         << "  --restart-from FILE          checkpoint of an interrupted run to continue, instead of --state\n"
+         << "  --platform NAME              platform to run on (default: fastest available)\n"
+         << "  --property KEY=VALUE         platform property, may be given more than once\n"
+         << "  --plugin-dir DIR             additional directory to load OpenMM plugins from\n"
+         << "  --checkpoint FILE            State XML checkpoint to write, with FILE.integrator beside it\n"
+         << "                               (default: checkpoint.xml)\n"
+         << "  --checkpoint-interval N      steps between checkpoints (default: 0, at the end only)\n";
+}
+
+/**
+ * Read an object written either by XmlSerializer or by BinarySerializer.
+ */
+template <class T>
+static T* readSerialized(const string& fileName) {
+    ifstream file(fileName.c_str(), ios_base::in | ios_base::binary);
+    if (!file)
+        throw OpenMMException("Could not open file for reading: "+fileName);
+    if (BinarySerializer::isBinary(file))
+        return BinarySerializer::deserialize<T>(file);
+    return XmlSerializer::deserialize<T>(file);
+}
+
+/**
+ * Write a file to a temporary file and then move it over the original, so
+ * that an interruption never leaves behind a truncated file.
+ */
+static void writeAtomically(const string& fileName, const function<void(ostream&)>& write) {
+    string tempFileName = fileName+".tmp";
+    {
+        ofstream file(tempFileName.c_str(), ios_base::out | ios_base::trunc | ios_base::binary);
+        if (!file)
+            throw OpenMMException("Could not open file for writing: "+tempFileName);
+        write(file);
+        file.close();
+        if (!file)
+            throw OpenMMException("Error writing file: "+tempFileName);
+    }
+    if (rename(tempFileName.c_str(), fileName.c_str()) != 0)
+        throw OpenMMException("Could not move "+tempFileName+" to "+fileName);
+}
+
+/**
+ * Write the State to the checkpoint, and the number of steps run and the
+ * integrator's own checkpoint to the file beside it. The step count of the
+ * Context is stored in both, so that a State and integrator checkpoint
+ * written at different times are never restored together.
+ */
+static void writeCheckpoint(const Context& context, const Integrator& integrator, long long stepsDone, const string& fileName) {
+    State state = context.getState(State::Positions | State::Velocities | State::Parameters, true);
+    const MmvtLangevinMiddleIntegrator* mmvtIntegrator = dynamic_cast<const MmvtLangevinMiddleIntegrator*>(&integrator);
+    writeAtomically(fileName+".integrator", [&] (ostream& file) {
+        long long stepCount = context.getStepCount();
+        bool isMmvt = (mmvtIntegrator != NULL);
+        file.write((char*) &stepsDone, sizeof(long long));
+        file.write((char*) &stepCount, sizeof(long long));
+        file.write((char*) &isMmvt, sizeof(bool));
+        if (isMmvt)
+            mmvtIntegrator->createCheckpoint(file);
+    });
+    writeAtomically(fileName, [&] (ostream& file) {
+        XmlSerializer::serialize<State>(&state, "State", file);
+    });
+}
+
+/**
+ * Restore the integrator from the file written beside a checkpoint, after the
+ * State has been set on the Context, and return the number of steps run
+ * before the checkpoint.
+ */
+static long long loadCheckpoint(const Context& context, Integrator& integrator, const string& fileName) {
+    string integratorFileName = fileName+".integrator";
+    ifstream file(integratorFileName.c_str(), ios_base::in | ios_base::binary);
+    if (!file)
+        throw OpenMMException("Could not open file for reading: "+integratorFileName);
+    long long stepsDone, stepCount;
+    bool isMmvt;
+    file.read((char*) &stepsDone, sizeof(long long));
+    file.read((char*) &stepCount, sizeof(long long));
+    file.read((char*) &isMmvt, sizeof(bool));
+    if (!file)
+        throw OpenMMException("Error reading file: "+integratorFileName);
+    if (stepCount != context.getStepCount())
+        throw OpenMMException(integratorFileName+" was not written with the State in "+fileName);
+    MmvtLangevinMiddleIntegrator* mmvtIntegrator = dynamic_cast<MmvtLangevinMiddleIntegrator*>(&integrator);
+    if (isMmvt != (mmvtIntegrator != NULL))
+        throw OpenMMException(integratorFileName+" was written for a different integrator");
+    if (isMmvt)
+        mmvtIntegrator->loadCheckpoint(file);
+    return stepsDone;
+}
+
+static long long parseCount(const string& option, const string& value) {
+    char* end;
+    long long count = strtoll(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0' || count < 0)
+        throw OpenMMException("Illegal value for "+option+": "+value);
+    return count;
+}
+
+int main(int argc, char* argv[]) {
+    string systemFileName, stateFileName, restartFileName, integratorFileName, platformName;
+    string checkpointFileName = "checkpoint.xml";
+    vector<string> pluginDirs;
+    map<string, string> properties;
+    long long numSteps = -1;
+    long long checkpointInterval = 0;
+    try {
+        for (int i = 1; i < argc; i++) {
+            string option = argv[i];
+            if (option == "-h" || option == "--help") {
+                printUsage(argv[0]);
+                return 0;
+            }
+            if (i+1 >= argc)
+                throw OpenMMException("Missing value for "+option);
+            string value = argv[++i];
+            if (option == "--system")
+                systemFileName = value;
+            else if (option == "--state")
+                stateFileName = value;
+            else if (option == "--restart-from")
+                restartFileName = value;
+            else if (option == "--integrator")
+                integratorFileName = value;
+            else if (option == "--platform")
+                platformName = value;
+            else if (option == "--steps")
+                numSteps = parseCount(option, value);
+            else if (option == "--checkpoint")
+                checkpointFileName = value;
+            else if (option == "--checkpoint-interval")
+                checkpointInterval = parseCount(option, value);
+            else if (option == "--plugin-dir")
+                pluginDirs.push_back(value);
+            else if (option == "--property") {
+                size_t split = value.find('=');
+                if (split == string::npos)
+                    throw OpenMMException("Platform properties must be given as KEY=VALUE: "+value);
+                properties[value.substr(0, split)] = value.substr(split+1);
+            }
+            else
+                throw OpenMMException("Unknown option: "+option);
+        }
+        if (systemFileName.empty() || stateFileName.empty() == restartFileName.empty() || integratorFileName.empty() || numSteps < 0) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        if (!properties.empty() && platformName.empty())
+            throw OpenMMException("--property may only be given together with --platform");
+    }
+    catch (const exception& e) {
+        cerr << "seekr2_run: " << e.what() << endl;
+        printUsage(argv[0]);
+        return 1;
+    }
+    
+    try {
+        // Load the platform plugins, including the SEEKR2 kernels.
+        
+        Platform::loadPluginsFromDirectory(Platform::getDefaultPluginsDirectory());
+        for (auto& dir : pluginDirs)
+            Platform::loadPluginsFromDirectory(dir);
+        
+        unique_ptr<System> system(readSerialized<System>(systemFileName));
+        unique_ptr<State> state(readSerialized<State>(restartFileName.empty() ? stateFileName : restartFileName));
+        unique_ptr<Integrator> integrator(readSerialized<Integrator>(integratorFileName));
+        MmvtLangevinMiddleIntegrator* mmvtIntegrator = dynamic_cast<MmvtLangevinMiddleIntegrator*>(integrator.get());
+        if (mmvtIntegrator != NULL)
+            cout << "Integrator: MmvtLangevinMiddleIntegrator\n";
+        else if (dynamic_cast<ElberLangevinMiddleIntegrator*>(integrator.get()) != NULL)
+            cout << "Integrator: ElberLangevinMiddleIntegrator\n";
+        else
+            cout << "Integrator: not a SEEKR2 integrator, no crossings will be recorded\n";
+        
+        unique_ptr<Context> context;
+        if (platformName.empty())
+            context.reset(new Context(*system, *integrator));
+        else {
+            Platform& platform = Platform::getPlatformByName(platformName);
+            context.reset(new Context(*system, *integrator, platform, properties));
+        }
+        context->setState(*state);
+        cout << "Platform: " << context->getPlatform().getName() << "\n";
+        long long stepsDone = 0;
+        if (!restartFileName.empty()) {
+            stepsDone = loadCheckpoint(*context, *integrator, restartFileName);
+            cout << "Restarting after step " << stepsDone << "\n";
+        }
+        
+        // Run in chunks, writing a checkpoint after each one.
+        
+        long long chunkSize = (checkpointInterval > 0 ? checkpointInterval : numSteps);
+        long long startStep = stepsDone;
+        auto startTime = chrono::steady_clock::now();
+        while (stepsDone < numSteps) {
+            long long steps = min(min(chunkSize, numSteps-stepsDone), (long long) INT_MAX);
+            long long stepCount = context->getStepCount();
+            integrator->step((int) steps);
+            stepsDone += context->getStepCount()-stepCount;
+            writeCheckpoint(*context, *integrator, stepsDone, checkpointFileName);
+            double elapsed = chrono::duration<double>(chrono::steady_clock::now()-startTime).count();
+            double nsPerDay = (elapsed > 0 ? (stepsDone-startStep)*integrator->getStepSize()*1e-3*86400.0/elapsed : 0.0);
+            cout << "Step " << stepsDone << "/" << numSteps << ", " << elapsed << " s, " << nsPerDay << " ns/day" << endl;
+            if (mmvtIntegrator != NULL && mmvtIntegrator->isConverged()) {
+                cout << "MMVT statistics converged, stopping early" << endl;
+                break;
+            }
+        }
+        if (stepsDone == startStep)
+            writeCheckpoint(*context, *integrator, stepsDone, checkpointFileName);
+    }
+    catch (const exception& e) {
+        cerr << "seekr2_run: " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
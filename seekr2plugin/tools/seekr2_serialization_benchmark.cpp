@@ -0,0 +1,190 @@
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * seekr2_serialization_benchmark: compare XmlSerializer and BinarySerializer
+ * on a System and a State, such as the ones given to seekr2_run. For each
+ * object and each serializer it reports the size of the serialized data and
+ * the time taken to write and to read it, which includes running the
+ * serialization proxies, and the speedup of BinarySerializer over
+ * XmlSerializer. Every object read back is checked against the original.
+ */
+
+#include "BinarySerializer.h"
+#include "openmm/OpenMMException.h"
+#include "openmm/State.h"
+#include "openmm/System.h"
+#include "openmm/serialization/XmlSerializer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace OpenMM;
+using namespace std;
+
+static void printUsage(const char* program) {
+    cerr << "Usage: " << program << " [options] SYSTEM STATE\n"
+         << "\n"
+         << "SYSTEM and STATE may be written by either XmlSerializer or BinarySerializer.\n"
+         << "\n"
+         << "Options:\n"
+         << "  --repeats N                  number of times to write and read each object (default: 10)\n";
+}
+
+template <class T>
+static T* readObject(const string& fileName) {
+    ifstream file(fileName, ios::in | ios::binary);
+    if (!file.is_open())
+        throw OpenMMException("Failed to open "+fileName);
+    if (BinarySerializer::isBinary(file))
+        return BinarySerializer::deserialize<T>(file);
+    return XmlSerializer::deserialize<T>(file);
+}
+
+static void checkCopy(const System& original, const System& copy) {
+    if (copy.getNumParticles() != original.getNumParticles() || copy.getNumForces() != original.getNumForces())
+        throw OpenMMException("The System read back differs from the original");
+    for (int i = 0; i < original.getNumParticles(); i++)
+        if (copy.getParticleMass(i) != original.getParticleMass(i))
+            throw OpenMMException("The System read back differs from the original");
+}
+
+static void checkCopy(const State& original, const State& copy) {
+    const vector<Vec3>& positions = original.getPositions();
+    const vector<Vec3>& velocities = original.getVelocities();
+    if (copy.getTime() != original.getTime() || copy.getPositions().size() != positions.size())
+        throw OpenMMException("The State read back differs from the original");
+    for (int i = 0; i < positions.size(); i++)
+        if (copy.getPositions()[i] != positions[i] || copy.getVelocities()[i] != velocities[i])
+            throw OpenMMException("The State read back differs from the original");
+}
+
+/**
+ * Write and read an object repeatedly with both serializers, and print one
+ * line of results for each.
+ */
+template <class T>
+static void benchmark(const T& object, const string& rootName, const string& objectName, int repeats) {
+    double xmlWriteTime = 0.0, xmlReadTime = 0.0;
+    for (int binary = 0; binary < 2; binary++) {
+        string data;
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < repeats; i++) {
+            ostringstream stream;
+            if (binary)
+                BinarySerializer::serialize<T>(&object, rootName, stream);
+            else
+                XmlSerializer::serialize<T>(&object, rootName, stream);
+            if (i == 0)
+                data = stream.str();
+        }
+        double writeTime = chrono::duration<double>(chrono::steady_clock::now()-start).count()/repeats;
+        start = chrono::steady_clock::now();
+        for (int i = 0; i < repeats; i++) {
+            istringstream stream(data);
+            T* copy = (binary ? BinarySerializer::deserialize<T>(stream) : XmlSerializer::deserialize<T>(stream));
+            if (i == 0)
+                checkCopy(object, *copy);
+            delete copy;
+        }
+        double readTime = chrono::duration<double>(chrono::steady_clock::now()-start).count()/repeats;
+        if (!binary) {
+            xmlWriteTime = writeTime;
+            xmlReadTime = readTime;
+        }
+        cout << left << setw(8) << objectName << setw(8) << (binary ? "Binary" : "Xml") << right << setw(14) << data.size()
+             << fixed << setprecision(2) << setw(14) << 1000*writeTime << setw(14) << 1000*readTime
+             << setw(15) << xmlWriteTime/writeTime << setw(14) << xmlReadTime/readTime << defaultfloat << endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    vector<string> fileNames;
+    int repeats = 10;
+    try {
+        for (int i = 1; i < argc; i++) {
+            string option = argv[i];
+            if (option == "-h" || option == "--help") {
+                printUsage(argv[0]);
+                return 0;
+            }
+            if (option == "--repeats") {
+                if (i+1 >= argc)
+                    throw OpenMMException("Missing value for "+option);
+                string value = argv[++i];
+                char* end;
+                long number = strtol(value.c_str(), &end, 10);
+                if (value.empty() || *end != '\0' || number < 1)
+                    throw OpenMMException("Illegal value for "+option+": "+value);
+                repeats = (int) number;
+            }
+            else if (option.size() > 1 && option[0] == '-')
+                throw OpenMMException("Unknown option: "+option);
+            else
+                fileNames.push_back(option);
+        }
+        if (fileNames.size() != 2) {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    catch (const exception& e) {
+        cerr << "seekr2_serialization_benchmark: " << e.what() << endl;
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    try {
+        System* system = readObject<System>(fileNames[0]);
+        State* state = readObject<State>(fileNames[1]);
+        cout << "# " << fileNames[0] << ": " << system->getNumParticles() << " particles, " << system->getNumForces()
+             << " forces; " << repeats << " repeats" << endl;
+        cout << left << setw(8) << "object" << setw(8) << "format" << right << setw(14) << "bytes" << setw(14) << "write ms"
+             << setw(14) << "read ms" << setw(15) << "write speedup" << setw(14) << "read speedup" << endl;
+        benchmark(*system, "System", "System", repeats);
+        benchmark(*state, "State", "State", repeats);
+        delete system;
+        delete state;
+    }
+    catch (const exception& e) {
+        cerr << "seekr2_serialization_benchmark: " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,242 @@
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * seekr2_state_encoding_benchmark: compare the size of saved states, and the
+ * speed of writing and reading them, for every format CrossingStateEncoder
+ * supports.
+ *
+ * The structure is read from an Amber coordinate file, such as
+ * examples/tryp_ben.inpcrd, and used as the reference structure of the
+ * anchor. The saved state is that structure with every atom displaced at
+ * random, and with random velocities, as it might be at a crossing after a
+ * while in the anchor. The speeds are given in megabytes of double
+ * precision positions and velocities processed per second.
+ */
+
+#include "CrossingStateEncoder.h"
+#include "openmm/OpenMMException.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace Seekr2Plugin;
+using namespace OpenMM;
+using namespace std;
+
+static void printUsage(const char* program) {
+    cerr << "Usage: " << program << " [options] INPCRD\n"
+         << "\n"
+         << "Options:\n"
+         << "  --repeats N                  number of times to encode and decode each state (default: 20)\n"
+         << "  --displacement D             standard deviation of the displacement from the reference, in nm (default: 0.05)\n"
+         << "  --resolution R               resolution of the FixedPoint format (default: 1e-4)\n"
+         << "  --atoms N                    save only the first N atoms (default: every atom)\n";
+}
+
+static double parseNumber(const string& option, const string& value) {
+    char* end;
+    double number = strtod(value.c_str(), &end);
+    if (value.empty() || *end != '\0' || number < 0)
+        throw OpenMMException("Illegal value for "+option+": "+value);
+    return number;
+}
+
+/**
+ * Read the positions and periodic box vectors from an Amber coordinate file.
+ */
+static void readInpcrd(const string& fileName, vector<Vec3>& positions, Vec3* box) {
+    ifstream file(fileName);
+    if (!file.is_open())
+        throw OpenMMException("Failed to open "+fileName);
+    string title;
+    getline(file, title);
+    int numAtoms;
+    if (!(file >> numAtoms))
+        throw OpenMMException("Failed to read the number of atoms from "+fileName);
+    string line;
+    getline(file, line);
+    positions.resize(numAtoms);
+    for (int i = 0; i < numAtoms; i++)
+        if (!(file >> positions[i][0] >> positions[i][1] >> positions[i][2]))
+            throw OpenMMException("Failed to read the coordinates from "+fileName);
+    for (Vec3& pos : positions)
+        pos *= 0.1;
+    double a, b, c, alpha, beta, gamma;
+    if (!(file >> a >> b >> c >> alpha >> beta >> gamma))
+        throw OpenMMException("Failed to read the periodic box from "+fileName);
+    alpha *= M_PI/180.0;
+    beta *= M_PI/180.0;
+    gamma *= M_PI/180.0;
+    box[0] = Vec3(a, 0, 0)*0.1;
+    box[1] = Vec3(b*cos(gamma), b*sin(gamma), 0)*0.1;
+    double cx = c*cos(beta);
+    double cy = c*(cos(alpha)-cos(beta)*cos(gamma))/sin(gamma);
+    box[2] = Vec3(cx, cy, sqrt(c*c-cx*cx-cy*cy))*0.1;
+}
+
+int main(int argc, char* argv[]) {
+    string inpcrdFileName;
+    int repeats = 20, numSaved = -1;
+    double displacement = 0.05, resolution = 1e-4;
+    try {
+        for (int i = 1; i < argc; i++) {
+            string option = argv[i];
+            if (option == "-h" || option == "--help") {
+                printUsage(argv[0]);
+                return 0;
+            }
+            if (option == "--repeats" || option == "--displacement" || option == "--resolution" || option == "--atoms") {
+                if (i+1 >= argc)
+                    throw OpenMMException("Missing value for "+option);
+                double value = parseNumber(option, argv[++i]);
+                if (option == "--repeats")
+                    repeats = max(1, (int) value);
+                else if (option == "--displacement")
+                    displacement = value;
+                else if (option == "--resolution")
+                    resolution = value;
+                else
+                    numSaved = (int) value;
+            }
+            else if (option.size() > 1 && option[0] == '-')
+                throw OpenMMException("Unknown option: "+option);
+            else
+                inpcrdFileName = option;
+        }
+        if (inpcrdFileName.empty()) {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    catch (const exception& e) {
+        cerr << "seekr2_state_encoding_benchmark: " << e.what() << endl;
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    try {
+        // Build the state to save.
+
+        vector<Vec3> reference;
+        Vec3 box[3];
+        readInpcrd(inpcrdFileName, reference, box);
+        int numAtoms = reference.size();
+        mt19937_64 random(0);
+        normal_distribution<double> gaussian(0.0, 1.0);
+        vector<Vec3> positions(numAtoms), velocities(numAtoms);
+        for (int i = 0; i < numAtoms; i++) {
+            positions[i] = reference[i]+Vec3(gaussian(random), gaussian(random), gaussian(random))*displacement;
+            velocities[i] = Vec3(gaussian(random), gaussian(random), gaussian(random))*0.5;
+        }
+        vector<int> atoms;
+        if (numSaved >= 0 && numSaved < numAtoms) {
+            for (int i = 0; i < numSaved; i++)
+                atoms.push_back(i);
+            positions.resize(numSaved);
+            velocities.resize(numSaved);
+        }
+        cout << "# " << inpcrdFileName << ": " << numAtoms << " atoms, " << positions.size() << " saved, "
+             << repeats << " repeats" << endl;
+        cout << left << setw(12) << "format" << setw(11) << "reference" << setw(12) << "compressed"
+             << right << setw(12) << "bytes" << setw(9) << "ratio" << setw(14) << "encode MB/s" << setw(14) << "decode MB/s"
+             << setw(14) << "max pos err" << setw(14) << "max vel err" << endl;
+
+        // Encode and decode the state in every format.
+
+        const char* formatNames[] = {"Xml", "Double", "Float", "FixedPoint"};
+        double xmlSize = 0.0;
+        for (int format = CrossingStateEncoder::Xml; format <= CrossingStateEncoder::FixedPoint; format++) {
+            for (int useReference = 0; useReference < 2; useReference++) {
+                for (int compress = 0; compress < 2; compress++) {
+                    if (format == CrossingStateEncoder::Xml && (useReference || compress))
+                        continue;
+                    if (compress && !CrossingStateEncoder::isCompressionAvailable())
+                        continue;
+                    CrossingStateEncoder encoder;
+                    encoder.setFormat((CrossingStateEncoder::Format) format);
+                    encoder.setResolution(resolution);
+                    encoder.setCompression(compress);
+                    if (useReference)
+                        encoder.setReferencePositions(reference);
+                    string data;
+                    auto start = chrono::steady_clock::now();
+                    for (int i = 0; i < repeats; i++) {
+                        ostringstream stream;
+                        encoder.encode(1.0, 500, box, atoms, positions, velocities, stream);
+                        if (i == 0)
+                            data = stream.str();
+                    }
+                    double encodeTime = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+                    CrossingSnapshot snapshot;
+                    vector<int> decodedAtoms;
+                    start = chrono::steady_clock::now();
+                    for (int i = 0; i < repeats; i++) {
+                        istringstream stream(data);
+                        encoder.decode(stream, snapshot, decodedAtoms);
+                    }
+                    double decodeTime = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+                    double positionError = 0.0, velocityError = 0.0;
+                    for (int i = 0; i < positions.size(); i++)
+                        for (int j = 0; j < 3; j++) {
+                            positionError = max(positionError, fabs(snapshot.positions[i][j]-positions[i][j]));
+                            velocityError = max(velocityError, fabs(snapshot.velocities[i][j]-velocities[i][j]));
+                        }
+                    if (format == CrossingStateEncoder::Xml)
+                        xmlSize = data.size();
+                    double megabytes = repeats*positions.size()*6*sizeof(double)/1e6;
+                    cout << left << setw(12) << formatNames[format] << setw(11) << (useReference ? "yes" : "no")
+                         << setw(12) << (compress ? "yes" : "no") << right << setw(12) << data.size()
+                         << setw(9) << fixed << setprecision(2) << xmlSize/data.size()
+                         << setw(14) << setprecision(1) << megabytes/encodeTime << setw(14) << megabytes/decodeTime
+                         << setw(14) << scientific << setprecision(2) << positionError << setw(14) << velocityError
+                         << defaultfloat << endl;
+                }
+            }
+        }
+    }
+    catch (const exception& e) {
+        cerr << "seekr2_state_encoding_benchmark: " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
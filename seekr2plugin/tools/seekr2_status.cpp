@@ -0,0 +1,164 @@
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * seekr2_status: print the live status of running MMVT anchors.
+ *
+ * Each anchor must have been given a status segment name with
+ * MmvtLangevinMiddleIntegrator::setStatusSegmentName(). The segments are
+ * mapped read only, so reading them never slows down or blocks the
+ * simulations. The step count, time, transition statistics and performance
+ * counters of each anchor are printed in the same format as the statistics
+ * file written by the integrator.
+ */
+
+#include "MmvtStatusSegment.h"
+#include "openmm/OpenMMException.h"
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+    #include <signal.h>
+#endif
+
+using namespace Seekr2Plugin;
+using namespace OpenMM;
+using namespace std;
+
+static void printUsage(const char* program) {
+    cerr << "Usage: " << program << " [options] SEGMENT [SEGMENT ...]\n"
+         << "\n"
+         << "Options:\n"
+         << "  --watch SECONDS              print the status again every SECONDS seconds\n";
+}
+
+static bool isRunning(int processId) {
+#ifdef _WIN32
+    return true;
+#else
+    return (kill(processId, 0) == 0 || errno == EPERM);
+#endif
+}
+
+static void printStatus(const string& name, const MmvtStatus& status) {
+    const MmvtAnchorStatistics& statistics = status.statistics;
+    const MmvtPerformanceCounters& counters = status.counters;
+    int numGroups = statistics.milestoneGroups.size();
+    cout << "# " << name << ": process " << status.processId << (isRunning(status.processId) ? " running" : " not running")
+         << ", " << status.numUpdates << " updates\n";
+    cout << "step: " << status.stepCount << "\n";
+    cout << "time: " << status.time << "\n";
+    cout << "bounces: " << status.bounceCounter << "\n";
+    for (int i = 0; i < numGroups; i++)
+        cout << "N_alpha_" << statistics.milestoneGroups[i] << ": " << statistics.N_alpha_beta[i] << "\n";
+    for (int i = 0; i < numGroups; i++)
+        for (int j = 0; j < numGroups; j++)
+            if (i != j)
+                cout << "N_" << statistics.milestoneGroups[i] << "_" << statistics.milestoneGroups[j] << "_alpha: " << statistics.Nij_alpha[i][j] << "\n";
+    for (int i = 0; i < numGroups; i++)
+        cout << "R_" << statistics.milestoneGroups[i] << "_alpha: " << statistics.Ri_alpha[i] << "\n";
+    cout << "T_alpha: " << statistics.T_alpha << "\n";
+    cout << "checks per step: " << counters.getChecksPerStep() << "\n";
+    cout << "boundary check interval: " << counters.boundaryCheckInterval << "\n";
+    cout << "rollbacks: " << counters.numRollbacks << ", " << counters.numDiscardedSteps << " steps discarded\n";
+}
+
+int main(int argc, char* argv[]) {
+    vector<string> names;
+    double watchInterval = 0.0;
+    try {
+        for (int i = 1; i < argc; i++) {
+            string option = argv[i];
+            if (option == "-h" || option == "--help") {
+                printUsage(argv[0]);
+                return 0;
+            }
+            if (option == "--watch") {
+                if (i+1 >= argc)
+                    throw OpenMMException("Missing value for "+option);
+                string value = argv[++i];
+                char* end;
+                watchInterval = strtod(value.c_str(), &end);
+                if (value.empty() || *end != '\0' || !(watchInterval > 0.0))
+                    throw OpenMMException("Illegal value for "+option+": "+value);
+            }
+            else if (option.size() > 1 && option[0] == '-')
+                throw OpenMMException("Unknown option: "+option);
+            else
+                names.push_back(option);
+        }
+        if (names.empty()) {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    catch (const exception& e) {
+        cerr << "seekr2_status: " << e.what() << endl;
+        printUsage(argv[0]);
+        return 1;
+    }
+    
+    // A segment is attached again every time it is read, so that a new run
+    // of an anchor with the same segment name is picked up.
+    
+    cout.setf(ios::fixed, ios::floatfield);
+    cout.precision(3);
+    int result = 0;
+    while (true) {
+        result = 0;
+        for (int i = 0; i < names.size(); i++) {
+            try {
+                MmvtStatusSegment segment;
+                segment.attach(names[i]);
+                MmvtStatus status;
+                segment.read(status);
+                printStatus(segment.getName(), status);
+            }
+            catch (const exception& e) {
+                cerr << "seekr2_status: " << e.what() << endl;
+                result = 1;
+            }
+        }
+        cout.flush();
+        if (watchInterval == 0.0)
+            break;
+        this_thread::sleep_for(chrono::duration<double>(watchInterval));
+        cout << "\n";
+    }
+    return result;
+}
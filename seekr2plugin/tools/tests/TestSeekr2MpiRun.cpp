@@ -0,0 +1,176 @@
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * This tests seekr2_mpi_run by running it with mpiexec on this machine. It is
+ * given the command to launch the runner on the command line:
+ *
+ *     TestSeekr2MpiRun MPIEXEC NUMPROC_FLAG RUNNER PLUGIN_DIR [MPIEXEC_FLAGS...]
+ */
+
+#include "MmvtLangevinMiddleIntegrator.h"
+#include "MmvtKineticsEstimator.h"
+#include "openmm/internal/AssertionUtilities.h"
+#include "openmm/CustomExternalForce.h"
+#include "openmm/Context.h"
+#include "openmm/Platform.h"
+#include "openmm/State.h"
+#include "openmm/System.h"
+#include "openmm/VerletIntegrator.h"
+#include "openmm/serialization/XmlSerializer.h"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace Seekr2Plugin;
+using namespace OpenMM;
+using namespace std;
+
+const string outputDir = "/tmp/seekr2_mpi_run_test";
+
+/**
+ * Write the input files of an anchor holding one particle between walls at
+ * x = -1 and x = 1, moving toward x = 1 with the given speed.
+ */
+void writeAnchor(const string& name, double speed, ofstream& manifest) {
+    System system;
+    system.addParticle(1.0);
+    CustomExternalForce* boundaries = new CustomExternalForce("step(x-1.0)+2*step(-1.0-x)");
+    boundaries->addParticle(0);
+    boundaries->setForceGroup(1);
+    system.addForce(boundaries);
+    MmvtLangevinMiddleIntegrator integrator(0.0, 0.0, 0.01, outputDir+"/"+name+".log");
+    integrator.addMilestoneGroup(1);
+    integrator.addMilestoneGroup(2);
+    
+    // Create the State with a VerletIntegrator, so that the Reference
+    // kernels of the plugin need not be loaded here.
+    
+    VerletIntegrator verlet(0.01);
+    Context context(system, verlet, Platform::getPlatformByName("Reference"));
+    context.setPositions(vector<Vec3>(1, Vec3(0.05, 0, 0)));
+    context.setVelocities(vector<Vec3>(1, Vec3(speed, 0, 0)));
+    State state = context.getState(State::Positions | State::Velocities);
+    string prefix = outputDir+"/"+name;
+    ofstream systemFile((prefix+"_system.xml").c_str());
+    XmlSerializer::serialize<System>(&system, "System", systemFile);
+    ofstream stateFile((prefix+"_state.xml").c_str());
+    XmlSerializer::serialize<State>(&state, "State", stateFile);
+    ofstream integratorFile((prefix+"_integrator.xml").c_str());
+    XmlSerializer::serialize<Integrator>(&integrator, "Integrator", integratorFile);
+    manifest << name << " " << prefix << "_system.xml " << prefix << "_state.xml " << prefix << "_integrator.xml\n";
+}
+
+const char* names[] = {"fast", "medium", "slow"};
+
+void writeAnchors() {
+    string command = "rm -rf "+outputDir+" && mkdir -p "+outputDir;
+    ASSERT_EQUAL(0, system(command.c_str()));
+    double speeds[] = {1.0, 0.5, 0.25};
+    ofstream manifest((outputDir+"/anchors.txt").c_str());
+    manifest << "# name system state integrator\n";
+    for (int i = 0; i < 3; i++)
+        writeAnchor(names[i], speeds[i], manifest);
+}
+
+void runJob(const vector<string>& launch, int steps, const string& options="") {
+    stringstream run;
+    run << launch[0] << " " << launch[1] << " 3";
+    for (int i = 4; i < launch.size(); i++)
+        run << " " << launch[i];
+    run << " " << launch[2] << " --anchors " << outputDir << "/anchors.txt --steps " << steps << " --block-steps 250"
+        << " --platform Reference --plugin-dir " << launch[3] << " --output-dir " << outputDir << " " << options;
+    cout << run.str() << endl;
+    ASSERT_EQUAL(0, system(run.str().c_str()));
+}
+
+/**
+ * Check that every anchor ran 1000 steps in all, and that rank 0 wrote its
+ * statistics.
+ */
+void checkResults() {
+    int expectedBounces[] = {5, 3, 1};
+    for (int i = 0; i < 3; i++) {
+        string prefix = outputDir+"/"+names[i];
+        ifstream checkpointFile((prefix+".checkpoint.xml").c_str());
+        ASSERT(checkpointFile.good());
+        State* checkpoint = XmlSerializer::deserialize<State>(checkpointFile);
+        ASSERT_EQUAL_TOL(10.0, checkpoint->getTime(), 1e-6);
+        delete checkpoint;
+        MmvtAnchorStatistics statistics = MmvtKineticsEstimator::readStatisticsFile(prefix+".statistics.txt");
+        ASSERT_EQUAL(2, (int) statistics.milestoneGroups.size());
+        ASSERT_EQUAL(expectedBounces[i], statistics.N_alpha_beta[0]+statistics.N_alpha_beta[1]);
+        ASSERT_EQUAL(expectedBounces[i]-1, statistics.Nij_alpha[0][1]+statistics.Nij_alpha[1][0]);
+    }
+}
+
+void testMpiRun(const vector<string>& launch) {
+    // Three anchors shared by two worker ranks, so the first rank to finish
+    // its anchor must go on to run the third.
+    
+    writeAnchors();
+    runJob(launch, 1000);
+    checkResults();
+}
+
+void testResume(const vector<string>& launch) {
+    // A second job continues each anchor from the checkpoint of the first,
+    // with its statistics and step count, rather than starting it over.
+    
+    writeAnchors();
+    runJob(launch, 500);
+    runJob(launch, 1000, "--resume");
+    checkResults();
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 5) {
+        cout << "Usage: " << argv[0] << " MPIEXEC NUMPROC_FLAG RUNNER PLUGIN_DIR [MPIEXEC_FLAGS...]" << endl;
+        return 1;
+    }
+    try {
+        vector<string> launch(argv+1, argv+argc);
+        testMpiRun(launch);
+        testResume(launch);
+    }
+    catch(const exception& e) {
+        cout << "exception: " << e.what() << endl;
+        return 1;
+    }
+    cout << "Done" << endl;
+    return 0;
+}
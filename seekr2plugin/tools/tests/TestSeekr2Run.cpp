@@ -0,0 +1,245 @@
+/*
+ * Copyright 2019 by Lane Votapka
+ * All rights reserved
+ * -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2008-2012 Stanford University and the Authors.      *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+
+/**
+ * This tests that seekr2_run continues the bounce counter and statistics of
+ * an interrupted MMVT run. It is given the command to run on the command
+ * line:
+ *
+ *     TestSeekr2Run RUNNER PLUGIN_DIR
+ */
+
+#include "MmvtLangevinMiddleIntegrator.h"
+#include "MmvtKineticsEstimator.h"
+#include "openmm/internal/AssertionUtilities.h"
+#include "openmm/CustomExternalForce.h"
+#include "openmm/Context.h"
+#include "openmm/Platform.h"
+#include "openmm/State.h"
+#include "openmm/System.h"
+#include "openmm/VerletIntegrator.h"
+#include "openmm/serialization/XmlSerializer.h"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace Seekr2Plugin;
+using namespace OpenMM;
+using namespace std;
+
+const string outputDir = "/tmp/seekr2_run_test";
+
+/**
+ * Write the input files of a run of one particle between walls at x = -1 and
+ * x = 1, moving toward x = 1 at 1 nm/ps without friction, so that it bounces
+ * at the same times however the run is divided.
+ */
+void writeInputs(const string& name, int convergenceBlockSteps=0) {
+    System system;
+    system.addParticle(1.0);
+    CustomExternalForce* boundaries = new CustomExternalForce("step(x-1.0)+2*step(-1.0-x)");
+    boundaries->addParticle(0);
+    boundaries->setForceGroup(1);
+    system.addForce(boundaries);
+    string prefix = outputDir+"/"+name;
+    MmvtLangevinMiddleIntegrator integrator(0.0, 0.0, 0.01, prefix+".log");
+    integrator.addMilestoneGroup(1);
+    integrator.addMilestoneGroup(2);
+    integrator.setSaveStatisticsFileName(prefix+".statistics.txt");
+    if (convergenceBlockSteps > 0) {
+        integrator.setConvergenceBlockSteps(convergenceBlockSteps);
+        integrator.setConvergenceTolerance(10.0);
+    }
+    
+    // Create the State with a VerletIntegrator, so that the Reference
+    // kernels of the plugin need not be loaded here.
+    
+    VerletIntegrator verlet(0.01);
+    Context context(system, verlet, Platform::getPlatformByName("Reference"));
+    context.setPositions(vector<Vec3>(1, Vec3(0.0345, 0, 0)));
+    context.setVelocities(vector<Vec3>(1, Vec3(1.0, 0, 0)));
+    State state = context.getState(State::Positions | State::Velocities);
+    ofstream systemFile((prefix+"_system.xml").c_str());
+    XmlSerializer::serialize<System>(&system, "System", systemFile);
+    ofstream stateFile((prefix+"_state.xml").c_str());
+    XmlSerializer::serialize<State>(&state, "State", stateFile);
+    ofstream integratorFile((prefix+"_integrator.xml").c_str());
+    XmlSerializer::serialize<Integrator>(&integrator, "Integrator", integratorFile);
+}
+
+int runCommand(const vector<string>& launch, const string& name, const string& options) {
+    string prefix = outputDir+"/"+name;
+    stringstream command;
+    command << launch[0] << " --system " << prefix << "_system.xml --integrator " << prefix << "_integrator.xml "
+            << options << " --checkpoint " << prefix << ".checkpoint.xml --plugin-dir " << launch[1];
+    cout << command.str() << endl;
+    return system(command.str().c_str());
+}
+
+void run(const vector<string>& launch, const string& name, const string& start, int steps, const string& options="") {
+    stringstream allOptions;
+    allOptions << start << " --steps " << steps << " --platform Reference " << options;
+    ASSERT_EQUAL(0, runCommand(launch, name, allOptions.str()));
+}
+
+/**
+ * Read the number of steps run, as recorded beside a checkpoint.
+ */
+long long readStepsDone(const string& checkpointFileName) {
+    ifstream file((checkpointFileName+".integrator").c_str(), ios_base::binary);
+    long long stepsDone;
+    file.read((char*) &stepsDone, sizeof(long long));
+    ASSERT(file);
+    return stepsDone;
+}
+
+vector<string> readLines(const string& fileName) {
+    ifstream file(fileName.c_str());
+    vector<string> lines;
+    string line;
+    while (getline(file, line))
+        lines.push_back(line);
+    return lines;
+}
+
+void copyFile(const string& source, const string& dest) {
+    ifstream input(source.c_str(), ios_base::binary);
+    ofstream output(dest.c_str(), ios_base::binary);
+    output << input.rdbuf();
+}
+
+void testRestart(const vector<string>& launch) {
+    string command = "rm -rf "+outputDir+" && mkdir -p "+outputDir;
+    ASSERT_EQUAL(0, system(command.c_str()));
+    
+    // A run of 1000 steps without interruption bounces five times, shortly
+    // before t = 1, 3, 5, 7 and 9.
+    
+    writeInputs("whole");
+    run(launch, "whole", "--state "+outputDir+"/whole_state.xml", 1000);
+    vector<string> wholeLog = readLines(outputDir+"/whole.log");
+    ASSERT_EQUAL(6, (int) wholeLog.size());
+    
+    // Run the same 1000 steps in pieces. The run is checkpointed after 500
+    // steps and continued to 700, logging the fourth bounce, and then
+    // restarted from the checkpoint at 500 as though it had been killed
+    // after writing it.
+    
+    writeInputs("pieces");
+    string prefix = outputDir+"/pieces";
+    run(launch, "pieces", "--state "+prefix+"_state.xml", 500);
+    copyFile(prefix+".checkpoint.xml", prefix+".saved.xml");
+    copyFile(prefix+".checkpoint.xml.integrator", prefix+".saved.xml.integrator");
+    run(launch, "pieces", "--restart-from "+prefix+".checkpoint.xml", 700);
+    ASSERT_EQUAL(5, (int) readLines(prefix+".log").size());
+    run(launch, "pieces", "--restart-from "+prefix+".saved.xml", 1000);
+    
+    // The bounce indices continue from the checkpoint, the bounce logged
+    // after it is not repeated, and the statistics are those of the whole
+    // run rather than of the steps after the restart.
+    
+    vector<string> log = readLines(prefix+".log");
+    ASSERT_EQUAL(wholeLog.size(), log.size());
+    for (int i = 0; i < log.size(); i++)
+        ASSERT_EQUAL(wholeLog[i], log[i]);
+    for (int i = 1; i < log.size(); i++) {
+        int group, bounce;
+        char comma;
+        stringstream fields(log[i]);
+        fields >> group >> comma >> bounce;
+        ASSERT_EQUAL(i-1, bounce);
+    }
+    MmvtAnchorStatistics whole = MmvtKineticsEstimator::readStatisticsFile(outputDir+"/whole.statistics.txt");
+    MmvtAnchorStatistics pieces = MmvtKineticsEstimator::readStatisticsFile(prefix+".statistics.txt");
+    ASSERT_EQUAL(5, whole.N_alpha_beta[0]+whole.N_alpha_beta[1]);
+    for (int i = 0; i < 2; i++) {
+        ASSERT_EQUAL(whole.N_alpha_beta[i], pieces.N_alpha_beta[i]);
+        ASSERT_EQUAL_TOL(whole.Ri_alpha[i], pieces.Ri_alpha[i], 1e-6);
+        for (int j = 0; j < 2; j++)
+            ASSERT_EQUAL(whole.Nij_alpha[i][j], pieces.Nij_alpha[i][j]);
+    }
+    ASSERT_EQUAL_TOL(whole.T_alpha, pieces.T_alpha, 1e-6);
+    ifstream checkpointFile((prefix+".checkpoint.xml").c_str());
+    State* checkpoint = XmlSerializer::deserialize<State>(checkpointFile);
+    ASSERT_EQUAL_TOL(10.0, checkpoint->getTime(), 1e-6);
+    delete checkpoint;
+}
+
+void testEarlyStop(const vector<string>& launch) {
+    // The statistics converge partway through a chunk between checkpoints.
+    // The number of steps recorded is the number actually run, not the size
+    // of the chunks.
+    
+    writeInputs("converged", 200);
+    string prefix = outputDir+"/converged";
+    run(launch, "converged", "--state "+prefix+"_state.xml", 20000, "--checkpoint-interval 300");
+    long long stepsDone = readStepsDone(prefix+".checkpoint.xml");
+    ASSERT(stepsDone < 20000);
+    ASSERT_EQUAL(0, stepsDone%200);
+    ifstream checkpointFile((prefix+".checkpoint.xml").c_str());
+    State* checkpoint = XmlSerializer::deserialize<State>(checkpointFile);
+    ASSERT_EQUAL_TOL(stepsDone*0.01, checkpoint->getTime(), 1e-6);
+    delete checkpoint;
+}
+
+void testPropertyWithoutPlatform(const vector<string>& launch) {
+    // Platform properties cannot be applied to the default platform, so they
+    // are rejected rather than ignored.
+    
+    writeInputs("property");
+    ASSERT(runCommand(launch, "property", "--state "+outputDir+"/property_state.xml --steps 10 --property Threads=1") != 0);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        cout << "Usage: " << argv[0] << " RUNNER PLUGIN_DIR" << endl;
+        return 1;
+    }
+    try {
+        vector<string> launch(argv+1, argv+argc);
+        testRestart(launch);
+        testEarlyStop(launch);
+        testPropertyWithoutPlatform(launch);
+    }
+    catch(const exception& e) {
+        cout << "exception: " << e.what() << endl;
+        return 1;
+    }
+    cout << "Done" << endl;
+    return 0;
+}